@@ -0,0 +1,69 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "AnalogAxis.h"
+
+#include <cassert>
+#include <cstdlib>
+
+AnalogAxis::AnalogAxis(const Calibration &cal) :
+   m_cal(cal),
+   m_held(cal.centre)
+{
+   assert(cal.min < cal.centre && cal.centre < cal.max);
+}
+
+int32_t AnalogAxis::Map(uint16_t reading) const
+{
+   int32_t r  = reading;
+   int32_t hi = int32_t(m_cal.centre) + m_cal.deadzone;
+   int32_t lo = int32_t(m_cal.centre) - m_cal.deadzone;
+
+   // Each side is scaled on its own, so the centre needn't be half way
+   if (r >= hi)
+      return r >= m_cal.max ? RANGE : (r - hi) * RANGE / (m_cal.max - hi);
+   if (r <= lo)
+      return r <= m_cal.min ? -RANGE : -((lo - r) * RANGE / (lo - m_cal.min));
+
+   return 0;
+}
+
+int16_t AnalogAxis::Update(uint16_t reading)
+{
+   int32_t target = Map(reading);
+
+   if (target == m_value)
+      return m_value;
+
+   bool settled = target == 0 || target == RANGE || target == -RANGE;
+
+   if (settled || std::abs(int32_t(reading) - int32_t(m_held)) > m_cal.hysteresis)
+   {
+      m_held  = reading;
+      m_value = int16_t(target);
+   }
+
+   return m_value;
+}
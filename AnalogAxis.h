@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Turns a filtered analog reading into the signed value the report carries.
+// Each axis has its own end stops and centre, so a stick that only reaches
+// part of the ADC's range, or rests off centre, still covers the whole
+// report range with zero at rest.
+//
+// Readings within the deadzone of the centre report zero. Elsewhere the
+// output only follows once the reading has moved more than the hysteresis
+// from where it was last taken, so noise on a stick held still doesn't change
+// the report, and so doesn't send one. Settling on the centre or an end stop
+// is always taken, so those are never held a little short.
+class AnalogAxis
+{
+public:
+   static constexpr int32_t RANGE = 32767; // Output runs -RANGE to RANGE
+
+   // All in the 16-bit scale of InputData::analog
+   struct Calibration
+   {
+      uint16_t min        = 0x0000;
+      uint16_t centre     = 0x8000;
+      uint16_t max        = 0xFFE0; // A code short of the ADC's top, which the filter only approaches
+      uint16_t deadzone   = 0x0400; // Either side of centre, about 1.5% of travel
+      uint16_t hysteresis = 0x0060; // 6 ADC codes, a few times the filtered noise
+   };
+
+   AnalogAxis() = default;
+   explicit AnalogAxis(const Calibration &cal);
+
+   // Takes a new reading and returns the calibrated value
+   int16_t Update(uint16_t reading);
+
+   int16_t            Value() const          { return m_value; }
+   const Calibration &GetCalibration() const { return m_cal; }
+
+private:
+   int32_t Map(uint16_t reading) const;
+
+private:
+   Calibration m_cal;
+   uint16_t    m_held  = 0x8000; // Reading the output was last taken from
+   int16_t     m_value = 0;
+};
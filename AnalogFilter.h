@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+
+// Decimating filter for one ADC input. Every 2^oversampleBits 12-bit samples
+// are averaged into one 16-bit value, which cuts uncorrelated noise by the
+// square root of the count. That can optionally feed a first order IIR with
+// a time constant of 2^iirShift averages, for slow drift and hum that
+// averaging over a fraction of a millisecond can't reach.
+//
+// Add() is inline and all integer, since it runs for every conversion.
+class AnalogFilter
+{
+public:
+   static constexpr uint32_t MAX_OVERSAMPLE_BITS = 8;
+
+   AnalogFilter() = default;
+
+   AnalogFilter(uint32_t oversampleBits, uint32_t iirShift) :
+      m_oversampleBits(oversampleBits),
+      m_iirShift(iirShift)
+   {
+      assert(oversampleBits <= MAX_OVERSAMPLE_BITS && iirShift < 16);
+   }
+
+   // Returns true when the sample completes an average and Value() moves on
+   bool Add(uint16_t sample)
+   {
+      m_sum += sample;
+
+      if (++m_count < (1u << m_oversampleBits))
+         return false;
+
+      // At most 2^20 before the shift up to 16-bit scale, so no overflow
+      int32_t average = int32_t((m_sum << 4) >> m_oversampleBits);
+
+      m_sum   = 0;
+      m_count = 0;
+
+      if (!m_primed)
+      {
+         m_state  = average << IIR_FRAC_BITS;
+         m_primed = true;
+      }
+
+      m_state += ((average << IIR_FRAC_BITS) - m_state) >> m_iirShift;
+      m_value  = uint16_t(m_state >> IIR_FRAC_BITS);
+
+      return true;
+   }
+
+   // Takes effect from the next average
+   void SetIIRShift(uint32_t iirShift)
+   {
+      assert(iirShift < 16);
+      m_iirShift = iirShift;
+   }
+
+   // Latest output, 12-bit input scaled to 16 bits
+   uint16_t Value() const { return m_value; }
+
+private:
+   static constexpr uint32_t IIR_FRAC_BITS = 8;
+
+   uint32_t m_oversampleBits = 0;
+   uint32_t m_iirShift       = 0;
+   uint32_t m_sum            = 0;
+   uint32_t m_count          = 0;
+   int32_t  m_state          = 0; // 16.8
+   bool     m_primed         = false;
+   uint16_t m_value          = 0;
+};
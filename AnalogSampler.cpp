@@ -0,0 +1,159 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "AnalogSampler.h"
+
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+
+#include <cstdint>
+
+// Samples this close to a full lap behind are treated as lost
+constexpr uint32_t OVERRUN_MARGIN = 32;
+
+// Even at the ADC's top rate of 500kHz this lasts over 2 hours before the
+// control channel re-arms it
+constexpr uint32_t RELOAD_COUNT = 0xFFFFFFFF;
+
+// The ADC runs from a 48MHz clock and takes 96 of them per conversion
+constexpr uint32_t ADC_CLOCK_HZ   = 48000000;
+constexpr uint32_t ADC_CONVERSION = 96;
+
+// The write ring wraps on the low address bits, so it must be aligned to its size
+alignas(1u << AnalogSampler::RING_BITS) uint16_t AnalogSampler::s_ring[RING_SAMPLES];
+uint32_t AnalogSampler::s_reloadCount = RELOAD_COUNT;
+
+uint32_t AnalogSampler::RingUS(uint32_t sampleHz)
+{
+   return uint32_t(uint64_t(RING_SAMPLES - OVERRUN_MARGIN) * 1000000 / sampleHz);
+}
+
+AnalogSampler::AnalogSampler(uint32_t numChannels, uint32_t sampleHz, uint32_t oversampleBits, uint32_t iirShift) :
+   m_numChannels(numChannels)
+{
+   assert(numChannels > 0 && numChannels <= MAX_CHANNELS);
+   assert(sampleHz > 0 && sampleHz <= ADC_CLOCK_HZ / ADC_CONVERSION);
+
+   for (uint32_t i = 0; i < numChannels; i++)
+      m_filters[i] = AnalogFilter(oversampleBits, iirShift);
+
+   m_ringUS = RingUS(sampleHz);
+
+   adc_init();
+
+   // Make sure analog GPIO is high-impedance, no pullups etc
+   for (uint32_t i = 0; i < numChannels; i++)
+      adc_gpio_init(26 + i);
+
+   // A conversion every (1 + div) ADC clocks, one DMA request each
+   adc_set_clkdiv(float(ADC_CLOCK_HZ / sampleHz - 1));
+   adc_set_round_robin((1u << numChannels) - 1);
+   adc_fifo_setup(true, true, 1, false, false);
+
+   m_dataChannel = dma_claim_unused_channel(true);
+   m_ctrlChannel = dma_claim_unused_channel(true);
+
+   // The control channel writes the reload count to the data channel's
+   // trigger alias. The write address isn't reset, so it carries on round the ring.
+   dma_channel_config ctrlCfg = dma_channel_get_default_config(m_ctrlChannel);
+   channel_config_set_transfer_data_size(&ctrlCfg, DMA_SIZE_32);
+   channel_config_set_read_increment(&ctrlCfg, false);
+   channel_config_set_write_increment(&ctrlCfg, false);
+   dma_channel_configure(m_ctrlChannel, &ctrlCfg, &dma_hw->ch[m_dataChannel].al1_transfer_count_trig,
+                         &s_reloadCount, 1, false);
+
+   dma_channel_config dataCfg = dma_channel_get_default_config(m_dataChannel);
+   channel_config_set_transfer_data_size(&dataCfg, DMA_SIZE_16);
+   channel_config_set_read_increment(&dataCfg, false);
+   channel_config_set_write_increment(&dataCfg, true);
+   channel_config_set_ring(&dataCfg, true, RING_BITS);
+   channel_config_set_dreq(&dataCfg, DREQ_ADC);
+   channel_config_set_chain_to(&dataCfg, m_ctrlChannel);
+   dma_channel_configure(m_dataChannel, &dataCfg, s_ring, &adc_hw->fifo, RELOAD_COUNT, true);
+
+   m_running = true;
+
+   Restart();
+}
+
+uint32_t AnalogSampler::WritePos() const
+{
+   uint32_t written = dma_hw->ch[m_dataChannel].write_addr - uint32_t(uintptr_t(s_ring));
+   return (written / sizeof(uint16_t)) & (RING_SAMPLES - 1);
+}
+
+void AnalogSampler::Restart()
+{
+   adc_run(false);
+
+   // Let the conversion in flight land in the ring
+   while (!(adc_hw->cs & ADC_CS_READY_BITS))
+      tight_loop_contents();
+
+   adc_fifo_drain();
+
+   // Round robin starts from the selected input
+   adc_select_input(0);
+
+   m_readPos      = WritePos();
+   m_nextChannel  = 0;
+   m_lastUpdateUS = time_us_32();
+
+   adc_run(true);
+}
+
+void AnalogSampler::Update()
+{
+   uint32_t nowUS = time_us_32();
+
+   // A full ring looks just like an empty one, and loses track of which
+   // input is which, so start again if we could have been lapped
+   if (nowUS - m_lastUpdateUS >= m_ringUS)
+   {
+      m_stats.overruns++;
+      Restart();
+      return;
+   }
+
+   uint32_t writePos = WritePos();
+   uint32_t avail    = (writePos - m_readPos) & (RING_SAMPLES - 1);
+   uint32_t channel  = m_nextChannel;
+
+   m_lastUpdateUS   = nowUS;
+   m_stats.samples += avail;
+
+   for (uint32_t i = 0; i < avail; i++)
+   {
+      if (m_filters[channel].Add(s_ring[(m_readPos + i) & (RING_SAMPLES - 1)]))
+         m_stats.outputs++;
+
+      if (++channel == m_numChannels)
+         channel = 0;
+   }
+
+   m_readPos     = writePos;
+   m_nextChannel = channel;
+}
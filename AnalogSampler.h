@@ -0,0 +1,94 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "AnalogFilter.h"
+
+#include <cstdint>
+
+// Runs the ADC free, round robin over the first numChannels inputs, and DMAs
+// every conversion into a ring, so reading the analogs never waits on a
+// conversion. Update() feeds whatever has arrived through each input's
+// AnalogFilter, and Value() is always the latest filtered reading.
+//
+// As with ButtonSampler, a second DMA channel re-arms the first when its
+// transfer count runs out. The ADC FIFO doesn't say which input a sample came
+// from, so that's kept by counting; if Update() falls a whole ring behind,
+// the count is lost and the ADC is restarted on the first input.
+class AnalogSampler
+{
+public:
+   struct Stats
+   {
+      uint32_t samples  = 0; // Conversions taken out of the ring
+      uint32_t outputs  = 0; // Filtered values produced, over all inputs
+      uint32_t overruns = 0; // Restarts after the ring wrapped
+   };
+
+   static constexpr uint32_t MAX_CHANNELS = 3;
+   static constexpr uint32_t RING_BITS    = 11;
+   static constexpr uint32_t RING_SAMPLES = (1u << RING_BITS) / sizeof(uint16_t);
+
+   AnalogSampler() = default;
+   AnalogSampler(uint32_t numChannels, uint32_t sampleHz, uint32_t oversampleBits, uint32_t iirShift);
+
+   // How long the ring lasts at sampleHz, less a margin; Update() must be
+   // called at least this often or the samples are lost
+   static uint32_t RingUS(uint32_t sampleHz);
+
+   bool Running() const { return m_running; }
+
+   void     Update();
+   uint16_t Value(uint32_t channel) const { return m_filters[channel].Value(); }
+
+   // Filter strength for every input, see AnalogFilter
+   void SetIIRShift(uint32_t iirShift)
+   {
+      for (AnalogFilter &filter : m_filters)
+         filter.SetIIRShift(iirShift);
+   }
+
+   const Stats &GetStats() const { return m_stats; }
+
+private:
+   uint32_t WritePos() const;
+   void     Restart();
+
+   static uint16_t s_ring[RING_SAMPLES];
+   static uint32_t s_reloadCount;
+
+   bool     m_running     = false;
+   uint32_t m_numChannels = 0;
+   uint32_t m_dataChannel = 0;
+   uint32_t m_ctrlChannel = 0;
+   uint32_t m_ringUS      = 0; // How long the ring takes to fill, less a margin
+
+   uint32_t     m_readPos      = 0;
+   uint32_t     m_nextChannel  = 0; // Input the sample at m_readPos came from
+   uint32_t     m_lastUpdateUS = 0;
+   AnalogFilter m_filters[MAX_CHANNELS];
+   Stats        m_stats;
+};
@@ -23,24 +23,147 @@
  *
  */
 #include "ArcadeCtrl.h"
+#include "ConfigStore.h"
 
 #include "bsp/board.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+
+#include <algorithm>
+#include <cstring>
+
+static ArcadeCtrl *s_irqCtrl;
+static ArcadeCtrl *s_core1Ctrl;
+
+// Flat at slow speeds for fine aiming, rising to 3x for fast spins. Speeds
+// are raw counts per ms, before the board's gain.
+const Encoder::AccelCurve ArcadeCtrl::s_trackballAccel =
+{
+   3,
+   {
+      { Encoder::ToFixed(1.0f),  Encoder::ToFixed(1.0f) },
+      { Encoder::ToFixed(4.0f),  Encoder::ToFixed(2.0f) },
+      { Encoder::ToFixed(12.0f), Encoder::ToFixed(3.0f) }
+   }
+};
+
+// MAME's defaults, wired as the two player table entry below: player 1's
+// joystick on 0-3, buttons on 4-9 and start on 20, player 2's buttons on
+// 10-15 and joystick on 16-19
+const KeyMap ArcadeCtrl::s_mameKeys =
+{
+   {
+      HID_KEY_ARROW_UP, HID_KEY_ARROW_DOWN, HID_KEY_ARROW_LEFT, HID_KEY_ARROW_RIGHT,
+      HID_KEY_CONTROL_LEFT, HID_KEY_ALT_LEFT, HID_KEY_SPACE, HID_KEY_SHIFT_LEFT, HID_KEY_Z, HID_KEY_X,
+      HID_KEY_A, HID_KEY_S, HID_KEY_Q, HID_KEY_W, HID_KEY_I, HID_KEY_K,
+      HID_KEY_R, HID_KEY_F, HID_KEY_D, HID_KEY_G,
+      HID_KEY_1, 0, 0, 0,
+      HID_KEY_5, HID_KEY_9 // Coin and service, from s_hotkeyRemap
+   }
+};
+
+// For the one player wiring: GPIO 10 is a shift button, turning start into
+// coin and the first button into service while it's held. The two are sent
+// as buttons 24 and 25, with keys in s_mameKeys.
+const RemapTable ArcadeCtrl::s_hotkeyRemap =
+{
+   10,
+   0, {},
+   2,
+   {
+      { 20, 24 },
+      { 4,  25 }
+   }
+};
 
 // BOARD CONFIG - chosen based on the DIP of the connected board
 // One config per dip option (00, 01, 10, 11)
 ArcadeCtrl::BoardConfig ArcadeCtrl::s_boardConfigs[4] =
 {
-   // Analogs  Encoders  Gain
-   0,          2,        10.0f,    // Player 1 with low PPR trackball
-   0,          1,       -1.0f,     // Player 2 with high PPR spinner (reversed)
-   0,          0,        1.0f,
-   0,          0,        1.0f
+   // Analogs  Encoders  Gain     IRQ press  Dual core  SOF lead us  Split HID  Release us  Confirm mask  Confirm us  PIO sampler  PIO count  Smooth  Accel                ADC DMA  Player 2 mask  Keymap   Turbo mask  Turbo polls  Remap    Sleep
+   { 0,        2,        10.0f,   false,     false,     0,           true,      5000,       0,            0,          false,       false,     false,  &s_trackballAccel,   true,    0,             nullptr,  0,          2,           nullptr, true },    // Player 1 with low PPR trackball
+   { 0,        1,       -1.0f,    false,     false,     0,           true,      5000,       0,            0,          false,       false,     false,  nullptr,             true,    0,             nullptr,  0,          2,           nullptr, true },    // Player 2 with high PPR spinner (reversed)
+   { 0,        0,        1.0f,    false,     false,     0,           true,      5000,       0,            0,          false,       false,     false,  nullptr,             true,    0,             nullptr,  0,          2,           nullptr, true },
+   { 0,        0,        1.0f,    false,     false,     0,           true,      5000,       0,            0,          false,       false,     false,  nullptr,             true,    0x000FFC00,    nullptr,  0,          2,           nullptr, true }     // Two players, second joystick on 16-19 and buttons on 10-15
 };
 
+// SAVED CONFIG - board configs kept in flash override the table above
+
+// Limits on the values that can be changed after the build, whether tuned
+// over USB or read back from flash
+constexpr uint32_t MAX_POLL_MS      = 64;
+constexpr uint32_t MAX_FILTER_SHIFT = 8;
+constexpr int32_t  MAX_GAIN         = 1000 << 16;
+constexpr uint32_t MAX_TURBO_POLLS  = 64;
+
+// Bump on any change to StoredBoardConfig, so old records are ignored rather than misread
+constexpr uint16_t CONFIG_VERSION = 6;
+
+enum
+{
+   STORED_IRQ_PRESS   = 1 << 0,
+   STORED_DUAL_CORE   = 1 << 1,
+   STORED_SPLIT_HID   = 1 << 2,
+   STORED_PIO_SAMPLER = 1 << 3,
+   STORED_PIO_COUNT   = 1 << 4,
+   STORED_SMOOTH      = 1 << 5,
+   STORED_ADC_DMA     = 1 << 6,
+   STORED_SLEEP       = 1 << 7,
+};
+
+// Curves a saved config can pick, by index
+static const Encoder::AccelCurve *const s_accelCurves[] = { nullptr, &ArcadeCtrl::s_trackballAccel };
+
+constexpr uint32_t NUM_ACCEL_CURVES = sizeof(s_accelCurves) / sizeof(s_accelCurves[0]);
+
+// And key maps
+static const KeyMap *const s_keymaps[] = { nullptr, &ArcadeCtrl::s_mameKeys };
+
+constexpr uint32_t NUM_KEYMAPS = sizeof(s_keymaps) / sizeof(s_keymaps[0]);
+
+// And remaps
+static const RemapTable *const s_remaps[] = { nullptr, &ArcadeCtrl::s_hotkeyRemap };
+
+constexpr uint32_t NUM_REMAPS = sizeof(s_remaps) / sizeof(s_remaps[0]);
+
+struct StoredBoardConfig
+{
+   uint8_t  valid;       // Otherwise the table's entry for this DIP stands
+   uint8_t  numAnalogs;
+   uint8_t  numEncoders;
+   uint8_t  accel;       // Index into s_accelCurves
+   uint32_t flags;       // STORED_*
+   float    encoderGain;
+   uint32_t sofLeadUS;
+   uint32_t releaseUS;
+   uint32_t confirmMask;
+   uint32_t confirmUS;
+   uint32_t player2Mask;
+   uint32_t turboMask;
+   uint8_t  pollMS;
+   uint8_t  adcFilterShift;
+   uint8_t  keymap;      // Index into s_keymaps, zero for the gamepad
+   uint8_t  turboPolls;
+   uint8_t  remap;       // Index into s_remaps, zero for none
+   uint8_t  reserved[3];
+
+   AnalogAxis::Calibration axisCal[3];
+};
+
+// One per DIP setting
+struct StoredConfig
+{
+   StoredBoardConfig boards[4];
+};
+
+static_assert(sizeof(StoredConfig) <= ConfigStore::MAX_DATA, "saved configs don't fit a record");
+
 // PIN CONFIG
 
 // First 0-15 & pin 20 are button GPIO inputs.
-// 16 through 19 are either encoder inputs or can be used for a second joystick.
+// 16 through 19 are either encoder inputs or can be used for a second joystick,
+// when no encoders are fitted (see BoardConfig::player2Mask).
 // 21 & 22 are DIP switch inputs.
 // 26, 27 & 28 are fixed analog inputs (hardcoded in Analog.cpp)
 
@@ -62,6 +185,31 @@ constexpr uint32_t GPIO_MASK = INPUT_MASK | DIP_MASK | PIO_MASK;
 
 constexpr uint32_t POLL_INTERVAL_MS = 1;
 
+// Resolution of the debounce windows
+constexpr uint32_t DEBOUNCE_TICK_US = 250;
+
+// PIO button sampling at 100kHz. The encoders each take state machine 0 and
+// the first 24 (28 when counting) instructions of their PIO; pio1 only has
+// one with two encoders.
+constexpr uint32_t SAMPLER_PIO_INDEX = 1;
+constexpr uint32_t SAMPLE_PERIOD_US  = 10;
+
+// Hardware alarm flipping the autofire phase
+constexpr uint32_t AUTOFIRE_ALARM = 0;
+
+// Waiting for a deadline wakes this much ahead of it and spins the rest, as
+// getting out of WFE through the alarm interrupt takes a few us
+constexpr uint32_t WAKE_EARLY_US = 4;
+
+// Free-running ADC, per input. Each filtered value averages 16 conversions,
+// so 2kHz, then smooths over 2 of those.
+constexpr uint32_t ADC_INPUT_HZ        = 32000;
+constexpr uint32_t ADC_OVERSAMPLE_BITS = 4;
+
+// HID endpoint polling interval we ask the host for
+constexpr uint8_t HID_INTERVAL_MS     = 5;
+constexpr uint8_t HID_SOF_INTERVAL_MS = 1;
+
 enum
 {
    BLINK_NOT_MOUNTED = 250,
@@ -80,21 +228,231 @@ ArcadeCtrl::ArcadeCtrl()
 
    m_boardCfg = s_boardConfigs[pidDip];
 
-   m_usb = USB(pidDip, m_boardCfg.numAnalogs, m_boardCfg.numEncoders);
+   // Read once here, so nothing after boot goes to flash for config
+   m_dip             = pidDip;
+   m_configFromFlash = LoadBoardConfig(pidDip, &m_boardCfg);
+
+   bool sofSync = m_boardCfg.sofLeadUS != 0;
+
+   // Without encoders, their pins are free for a second joystick
+   m_inputMask = INPUT_MASK;
+
+   if (m_boardCfg.numEncoders == 0)
+      m_inputMask |= m_boardCfg.player2Mask & PIO_MASK;
+
+   // Everything past the debouncer works on the buttons as remapped
+   m_buttonMask = m_inputMask;
+
+   if (m_boardCfg.remap != nullptr)
+   {
+      m_remap      = ButtonRemap(*m_boardCfg.remap);
+      m_buttonMask = m_remap.Outputs(m_inputMask);
+   }
+
+   m_usb = USB(pidDip, m_boardCfg.numAnalogs, m_boardCfg.numEncoders,
+               sofSync ? HID_SOF_INTERVAL_MS : HID_INTERVAL_MS, m_boardCfg.splitHID,
+               m_boardCfg.player2Mask & m_buttonMask);
+
+   m_autofire = Autofire(m_boardCfg.turboMask & m_buttonMask, m_boardCfg.turboPolls);
+
+   if (sofSync || m_autofire.Enabled())
+      m_usb.EnableSOF();
+
+   if (m_boardCfg.keymap != nullptr)
+      m_usb.EnableKeyboard(*m_boardCfg.keymap);
+
+   // Every button gets the same windows for now, but the debouncer takes them per button
+   m_debouncer = Debouncer(DEBOUNCE_TICK_US);
+   m_debouncer.SetReleaseWindow(m_inputMask, m_boardCfg.releaseUS);
+   m_debouncer.SetPressConfirm(m_boardCfg.confirmMask & m_inputMask, m_boardCfg.confirmUS);
 
    // Create our encoder inputs
    if (m_boardCfg.numEncoders > 0)
-      m_encoders[0] = Encoder(0, ENCODER0_A_PIN, ENCODER0_B_PIN, m_boardCfg.encoderGain);
+      m_encoders[0] = Encoder(0, ENCODER0_A_PIN, ENCODER0_B_PIN, m_boardCfg.encoderGain, m_boardCfg.pioCount);
    if (m_boardCfg.numEncoders > 1)
-      m_encoders[1] = Encoder(1, ENCODER1_A_PIN, ENCODER1_B_PIN, m_boardCfg.encoderGain);
+      m_encoders[1] = Encoder(1, ENCODER1_A_PIN, ENCODER1_B_PIN, m_boardCfg.encoderGain, m_boardCfg.pioCount);
+
+   for (uint32_t i = 0; i < m_boardCfg.numEncoders; i++)
+   {
+      m_encoders[i].SetSmoothing(m_boardCfg.smooth);
+      m_encoders[i].SetAccel(m_boardCfg.accel);
+   }
+
+   // After the encoders, whose program has to be loaded at offset 0
+   if (m_boardCfg.pioSampler)
+      m_sampler = ButtonSampler(SAMPLER_PIO_INDEX, SAMPLE_PERIOD_US);
 
    // Create our analog inputs
+   if (m_boardCfg.adcDMA && m_boardCfg.numAnalogs > 0)
+      m_analogSampler = AnalogSampler(m_boardCfg.numAnalogs, ADC_INPUT_HZ * m_boardCfg.numAnalogs,
+                                      ADC_OVERSAMPLE_BITS, m_boardCfg.adcFilterShift);
+   else
+   {
+      for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
+         m_analogs[i] = Analog(i);
+   }
+
    for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
-      m_analogs[i] = Analog(i);
+      m_axes[i] = AnalogAxis(m_boardCfg.axisCal[i]);
+
+   if (m_boardCfg.irqPressPath && !m_boardCfg.dualCore)
+      InitPressIRQ();
 
    // The tiny-usb code is essentially a singleton, so register our
    // class to interact with it
    RegisterUSBHandler(&m_usb);
+
+   USB::FeatureHandler tuning;
+   tuning.get = &GetTuning;
+   tuning.set = &SetTuning;
+   tuning.ctx = this;
+   m_usb.SetFeatureHandler(tuning);
+}
+
+// The DMA rings are only drained once a poll, so a slower poll than either
+// lasts would lose every lap: the axes would freeze and taps go missing
+static uint32_t MaxPollMS(uint32_t numAnalogs, bool adcDMA, bool pioSampler)
+{
+   uint32_t ringUS = UINT32_MAX;
+
+   if (adcDMA && numAnalogs > 0)
+      ringUS = AnalogSampler::RingUS(ADC_INPUT_HZ * numAnalogs);
+
+   if (pioSampler)
+      ringUS = std::min(ringUS, ButtonSampler::RingUS(SAMPLE_PERIOD_US));
+
+   // Less a millisecond, as a poll can start that late
+   return std::min(MAX_POLL_MS, ringUS / 1000 - 1);
+}
+
+static bool PackBoardConfig(const ArcadeCtrl::BoardConfig &cfg, StoredBoardConfig *stored)
+{
+   uint32_t accel = 0;
+
+   while (accel < NUM_ACCEL_CURVES && s_accelCurves[accel] != cfg.accel)
+      accel++;
+
+   if (accel == NUM_ACCEL_CURVES)
+      return false; // Only curves built in can be saved
+
+   uint32_t keymap = 0;
+
+   while (keymap < NUM_KEYMAPS && s_keymaps[keymap] != cfg.keymap)
+      keymap++;
+
+   if (keymap == NUM_KEYMAPS)
+      return false; // Likewise key maps
+
+   uint32_t remap = 0;
+
+   while (remap < NUM_REMAPS && s_remaps[remap] != cfg.remap)
+      remap++;
+
+   if (remap == NUM_REMAPS)
+      return false; // And remaps
+
+   stored->valid       = 1;
+   stored->numAnalogs  = uint8_t(cfg.numAnalogs);
+   stored->numEncoders = uint8_t(cfg.numEncoders);
+   stored->accel       = uint8_t(accel);
+   stored->keymap      = uint8_t(keymap);
+   stored->remap       = uint8_t(remap);
+   stored->encoderGain = cfg.encoderGain;
+   stored->sofLeadUS   = cfg.sofLeadUS;
+   stored->releaseUS   = cfg.releaseUS;
+   stored->confirmMask = cfg.confirmMask;
+   stored->confirmUS   = cfg.confirmUS;
+   stored->player2Mask = cfg.player2Mask;
+   stored->turboMask   = cfg.turboMask;
+   stored->turboPolls  = uint8_t(cfg.turboPolls);
+   stored->pollMS      = uint8_t(cfg.pollMS);
+
+   stored->adcFilterShift = uint8_t(cfg.adcFilterShift);
+
+   stored->flags = (cfg.irqPressPath ? STORED_IRQ_PRESS   : 0) |
+                   (cfg.dualCore     ? STORED_DUAL_CORE   : 0) |
+                   (cfg.splitHID     ? STORED_SPLIT_HID   : 0) |
+                   (cfg.pioSampler   ? STORED_PIO_SAMPLER : 0) |
+                   (cfg.pioCount     ? STORED_PIO_COUNT   : 0) |
+                   (cfg.smooth       ? STORED_SMOOTH      : 0) |
+                   (cfg.adcDMA       ? STORED_ADC_DMA     : 0) |
+                   (cfg.sleep        ? STORED_SLEEP       : 0);
+
+   memcpy(stored->axisCal, cfg.axisCal, sizeof(stored->axisCal));
+
+   return true;
+}
+
+// Anything out of range leaves cfg alone, so a bad record falls back to the table
+static bool UnpackBoardConfig(const StoredBoardConfig &stored, ArcadeCtrl::BoardConfig *cfg)
+{
+   if (!stored.valid || stored.numAnalogs > 3 || stored.numEncoders > 2 || stored.accel >= NUM_ACCEL_CURVES ||
+       stored.pollMS == 0 ||
+       stored.pollMS > MaxPollMS(stored.numAnalogs, stored.flags & STORED_ADC_DMA, stored.flags & STORED_PIO_SAMPLER) ||
+       stored.adcFilterShift > MAX_FILTER_SHIFT ||
+       (stored.player2Mask & ~(INPUT_MASK | PIO_MASK)) != 0 || stored.keymap >= NUM_KEYMAPS ||
+       (stored.turboMask & ~(INPUT_MASK | PIO_MASK)) != 0 || stored.turboPolls > MAX_TURBO_POLLS ||
+       stored.remap >= NUM_REMAPS)
+      return false;
+
+   for (const AnalogAxis::Calibration &cal : stored.axisCal)
+      if (!(cal.min < cal.centre && cal.centre < cal.max))
+         return false;
+
+   cfg->numAnalogs   = stored.numAnalogs;
+   cfg->numEncoders  = stored.numEncoders;
+   cfg->encoderGain  = stored.encoderGain;
+   cfg->irqPressPath = stored.flags & STORED_IRQ_PRESS;
+   cfg->dualCore     = stored.flags & STORED_DUAL_CORE;
+   cfg->sofLeadUS    = stored.sofLeadUS;
+   cfg->splitHID     = stored.flags & STORED_SPLIT_HID;
+   cfg->releaseUS    = stored.releaseUS;
+   cfg->confirmMask  = stored.confirmMask;
+   cfg->confirmUS    = stored.confirmUS;
+   cfg->player2Mask  = stored.player2Mask;
+   cfg->turboMask    = stored.turboMask;
+   cfg->turboPolls   = stored.turboPolls;
+   cfg->pioSampler   = stored.flags & STORED_PIO_SAMPLER;
+   cfg->pioCount     = stored.flags & STORED_PIO_COUNT;
+   cfg->smooth       = stored.flags & STORED_SMOOTH;
+   cfg->accel        = s_accelCurves[stored.accel];
+   cfg->keymap       = s_keymaps[stored.keymap];
+   cfg->remap        = s_remaps[stored.remap];
+   cfg->adcDMA       = stored.flags & STORED_ADC_DMA;
+   cfg->sleep        = stored.flags & STORED_SLEEP;
+   cfg->pollMS       = stored.pollMS;
+
+   cfg->adcFilterShift = stored.adcFilterShift;
+
+   memcpy(cfg->axisCal, stored.axisCal, sizeof(cfg->axisCal));
+
+   return true;
+}
+
+bool ArcadeCtrl::LoadBoardConfig(uint32_t dip, BoardConfig *cfg)
+{
+   ConfigStore  store;
+   StoredConfig stored;
+
+   if (!store.Load(CONFIG_VERSION, &stored, sizeof(stored)))
+      return false;
+
+   return UnpackBoardConfig(stored.boards[dip], cfg);
+}
+
+bool ArcadeCtrl::SaveBoardConfig(uint32_t dip, const BoardConfig &cfg)
+{
+   ConfigStore  store;
+   StoredConfig stored;
+
+   // Keep whatever is saved for the other DIP settings
+   if (!store.Load(CONFIG_VERSION, &stored, sizeof(stored)))
+      stored = {};
+
+   if (!PackBoardConfig(cfg, &stored.boards[dip & 3]))
+      return false;
+
+   return store.Save(CONFIG_VERSION, &stored, sizeof(stored));
 }
 
 void ArcadeCtrl::UpdateBlinker()
@@ -112,62 +470,546 @@ void ArcadeCtrl::UpdateBlinker()
    m_blinker.Process();
 }
 
+// On the millisecond the blinker will see it, as it counts in those
+uint64_t ArcadeCtrl::BlinkerDueUS(uint64_t nowUS) const
+{
+   uint64_t nowMS = nowUS / 1000;
+
+   return (nowMS + m_blinker.MSUntilChange(uint32_t(nowMS))) * 1000;
+}
+
+// Sleeps until an interrupt, an SEV from the other core, or the first
+// deadline: pollUS, and on core0 the LED's next change. Anything that wakes
+// us early just runs the loop again.
+void ArcadeCtrl::WaitForWork(uint64_t pollUS)
+{
+   if (!m_boardCfg.sleep)
+      return;
+
+   uint64_t now        = time_us_64();
+   uint64_t deadlineUS = get_core_num() == 0 ? std::min(pollUS, BlinkerDueUS(now)) : pollUS;
+
+   if (deadlineUS <= now + WAKE_EARLY_US)
+      return;
+
+   best_effort_wfe_or_timeout(from_us_since_boot(deadlineUS - WAKE_EARLY_US));
+
+   m_usb.GetTelemetry().Slept(get_core_num(), uint32_t(time_us_64() - now));
+}
+
+// Its cadence follows the host's polls, so it waits for the SOF lock
+void ArcadeCtrl::StartAutofire()
+{
+   if (m_autofire.Enabled() && !m_autofire.Running() && m_usb.SOFLocked())
+      m_autofire.Start(AUTOFIRE_ALARM, m_usb);
+}
+
 int ArcadeCtrl::Run()
 {
-   uint32_t startMS = 0;
+   if (m_boardCfg.dualCore)
+      return RunDualCore();
+
+   Telemetry &telemetry = m_usb.GetTelemetry();
 
    do
    {
+      // Nothing to do before the next poll or LED change, unless an interrupt brings it
+      WaitForWork(m_nextPollUS);
+
+      telemetry.LoopIteration();
+
       // We do these two every time in the loop, regardless of polling interval
       m_usb.Process();
+      m_trace.Flush();
       UpdateBlinker();
+      StartAutofire();
+      SaveTuning();
 
-      uint32_t now = to_ms_since_boot(get_absolute_time());
+      // Presses caught by the GPIO interrupt don't wait for the poll
+      if (m_boardCfg.irqPressPath)
+         SendIRQPresses(uint32_t(m_nextPollUS));
 
       // Poll inputs at defined interval
-      if (now - startMS < POLL_INTERVAL_MS)
+      if (!PollDue())
          continue;
 
-      startMS = now;
+      ApplyTuning();
 
       const InputData &lastSent = m_usb.LastSentData();
       InputData        inputs;
 
       ReadInputs(&inputs, lastSent);
+      NextEdge(&inputs);
+
+      inputs.buttons = m_autofire.Apply(inputs.buttons);
+
+      // Held back, the change stays queued for the poll after the flip
+      uint32_t dirty = m_autofire.Holding(time_us_32()) ? 0 : m_usb.DirtyReports(inputs, lastSent);
+      bool     sent  = dirty != 0 && m_usb.SendData(inputs, dirty);
+
+      m_trace.Record(inputs, sent ? time_us_32() : 0);
+   }
+   while (true);
+
+   return 0;
+}
 
-      if (NeedsSending(inputs, lastSent))
-         m_usb.SendData(inputs);
+// Core0 only services USB and the LED; core1 samples, debounces and decides
+// what has changed, handing snapshots over through a lock-free ring so that
+// neither side ever waits for the other.
+int ArcadeCtrl::RunDualCore()
+{
+   assert(s_core1Ctrl == nullptr);
+   s_core1Ctrl = this;
+
+   multicore_launch_core1(&Core1Entry);
+
+   Telemetry &telemetry = m_usb.GetTelemetry();
+
+   do
+   {
+      // The poll is core1's, which sends an event with each snapshot
+      WaitForWork(UINT64_MAX);
+
+      telemetry.LoopIteration();
+
+      m_usb.Process();
+      m_trace.Flush();
+      UpdateBlinker();
+      StartAutofire();
+      SendSnapshots();
+      SaveTuning();
    }
    while (true);
 
    return 0;
 }
 
+void ArcadeCtrl::Core1Entry()
+{
+   // Lets core0 park us while it writes flash
+   multicore_lockout_victim_init();
+
+   s_core1Ctrl->SampleLoop();
+}
+
+void ArcadeCtrl::SampleLoop()
+{
+   InputData lastPublished {};
+
+   do
+   {
+      WaitForWork(m_nextPollUS);
+
+      if (!PollDue())
+         continue;
+
+      ApplyTuning();
+
+      InputSnapshot snapshot;
+      ReadInputs(&snapshot.inputs, lastPublished);
+
+      if (m_usb.DirtyReports(snapshot.inputs, lastPublished) == 0)
+         continue;
+
+      snapshot.sampleUS = time_us_32();
+
+      // If core0 has fallen this far behind, drop this sample. lastPublished
+      // is left alone, so the change is picked up again by the next poll.
+      if (!m_snapshots.Push(snapshot))
+      {
+         m_pipelineStats.overruns++;
+         continue;
+      }
+
+      m_pipelineStats.published++;
+      lastPublished = snapshot.inputs;
+
+      // Wakes core0 to send it
+      __sev();
+   }
+   while (true);
+}
+
+void ArcadeCtrl::SendSnapshots()
+{
+   InputSnapshot snapshot;
+
+   // Only the newest snapshot matters, older ones are superseded by it
+   while (m_snapshots.Pop(&snapshot))
+   {
+      uint32_t age = time_us_32() - snapshot.sampleUS;
+
+      m_pipelineStats.consumed++;
+      m_pipelineStats.totalAgeUS += age;
+      m_pipelineStats.maxAgeUS = std::max(m_pipelineStats.maxAgeUS, age);
+
+      if (m_havePendingSnapshot)
+         m_pipelineStats.superseded++;
+
+      m_pendingSnapshot     = snapshot;
+      m_havePendingSnapshot = true;
+   }
+
+   const InputData &lastSent = m_usb.LastSentData();
+   InputData        inputs   = lastSent;
+
+   if (m_havePendingSnapshot)
+   {
+      inputs = m_pendingSnapshot.inputs;
+
+      // Core1 works out encoder deltas against what it last published, but they
+      // must be relative to what the host last received.
+      for (uint32_t i = 0; i < m_boardCfg.numEncoders; i++)
+         inputs.angleDelta[i] = inputs.angle[i] - lastSent.angle[i];
+   }
+   else
+   {
+      // Held as core1 last saw them, for turbo to flip
+      inputs.buttons       = m_pendingSnapshot.inputs.buttons;
+      inputs.angleDelta[0] = 0;
+      inputs.angleDelta[1] = 0;
+   }
+
+   // Button changes go out in order even with no new snapshot, as a tap can
+   // start and end between core1's polls. Turbo flips with none of either.
+   if (!NextEdge(&inputs) && !m_havePendingSnapshot && !m_autofire.Running())
+      return;
+
+   if (m_autofire.Holding(time_us_32()))
+      return;
+
+   inputs.buttons = m_autofire.Apply(inputs.buttons);
+
+   uint32_t dirty = m_usb.DirtyReports(inputs, lastSent);
+
+   // Keep the snapshot until it's queued; the endpoint may still be busy
+   if (dirty == 0)
+      m_havePendingSnapshot = false;
+   else if (m_usb.SendData(inputs, dirty))
+   {
+      m_trace.Record(inputs, time_us_32());
+      m_havePendingSnapshot = false;
+   }
+}
+
+// Puts the oldest button state the host hasn't had in place of the polled
+// one, so a tap shorter than the endpoint is busy is still sent, press then
+// release. Returns false, leaving inputs alone, if the host is up to date.
+bool ArcadeCtrl::NextEdge(InputData *inputs)
+{
+   const InputData &lastSent = m_usb.LastSentData();
+
+   m_edges.Collect(lastSent.buttons);
+
+   while (m_edges.Pending() > 0)
+   {
+      InputData next = lastSent;
+      next.buttons = m_autofire.Apply(m_edges.Front().buttons);
+
+      if (m_usb.DirtyReports(next, lastSent) != 0)
+         break;
+
+      m_edges.Pop(); // Sent, or only buttons the host doesn't get
+   }
+
+   if (m_edges.Pending() == 0)
+      return false;
+
+   inputs->buttons  = m_edges.Front().buttons;
+   inputs->sampleUS = m_edges.Front().timeUS;
+   return true;
+}
+
+uint16_t ArcadeCtrl::GetTuning(void *ctx, [[maybe_unused]] uint8_t reportID, uint8_t *buffer, uint16_t reqlen)
+{
+   ArcadeCtrl  *ctrl = static_cast<ArcadeCtrl *>(ctx);
+   BoardConfig &cfg  = ctrl->m_boardCfg;
+   TuningReport report = {};
+
+   if (reqlen < sizeof(report))
+      return 0;
+
+   // Read while the sampling core may be applying a set, so it can be a poll
+   // behind, but each field is a single aligned word
+   report.version       = TUNING_VERSION;
+   report.hidIntervalMS = ctrl->m_usb.PollIntervalMS();
+   report.pollMS        = uint8_t(cfg.pollMS);
+   report.filterShift   = uint8_t(cfg.adcFilterShift);
+   report.releaseUS     = cfg.releaseUS;
+   report.confirmUS     = cfg.confirmUS;
+   report.encoderGain   = Encoder::ToFixed(cfg.encoderGain);
+   report.sofLeadUS     = cfg.sofLeadUS;
+
+   report.fields = TUNE_RELEASE_US | TUNE_CONFIRM_US |
+                   (cfg.sofLeadUS == 0 ? TUNE_POLL_MS : TUNE_SOF_LEAD) |
+                   (cfg.numEncoders > 0 ? TUNE_GAIN : 0) |
+                   (ctrl->m_analogSampler.Running() ? TUNE_FILTER : 0);
+
+   bool applied = ctrl->m_tuningApplied.load(std::memory_order_acquire) == ctrl->m_tuningQueued;
+
+   report.status = applied && !ctrl->m_saveRequested ? ctrl->m_tuningStatus : uint8_t(TUNING_PENDING);
+
+   memcpy(buffer, &report, sizeof(report));
+   return sizeof(report);
+}
+
+uint8_t ArcadeCtrl::CheckTuning(const TuningReport &req) const
+{
+   if (req.version != TUNING_VERSION || (req.command != TUNING_APPLY && req.command != TUNING_SAVE))
+      return TUNING_BAD_REQUEST;
+
+   uint16_t tunable = TUNE_RELEASE_US | TUNE_CONFIRM_US |
+                      (m_boardCfg.sofLeadUS == 0 ? TUNE_POLL_MS : TUNE_SOF_LEAD) |
+                      (m_boardCfg.numEncoders > 0 ? TUNE_GAIN : 0) |
+                      (m_analogSampler.Running() ? TUNE_FILTER : 0);
+
+   if (req.fields & ~tunable)
+      return TUNING_NOT_TUNABLE;
+
+   uint32_t maxWindowUS = Debouncer::MAX_TICKS * DEBOUNCE_TICK_US;
+   uint32_t maxPollMS   = MaxPollMS(m_boardCfg.numAnalogs, m_boardCfg.adcDMA, m_boardCfg.pioSampler);
+
+   if (((req.fields & TUNE_POLL_MS) && (req.pollMS == 0 || req.pollMS > maxPollMS)) ||
+       ((req.fields & TUNE_RELEASE_US) && req.releaseUS > maxWindowUS) ||
+       ((req.fields & TUNE_CONFIRM_US) && req.confirmUS > maxWindowUS) ||
+       ((req.fields & TUNE_GAIN) && (req.encoderGain == 0 || req.encoderGain > MAX_GAIN || req.encoderGain < -MAX_GAIN)) ||
+       ((req.fields & TUNE_FILTER) && req.filterShift > MAX_FILTER_SHIFT) ||
+       ((req.fields & TUNE_SOF_LEAD) && (req.sofLeadUS == 0 || req.sofLeadUS > 999)))
+      return TUNING_OUT_OF_RANGE;
+
+   return TUNING_OK;
+}
+
+void ArcadeCtrl::SetTuning(void *ctx, [[maybe_unused]] uint8_t reportID, const uint8_t *buffer, uint16_t len)
+{
+   ArcadeCtrl  *ctrl = static_cast<ArcadeCtrl *>(ctx);
+   TuningReport req;
+
+   if (len != sizeof(req))
+   {
+      ctrl->m_tuningStatus = TUNING_BAD_REQUEST;
+      return;
+   }
+
+   memcpy(&req, buffer, sizeof(req));
+
+   uint8_t status = ctrl->CheckTuning(req);
+
+   if (status == TUNING_OK && !ctrl->m_tuning.Push(req))
+      status = TUNING_BUSY;
+
+   ctrl->m_tuningStatus = status;
+
+   if (status != TUNING_OK)
+      return;
+
+   ctrl->m_tuningQueued++;
+
+   if (req.command == TUNING_SAVE)
+      ctrl->m_saveRequested = true;
+}
+
+void ArcadeCtrl::ApplyTuning()
+{
+   TuningReport req;
+
+   while (m_tuning.Pop(&req))
+   {
+      if (req.fields & TUNE_POLL_MS)
+         m_boardCfg.pollMS = req.pollMS;
+
+      if (req.fields & TUNE_SOF_LEAD)
+         m_boardCfg.sofLeadUS = req.sofLeadUS;
+
+      // Windows are picked up as each button next reloads its counter
+      if (req.fields & TUNE_RELEASE_US)
+      {
+         m_boardCfg.releaseUS = req.releaseUS;
+         m_debouncer.SetReleaseWindow(m_inputMask, req.releaseUS);
+      }
+
+      if (req.fields & TUNE_CONFIRM_US)
+      {
+         m_boardCfg.confirmUS = req.confirmUS;
+         m_debouncer.SetPressConfirm(m_boardCfg.confirmMask & m_inputMask, req.confirmUS);
+      }
+
+      // Gain is applied to each read's new steps, so the position doesn't jump
+      if (req.fields & TUNE_GAIN)
+      {
+         m_boardCfg.encoderGain = float(req.encoderGain) / float(1 << 16);
+
+         for (uint32_t i = 0; i < m_boardCfg.numEncoders; i++)
+            m_encoders[i].SetGain(m_boardCfg.encoderGain);
+      }
+
+      if (req.fields & TUNE_FILTER)
+      {
+         m_boardCfg.adcFilterShift = req.filterShift;
+         m_analogSampler.SetIIRShift(req.filterShift);
+      }
+
+      m_tuningApplied.fetch_add(1, std::memory_order_release);
+
+      // Core0 may be waiting on this to save
+      __sev();
+   }
+}
+
+void ArcadeCtrl::SaveTuning()
+{
+   // Wait until the sampling side has applied everything up to the save
+   if (!m_saveRequested || m_tuningApplied.load(std::memory_order_acquire) != m_tuningQueued)
+      return;
+
+   // Flash can't be read while it's written, so park core1, which runs from it
+   if (m_boardCfg.dualCore)
+      multicore_lockout_start_blocking();
+
+   bool saved = SaveBoardConfig(m_dip, m_boardCfg);
+
+   if (m_boardCfg.dualCore)
+      multicore_lockout_end_blocking();
+
+   m_tuningStatus  = saved ? TUNING_OK : TUNING_SAVE_FAILED;
+   m_saveRequested = false;
+}
+
+bool ArcadeCtrl::PollDue()
+{
+   // Straight after a turbo flip, so the new state is queued for the host's next poll
+   if (m_autofire.TakeFlip())
+      return true;
+
+   if (m_boardCfg.sofLeadUS == 0)
+   {
+      absolute_time_t time = get_absolute_time();
+      uint32_t        now  = to_ms_since_boot(time);
+
+      if (now - m_pollStartMS < m_boardCfg.pollMS)
+         return false;
+
+      m_usb.GetTelemetry().Poll((now - m_pollStartMS - m_boardCfg.pollMS) * 1000, m_boardCfg.pollMS * 1000);
+
+      // From the 64 bit time, as this is the sleep's deadline and the 32 bit
+      // milliseconds wrap after 49 days
+      m_pollStartMS = now;
+      m_nextPollUS  = (to_us_since_boot(time) / 1000 + m_boardCfg.pollMS) * 1000;
+      return true;
+   }
+
+   uint64_t now = time_us_64();
+
+   if (now < m_nextPollUS)
+      return false;
+
+   // Until we've seen enough frames to know when they start, poll every 1ms
+   if (!m_usb.SOFLocked())
+   {
+      m_usb.GetTelemetry().Poll(uint32_t(now - m_nextPollUS), POLL_INTERVAL_MS * 1000);
+      m_nextPollUS = now + POLL_INTERVAL_MS * 1000;
+      return true;
+   }
+
+   // Sample sofLeadUS ahead of the next start-of-frame, so the report waiting
+   // in the endpoint for that frame's IN token is as fresh as possible
+   uint32_t sinceSOF  = (now % 1000 + 1000 - m_usb.SOFPhaseUS()) % 1000;
+   uint64_t nextSOF   = now - sinceSOF + 1000;
+   uint32_t lead      = std::min(m_boardCfg.sofLeadUS, 999u);
+   uint64_t samplePos = nextSOF - lead;
+
+   if (now < samplePos)
+   {
+      m_nextPollUS = samplePos;
+      return false;
+   }
+
+   m_usb.GetTelemetry().Poll(uint32_t(now - m_nextPollUS), 1000);
+
+   uint32_t toSOF = uint32_t(nextSOF - now);
+
+   if (m_sofStats.samples == 0 || toSOF < m_sofStats.minPhaseUS)
+      m_sofStats.minPhaseUS = toSOF;
+   if (toSOF > m_sofStats.maxPhaseUS)
+      m_sofStats.maxPhaseUS = toSOF;
+
+   m_sofStats.samples++;
+   m_sofStats.totalPhaseUS   += toSOF;
+   m_sofStats.totalPhaseSqUS += uint64_t(toSOF) * toSOF;
+
+   m_nextPollUS = nextSOF + 1000 - lead;
+   return true;
+}
+
 void ArcadeCtrl::ReadInputs(InputData *inputs, const InputData &lastSent)
 {
+   uint32_t nowUS = time_us_32();
+
    *inputs = {};
+   inputs->sampleUS = nowUS;
+
+   // We also want to debounce the buttons. We pass the press immediately, but
+   // a release only once the button has stayed up for its release window, so
+   // any bouncing in that window is ignored. This won't affect the latency of
+   // the press reaching the device. Buttons marked as needing press
+   // confirmation must instead be held for their confirm window first.
+   // The board's remap, if it has one, then moves them to the buttons sent.
+   //
+   // Our input pins are pulled-up, so we need to invert to get the up/down state.
+   //
+   // Raw edges are only kept for the trace, so cost nothing without it.
+   uint32_t rawEdges = 0;
+
+   if (m_sampler.Running())
+   {
+      // Every sample since the last pass, so taps shorter than the poll aren't missed
+      m_sampler.Drain([this, &rawEdges](uint32_t levels, uint32_t sampleUS)
+      {
+         m_edges.Record(Remap(m_debouncer.Update(~levels & m_inputMask, sampleUS)), sampleUS);
+
+         if (CFG_TUD_CDC)
+         {
+            rawEdges   |= levels ^ m_rawLevels;
+            m_rawLevels = levels;
+         }
+      });
 
-   // Our input pins are pulled-up, so we need to invert to get the up/down state
-   uint32_t buttons = (~gpio_get_all()) & INPUT_MASK;
-
-   // We also want to debounce the buttons. We'll pass the press immediately,
-   // but wait for 5ms for bouncing on release. This will debounce both the press
-   // and release, but won't affect the latency of the press reaching the device.
-   // Essentially, every sampling period we overwrite the oldest entry in a circular
-   // buffer with the current state of the buttons, one bit per button (0=up, 1=down).
-   // We simply bitwise OR every entry in the buffer together to get the input to
-   // send to the device. So, any button registered as down will be seen as down
-   // immediately, but will take at least 5ms to clear the ring buffer and become
-   // UP again. Any bouncing in that 5ms period is then essentially ignored.
-   m_buttonDebounceArray[m_buttonDebouncePos++] = buttons;
-   if (m_buttonDebouncePos >= m_buttonDebounceArray.size())
-      m_buttonDebouncePos = 0;
-
-   for (uint32_t i = 0; i < m_buttonDebounceArray.size(); i++)
-      inputs->buttons |= m_buttonDebounceArray[i];
+      inputs->buttons = Remap(m_debouncer.State());
+   }
+   else
+   {
+      uint32_t levels = gpio_get_all();
+
+      inputs->buttons = Remap(m_debouncer.Update(~levels & m_inputMask, nowUS));
+      m_edges.Record(inputs->buttons, nowUS);
+
+      if (CFG_TUD_CDC)
+      {
+         rawEdges    = levels ^ m_rawLevels;
+         m_rawLevels = levels;
+      }
+   }
+
+   inputs->raw      = ~m_rawLevels & m_inputMask;
+   inputs->rawEdges = rawEdges & m_inputMask;
+
+   // Analogs are kept at 16 bits; filtered, the ADC's 12 have more to give
+   if (m_analogSampler.Running())
+   {
+      m_analogSampler.Update();
+
+      for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
+         inputs->analog[i] = m_analogSampler.Value(i);
+   }
+   else
+   {
+      for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
+         inputs->analog[i] = m_analogs[i].Read() << 4;
+   }
 
    for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
-      inputs->analog[i] = m_analogs[i].Read();
+      inputs->axis[i] = m_axes[i].Update(inputs->analog[i]);
 
    for (uint32_t i = 0; i < m_boardCfg.numEncoders; i++)
    {
@@ -178,20 +1020,99 @@ void ArcadeCtrl::ReadInputs(InputData *inputs, const InputData &lastSent)
    }
 }
 
-bool ArcadeCtrl::NeedsSending(const InputData &cur, const InputData &prev)
+void ArcadeCtrl::InitPressIRQ()
 {
-   if (cur.buttons != prev.buttons)
-      return true;
+   assert(s_irqCtrl == nullptr);
+   s_irqCtrl = this;
 
-   for (uint32_t i = 0; i < m_boardCfg.numAnalogs; i++)
-      if (cur.analog[i] != prev.analog[i])
-         return true;
+   // Only presses are interrupt driven. Releases still need the full
+   // debounce window, so they keep coming from the poll.
+   for (uint32_t i = 0; i < 32; i++)
+      if (m_inputMask & (1 << i))
+         gpio_set_irq_enabled_with_callback(i, GPIO_IRQ_EDGE_FALL, true, &PressIRQHandler);
+}
 
-   for (uint32_t i = 0; i < m_boardCfg.numEncoders; i++)
-      if (cur.angle[i] != prev.angle[i] || cur.angleDelta != 0)
-         return true;
+void ArcadeCtrl::PressIRQHandler(uint gpio, [[maybe_unused]] uint32_t events)
+{
+   ArcadeCtrl *ctrl = s_irqCtrl;
+
+   // The falling edge is the first contact; take it even if the pin has
+   // already bounced back up by now, just as the debounce ring would.
+   if (ctrl->m_irqPressed == 0)
+      ctrl->m_irqPressUS = time_us_32();
+
+   ctrl->m_irqPressed |= 1u << gpio;
+}
+
+void ArcadeCtrl::SendIRQPresses(uint32_t nextPollUS)
+{
+   if (m_irqPressed == 0)
+      return;
+
+   uint32_t irqState = save_and_disable_interrupts();
+   uint32_t pressed  = m_irqPressed;
+   uint32_t edgeUS   = m_irqPressUS;
+   m_irqPressed = 0;
+   restore_interrupts(irqState);
+
+   // Presses on buttons needing confirmation are left to the poll
+   pressed &= ~m_boardCfg.confirmMask;
+
+   if (pressed == 0)
+      return;
+
+   // Hold the press for the full release window, exactly as if the poll had seen it
+   m_debouncer.ForcePress(pressed);
+
+   // The buttons they press once remapped, in whichever layer the buttons
+   // held with them pick; turbo buttons wait for their phase
+   uint32_t held    = m_debouncer.State();
+   uint32_t buttons = m_autofire.Apply(Remap(held) & ~Remap(held & ~pressed));
+
+   if (buttons == 0)
+      return;
+
+   // Changes the host hasn't had yet go first, in order, from the poll
+   InputData older;
+
+   if (NextEdge(&older) || m_autofire.Holding(time_us_32()))
+      return;
+
+   const InputData &lastSent = m_usb.LastSentData();
 
-   return false;
+   if ((lastSent.buttons | buttons) == lastSent.buttons)
+      return; // Already reported
+
+   // Only the buttons change; any encoder motion goes with the next poll
+   InputData inputs = lastSent;
+   inputs.buttons |= buttons;
+   inputs.sampleUS = edgeUS;
+   inputs.raw     |= pressed;
+   inputs.rawEdges = pressed;
+   inputs.angleDelta[0] = 0;
+   inputs.angleDelta[1] = 0;
+
+   uint32_t dirty = m_usb.DirtyReports(inputs, lastSent);
+
+   if (dirty == 0 || !m_usb.SendData(inputs, dirty))
+      return; // Nothing the host sees, or endpoint busy, the poll will pick it up from the debounce ring
+
+   uint32_t queuedUS = time_us_32();
+
+   m_trace.Record(inputs, queuedUS);
+
+   uint32_t edgeToQueue = queuedUS - edgeUS;
+   int32_t  saved = int32_t(nextPollUS - queuedUS);
+
+   m_irqPressStats.presses++;
+   m_irqPressStats.totalEdgeToQueueUS += edgeToQueue;
+   m_irqPressStats.maxEdgeToQueueUS = std::max(m_irqPressStats.maxEdgeToQueueUS, edgeToQueue);
+
+   if (saved > 0)
+   {
+      m_irqPressStats.totalSavedUS += saved;
+      m_irqPressStats.maxSavedUS = std::max(m_irqPressStats.maxSavedUS, uint32_t(saved));
+   }
 }
 
 void ArcadeCtrl::InitGPIO()
@@ -27,43 +27,222 @@
 
 #include "Encoder.h"
 #include "Analog.h"
+#include "AnalogAxis.h"
 #include "InputData.h"
 #include "USB.h"
 #include "BlinkLED.h"
+#include "SPSCRing.h"
+#include "Tuning.h"
+#include "Debouncer.h"
+#include "ButtonSampler.h"
+#include "AnalogSampler.h"
+#include "InputTrace.h"
+#include "Keyboard.h"
+#include "EdgeQueue.h"
+#include "Autofire.h"
+#include "ButtonRemap.h"
 
+#include <atomic>
 #include <cstdint>
-#include <array>
 
 class ArcadeCtrl
 {
 public:
+    struct BoardConfig
+    {
+        uint32_t numAnalogs   = 0;
+        uint32_t numEncoders  = 0;
+        float    encoderGain  = 1.0f;
+        bool     irqPressPath = false; // Send presses from a GPIO edge interrupt, ahead of the poll
+        bool     dualCore     = false; // Sample on core1, USB on core0 (irqPressPath is ignored)
+        uint32_t sofLeadUS    = 0;     // Non-zero asks for 1ms polling and samples this long before each SOF
+        bool     splitHID     = true;  // Mouse on its own HID interface, so it isn't a frame behind the gamepad
+        uint32_t releaseUS    = 5000;  // Release debounce window
+        uint32_t confirmMask  = 0;     // Buttons whose presses must be held for confirmUS (noisy leaf switches)
+        uint32_t confirmUS    = 0;
+        bool     pioSampler   = false; // Sample buttons at 100kHz with PIO + DMA instead of once per poll
+        bool     pioCount     = false; // Encoders counted by their state machine, no interrupt per step
+        bool     smooth       = false; // Interpolate encoder counts between edges, for slow trackballs
+
+        const Encoder::AccelCurve *accel = nullptr; // Scales the encoder gain with speed
+
+        bool     adcDMA       = true;  // Free-running ADC filtered in the background, not a blocking read per axis
+
+        // GPIOs that are a second player's, sent as a gamepad on an interface of
+        // their own. 16-19 can only be used with no encoders fitted.
+        uint32_t player2Mask  = 0;
+
+        // Sends the buttons as keys of an NKRO keyboard in place of the gamepad.
+        // Analogs aren't sent then, and a second joystick's keys are in the map.
+        const KeyMap *keymap = nullptr;
+
+        // Buttons that autofire while held, down and up for turboPolls of the
+        // host's polls each. Needs the SOF, so takes the USB interrupt every frame.
+        uint32_t turboMask  = 0;
+        uint32_t turboPolls = 2;
+
+        // Moves GPIOs to other buttons, with a shift layer. player2Mask,
+        // turboMask and the key map are of the buttons once moved, while
+        // confirmMask, being for the debouncer, stays on the GPIOs.
+        const RemapTable *remap = nullptr;
+
+        // Waits in WFE between its deadlines and interrupts, rather than
+        // spinning on the timer. Only the sample and LED have deadlines; USB
+        // work, button edges, encoder steps and the turbo alarm interrupt.
+        bool     sleep        = true;
+
+        // Not in the table, since they depend on the sticks fitted rather than the board
+        AnalogAxis::Calibration axisCal[3] = {};
+
+        // Also tunable at runtime, see Tuning.h
+        uint32_t pollMS         = 1; // Sampling interval, unless synced to SOF
+        uint32_t adcFilterShift = 1; // Analog IIR time constant, 2^n averages
+    };
+
+    // How much the interrupt driven press path is saving
+    struct IRQPressStats
+    {
+        uint32_t presses            = 0; // Presses queued ahead of the poll
+        uint64_t totalEdgeToQueueUS = 0;
+        uint32_t maxEdgeToQueueUS   = 0;
+        uint64_t totalSavedUS       = 0; // Sum of time left until the poll would have sampled them
+        uint32_t maxSavedUS         = 0;
+    };
+
+    // Core1 -> core0 snapshot hand-over in dual core mode
+    struct PipelineStats
+    {
+        uint32_t published  = 0; // Snapshots pushed by core1
+        uint32_t overruns   = 0; // Snapshots dropped because the ring was full
+        uint32_t consumed   = 0; // Snapshots popped by core0
+        uint32_t superseded = 0; // Popped but replaced by a newer one before being sent
+        uint64_t totalAgeUS = 0; // Sample to pop, summed over consumed snapshots
+        uint32_t maxAgeUS   = 0;
+    };
+
+    // Phase of the SOF synchronised samples, i.e. how long before the next
+    // start-of-frame each one was taken. Jitter is the spread of these.
+    struct SOFStats
+    {
+        uint32_t samples        = 0;
+        uint32_t minPhaseUS     = 0;
+        uint32_t maxPhaseUS     = 0;
+        uint64_t totalPhaseUS   = 0;
+        uint64_t totalPhaseSqUS = 0;
+    };
+
+    // Indexed by the board DIP switches. Public so the host simulation can
+    // pick or tweak a config before constructing the controller.
+    static BoardConfig s_boardConfigs[4];
+
+    // Acceleration curves the board configs can pick from
+    static const Encoder::AccelCurve s_trackballAccel;
+
+    // Key maps likewise; MAME's default keys for one or two players
+    static const KeyMap s_mameKeys;
+
+    // And remaps; a shift button for coin and service on one player's board
+    static const RemapTable s_hotkeyRemap;
+
     ArcadeCtrl();
 
+    // Saves cfg to flash for the given DIP setting, to be used in place of
+    // s_boardConfigs from the next boot. Flash is unavailable while it's
+    // written, so only call this with core1 not running or locked out.
+    static bool SaveBoardConfig(uint32_t dip, const BoardConfig &cfg);
+
+    // Replaces the fields of cfg that were saved for dip, if any were
+    static bool LoadBoardConfig(uint32_t dip, BoardConfig *cfg);
+
     int Run();
 
+    const BoardConfig   &GetBoardConfig() const   { return m_boardCfg; }
+    bool                 ConfigFromFlash() const  { return m_configFromFlash; }
+    const IRQPressStats &GetIRQPressStats() const { return m_irqPressStats; }
+    const PipelineStats &GetPipelineStats() const { return m_pipelineStats; }
+    const SOFStats      &GetSOFStats() const      { return m_sofStats; }
+    const USB           &GetUSB() const           { return m_usb; }
+    const ButtonSampler &GetSampler() const       { return m_sampler; }
+    const AnalogSampler &GetAnalogSampler() const { return m_analogSampler; }
+    const InputTrace    &GetTrace() const         { return m_trace; }
+    const EdgeQueue     &GetEdges() const         { return m_edges; }
+    const Autofire      &GetAutofire() const      { return m_autofire; }
+
 private:
     void InitGPIO();
     void ReadInputs(InputData *inputs, const InputData &curInputs);
     void UpdateBlinker();
+    bool PollDue();
+    void WaitForWork(uint64_t pollUS);
+    uint64_t BlinkerDueUS(uint64_t nowUS) const;
+    void InitPressIRQ();
+    void SendIRQPresses(uint32_t nextPollUS);
+    bool NextEdge(InputData *inputs);
 
-    bool NeedsSending(const InputData &data1, const InputData &data2);
+    uint32_t Remap(uint32_t gpios) const { return m_remap.Enabled() ? m_remap.Apply(gpios) : gpios; }
+    void StartAutofire();
 
-private:
-    struct BoardConfig
-    {
-        uint32_t numAnalogs  = 0;
-        uint32_t numEncoders = 0;
-        float    encoderGain = 1.0f;
-    };
+    static void PressIRQHandler(uint gpio, uint32_t events);
 
-    static BoardConfig s_boardConfigs[4];
+    int  RunDualCore();
+    void SampleLoop();
+    void SendSnapshots();
 
+    static void Core1Entry();
+
+    static uint16_t GetTuning(void *ctx, uint8_t reportID, uint8_t *buffer, uint16_t reqlen);
+    static void     SetTuning(void *ctx, uint8_t reportID, const uint8_t *buffer, uint16_t len);
+
+    uint8_t CheckTuning(const TuningReport &req) const;
+    void    ApplyTuning();
+    void    SaveTuning();
+
+private:
     BoardConfig m_boardCfg;
+    bool        m_configFromFlash = false;
+    uint32_t    m_dip             = 0;
+    uint32_t    m_inputMask       = 0; // Button GPIOs, with the second joystick's if there is one
+    uint32_t    m_buttonMask      = 0; // Buttons those can set, once remapped
     Encoder     m_encoders[2];
     Analog      m_analogs[3];
+    AnalogAxis  m_axes[3];
     USB         m_usb;
     BlinkLED    m_blinker;
+    InputTrace  m_trace;    // Written to the CDC interface, in builds that have one
+
+    uint32_t m_pollStartMS = 0;
+    uint64_t m_nextPollUS  = 0;
+    SOFStats m_sofStats;
+
+    Debouncer     m_debouncer;
+    ButtonSampler m_sampler;
+    AnalogSampler m_analogSampler;
+    uint32_t      m_rawLevels = ~0u; // Last sampled, for the trace's raw edges
+    ButtonRemap   m_remap;
+    EdgeQueue     m_edges;           // Button changes the host hasn't had yet
+    Autofire      m_autofire;
+
+    volatile uint32_t m_irqPressed = 0;
+    volatile uint32_t m_irqPressUS = 0;
+    IRQPressStats     m_irqPressStats;
+
+    struct InputSnapshot
+    {
+        InputData inputs {};
+        uint32_t  sampleUS = 0;
+    };
+
+    SPSCRing<InputSnapshot, 8> m_snapshots;
+    InputSnapshot              m_pendingSnapshot;
+    bool                       m_havePendingSnapshot = false;
+    PipelineStats              m_pipelineStats;
 
-    std::array<uint32_t, 5> m_buttonDebounceArray {};
-    uint32_t                m_buttonDebouncePos = 0;
+    // Tuning sets are checked and queued on the USB side, and applied by
+    // whichever core samples, at the start of its next poll. Saving is left
+    // to the USB side's loop once they've been applied.
+    SPSCRing<TuningReport, 2> m_tuning;
+    std::atomic<uint32_t>     m_tuningApplied { 0 };
+    uint32_t                  m_tuningQueued  = 0;
+    bool                      m_saveRequested = false;
+    uint8_t                   m_tuningStatus  = TUNING_OK;
 };
\ No newline at end of file
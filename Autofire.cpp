@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "Autofire.h"
+#include "USB.h"
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+Autofire *Autofire::s_autofire = nullptr;
+
+void Autofire::Start(uint32_t alarmNum, const USB &usb)
+{
+   s_autofire = this;
+   m_usb      = &usb;
+   m_alarm    = alarmNum;
+   m_pollUS   = time_us_64();
+
+   hardware_alarm_claim(alarmNum);
+   hardware_alarm_set_callback(alarmNum, &AlarmCallback);
+
+   Schedule();
+}
+
+void Autofire::AlarmCallback(uint32_t alarmNum)
+{
+   (void)alarmNum;
+   s_autofire->Flip();
+}
+
+void Autofire::Flip()
+{
+   m_phase = ~m_phase;
+   m_flips = m_flips + 1;
+
+   // The interrupt wakes core0, but core1 may be the one waiting to sample
+   __sev();
+
+   Schedule();
+}
+
+// A state on from the last flip's poll, moved to the nearest poll on the grid
+void Autofire::Schedule()
+{
+   uint32_t periodUS = m_usb->PollPeriodUS();
+   uint32_t stateUS  = m_polls * periodUS;
+
+   for (;;)
+   {
+      m_pollUS += stateUS;
+
+      uint32_t past = uint32_t((m_pollUS + periodUS - m_usb->PollGridUS()) % periodUS);
+
+      m_pollUS = past < periodUS / 2 ? m_pollUS - past : m_pollUS + (periodUS - past);
+
+      m_flipAtUS = uint32_t(m_pollUS + FLIP_AFTER_POLL_US);
+
+      if (!hardware_alarm_set_target(m_alarm, from_us_since_boot(m_pollUS + FLIP_AFTER_POLL_US)))
+         return;
+
+      // Too late for this one. Skip a whole cycle, so the phase stays in step.
+      m_pollUS += stateUS;
+      m_missed = m_missed + 1;
+   }
+}
@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+class USB;
+
+// Turbo for the buttons in a mask: held, they read down and up in turn, each
+// state for a set number of the host's polls. All of them share one free
+// running phase, so a press can start part way through a down state, but
+// every state after that is whole.
+//
+// The phase is flipped by a hardware alarm rather than the main loop, so how
+// busy the loop is doesn't change the cadence. Each flip is put just after a
+// frame the host polls in and snapped to USB's poll grid, so the device's
+// clock drifting from the host's doesn't build up, and the sampling runs
+// straight away so the new state is queued for the next poll.
+class Autofire
+{
+public:
+   // Past the host's IN token in the frame it polls in
+   static constexpr uint32_t FLIP_AFTER_POLL_US = 250;
+
+   struct Stats
+   {
+      uint32_t flips  = 0;
+      uint32_t missed = 0; // Alarms that were late by a whole state, which was skipped
+   };
+
+   Autofire() = default;
+   Autofire(uint32_t mask, uint32_t polls) : m_mask(polls != 0 ? mask : 0), m_polls(polls) {}
+
+   bool Enabled() const { return m_mask != 0; }
+   bool Running() const { return m_usb != nullptr; }
+
+   // Held turbo buttons read as the phase, the rest as they are. No branches,
+   // so every sample costs the same.
+   uint32_t Apply(uint32_t buttons) const { return buttons & (~m_mask | m_phase); }
+
+   // Once usb's poll grid is known, i.e. the SOF is locked
+   void Start(uint32_t alarmNum, const USB &usb);
+
+   // From the SOF of the poll a flip follows until the flip. Anything queued
+   // then would reach the host at the next poll with the old phase, and the
+   // flip a poll late, so sending waits; it gets to the host no later.
+   bool Holding(uint32_t nowUS) const
+   {
+      return Running() && uint32_t(m_flipAtUS - nowUS) <= FLIP_AFTER_POLL_US;
+   }
+
+   // True once after each flip, for the sampling side to poll straight away
+   bool TakeFlip()
+   {
+      uint32_t flips = m_flips;
+      bool     taken = flips != m_flipsTaken;
+
+      m_flipsTaken = flips;
+      return taken;
+   }
+
+   Stats GetStats() const { return Stats { m_flips, m_missed }; }
+
+private:
+   static void AlarmCallback(uint32_t alarmNum);
+
+   void Flip();
+   void Schedule();
+
+   static Autofire *s_autofire;
+
+   uint32_t   m_mask  = 0;
+   uint32_t   m_polls = 0;
+   const USB *m_usb   = nullptr;
+   uint32_t   m_alarm = 0;
+   uint64_t   m_pollUS = 0; // SOF of the poll frame the last flip followed
+
+   volatile uint32_t m_phase  = ~0u; // All down or all up
+   volatile uint32_t m_flipAtUS = 0;
+   volatile uint32_t m_flips  = 0;
+   volatile uint32_t m_missed = 0;
+   uint32_t          m_flipsTaken = 0;
+};
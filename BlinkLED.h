@@ -43,6 +43,16 @@ public:
 
    void Process();
 
+   // How long from nowMS until Process() has something to do
+   uint32_t MSUntilChange(uint32_t nowMS) const
+   {
+      if (!m_intervalMS)
+         return m_ledState ? 0 : UINT32_MAX;
+
+      uint32_t elapsed = nowMS - m_lastMS;
+      return elapsed < m_intervalMS ? m_intervalMS - elapsed : 0;
+   }
+
 private:
     uint32_t m_intervalMS = 0;
     uint32_t m_lastMS     = 0;
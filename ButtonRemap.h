@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Moves GPIOs to other buttons, by default and while a shift button is held.
+// GPIOs not listed stay where they are, in both layers. The shift button is
+// never sent itself.
+struct RemapTable
+{
+   static constexpr uint32_t MAX_ENTRIES = 16;
+   static constexpr uint8_t  NO_BUTTON   = 0xFF;
+
+   struct Entry
+   {
+      uint8_t gpio;
+      uint8_t button; // Bit in the buttons sent, or NO_BUTTON to drop the GPIO
+   };
+
+   uint8_t  shift;          // GPIO, or NO_BUTTON for no shift layer
+   uint32_t numEntries;
+   Entry    entries[MAX_ENTRIES];
+   uint32_t numShifted;     // Applied over the entries while shift is held
+   Entry    shifted[MAX_ENTRIES];
+};
+
+// Turns debounced GPIOs into the buttons everything after sees. The table is
+// resolved into, for each layer, a lookup of the buttons set by each nibble
+// of GPIOs, so every state costs the same eight loads and ORs however much is
+// mapped. The shift button's bit picks the layer by index rather than a
+// branch; without a shift layer both layers are the same.
+//
+// Entries outside the 32 GPIOs or buttons are ignored.
+class ButtonRemap
+{
+public:
+   constexpr ButtonRemap() = default;
+
+   constexpr explicit ButtonRemap(const RemapTable &table) : m_enabled(true)
+   {
+      uint8_t to[2][32] = {};
+
+      for (uint32_t i = 0; i < 32; i++)
+         to[0][i] = uint8_t(i);
+
+      Move(to[0], table.entries, table.numEntries);
+
+      for (uint32_t i = 0; i < 32; i++)
+         to[1][i] = to[0][i];
+
+      if (table.shift < 32)
+      {
+         Move(to[1], table.shifted, table.numShifted);
+
+         to[0][table.shift] = RemapTable::NO_BUTTON;
+         to[1][table.shift] = RemapTable::NO_BUTTON;
+         m_shift            = table.shift;
+      }
+
+      for (uint32_t layer = 0; layer < 2; layer++)
+         for (uint32_t nibble = 0; nibble < 8; nibble++)
+            for (uint32_t bits = 0; bits < 16; bits++)
+               for (uint32_t b = 0; b < 4; b++)
+               {
+                  uint8_t button = to[layer][nibble * 4 + b];
+
+                  if ((bits >> b) & 1 && button < 32)
+                     m_lut[layer][nibble][bits] |= 1u << button;
+               }
+   }
+
+   constexpr bool Enabled() const { return m_enabled; }
+
+   constexpr uint32_t Apply(uint32_t gpios) const
+   {
+      const uint32_t (&lut)[8][16] = m_lut[(gpios >> m_shift) & 1];
+
+      return lut[0][gpios & 15]         | lut[1][(gpios >> 4) & 15]  |
+             lut[2][(gpios >> 8) & 15]  | lut[3][(gpios >> 12) & 15] |
+             lut[4][(gpios >> 16) & 15] | lut[5][(gpios >> 20) & 15] |
+             lut[6][(gpios >> 24) & 15] | lut[7][(gpios >> 28) & 15];
+   }
+
+   // Every button that some state of gpios can set
+   constexpr uint32_t Outputs(uint32_t gpios) const
+   {
+      return Apply(gpios & ~(1u << m_shift)) | Apply(gpios);
+   }
+
+private:
+   static constexpr void Move(uint8_t *to, const RemapTable::Entry *entries, uint32_t count)
+   {
+      for (uint32_t i = 0; i < count && i < RemapTable::MAX_ENTRIES; i++)
+         if (entries[i].gpio < 32 && (entries[i].button < 32 || entries[i].button == RemapTable::NO_BUTTON))
+            to[entries[i].gpio] = entries[i].button;
+   }
+
+   uint32_t m_lut[2][8][16] = {}; // Layer, nibble of GPIOs, its value
+   uint32_t m_shift         = 0;
+   bool     m_enabled       = false;
+};
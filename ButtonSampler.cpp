@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "ButtonSampler.h"
+
+#include "ButtonSamplerPio.h"
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
+
+#include <cstdint>
+
+// Samples this close to a full lap behind are treated as lost
+constexpr uint32_t OVERRUN_MARGIN = 32;
+
+// At 100kHz this lasts about 12 hours before the control channel re-arms it
+constexpr uint32_t RELOAD_COUNT = 0xFFFFFFFF;
+
+// The write ring wraps on the low address bits, so it must be aligned to its size
+alignas(1u << ButtonSampler::RING_BITS) uint32_t ButtonSampler::s_ring[RING_WORDS];
+uint32_t ButtonSampler::s_reloadCount = RELOAD_COUNT;
+
+uint32_t ButtonSampler::RingUS(uint32_t periodUS)
+{
+   return (RING_WORDS - OVERRUN_MARGIN) * periodUS;
+}
+
+ButtonSampler::ButtonSampler(uint32_t pioIndex, uint32_t periodUS) :
+   m_periodUS(periodUS)
+{
+   assert(pioIndex < 2);
+   assert(periodUS > 0);
+
+   PIO pio = pioIndex == 0 ? pio0 : pio1;
+
+   // Pins stay as pulled-up SIO inputs; the PIO can read any pin regardless
+   uint32_t offset = pio_add_program(pio, &ButtonSampler_program);
+   m_stateMachine = pio_claim_unused_sm(pio, true);
+
+   m_dataChannel = dma_claim_unused_channel(true);
+   m_ctrlChannel = dma_claim_unused_channel(true);
+
+   // The control channel writes the reload count to the data channel's
+   // trigger alias. The write address isn't reset, so it carries on round the ring.
+   dma_channel_config ctrlCfg = dma_channel_get_default_config(m_ctrlChannel);
+   channel_config_set_transfer_data_size(&ctrlCfg, DMA_SIZE_32);
+   channel_config_set_read_increment(&ctrlCfg, false);
+   channel_config_set_write_increment(&ctrlCfg, false);
+   dma_channel_configure(m_ctrlChannel, &ctrlCfg, &dma_hw->ch[m_dataChannel].al1_transfer_count_trig,
+                         &s_reloadCount, 1, false);
+
+   dma_channel_config dataCfg = dma_channel_get_default_config(m_dataChannel);
+   channel_config_set_transfer_data_size(&dataCfg, DMA_SIZE_32);
+   channel_config_set_read_increment(&dataCfg, false);
+   channel_config_set_write_increment(&dataCfg, true);
+   channel_config_set_ring(&dataCfg, true, RING_BITS);
+   channel_config_set_dreq(&dataCfg, pio_get_dreq(pio, m_stateMachine, false));
+   channel_config_set_chain_to(&dataCfg, m_ctrlChannel);
+   dma_channel_configure(m_dataChannel, &dataCfg, s_ring, &pio->rxf[m_stateMachine], RELOAD_COUNT, true);
+
+   // One instruction per sample
+   uint32_t clkdiv = clock_get_hz(clk_sys) / 1000000 * periodUS;
+   assert(clkdiv <= 0xFFFF);
+
+   m_readPos  = WritePos();
+   m_sampleUS = time_us_32() + periodUS;
+
+   ButtonSamplerProgramInit(pio, m_stateMachine, offset, clkdiv);
+
+   m_running = true;
+}
+
+uint32_t ButtonSampler::WritePos() const
+{
+   uint32_t written = dma_hw->ch[m_dataChannel].write_addr - uint32_t(uintptr_t(s_ring));
+   return (written / sizeof(uint32_t)) & (RING_WORDS - 1);
+}
+
+uint32_t ButtonSampler::Available()
+{
+   uint32_t writePos = WritePos();
+   uint32_t nowUS    = time_us_32();
+   uint32_t avail    = (writePos - m_readPos) & (RING_WORDS - 1);
+
+   // A full ring looks just like an empty one, but the clock tells them apart.
+   // If we've fallen that far behind, skip to the newest sample.
+   if (int32_t(nowUS - m_sampleUS) > 0 && (nowUS - m_sampleUS) / m_periodUS >= RING_WORDS - OVERRUN_MARGIN)
+   {
+      m_stats.overruns++;
+      m_readPos  = (writePos - 1) & (RING_WORDS - 1);
+      m_sampleUS = nowUS;
+      avail      = 1;
+   }
+
+   return avail;
+}
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "hardware/pio.h"
+
+// Samples every GPIO at a fixed rate with a PIO state machine, and DMAs the
+// samples into a ring so the CPU never reads the pins itself. Drain() then
+// hands over everything sampled since it was last called, so short taps and
+// bounce are seen exactly rather than at whatever moment the loop polls.
+//
+// A second DMA channel re-arms the first whenever its transfer count runs
+// out, so the ring is filled for as long as the device is powered.
+class ButtonSampler
+{
+public:
+   struct Stats
+   {
+      uint32_t samples  = 0; // Samples taken out of the ring
+      uint32_t passed   = 0; // Samples passed on by Drain(); runs of the same levels only pass their ends
+      uint32_t overruns = 0; // Times Drain() was called too late and the ring had wrapped
+   };
+
+   static constexpr uint32_t RING_BITS  = 12;
+   static constexpr uint32_t RING_WORDS = (1u << RING_BITS) / sizeof(uint32_t);
+
+   ButtonSampler() = default;
+   ButtonSampler(uint32_t pioIndex, uint32_t periodUS);
+
+   // How long the ring lasts at periodUS, less a margin; Drain() must be
+   // called at least this often or the samples are lost
+   static uint32_t RingUS(uint32_t periodUS);
+
+   bool Running() const { return m_running; }
+
+   // Calls fn(levels, sampleUS) for the samples taken since the last call,
+   // oldest first. Of a run of identical samples only the first and last are
+   // passed, which is all a debouncer needs to time the run.
+   template <typename Fn>
+   void Drain(Fn fn);
+
+   const Stats &GetStats() const { return m_stats; }
+
+private:
+   uint32_t WritePos() const;
+   uint32_t Available();
+
+   static uint32_t s_ring[RING_WORDS];
+   static uint32_t s_reloadCount;
+
+   bool     m_running      = false;
+   uint32_t m_periodUS     = 1;
+   uint32_t m_stateMachine = 0;
+   uint32_t m_dataChannel  = 0;
+   uint32_t m_ctrlChannel  = 0;
+
+   uint32_t m_readPos    = 0;
+   uint32_t m_sampleUS   = 0;  // Time of the sample at m_readPos
+   uint32_t m_lastLevels = ~0u;
+   Stats    m_stats;
+};
+
+template <typename Fn>
+void ButtonSampler::Drain(Fn fn)
+{
+   uint32_t avail = Available();
+
+   m_stats.samples += avail;
+
+   for (uint32_t i = 0; i < avail; i++)
+   {
+      uint32_t pos    = (m_readPos + i) & (RING_WORDS - 1);
+      uint32_t levels = s_ring[pos];
+      bool     last   = i + 1 == avail;
+
+      if (levels != m_lastLevels || last || s_ring[(pos + 1) & (RING_WORDS - 1)] != levels)
+      {
+         fn(levels, m_sampleUS);
+         m_stats.passed++;
+      }
+
+      m_lastLevels = levels;
+      m_sampleUS  += m_periodUS;
+   }
+
+   m_readPos = (m_readPos + avail) & (RING_WORDS - 1);
+}
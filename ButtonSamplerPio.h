@@ -0,0 +1,49 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------------- //
+// ButtonSampler //
+// ------------- //
+
+#define ButtonSampler_wrap_target 0
+#define ButtonSampler_wrap 0
+
+static const uint16_t ButtonSampler_program_instructions[] = {
+            //     .wrap_target
+    0x4000, //  0: in     pins, 32                   
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program ButtonSampler_program = {
+    .instructions = ButtonSampler_program_instructions,
+    .length = 1,
+    .origin = -1,
+};
+
+static inline pio_sm_config ButtonSampler_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + ButtonSampler_wrap_target, offset + ButtonSampler_wrap);
+    return c;
+}
+
+static inline void ButtonSamplerProgramInit(PIO pio, uint sm, uint offset, uint clkdiv)
+{
+    pio_sm_config cfg = ButtonSampler_program_get_default_config(offset);
+    sm_config_set_in_pins(&cfg, 0);
+    sm_config_set_in_shift(&cfg, /*shift_right=*/false, /*autopush=*/true, 32);
+    sm_config_set_fifo_join(&cfg, PIO_FIFO_JOIN_RX);
+    sm_config_set_clkdiv_int_frac(&cfg, clkdiv, 0);
+    pio_sm_init(pio, sm, offset, &cfg);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+#endif
+
@@ -0,0 +1,198 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "ConfigStore.h"
+
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include <cassert>
+#include <cstring>
+
+constexpr uint32_t RECORD_MAGIC     = 0x47464341; // "ACFG"
+constexpr uint32_t SLOTS_PER_SECTOR = FLASH_SECTOR_SIZE / ConfigStore::SLOT_SIZE;
+
+static_assert(ConfigStore::SLOT_SIZE % FLASH_PAGE_SIZE == 0, "slots must be whole pages");
+
+ConfigStore::ConfigStore() :
+   ConfigStore(PICO_FLASH_SIZE_BYTES - SECTORS * FLASH_SECTOR_SIZE, SECTORS)
+{
+}
+
+ConfigStore::ConfigStore(uint32_t flashOffset, uint32_t numSectors) :
+   m_offset(flashOffset),
+   m_numSlots(numSectors * SLOTS_PER_SECTOR)
+{
+   // With a single sector, making room would mean erasing the newest record
+   assert(numSectors >= 2 && flashOffset % FLASH_SECTOR_SIZE == 0);
+
+   Scan();
+}
+
+// CRC-32 (as zlib) a nibble at a time, which is plenty for a few hundred
+// bytes at boot and keeps the table small
+static uint32_t Crc32(uint32_t crc, const uint8_t *bytes, uint32_t count)
+{
+   static const uint32_t table[16] =
+   {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+   };
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      crc ^= bytes[i];
+      crc = (crc >> 4) ^ table[crc & 0xF];
+      crc = (crc >> 4) ^ table[crc & 0xF];
+   }
+
+   return crc;
+}
+
+uint32_t ConfigStore::CRC(const Header &header, const void *data)
+{
+   Header h = header;
+   h.crc = 0;
+
+   uint32_t crc = Crc32(0xFFFFFFFF, reinterpret_cast<const uint8_t *>(&h), sizeof(h));
+   return ~Crc32(crc, static_cast<const uint8_t *>(data), h.length);
+}
+
+const uint8_t *ConfigStore::Slot(uint32_t slot) const
+{
+   return reinterpret_cast<const uint8_t *>(XIP_BASE + m_offset + slot * SLOT_SIZE);
+}
+
+bool ConfigStore::Valid(uint32_t slot) const
+{
+   Header header;
+   memcpy(&header, Slot(slot), sizeof(header));
+
+   return header.magic == RECORD_MAGIC && header.length <= MAX_DATA &&
+          header.crc == CRC(header, Slot(slot) + sizeof(Header));
+}
+
+bool ConfigStore::Erased(uint32_t slot, uint32_t length) const
+{
+   const uint8_t *bytes = Slot(slot);
+
+   for (uint32_t i = 0; i < length; i++)
+      if (bytes[i] != 0xFF)
+         return false;
+
+   return true;
+}
+
+void ConfigStore::Scan()
+{
+   for (uint32_t slot = 0; slot < m_numSlots; slot++)
+   {
+      if (!Valid(slot))
+         continue;
+
+      Header header;
+      memcpy(&header, Slot(slot), sizeof(header));
+
+      if (m_latest < 0 || int32_t(header.seq - m_seq) > 0)
+      {
+         m_latest = int32_t(slot);
+         m_seq    = header.seq;
+      }
+   }
+
+   m_next = m_latest < 0 ? 0 : (uint32_t(m_latest) + 1) % m_numSlots;
+}
+
+bool ConfigStore::Load(uint16_t version, void *data, uint32_t size) const
+{
+   if (m_latest < 0)
+      return false;
+
+   Header header;
+   memcpy(&header, Slot(uint32_t(m_latest)), sizeof(header));
+
+   if (header.version != version || header.length != size)
+      return false;
+
+   memcpy(data, Slot(uint32_t(m_latest)) + sizeof(Header), size);
+   return true;
+}
+
+bool ConfigStore::Save(uint16_t version, const void *data, uint32_t size)
+{
+   assert(size <= MAX_DATA);
+
+   Header header = { RECORD_MAGIC, m_seq + 1, version, uint16_t(size), 0 };
+   header.crc = CRC(header, data);
+
+   // Unwritten bytes are left erased
+   uint8_t image[SLOT_SIZE];
+   memset(image, 0xFF, sizeof(image));
+   memcpy(image, &header, sizeof(header));
+   memcpy(image + sizeof(header), data, size);
+
+   // Pass over anything a torn write left behind. Arriving at a new sector,
+   // erase it unless it's clean, which also clears up after a torn erase.
+   // The newest record is always behind us, in another sector.
+   uint32_t slot = m_next;
+
+   while (true)
+   {
+      if (slot % SLOTS_PER_SECTOR == 0)
+      {
+         if (!Erased(slot, FLASH_SECTOR_SIZE))
+         {
+            uint32_t interrupts = save_and_disable_interrupts();
+            flash_range_erase(m_offset + slot * SLOT_SIZE, FLASH_SECTOR_SIZE);
+            restore_interrupts(interrupts);
+
+            m_stats.erases++;
+         }
+
+         break;
+      }
+
+      if (Erased(slot, SLOT_SIZE))
+         break;
+
+      m_stats.skipped++;
+      slot = (slot + 1) % m_numSlots;
+   }
+
+   uint32_t interrupts = save_and_disable_interrupts();
+   flash_range_program(m_offset + slot * SLOT_SIZE, image, SLOT_SIZE);
+   restore_interrupts(interrupts);
+
+   m_stats.saves++;
+   m_next = (slot + 1) % m_numSlots;
+
+   if (!Valid(slot))
+      return false;
+
+   m_latest = int32_t(slot);
+   m_seq    = header.seq;
+
+   return true;
+}
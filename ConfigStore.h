@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Log-structured store for a small block of settings, kept in the last few
+// sectors of flash.
+//
+// Each Save() appends a whole new record, with a sequence number and a CRC,
+// to the next free slot, going round the sectors in turn, so every sector is
+// erased equally often. A sector is only erased when the writes reach it
+// again, by which time the newest record is always in another one. Load()
+// returns the valid record with the highest sequence number, so a write cut
+// short by a power failure is just a bad CRC and the previous record stands.
+//
+// Records carry the caller's version of the data's layout, and Load() only
+// accepts its own.
+//
+// Erasing and programming stop XIP, so interrupts are disabled around them
+// here. Anything else running from flash, such as the other core, has to be
+// held off by the caller.
+class ConfigStore
+{
+public:
+   struct Stats
+   {
+      uint32_t saves   = 0;
+      uint32_t erases  = 0; // Sectors erased
+      uint32_t skipped = 0; // Slots passed over for holding a torn write
+   };
+
+   static constexpr uint32_t SECTORS   = 4;
+   static constexpr uint32_t SLOT_SIZE = 512; // Two flash pages
+   static constexpr uint32_t MAX_DATA  = SLOT_SIZE - 16;
+
+   // By default the store takes the end of flash
+   ConfigStore();
+   ConfigStore(uint32_t flashOffset, uint32_t numSectors);
+
+   // Copies out the newest record if it has this version and size
+   bool Load(uint16_t version, void *data, uint32_t size) const;
+
+   // Appends a record, erasing the next sector first if need be. Returns
+   // false if it didn't read back intact.
+   bool Save(uint16_t version, const void *data, uint32_t size);
+
+   bool         Empty() const    { return m_latest < 0; }
+   const Stats &GetStats() const { return m_stats; }
+
+private:
+   struct Header
+   {
+      uint32_t magic;
+      uint32_t seq;
+      uint16_t version;
+      uint16_t length;
+      uint32_t crc;
+   };
+
+   static_assert(sizeof(Header) == SLOT_SIZE - MAX_DATA, "header doesn't fill its space");
+
+   void           Scan();
+   const uint8_t *Slot(uint32_t slot) const;
+   bool           Valid(uint32_t slot) const;
+   bool           Erased(uint32_t slot, uint32_t length) const;
+
+   static uint32_t CRC(const Header &header, const void *data);
+
+private:
+   uint32_t m_offset    = 0;
+   uint32_t m_numSlots  = 0;
+   int32_t  m_latest    = -1; // Slot of the newest valid record
+   uint32_t m_seq       = 0;  // Its sequence number
+   uint32_t m_next      = 0;  // Where the next one goes
+   Stats    m_stats;
+};
@@ -0,0 +1,135 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "Debouncer.h"
+
+#include <algorithm>
+
+Debouncer::Debouncer(uint32_t tickUS) :
+   m_tickUS(std::max(tickUS, 1u))
+{
+}
+
+uint32_t Debouncer::Ticks(uint32_t windowUS) const
+{
+   return std::min((windowUS + m_tickUS - 1) / m_tickUS, MAX_TICKS);
+}
+
+void Debouncer::SetPlanes(uint32_t *planes, uint32_t mask, uint32_t ticks)
+{
+   for (uint32_t p = 0; p < NUM_PLANES; p++)
+      planes[p] = (ticks >> p) & 1 ? planes[p] | mask : planes[p] & ~mask;
+}
+
+void Debouncer::Load(const uint32_t *planes, uint32_t mask)
+{
+   for (uint32_t p = 0; p < NUM_PLANES; p++)
+      m_count[p] = (m_count[p] & ~mask) | (planes[p] & mask);
+}
+
+void Debouncer::SetReleaseWindow(uint32_t mask, uint32_t windowUS)
+{
+   SetPlanes(m_releaseReload, mask, Ticks(windowUS));
+}
+
+void Debouncer::SetPressConfirm(uint32_t mask, uint32_t windowUS)
+{
+   // A zero window would still need two samples; that's just an eager press
+   if (windowUS == 0)
+   {
+      ClearPressConfirm(mask);
+      return;
+   }
+
+   SetPlanes(m_confirmReload, mask, Ticks(windowUS));
+   m_confirmMask |= mask;
+}
+
+void Debouncer::ClearPressConfirm(uint32_t mask)
+{
+   m_confirmMask &= ~mask;
+}
+
+void Debouncer::ForcePress(uint32_t mask)
+{
+   m_state |= mask;
+   Load(m_releaseReload, mask);
+}
+
+uint32_t Debouncer::Update(uint32_t down, uint32_t nowUS)
+{
+   // Whole ticks since the last sample; the remainder carries over
+   uint32_t elapsedUS = m_started ? nowUS - m_lastUS : 0;
+   uint32_t total     = m_tickRemUS + elapsedUS;
+   uint32_t ticks     = std::min(total / m_tickUS, MAX_TICKS);
+
+   m_tickRemUS = total % m_tickUS;
+   m_lastUS    = nowUS;
+   m_started   = true;
+
+   // Counters that run: held buttons reading up count down their release
+   // window, confirm buttons that were down last sample and still are count
+   // down their confirm window.
+   uint32_t confirming = down & m_prevDown & ~m_state & m_confirmMask;
+   uint32_t run        = (~down & m_state) | confirming;
+
+   // Bit-sliced subtract of ticks from every running counter, saturating at 0
+   uint32_t borrow = 0;
+   uint32_t any    = 0;
+   uint32_t diff[NUM_PLANES];
+
+   for (uint32_t p = 0; p < NUM_PLANES; p++)
+   {
+      uint32_t a = m_count[p];
+      uint32_t b = (ticks >> p) & 1 ? ~0u : 0;
+
+      diff[p] = a ^ b ^ borrow;
+      borrow  = (~a & b) | (~(a ^ b) & borrow);
+   }
+
+   uint32_t keep = run & ~borrow;
+
+   for (uint32_t p = 0; p < NUM_PLANES; p++)
+   {
+      m_count[p] = (m_count[p] & ~run) | (diff[p] & keep);
+      any |= m_count[p];
+   }
+
+   uint32_t expired   = run & ~any;
+   uint32_t released  = expired & ~down;
+   uint32_t confirmed = expired & down;
+   uint32_t pressed   = down & ~m_state & ~m_confirmMask;
+
+   m_state = (m_state | pressed | confirmed) & ~released;
+
+   // Anything down and held restarts its release window. Confirm buttons not
+   // yet held restart their confirm window unless it is already running.
+   Load(m_releaseReload, down & m_state);
+   Load(m_confirmReload, m_confirmMask & ~m_state & ~confirming);
+
+   m_prevDown = down;
+
+   return m_state;
+}
@@ -0,0 +1,84 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Debounces all 32 GPIO bits at once. Each button has a small down counter,
+// stored bit-sliced: plane p holds bit p of every button's counter, so one
+// word operation steps all 32 counters together.
+//
+// Presses are passed on as soon as they are seen. A release is only passed
+// on once the button has read up for its release window since it last read
+// down, so contact bounce in that window is ignored. Buttons in the press
+// confirm mask are for noisy leaf switches; they must read down for their
+// confirm window before the press is passed on.
+//
+// Windows are in microseconds and counted in ticks of tickUS on the time
+// given to Update(), not in samples, so they don't depend on the poll rate.
+class Debouncer
+{
+public:
+   static constexpr uint32_t NUM_PLANES = 6;
+   static constexpr uint32_t MAX_TICKS  = (1u << NUM_PLANES) - 1;
+
+   Debouncer() = default;
+   explicit Debouncer(uint32_t tickUS);
+
+   // Windows are rounded up to whole ticks, and capped at MAX_TICKS
+   void SetReleaseWindow(uint32_t mask, uint32_t windowUS);
+   void SetPressConfirm(uint32_t mask, uint32_t windowUS);
+   void ClearPressConfirm(uint32_t mask);
+
+   // down has a 1 for each button currently reading down. Returns the
+   // debounced state, 1 = down.
+   uint32_t Update(uint32_t down, uint32_t nowUS);
+
+   // Marks buttons as down from outside the sampling, e.g. a press caught by
+   // an edge interrupt. They are then held for their full release window.
+   void ForcePress(uint32_t mask);
+
+   uint32_t State() const  { return m_state; }
+   uint32_t TickUS() const { return m_tickUS; }
+
+private:
+   uint32_t Ticks(uint32_t windowUS) const;
+
+   static void SetPlanes(uint32_t *planes, uint32_t mask, uint32_t ticks);
+   void        Load(const uint32_t *planes, uint32_t mask);
+
+   uint32_t m_tickUS       = 250;
+   uint32_t m_state        = 0;
+   uint32_t m_prevDown     = 0;
+   uint32_t m_confirmMask  = 0;
+   uint32_t m_lastUS       = 0;
+   uint32_t m_tickRemUS    = 0;
+   bool     m_started      = false;
+
+   uint32_t m_count[NUM_PLANES]         = {};
+   uint32_t m_releaseReload[NUM_PLANES] = {};
+   uint32_t m_confirmReload[NUM_PLANES] = {};
+};
@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "EdgeQueue.h"
+
+void EdgeQueue::Collect(uint32_t hostButtons)
+{
+   ButtonEdge edge;
+
+   while (m_ring.Pop(&edge))
+   {
+      if (m_numPending == 0)
+      {
+         m_pending[m_numPending++] = edge;
+         continue;
+      }
+
+      ButtonEdge &last = m_pending[m_numPending - 1];
+      uint32_t    prev = m_numPending > 1 ? m_pending[m_numPending - 2].buttons : hostButtons;
+
+      // Merging is only safe if no button changes back: a press and its
+      // release must stay in separate reports. Keeps the earlier time, for
+      // the latency figures.
+      if (((last.buttons ^ prev) & (edge.buttons ^ last.buttons)) == 0)
+      {
+         last.buttons = edge.buttons;
+         m_stats.coalesced++;
+      }
+      else if (m_numPending < MAX_PENDING)
+         m_pending[m_numPending++] = edge;
+      else
+      {
+         last.buttons = edge.buttons;
+         m_stats.forced++;
+      }
+   }
+}
+
+void EdgeQueue::Pop()
+{
+   if (m_numPending == 0)
+      return;
+
+   for (uint32_t i = 1; i < m_numPending; i++)
+      m_pending[i - 1] = m_pending[i];
+
+   m_numPending--;
+}
@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "SPSCRing.h"
+
+#include <cstdint>
+
+// A debounced button state, as of a change
+struct ButtonEdge
+{
+   uint32_t buttons = 0; // 1 = down
+   uint32_t timeUS  = 0; // When the change was seen
+};
+
+// Every change of the debounced buttons, in order, until the host has had it.
+// The sampling side records each change as it's seen, several between polls
+// with the PIO sampler, into a lock-free ring, so it can be on the other
+// core. The USB side collects them into a short sequence of states to send,
+// merging each new state into the one before unless that would undo a change
+// still waiting. So a tap made while the endpoint is busy still goes out as a
+// press then a release, each seen by at least one host poll, while presses of
+// different buttons share a report.
+class EdgeQueue
+{
+public:
+   static constexpr uint32_t MAX_PENDING = 8;
+
+   struct Stats
+   {
+      uint32_t recorded  = 0; // Changes recorded by the sampling side
+      uint32_t dropped   = 0; // Ring full; left to the next change recorded
+      uint32_t coalesced = 0; // Merged into the state before, nothing lost
+      uint32_t forced    = 0; // Merged only because the sequence was full
+   };
+
+   // Sampling side. Records buttons if they differ from the last recorded.
+   void Record(uint32_t buttons, uint32_t timeUS)
+   {
+      if (buttons == m_recorded)
+         return;
+
+      if (!m_ring.Push(ButtonEdge { buttons, timeUS }))
+      {
+         m_stats.dropped++;
+         return;
+      }
+
+      m_recorded = buttons;
+      m_stats.recorded++;
+   }
+
+   // USB side. Takes in everything recorded since the last call, following
+   // hostButtons, the state the host has now.
+   void Collect(uint32_t hostButtons);
+
+   uint32_t          Pending() const { return m_numPending; }
+   const ButtonEdge &Front() const   { return m_pending[0]; } // The oldest state not yet sent
+   void              Pop();
+
+   const Stats &GetStats() const { return m_stats; }
+
+private:
+   SPSCRing<ButtonEdge, 32> m_ring;
+   uint32_t                 m_recorded = 0;
+
+   ButtonEdge m_pending[MAX_PENDING];
+   uint32_t   m_numPending = 0;
+   Stats      m_stats;
+};
@@ -26,52 +26,92 @@
 #include "Encoder.h"
 
 #include "EncoderPio.h"
+#include "Telemetry.h"
 
+#include "pico/time.h"
+
+#include <algorithm>
 #include <cstdint>
 
-float Encoder::s_rotation[2];
-float Encoder::s_gain;
+volatile int32_t  Encoder::s_steps[2];
+volatile uint32_t Encoder::s_edgeUS[2];
+volatile uint32_t Encoder::s_irqCount[2];
+
+// A whole count in 16.16
+static constexpr int64_t ONE_COUNT = int64_t(1) << Encoder::GAIN_FRAC_BITS;
 
 void Encoder::IRQHandler0()
 {
+    // Stamped before the count changes, see Steps()
+    s_edgeUS[0] = time_us_32();
+
+#if ARCADE_CTRL_TELEMETRY
+    s_irqCount[0]++;
+#endif
+
     // test if irq 0 was raised
     if (pio0_hw->irq & 1)
-        s_rotation[0] -= s_gain;
+        s_steps[0]--;
     // test if irq 1 was raised
     if (pio0_hw->irq & 2)
-        s_rotation[0] += s_gain;
+        s_steps[0]++;
     // clear both interrupts
     pio0_hw->irq = 3;
 }
 
 void Encoder::IRQHandler1()
 {
+    // Stamped before the count changes, see Steps()
+    s_edgeUS[1] = time_us_32();
+
+#if ARCADE_CTRL_TELEMETRY
+    s_irqCount[1]++;
+#endif
+
     // test if irq 0 was raised
     if (pio1_hw->irq & 1)
-        s_rotation[1] -= s_gain;
+        s_steps[1]--;
     // test if irq 1 was raised
     if (pio1_hw->irq & 2)
-        s_rotation[1] += s_gain;
+        s_steps[1]++;
     // clear both interrupts
     pio1_hw->irq = 3;
 }
 
-Encoder::Encoder(uint32_t pioIndex, uint32_t pinA, uint32_t pinB, float gain) :
-    m_pioIndex(pioIndex)
+void Encoder::ClearIRQCounts()
 {
-    assert(pioIndex < 2);
+    s_irqCount[0] = 0;
+    s_irqCount[1] = 0;
+}
 
-    s_gain = gain;
+Encoder::Encoder(uint32_t pioIndex, uint32_t pinA, uint32_t pinB, float gain, bool pioCount) :
+    m_pioIndex(pioIndex),
+    m_pioCount(pioCount),
+    m_gain(ToFixed(gain))
+{
+    assert(pioIndex < 2);
+    assert(pinB == pinA + 1);
 
     m_pio = pioIndex == 0 ? pio0 : pio1;
 
     pio_gpio_init(m_pio, pinA);
     pio_gpio_init(m_pio, pinB);
 
+    if (m_pioCount)
+    {
+        // The state machine counts by itself, so there's no interrupt to set up
+        uint32_t offset = pio_add_program(m_pio, &QuadEncoderCount_program);
+        m_stateMachine = pio_claim_unused_sm(m_pio, true);
+        EncoderCountProgramInit(m_pio, m_stateMachine, offset, pinA);
+
+        Zero();
+        return;
+    }
+
     // Claim state machine
     uint32_t offset = pio_add_program(m_pio, &QuadEncoder_program);
     m_stateMachine = pio_claim_unused_sm(m_pio, true);
-    EncoderProgramInit(m_pio, m_stateMachine, offset, pinA, pinB);
+    EncoderProgramInit(m_pio, m_stateMachine, offset, pinA);
 
     // set the IRQ handler
     if (pioIndex == 0)
@@ -92,12 +132,145 @@ Encoder::Encoder(uint32_t pioIndex, uint32_t pinA, uint32_t pinB, float gain) :
     Zero();
 }
 
+int32_t Encoder::Steps(uint32_t *edgeUS) const
+{
+    if (!m_pioCount)
+    {
+        // The handler stamps the edge before counting it, so if the count
+        // reads the same either side of the stamp, the two go together
+        int32_t steps;
+
+        do
+        {
+            steps   = s_steps[m_pioIndex];
+            *edgeUS = s_edgeUS[m_pioIndex];
+        }
+        while (steps != s_steps[m_pioIndex]);
+
+        return steps;
+    }
+
+    // The state machine pushes its count every pass without blocking, so
+    // anything already queued may be stale. Discard it and wait for the next
+    // push, which is at most a pass (10 cycles) away.
+    uint32_t stale = pio_sm_get_rx_fifo_level(m_pio, m_stateMachine);
+
+    for (uint32_t i = 0; i < stale; i++)
+        pio_sm_get(m_pio, m_stateMachine);
+
+    // There's no per edge time here, so any movement is put down to now
+    *edgeUS = time_us_32();
+
+    return static_cast<int32_t>(pio_sm_get_blocking(m_pio, m_stateMachine));
+}
+
 void Encoder::Zero()
 {
-    s_rotation[m_pioIndex] = 0.0f;
+    uint32_t edgeUS;
+
+    m_lastSteps = Steps(&edgeUS);
+    m_position  = 0;
+    m_count     = 0;
+    m_haveEdge  = false;
+    m_speed     = 0;
+    m_gliding   = false;
+    m_estimate  = 0;
 }
 
-int32_t Encoder::Read() const
+void Encoder::Edges(int32_t moved, uint32_t edgeUS)
 {
-   return static_cast<int32_t>(s_rotation[m_pioIndex]);
+    uint32_t gapUS = edgeUS - m_edgeUS;
+
+    // Speed over every edge since the last one the previous read saw. After a
+    // long enough gap the motion is starting from rest, with nothing to go on.
+    if (m_haveEdge && gapUS != 0 && gapUS < SMOOTH_MAX_GAP_US)
+    {
+        int64_t speed = (moved < 0 ? -moved : moved) * ONE_COUNT * 1000 / gapUS;
+        m_speed = static_cast<int32_t>(std::min<int64_t>(speed, INT32_MAX));
+    }
+    else
+        m_speed = 0;
+
+    m_dir      = moved > 0 ? 1 : -1;
+    m_edgeUS   = edgeUS;
+    m_haveEdge = true;
+
+    // Glide on from wherever the estimate had got to, but never from more
+    // than a count behind
+    int64_t target = m_count * ONE_COUNT;
+    int64_t behind = target - m_dir * ONE_COUNT;
+
+    m_glideFrom = m_dir > 0 ? std::clamp(m_estimate, behind, target) : std::clamp(m_estimate, target, behind);
+    m_gliding   = m_speed != 0;
+}
+
+int64_t Encoder::Interpolate(uint32_t nowUS)
+{
+    int64_t target = m_count * ONE_COUNT;
+
+    if (!m_gliding)
+        return target;
+
+    int64_t advance  = int64_t(m_speed) * (nowUS - m_edgeUS) / 1000;
+    int64_t estimate = m_dir > 0 ? std::min(m_glideFrom + advance, target) : std::max(m_glideFrom - advance, target);
+
+    // Once caught up there's nothing more to do until the next edge, which
+    // also stops the elapsed time above from ever wrapping
+    if (estimate == target)
+        m_gliding = false;
+
+    return estimate;
+}
+
+int32_t Encoder::AccelScale() const
+{
+    const AccelCurve::Point *p = m_accel->points;
+    uint32_t                 n = m_accel->numPoints;
+
+    if (m_speed <= p[0].speed)
+        return p[0].scale;
+
+    for (uint32_t i = 1; i < n; i++)
+    {
+        if (m_speed < p[i].speed)
+        {
+            int64_t along = int64_t(p[i].scale - p[i - 1].scale) * (m_speed - p[i - 1].speed);
+            return p[i - 1].scale + static_cast<int32_t>(along / (p[i].speed - p[i - 1].speed));
+        }
+    }
+
+    return p[n - 1].scale;
+}
+
+int32_t Encoder::Read()
+{
+    // The difference is taken before widening so the step count can wrap
+    uint32_t edgeUS;
+    int32_t  steps = Steps(&edgeUS);
+    int32_t  delta = static_cast<int32_t>(static_cast<uint32_t>(steps) - static_cast<uint32_t>(m_lastSteps));
+
+    m_lastSteps  = steps;
+    m_count     += delta;
+
+    if (delta != 0)
+        Edges(delta, edgeUS);
+
+    int64_t estimate = m_smooth ? Interpolate(time_us_32()) : m_count * ONE_COUNT;
+    int64_t moved    = estimate - m_estimate;
+
+    m_estimate = estimate;
+
+    // 16.16 counts by 16.16 gain. The acceleration scale is applied to the
+    // product at 16.16, which loses the odd bit but acceleration doesn't
+    // conserve counts anyway.
+    int64_t scaled = moved * m_gain;
+
+    if (m_accel != nullptr)
+        scaled = (scaled >> GAIN_FRAC_BITS) * AccelScale();
+
+    m_position += static_cast<uint64_t>(scaled);
+
+    // Dropping the fraction floors, so what's left in m_position is always a
+    // positive fraction and carries into the next read in either direction
+    return static_cast<int32_t>(m_position >> (2 * GAIN_FRAC_BITS));
 }
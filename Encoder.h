@@ -23,27 +23,108 @@
  *
  */
 
+#pragma once
+
 #include <cstdint>
 
 #include "hardware/pio.h"
 
+// The interrupt handlers only count raw quadrature steps, as integers, since
+// the M0+ has no FPU. Each encoder's gain is applied at read time in 16.16
+// fixed point, and the position is kept at that precision so fractions of a
+// count carry over between reads rather than being lost.
+//
+// With pioCount the state machine keeps the step count itself and there are
+// no interrupts at all, which suits high PPR spinners and trackballs that
+// would otherwise interrupt the CPU tens of thousands of times a second.
+//
+// Each interrupt also stamps the time of the edge, from which Read() keeps a
+// speed estimate. With smoothing on, a slow trackball's position is
+// interpolated between edges at that speed, running up to a count behind the
+// real one, so a count every few polls comes out as a steady fraction each
+// poll rather than a stair step. The estimate only ever closes on the real
+// count, so nothing is lost once the motion stops. An optional acceleration
+// curve then scales the gain with speed.
 class Encoder
 {
 public:
+   static constexpr uint32_t GAIN_FRAC_BITS = 16;
+
+   // Edges further apart than this are taken as motion starting from rest,
+   // which is reported straight away rather than spread over the gap
+   static constexpr uint32_t SMOOTH_MAX_GAP_US = 50000;
+
+   // Gain multiplier against speed, linearly interpolated between points and
+   // held flat past either end. Speeds are raw counts per ms, before the gain.
+   // Both are 16.16, see ToFixed().
+   struct AccelCurve
+   {
+      static constexpr uint32_t MAX_POINTS = 4;
+
+      struct Point
+      {
+         int32_t speed;
+         int32_t scale;
+      };
+
+      uint32_t numPoints;
+      Point    points[MAX_POINTS];
+   };
+
    Encoder() = default;
-   Encoder(uint32_t pioIndex, uint32_t pinA, uint32_t pinB, float gain);
+   Encoder(uint32_t pioIndex, uint32_t pinA, uint32_t pinB, float gain, bool pioCount = false);
+
+   void    SetGain(float gain)                  { m_gain = ToFixed(gain); }
+   void    SetSmoothing(bool smooth)            { m_smooth = smooth; }
+   void    SetAccel(const AccelCurve *curve)    { m_accel = curve; }
 
    void    Zero();
-   int32_t Read() const;
+   int32_t Read();
+
+   // Counts per ms in 16.16, as of the last edge seen by Read()
+   int32_t Speed() const { return m_speed; }
+
+   // Step interrupts taken per PIO, for telemetry
+   static uint32_t IRQCount(uint32_t pioIndex) { return s_irqCount[pioIndex & 1]; }
+   static void     ClearIRQCounts();
+
+   // Float to 16.16. Constant tables get converted at compile time; anything
+   // else only at construction, so the soft-float is fine.
+   static constexpr int32_t ToFixed(float value)
+   {
+      return static_cast<int32_t>(value * (1 << GAIN_FRAC_BITS) + (value < 0.0f ? -0.5f : 0.5f));
+   }
 
 private:
+   int32_t Steps(uint32_t *edgeUS) const;
+   void    Edges(int32_t moved, uint32_t edgeUS);
+   int64_t Interpolate(uint32_t nowUS);
+   int32_t AccelScale() const;
+
    static void IRQHandler0();
    static void IRQHandler1();
 
-   static float s_rotation[2];
-   static float s_gain;
+   static volatile int32_t  s_steps[2];
+   static volatile uint32_t s_edgeUS[2];
+   static volatile uint32_t s_irqCount[2];
 
    uint32_t m_pioIndex = 0;
+   bool     m_pioCount = false;
    PIO      m_pio;
    uint32_t m_stateMachine = 0;
+   int32_t  m_gain         = 1 << GAIN_FRAC_BITS;
+   int32_t  m_lastSteps    = 0;
+   uint64_t m_position     = 0; // In 32.32 counts after gain, left to wrap like the angle it's read as
+
+   bool              m_smooth = false;
+   const AccelCurve *m_accel  = nullptr;
+
+   int64_t  m_count       = 0; // Steps, unwrapped
+   uint32_t m_edgeUS      = 0; // Latest edge seen by Read()
+   bool     m_haveEdge    = false;
+   int32_t  m_speed       = 0; // 16.16 counts per ms
+   int32_t  m_dir         = 1;
+   bool     m_gliding     = false; // Estimate still closing on the count
+   int64_t  m_glideFrom   = 0;     // 16.16 counts, at m_edgeUS
+   int64_t  m_estimate    = 0;     // 16.16 counts, as last read
 };
@@ -57,7 +57,7 @@ static inline pio_sm_config QuadEncoder_program_get_default_config(uint offset)
     return c;
 }
 
-static inline void EncoderProgramInit(PIO pio, uint sm, uint offset, uint pinA, uint pinB)
+static inline void EncoderProgramInit(PIO pio, uint sm, uint offset, uint pinA)
 {
     pio_sm_config cfg = QuadEncoder_program_get_default_config(offset);
     sm_config_set_in_pins(&cfg, pinA);
@@ -68,3 +68,70 @@ static inline void EncoderProgramInit(PIO pio, uint sm, uint offset, uint pinA,
 
 #endif
 
+// ---------------- //
+// QuadEncoderCount //
+// ---------------- //
+
+#define QuadEncoderCount_wrap_target 17
+#define QuadEncoderCount_wrap 25
+
+#define QuadEncoderCount_offset_pc_start 26u
+
+static const uint16_t QuadEncoderCount_program_instructions[] = {
+    0x0011, //  0: jmp    17                         
+    0x0010, //  1: jmp    16                         
+    0x0017, //  2: jmp    23                         
+    0x0011, //  3: jmp    17                         
+    0x0017, //  4: jmp    23                         
+    0x0011, //  5: jmp    17                         
+    0x0011, //  6: jmp    17                         
+    0x0010, //  7: jmp    16                         
+    0x0010, //  8: jmp    16                         
+    0x0011, //  9: jmp    17                         
+    0x0011, // 10: jmp    17                         
+    0x0017, // 11: jmp    23                         
+    0x0011, // 12: jmp    17                         
+    0x0017, // 13: jmp    23                         
+    0x0010, // 14: jmp    16                         
+    0x0011, // 15: jmp    17                         
+    0x0051, // 16: jmp    x--, 17                    
+            //     .wrap_target
+    0xa0c1, // 17: mov    isr, x                     
+    0x8000, // 18: push   noblock                    
+    0x60c2, // 19: out    isr, 2                     
+    0x4002, // 20: in     pins, 2                    
+    0xa0e6, // 21: mov    osr, isr                   
+    0xa0a6, // 22: mov    pc, isr                    
+    0xa029, // 23: mov    x, !x                      
+    0x0059, // 24: jmp    x--, 25                    
+    0xa029, // 25: mov    x, !x                      
+            //     .wrap
+    0xa0e0, // 26: mov    osr, pins                  
+    0x0013, // 27: jmp    19                         
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program QuadEncoderCount_program = {
+    .instructions = QuadEncoderCount_program_instructions,
+    .length = 28,
+    .origin = 0,
+};
+
+static inline pio_sm_config QuadEncoderCount_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + QuadEncoderCount_wrap_target, offset + QuadEncoderCount_wrap);
+    return c;
+}
+
+static inline void EncoderCountProgramInit(PIO pio, uint sm, uint offset, uint pinA)
+{
+    pio_sm_config cfg = QuadEncoderCount_program_get_default_config(offset);
+    sm_config_set_in_pins(&cfg, pinA);
+    sm_config_set_in_shift(&cfg, /*shift_right=*/false, /*autopush=*/false, 0);
+    sm_config_set_fifo_join(&cfg, PIO_FIFO_JOIN_RX);
+    pio_sm_init(pio, sm, offset + QuadEncoderCount_offset_pc_start, &cfg);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+#endif
+
@@ -29,17 +29,12 @@
 
 struct InputData
 {
-   int8_t USBValueFromAnalog(uint32_t adcIndex)
-   {
-      // Bottom 4 bits of the 12-bit adc just seem to be noise,
-      // so ignore them and make signed
-      uint16_t a = (analog[adcIndex] >> 4) & 0xFF;
-      int16_t s = a - 128;
-      return s;
-   }
-
    uint32_t buttons;
-   uint16_t analog[3];
+   uint16_t analog[3]; // ADC readings scaled to 16 bits
+   int16_t  axis[3];   // Analogs after calibration, as reported
    int32_t  angle[2];
    int32_t  angleDelta[2];
+   uint32_t sampleUS;  // When read, for telemetry and the trace
+   uint32_t raw;       // Undebounced button levels, as last sampled, for the trace
+   uint32_t rawEdges;  // Of those, the ones that changed since the last poll
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "InputTrace.h"
+
+#include <algorithm>
+
+// Empty in builds without the CDC interface
+void InputTrace::Record([[maybe_unused]] const InputData &inputs, [[maybe_unused]] uint32_t sentUS)
+{
+#if CFG_TUD_CDC
+   if (sentUS == 0 && inputs.rawEdges == 0)
+      return;
+
+   TraceRecord record;
+   record.sync     = TRACE_SYNC;
+   record.seq      = m_seq++;
+   record.sampleUS = inputs.sampleUS;
+   record.sentUS   = sentUS;
+   record.buttons  = inputs.buttons;
+   record.changed  = inputs.buttons ^ m_lastButtons;
+   record.raw      = inputs.raw;
+   record.rawEdges = inputs.rawEdges;
+   record.dropped  = uint16_t(m_dropped);
+
+   // Anything beyond 16 bits goes in the next record
+   for (uint32_t i = 0; i < 2; i++)
+   {
+      int32_t moved = inputs.angle[i] - m_lastAngle[i];
+
+      record.counts[i] = int16_t(std::min(std::max(moved, -32768), 32767));
+      m_lastAngle[i]  += record.counts[i];
+   }
+
+   for (uint32_t i = 0; i < 3; i++)
+      record.analog[i] = inputs.analog[i];
+
+   // Taken as made whether or not there's room, so a drop shows as a gap in seq
+   m_lastButtons = inputs.buttons;
+
+   if (!m_ring.Push(record))
+      m_dropped++;
+#endif
+}
+
+void InputTrace::Flush()
+{
+#if CFG_TUD_CDC
+   TraceRecord record;
+
+   // With no terminal open, there's no one to tell about drops
+   if (!tud_cdc_connected())
+   {
+      while (m_ring.Pop(&record))
+         ;
+      return;
+   }
+
+   bool wrote = false;
+
+   while (tud_cdc_write_available() >= sizeof(record) && m_ring.Pop(&record))
+   {
+      tud_cdc_write(&record, sizeof(record));
+      wrote = true;
+   }
+
+   if (wrote)
+      tud_cdc_write_flush();
+#endif
+}
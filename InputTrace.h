@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "InputData.h"
+#include "SPSCRing.h"
+#include "TraceRecord.h"
+#include "tusb.h"
+
+// Collects TraceRecords from the loop that queues the reports and writes
+// them to the CDC interface from the USB side, through a lock-free ring so
+// neither waits on the other. Does nothing unless built with CDC.
+class InputTrace
+{
+public:
+   // After each poll, with when its report was queued (zero if it wasn't)
+   void Record(const InputData &inputs, uint32_t sentUS);
+
+   // Moves as many records to the CDC FIFO as it has room for
+   void Flush();
+
+   uint32_t Dropped() const { return m_dropped; }
+
+private:
+   static constexpr uint32_t RING_SIZE = 64;
+
+   SPSCRing<TraceRecord, RING_SIZE> m_ring;
+
+   uint16_t m_seq         = 0;
+   uint32_t m_dropped     = 0;
+   uint32_t m_lastButtons = 0;
+   int32_t  m_lastAngle[2] = {};
+};
@@ -0,0 +1,69 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "Keyboard.h"
+
+constexpr uint8_t FIRST_MODIFIER = 0xE0;
+constexpr uint8_t LAST_MODIFIER  = 0xE7;
+
+Keyboard::Keyboard(const KeyMap &map)
+{
+   KeyboardReport taken = {};
+
+   for (uint32_t i = 0; i < 32; i++)
+   {
+      uint8_t usage = map.usage[i];
+      Slot    slot;
+
+      if (usage >= FIRST_MODIFIER && usage <= LAST_MODIFIER)
+         slot = { 0, uint8_t(1u << (usage - FIRST_MODIFIER)) };
+      else if (usage != 0 && usage < KEY_BITMAP_BYTES * 8)
+         slot = { uint8_t(1 + usage / 8), uint8_t(1u << (usage % 8)) };
+      else
+         continue;
+
+      if (Byte(taken, slot) & slot.bit)
+         continue;
+
+      Byte(taken, slot) |= slot.bit;
+      m_slots[i]         = slot;
+      m_mask            |= 1u << i;
+   }
+}
+
+const KeyboardReport &Keyboard::Update(uint32_t buttons)
+{
+   buttons &= m_mask;
+
+   for (uint32_t changed = buttons ^ m_buttons; changed != 0; changed &= changed - 1)
+   {
+      const Slot &slot = m_slots[__builtin_ctz(changed)];
+
+      Byte(m_report, slot) ^= slot.bit;
+   }
+
+   m_buttons = buttons;
+   return m_report;
+}
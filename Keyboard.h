@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// HID keyboard usage for each GPIO, zero for none. Modifiers are the usual
+// 0xE0-0xE7 usages.
+struct KeyMap
+{
+   uint8_t usage[32];
+};
+
+// Usages 0 to KEY_BITMAP_BYTES * 8 - 1 are in the bitmap, which takes in
+// letters, digits, function keys, arrows and the keypad
+constexpr uint32_t KEY_BITMAP_BYTES = 15;
+
+// Matches HID_REPORT_DESC_KEYBOARD_NKRO: a bit per key rather than the boot
+// keyboard's six key array, so any number can be down at once
+struct __attribute__((packed)) KeyboardReport
+{
+   uint8_t modifiers;
+   uint8_t keys[KEY_BITMAP_BYTES];
+};
+
+// Turns the button state into an N-key-rollover keyboard report. The map is
+// resolved once into the byte and bit each GPIO sets, and each Update() only
+// flips the bits of the buttons that changed since the last one.
+//
+// A usage outside the bitmap, or one already taken by a lower GPIO, leaves
+// that GPIO without a key, so each bit has one owner and flipping is exact.
+class Keyboard
+{
+public:
+   Keyboard() = default;
+   explicit Keyboard(const KeyMap &map);
+
+   bool     Enabled() const { return m_mask != 0; }
+   uint32_t Mask() const    { return m_mask; } // GPIOs with a key
+
+   const KeyboardReport &Update(uint32_t buttons);
+
+private:
+   struct Slot
+   {
+      uint8_t byte = 0; // Into the report, so 0 is the modifiers
+      uint8_t bit  = 0;
+   };
+
+   static uint8_t &Byte(KeyboardReport &report, const Slot &slot)
+   {
+      return slot.byte == 0 ? report.modifiers : report.keys[slot.byte - 1];
+   }
+
+   Slot           m_slots[32];
+   uint32_t       m_mask    = 0;
+   uint32_t       m_buttons = 0; // As of the report
+   KeyboardReport m_report  = {};
+};
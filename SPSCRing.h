@@ -0,0 +1,76 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer ring. One core pushes, the other
+// pops; neither ever waits for the other. The head and tail are free running
+// counters, so SIZE must be a power of two and a full ring is head - tail == SIZE.
+template <typename T, uint32_t SIZE>
+class SPSCRing
+{
+   static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SPSCRing size must be a power of two");
+
+public:
+   // Producer only. Returns false, leaving the ring untouched, if it is full.
+   bool Push(const T &item)
+   {
+      uint32_t head = m_head.load(std::memory_order_relaxed);
+
+      if (head - m_tail.load(std::memory_order_acquire) == SIZE)
+         return false;
+
+      m_items[head & (SIZE - 1)] = item;
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+   }
+
+   // Consumer only. Returns false if there is nothing to pop.
+   bool Pop(T *item)
+   {
+      uint32_t tail = m_tail.load(std::memory_order_relaxed);
+
+      if (m_head.load(std::memory_order_acquire) == tail)
+         return false;
+
+      *item = m_items[tail & (SIZE - 1)];
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   // Approximate when called from either side while the other is running
+   uint32_t Size() const
+   {
+      return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+   }
+
+private:
+   std::atomic<uint32_t> m_head { 0 };
+   std::atomic<uint32_t> m_tail { 0 };
+   T                     m_items[SIZE];
+};
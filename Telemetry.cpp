@@ -0,0 +1,124 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "Telemetry.h"
+#include "Encoder.h"
+
+#include <cstring>
+
+uint16_t Telemetry::GetReport(uint8_t reportID, uint8_t *buffer, uint16_t reqlen) const
+{
+   if (reportID == TELEMETRY_COUNTERS_ID)
+   {
+      TelemetryCounters report = {};
+
+      if (reqlen < sizeof(report))
+         return 0;
+
+      report.version    = TELEMETRY_VERSION;
+      report.compiledIn = ARCADE_CTRL_TELEMETRY;
+
+#if ARCADE_CTRL_TELEMETRY
+      report.sinceClearMS   = (time_us_32() - m_clearedUS) / 1000;
+      report.loops          = m_loops;
+      report.polls          = m_polls;
+      report.overruns       = m_overruns;
+      report.maxLateUS      = m_maxLateUS;
+      report.queued         = m_queued;
+      report.completed      = m_completed;
+      report.readyMisses    = m_readyMisses;
+      report.encoderIRQs[0] = Encoder::IRQCount(0);
+      report.encoderIRQs[1] = Encoder::IRQCount(1);
+      report.sleeps[0]      = m_sleeps[0];
+      report.sleeps[1]      = m_sleeps[1];
+      report.sleptMS[0]     = uint32_t(m_sleptUS[0] / 1000);
+      report.sleptMS[1]     = uint32_t(m_sleptUS[1] / 1000);
+#endif
+
+      memcpy(buffer, &report, sizeof(report));
+      return sizeof(report);
+   }
+
+   const Histogram *histogram = nullptr;
+
+   switch (reportID)
+   {
+   case TELEMETRY_LOOP_ID:              histogram = &m_loop;            break;
+   case TELEMETRY_SAMPLE_TO_QUEUE_ID:   histogram = &m_sampleToQueue;   break;
+   case TELEMETRY_QUEUE_TO_COMPLETE_ID: histogram = &m_queueToComplete; break;
+   default:                             return 0;
+   }
+
+   TelemetryHistogram report = {};
+
+   if (reqlen < sizeof(report))
+      return 0;
+
+   report.version    = TELEMETRY_VERSION;
+   report.compiledIn = ARCADE_CTRL_TELEMETRY;
+   report.maxUS      = histogram->maxUS;
+   memcpy(report.buckets, histogram->buckets, sizeof(report.buckets));
+
+   memcpy(buffer, &report, sizeof(report));
+   return sizeof(report);
+}
+
+void Telemetry::SetReport(uint8_t reportID, const uint8_t *buffer, uint16_t len)
+{
+   TelemetryCounters req;
+
+   if (reportID != TELEMETRY_COUNTERS_ID || len != sizeof(req))
+      return;
+
+   memcpy(&req, buffer, sizeof(req));
+
+   if (req.version == TELEMETRY_VERSION && req.command == TELEMETRY_CLEAR)
+      Clear();
+}
+
+// From tud_task(), so the sampling core may be part way through an update.
+// At worst one event lands either side of the clear.
+void Telemetry::Clear()
+{
+   m_loops       = 0;
+   m_polls       = 0;
+   m_overruns    = 0;
+   m_maxLateUS   = 0;
+   m_queued      = 0;
+   m_completed   = 0;
+   m_readyMisses = 0;
+   m_sleeps[0]   = 0;
+   m_sleeps[1]   = 0;
+   m_sleptUS[0]  = 0;
+   m_sleptUS[1]  = 0;
+
+   m_loop            = {};
+   m_sampleToQueue   = {};
+   m_queueToComplete = {};
+
+   Encoder::ClearIRQCounts();
+
+   m_clearedUS = NowUS();
+}
@@ -0,0 +1,156 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "TelemetryReport.h"
+
+#include "pico/time.h"
+
+#ifndef ARCADE_CTRL_TELEMETRY
+#define ARCADE_CTRL_TELEMETRY 1
+#endif
+
+// Each event costs a timer read and a few adds, on whichever core records
+// it. Each counter has only the one writer; the feature reports read them
+// from tud_task() as they are.
+class Telemetry
+{
+public:
+   struct Histogram
+   {
+      uint32_t maxUS = 0;
+      uint32_t buckets[TELEMETRY_BUCKETS] = {};
+
+      void Add(uint32_t us)
+      {
+         uint32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+         buckets[bucket < TELEMETRY_BUCKETS ? bucket : TELEMETRY_BUCKETS - 1]++;
+
+         if (us > maxUS)
+            maxUS = us;
+      }
+   };
+
+   static uint32_t NowUS()
+   {
+#if ARCADE_CTRL_TELEMETRY
+      return time_us_32();
+#else
+      return 0;
+#endif
+   }
+
+   // Top of each main loop iteration
+   void LoopIteration()
+   {
+#if ARCADE_CTRL_TELEMETRY
+      uint32_t now = time_us_32();
+
+      if (m_loops++ != 0)
+         m_loop.Add(now - m_loopUS);
+
+      m_loopUS = now;
+#endif
+   }
+
+   // Each poll, with how long after it was due it started
+   void Poll(uint32_t lateUS, uint32_t intervalUS)
+   {
+#if ARCADE_CTRL_TELEMETRY
+      // The first has nothing to be late against
+      if (m_polls++ == 0)
+         return;
+
+      if (lateUS >= intervalUS)
+         m_overruns++;
+
+      if (lateUS > m_maxLateUS)
+         m_maxLateUS = lateUS;
+#endif
+   }
+
+   void Queued(uint8_t instance, uint32_t sampleUS)
+   {
+#if ARCADE_CTRL_TELEMETRY
+      uint32_t now = time_us_32();
+
+      m_sampleToQueue.Add(now - sampleUS);
+      m_queuedUS[instance & 1] = now;
+      m_queued++;
+#endif
+   }
+
+   void Completed(uint8_t instance)
+   {
+#if ARCADE_CTRL_TELEMETRY
+      m_queueToComplete.Add(time_us_32() - m_queuedUS[instance & 1]);
+      m_completed++;
+#endif
+   }
+
+   void ReadyMiss()
+   {
+#if ARCADE_CTRL_TELEMETRY
+      m_readyMisses++;
+#endif
+   }
+
+   // Each wait in WFE, by the core that waited
+   void Slept(uint32_t core, uint32_t us)
+   {
+#if ARCADE_CTRL_TELEMETRY
+      m_sleeps[core & 1]++;
+      m_sleptUS[core & 1] += us;
+#endif
+   }
+
+   // Feature report handlers, for the TELEMETRY_*_ID reports
+   uint16_t GetReport(uint8_t reportID, uint8_t *buffer, uint16_t reqlen) const;
+   void     SetReport(uint8_t reportID, const uint8_t *buffer, uint16_t len);
+
+private:
+   void Clear();
+
+   uint32_t m_clearedUS   = 0;
+   uint32_t m_loops       = 0;
+   uint32_t m_loopUS      = 0;
+   uint32_t m_polls       = 0;
+   uint32_t m_overruns    = 0;
+   uint32_t m_maxLateUS   = 0;
+   uint32_t m_queued      = 0;
+   uint32_t m_completed   = 0;
+   uint32_t m_readyMisses = 0;
+   uint32_t m_queuedUS[2] = {}; // Per HID instance
+   uint32_t m_sleeps[2]   = {}; // Per core
+   uint64_t m_sleptUS[2]  = {};
+
+   Histogram m_loop;
+   Histogram m_sampleToQueue;
+   Histogram m_queueToComplete;
+};
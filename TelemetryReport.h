@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// On-device latency and loop timing, read out through vendor defined HID
+// feature reports on the gamepad interface: one of counters and one per
+// histogram. Recorded by the Telemetry class. Build with
+// ARCADE_CTRL_TELEMETRY=0 to compile the recording out; the reports are
+// still there, but say so and hold zeros.
+//
+// Shared with the host side tools, so plain fixed-size fields only.
+// Little-endian, as both ends are.
+
+constexpr uint8_t TELEMETRY_VERSION = 2;
+
+enum : uint8_t
+{
+   TELEMETRY_COUNTERS_ID = 0x11,
+   TELEMETRY_LOOP_ID,              // Main loop iteration, us
+   TELEMETRY_SAMPLE_TO_QUEUE_ID,   // Inputs read to their report queued, us
+   TELEMETRY_QUEUE_TO_COMPLETE_ID, // Report queued to the host taking it, us
+   TELEMETRY_END_ID
+};
+
+// Set on the counters report to start over
+constexpr uint8_t TELEMETRY_CLEAR = 1;
+
+// Bucket 0 counts zeros, bucket n values in [2^(n-1), 2^n), and the last
+// everything from 2^(TELEMETRY_BUCKETS-2) up, which is 2ms on
+constexpr uint32_t TELEMETRY_BUCKETS = 13;
+
+struct __attribute__((packed)) TelemetryCounters
+{
+   uint8_t  version;        // TELEMETRY_VERSION
+   uint8_t  compiledIn;     // Zero if built with ARCADE_CTRL_TELEMETRY=0
+   uint8_t  command;        // Set: TELEMETRY_CLEAR
+   uint8_t  reserved;
+   uint32_t sinceClearMS;
+   uint32_t loops;          // Main loop iterations
+   uint32_t polls;          // Times the inputs were read
+   uint32_t overruns;       // Polls that started a whole interval late or more
+   uint32_t maxLateUS;      // Latest a poll has started
+   uint32_t queued;         // Reports queued, all interfaces
+   uint32_t completed;      // Reports the host has taken
+   uint32_t readyMisses;    // Reports not queued because the endpoint was busy
+   uint32_t encoderIRQs[2]; // Step interrupts, zero when counted by PIO
+   uint32_t sleeps[2];      // Waits in WFE, per core
+   uint32_t sleptMS[2];     // Time spent in them
+};
+
+struct __attribute__((packed)) TelemetryHistogram
+{
+   uint8_t  version;        // TELEMETRY_VERSION
+   uint8_t  compiledIn;
+   uint16_t reserved;
+   uint32_t maxUS;
+   uint32_t buckets[TELEMETRY_BUCKETS];
+};
+
+static_assert(sizeof(TelemetryCounters) == 60, "TelemetryCounters layout changed");
+static_assert(sizeof(TelemetryHistogram) == 60, "TelemetryHistogram layout changed");
@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// The input event trace streamed over the CDC ACM interface of builds with
+// ARCADE_CTRL_TRACE. A record is written for each poll that queued a report
+// or saw a button's raw level change, back to back with nothing in between.
+// Records the host didn't read in time are dropped rather than holding up the
+// HID reports; seq then skips by the number dropped.
+//
+// Shared with the host side tools, so plain fixed-size fields only.
+// Little-endian, as both ends are.
+
+// First in every record, to find the start of one when the stream is
+// opened part way through
+constexpr uint16_t TRACE_SYNC = 0x5441; // "AT"
+
+struct __attribute__((packed)) TraceRecord
+{
+   uint16_t sync;      // TRACE_SYNC
+   uint16_t seq;       // One more than the last record made, sent or not
+   uint32_t sampleUS;  // When the inputs were read, or a press interrupt taken
+   uint32_t sentUS;    // When the report was queued, zero if none was
+   uint32_t buttons;   // As reported, debounced, bit per GPIO
+   uint32_t changed;   // Buttons that changed since the previous record
+   uint32_t raw;       // Undebounced, as last sampled
+   uint32_t rawEdges;  // Raw levels that changed since the previous poll, bounce included
+   int16_t  counts[2]; // Encoder motion since the previous record, after gain
+   uint16_t analog[3]; // Filtered ADC readings at 16 bits
+   uint16_t dropped;   // Records dropped so far, wrapping
+};
+
+static_assert(sizeof(TraceRecord) == 40, "TraceRecord layout changed");
@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Runtime tuning over a vendor defined HID feature report on the gamepad
+// interface, so latency settings can be tried without a rebuild or the device
+// re-enumerating. GET_REPORT returns the values in use. SET_REPORT changes the
+// fields named in its mask, from the next poll, and with TUNING_SAVE also
+// saves them to flash for the next boot. The host's polling interval is fixed
+// when it enumerates, so it's reported but can't be set.
+//
+// Shared with the host side tools, so plain fixed-size fields only.
+// Little-endian, as both ends are.
+
+constexpr uint8_t TUNING_REPORT_ID = 0x10;
+constexpr uint8_t TUNING_VERSION   = 1;
+
+// Fields a set changes, and on a get, those this board can tune
+enum : uint16_t
+{
+   TUNE_POLL_MS    = 1 << 0,
+   TUNE_RELEASE_US = 1 << 1,
+   TUNE_CONFIRM_US = 1 << 2,
+   TUNE_GAIN       = 1 << 3,
+   TUNE_FILTER     = 1 << 4,
+   TUNE_SOF_LEAD   = 1 << 5,
+};
+
+enum : uint8_t
+{
+   TUNING_APPLY = 1, // Until the next boot
+   TUNING_SAVE  = 2, // And saved to flash
+};
+
+// How the last set went
+enum : uint8_t
+{
+   TUNING_OK = 0,
+   TUNING_PENDING,      // Not applied, or not saved, yet
+   TUNING_BAD_REQUEST,  // Wrong version, size or command
+   TUNING_NOT_TUNABLE,  // A field this board doesn't have
+   TUNING_OUT_OF_RANGE,
+   TUNING_BUSY,         // The last set hadn't been taken yet
+   TUNING_SAVE_FAILED,
+};
+
+struct __attribute__((packed)) TuningReport
+{
+   uint8_t  version;       // TUNING_VERSION
+   uint8_t  command;       // Set: TUNING_APPLY or TUNING_SAVE
+   uint8_t  status;        // Get: TUNING_OK etc.
+   uint8_t  hidIntervalMS; // Get: how often the host polls, fixed at enumeration
+   uint16_t fields;        // TUNE_*
+   uint8_t  pollMS;        // Inputs are sampled this often, unless synced to SOF
+   uint8_t  filterShift;   // Analog IIR time constant, 2^n averages
+   uint32_t releaseUS;     // Debounce release window
+   uint32_t confirmUS;     // Press confirm window, for buttons that have one
+   int32_t  encoderGain;   // 16.16
+   uint32_t sofLeadUS;     // Only on boards synced to SOF
+};
+
+static_assert(sizeof(TuningReport) == 24, "TuningReport layout changed");
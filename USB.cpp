@@ -25,8 +25,11 @@
  */
 
 #include "USB.h"
+#include "Tuning.h"
 #include "tusb.h"
 
+#include "pico/time.h"
+
 #include <algorithm>
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
@@ -36,55 +39,332 @@
  *   [MSB]         HID | MSC | CDC          [LSB]
  */
 #define _PID_MAP(itf, n) ((CFG_TUD_##itf) << (n))
-#define USB_PID(variant) (uint16_t)((0x4000 | (variant << 8) | _PID_MAP(CDC, 0) | \
-                         _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
-                         _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4)))
+#define USB_PID(variant, hidItfs) (uint16_t)((0x4000 | (variant << 8) | _PID_MAP(CDC, 0) | \
+                                  _PID_MAP(MSC, 1) | ((hidItfs) << 2) | \
+                                  _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4)))
 
 #define USB_VID 0xBA5E
 #define USB_BCD 0x0200
 
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
-#define EPNUM_HID 0x81
+// The trace's CDC interface follows the HID ones, in builds that have it
+#define CDC_TOTAL_LEN          (CFG_TUD_CDC ? TUD_CDC_DESC_LEN : 0)
+#define CONFIG_TOTAL_LEN       (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + CDC_TOTAL_LEN)
+#define CONFIG_SPLIT_TOTAL_LEN (TUD_CONFIG_DESC_LEN + 2 * TUD_HID_DESC_LEN + CDC_TOTAL_LEN)
+#define EPNUM_HID       0x81
+#define EPNUM_HID_MOUSE 0x82
+#define EPNUM_CDC_NOTIF 0x83
+#define EPNUM_CDC_OUT   0x04
+#define EPNUM_CDC_IN    0x84
 enum
 {
   ITF_NUM_HID,
-  ITF_NUM_TOTAL
+  ITF_NUM_HID_MOUSE  // Split interfaces only, or player 2's gamepad
+};
+
+// CDC takes two interfaces, control and data
+#define CDC_ITF_COUNT (CFG_TUD_CDC ? 2 : 0)
+
+// HID instance each report goes out on
+enum
+{
+  HID_INSTANCE_GAMEPAD,
+  HID_INSTANCE_MOUSE,
+  HID_INSTANCE_PLAYER2 = HID_INSTANCE_MOUSE // Two player boards have no mouse
 };
 
 enum
 {
-  REPORT_ID_GAMEPAD = 1,
+  REPORT_ID_GAMEPAD = 1,                 // Or the keyboard, in keyboard mode
   REPORT_ID_MOUSE,
-  REPORT_ID_COUNT
+  REPORT_ID_COUNT,                       // End of the single interface chain
+  REPORT_ID_GAMEPAD2 = REPORT_ID_COUNT   // On its own interface, never chained
 };
 
+// Each report's bit in a dirty mask
+static constexpr uint32_t ReportBit(uint8_t reportID) { return 1u << reportID; }
+
 static USB *s_usbHandler;
 
+// Mouse with 16-bit relative X and Y, in place of TUD_HID_REPORT_DESC_MOUSE's
+// 8-bit ones, so a fast spin isn't cut to 127 counts a report. Spinners and
+// trackballs have no wheel, so there's none here.
+#define HID_REPORT_DESC_MOUSE16(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP      )                   ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_MOUSE     )                   ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION  )                   ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE      ( HID_USAGE_DESKTOP_POINTER )                   ,\
+    HID_COLLECTION ( HID_COLLECTION_PHYSICAL   )                   ,\
+      HID_USAGE_PAGE  ( HID_USAGE_PAGE_BUTTON  )                   ,\
+        HID_USAGE_MIN   ( 1                                      ) ,\
+        HID_USAGE_MAX   ( 5                                      ) ,\
+        HID_LOGICAL_MIN ( 0                                      ) ,\
+        HID_LOGICAL_MAX ( 1                                      ) ,\
+        /* Left, Right, Middle, Backward, Forward buttons */ \
+        HID_REPORT_COUNT( 5                                      ) ,\
+        HID_REPORT_SIZE ( 1                                      ) ,\
+        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+        /* 3 bit padding */ \
+        HID_REPORT_COUNT( 1                                      ) ,\
+        HID_REPORT_SIZE ( 3                                      ) ,\
+        HID_INPUT       ( HID_CONSTANT                           ) ,\
+      HID_USAGE_PAGE  ( HID_USAGE_PAGE_DESKTOP )                   ,\
+        /* X, Y position [-32767, 32767] */ \
+        HID_USAGE         ( HID_USAGE_DESKTOP_X                    ) ,\
+        HID_USAGE         ( HID_USAGE_DESKTOP_Y                    ) ,\
+        HID_LOGICAL_MIN_N ( 0x8001, 2                              ) ,\
+        HID_LOGICAL_MAX_N ( 0x7fff, 2                              ) ,\
+        HID_REPORT_COUNT  ( 2                                      ) ,\
+        HID_REPORT_SIZE   ( 16                                     ) ,\
+        HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+    HID_COLLECTION_END                                            , \
+  HID_COLLECTION_END \
+
+// N-key-rollover keyboard: a bit per modifier, then a bit per key for usages
+// 0 up to the size of the bitmap. Not a boot keyboard, which can only report
+// six keys at once.
+#define HID_REPORT_DESC_KEYBOARD_NKRO(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP     )                 ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_KEYBOARD )                 ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION )                 ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE_PAGE    ( HID_USAGE_PAGE_KEYBOARD                ) ,\
+    HID_LOGICAL_MIN   ( 0                                      ) ,\
+    HID_LOGICAL_MAX   ( 1                                      ) ,\
+    HID_REPORT_SIZE   ( 1                                      ) ,\
+    /* 8 bit Modifiers, 0xE0-0xE7 */ \
+    HID_USAGE_MIN     ( 0xE0                                   ) ,\
+    HID_USAGE_MAX     ( 0xE7                                   ) ,\
+    HID_REPORT_COUNT  ( 8                                      ) ,\
+    HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    /* Key bitmap */ \
+    HID_USAGE_MIN     ( 0                                      ) ,\
+    HID_USAGE_MAX     ( KEY_BITMAP_BYTES * 8 - 1               ) ,\
+    HID_REPORT_COUNT  ( KEY_BITMAP_BYTES * 8                   ) ,\
+    HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+  HID_COLLECTION_END \
+
+// Matches HID_REPORT_DESC_MOUSE16
+typedef struct __attribute__((packed))
+{
+   uint8_t buttons;
+   int16_t x;
+   int16_t y;
+} mouse16_report_t;
+
+constexpr int32_t MOUSE_RANGE = 32767;
+
+// Gamepad with 16-bit X, Y and Rx in place of TUD_HID_REPORT_DESC_GAMEPAD's
+// 8-bit axes, so calibrated analogs keep their resolution. The axes nothing
+// drives and the hat are left out.
+#define HID_REPORT_DESC_GAMEPAD16(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP     )                 ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_GAMEPAD  )                 ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION )                 ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    /* X, Y, Rx [-32767, 32767] */ \
+    HID_USAGE         ( HID_USAGE_DESKTOP_X                    ) ,\
+    HID_USAGE         ( HID_USAGE_DESKTOP_Y                    ) ,\
+    HID_USAGE         ( HID_USAGE_DESKTOP_RX                   ) ,\
+    HID_LOGICAL_MIN_N ( 0x8001, 2                              ) ,\
+    HID_LOGICAL_MAX_N ( 0x7fff, 2                              ) ,\
+    HID_REPORT_COUNT  ( 3                                      ) ,\
+    HID_REPORT_SIZE   ( 16                                     ) ,\
+    HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    /* 32 bit Buttons */ \
+    HID_USAGE_PAGE    ( HID_USAGE_PAGE_BUTTON                  ) ,\
+    HID_USAGE_MIN     ( 1                                      ) ,\
+    HID_USAGE_MAX     ( 32                                     ) ,\
+    HID_LOGICAL_MIN   ( 0                                      ) ,\
+    HID_LOGICAL_MAX   ( 1                                      ) ,\
+    HID_REPORT_COUNT  ( 32                                     ) ,\
+    HID_REPORT_SIZE   ( 1                                      ) ,\
+    HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+  HID_COLLECTION_END \
+
+// Matches HID_REPORT_DESC_GAMEPAD16
+typedef struct __attribute__((packed))
+{
+   int16_t  x;
+   int16_t  y;
+   int16_t  rx;
+   uint32_t buttons;
+} gamepad16_report_t;
+
+// Vendor defined feature report carrying a TuningReport, with no input or
+// output, so hosts leave it to whatever asks for it
+#define HID_REPORT_DESC_TUNING(...) \
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2   ),\
+  HID_USAGE        ( 0x01                       ),\
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION ),\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE         ( 0x02                                   ),\
+    HID_LOGICAL_MIN   ( 0x00                                   ),\
+    HID_LOGICAL_MAX_N ( 0xff, 2                                ),\
+    HID_REPORT_SIZE   ( 8                                      ),\
+    HID_REPORT_COUNT  ( sizeof(TuningReport)                   ),\
+    HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),\
+  HID_COLLECTION_END \
+
+// Vendor defined feature reports for the telemetry counters and each of its
+// histograms, see TelemetryReport.h
+#define HID_REPORT_DESC_TELEMETRY_ITEM(reportID, usage, size) \
+    HID_REPORT_ID     ( reportID                               ) \
+    HID_USAGE         ( usage                                  ),\
+    HID_REPORT_COUNT  ( size                                   ),\
+    HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),\
+
+#define HID_REPORT_DESC_TELEMETRY() \
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2   ),\
+  HID_USAGE        ( 0x03                       ),\
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION ),\
+    HID_LOGICAL_MIN   ( 0x00                                   ),\
+    HID_LOGICAL_MAX_N ( 0xff, 2                                ),\
+    HID_REPORT_SIZE   ( 8                                      ),\
+    HID_REPORT_DESC_TELEMETRY_ITEM(TELEMETRY_COUNTERS_ID,          0x04, sizeof(TelemetryCounters)) \
+    HID_REPORT_DESC_TELEMETRY_ITEM(TELEMETRY_LOOP_ID,              0x05, sizeof(TelemetryHistogram)) \
+    HID_REPORT_DESC_TELEMETRY_ITEM(TELEMETRY_SAMPLE_TO_QUEUE_ID,   0x06, sizeof(TelemetryHistogram)) \
+    HID_REPORT_DESC_TELEMETRY_ITEM(TELEMETRY_QUEUE_TO_COMPLETE_ID, 0x07, sizeof(TelemetryHistogram)) \
+  HID_COLLECTION_END \
+
+// TinyUSB passes feature reports, ID and all, through a buffer of
+// CFG_TUD_HID_EP_BUFSIZE, stalling anything longer
+static_assert(sizeof(TuningReport) + 1 <= CFG_TUD_HID_EP_BUFSIZE, "tuning report doesn't fit the HID buffer");
+static_assert(sizeof(TelemetryCounters) + 1 <= CFG_TUD_HID_EP_BUFSIZE &&
+              sizeof(TelemetryHistogram) + 1 <= CFG_TUD_HID_EP_BUFSIZE, "telemetry reports don't fit the HID buffer");
+
 // Descriptor contents must exist long enough for transfer to complete.
+// Tuning and telemetry go on the gamepad interface, which every board has.
 static uint8_t gamepadOnly[] =
 {
-   TUD_HID_REPORT_DESC_GAMEPAD(HID_REPORT_ID(REPORT_ID_GAMEPAD))
+   HID_REPORT_DESC_GAMEPAD16(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
+   HID_REPORT_DESC_TUNING(HID_REPORT_ID(TUNING_REPORT_ID)),
+   HID_REPORT_DESC_TELEMETRY()
 };
 static uint8_t gamepadAndMouse[] =
 {
-   TUD_HID_REPORT_DESC_GAMEPAD(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
-   TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE))
+   HID_REPORT_DESC_GAMEPAD16(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
+   HID_REPORT_DESC_MOUSE16(HID_REPORT_ID(REPORT_ID_MOUSE)),
+   HID_REPORT_DESC_TUNING(HID_REPORT_ID(TUNING_REPORT_ID)),
+   HID_REPORT_DESC_TELEMETRY()
+};
+static uint8_t keyboardOnly[] =
+{
+   HID_REPORT_DESC_KEYBOARD_NKRO(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
+   HID_REPORT_DESC_TUNING(HID_REPORT_ID(TUNING_REPORT_ID)),
+   HID_REPORT_DESC_TELEMETRY()
+};
+static uint8_t keyboardAndMouse[] =
+{
+   HID_REPORT_DESC_KEYBOARD_NKRO(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
+   HID_REPORT_DESC_MOUSE16(HID_REPORT_ID(REPORT_ID_MOUSE)),
+   HID_REPORT_DESC_TUNING(HID_REPORT_ID(TUNING_REPORT_ID)),
+   HID_REPORT_DESC_TELEMETRY()
+};
+static uint8_t mouseOnly[] =
+{
+   HID_REPORT_DESC_MOUSE16(HID_REPORT_ID(REPORT_ID_MOUSE))
+};
+static uint8_t player2Only[] =
+{
+   HID_REPORT_DESC_GAMEPAD16(HID_REPORT_ID(REPORT_ID_GAMEPAD2))
 };
 
+// The bits of value under mask, moved down to be contiguous from bit 0
+static uint32_t PackBits(uint32_t value, uint32_t mask)
+{
+   uint32_t packed = 0;
+
+   for (uint32_t out = 1; mask != 0; mask &= mask - 1, out <<= 1)
+      if (value & mask & -mask)
+         packed |= out;
+
+   return packed;
+}
+
 void RegisterUSBHandler(USB *usb)
 {
    assert(s_usbHandler == nullptr);
    s_usbHandler = usb;
 }
 
-USB::USB(uint8_t pidDipValue, uint32_t numAnalogs, uint32_t numEncoders) :
+// Frames over which the earliest SOF callback is taken as the SOF time. Short
+// enough to follow the drift between our crystal and the host's.
+constexpr uint32_t SOF_WINDOW_FRAMES = 64;
+
+USB::USB(uint8_t pidDipValue, uint32_t numAnalogs, uint32_t numEncoders, uint8_t pollIntervalMS,
+         bool splitInterfaces, uint32_t player2Mask) :
    m_pidVariant(pidDipValue),
    m_numAnalogs(numAnalogs),
-   m_numEncoders(numEncoders)
+   m_numEncoders(numEncoders),
+   m_pollIntervalMS(pollIntervalMS),
+   m_splitInterfaces(splitInterfaces && numEncoders > 0),
+   m_player2Mask(numEncoders == 0 ? player2Mask : 0)
 {
    tusb_init();
 }
 
+void USB::EnableSOF()
+{
+   tud_sof_cb_enable(true);
+}
+
+void USB::OnStartOfFrame(uint32_t frameNumber)
+{
+   int64_t now = time_us_64();
+
+   // Frame numbers are only 11 bits
+   m_sofFrame += (frameNumber - m_sofFrame) & 0x7FF;
+
+   int64_t offset = now - int64_t(m_sofFrame) * 1000;
+
+   if (m_sofWindowCount == 0 || offset < m_sofWindowMin)
+      m_sofWindowMin = offset;
+
+   if (++m_sofWindowCount == SOF_WINDOW_FRAMES)
+   {
+      m_sofOffsetUS    = m_sofWindowMin;
+      m_sofPhaseUS     = uint32_t((m_sofOffsetUS % 1000 + 1000) % 1000);
+      m_sofLocked      = true;
+      m_sofWindowCount = 0;
+
+      UpdatePollGrid();
+   }
+
+   if (!m_sofLocked)
+      return;
+
+   uint32_t delay = uint32_t(std::max(offset - m_sofOffsetUS, int64_t(0)));
+
+   m_sofCallbackStats.callbacks++;
+   m_sofCallbackStats.totalDelayUS += delay;
+   m_sofCallbackStats.maxDelayUS    = std::max(m_sofCallbackStats.maxDelayUS, delay);
+}
+
+// Host controllers schedule interrupt endpoints at the power of two at or
+// below bInterval
+uint32_t USB::PollPeriodUS() const
+{
+   uint32_t frames = 1;
+
+   while (frames * 2 <= m_pollIntervalMS)
+      frames *= 2;
+
+   return frames * 1000;
+}
+
+void USB::UpdatePollGrid()
+{
+   int64_t period = PollPeriodUS();
+   int64_t sofUS  = m_sofOffsetUS + int64_t(m_pollFrame) * 1000;
+
+   m_pollGridUS = uint32_t((sofUS % period + period) % period);
+}
+
 void USB::Process()
 {
    // tinyusb device task
@@ -98,13 +378,14 @@ const uint8_t *USB::DeviceDescriptor() const
       .bLength = sizeof(tusb_desc_device_t),
       .bDescriptorType = TUSB_DESC_DEVICE,
       .bcdUSB = USB_BCD,
-      .bDeviceClass = 0x00,
-      .bDeviceSubClass = 0x00,
-      .bDeviceProtocol = 0x00,
+      // CDC's interface association descriptor needs the IAD device class
+      .bDeviceClass = CFG_TUD_CDC ? TUSB_CLASS_MISC : 0x00,
+      .bDeviceSubClass = CFG_TUD_CDC ? MISC_SUBCLASS_COMMON : 0x00,
+      .bDeviceProtocol = CFG_TUD_CDC ? MISC_PROTOCOL_IAD : 0x00,
       .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
 
       .idVendor = USB_VID,
-      .idProduct = USB_PID(m_pidVariant),
+      .idProduct = USB_PID(m_pidVariant, NumHIDInterfaces()),
       .bcdDevice = 0x0100,
 
       .iManufacturer = 0x01,
@@ -117,25 +398,74 @@ const uint8_t *USB::DeviceDescriptor() const
    return (const uint8_t*)&desc;
 }
 
-const uint8_t *USB::HIDDescReport() const
+template <size_t N>
+static const uint8_t *Pick(const uint8_t (&desc)[N], size_t *size)
 {
-   return m_numEncoders > 0 ? gamepadAndMouse : gamepadOnly;
+   *size = N;
+   return desc;
 }
 
-size_t USB::HIDDescReportSize() const
+const uint8_t *USB::PickHIDDescReport(uint8_t instance, size_t *size) const
 {
-   return m_numEncoders > 0 ? sizeof(gamepadAndMouse) : sizeof(gamepadOnly);
+   bool keyboard = KeyboardMode();
+
+   if (TwoPlayers())
+      return instance == HID_INSTANCE_PLAYER2 ? Pick(player2Only, size) : Pick(gamepadOnly, size);
+
+   if (m_splitInterfaces && instance == HID_INSTANCE_MOUSE)
+      return Pick(mouseOnly, size);
+
+   if (m_splitInterfaces || m_numEncoders == 0)
+      return keyboard ? Pick(keyboardOnly, size) : Pick(gamepadOnly, size);
+
+   return keyboard ? Pick(keyboardAndMouse, size) : Pick(gamepadAndMouse, size);
+}
+
+const uint8_t *USB::HIDDescReport(uint8_t instance) const
+{
+   size_t size;
+   return PickHIDDescReport(instance, &size);
+}
+
+size_t USB::HIDDescReportSize(uint8_t instance) const
+{
+   size_t size;
+   PickHIDDescReport(instance, &size);
+   return size;
 }
 
 const uint8_t *USB::DescriptorConfig() const
 {
+   // The mouse, or player 2's gamepad, on an interface of its own
+   if (NumHIDInterfaces() > 1)
+   {
+      static const uint8_t splitConfig[] =
+      {
+         TUD_CONFIG_DESCRIPTOR(1, 2 + CDC_ITF_COUNT, 0, CONFIG_SPLIT_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+
+         TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, HIDDescReportSize(HID_INSTANCE_GAMEPAD),
+                            EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, m_pollIntervalMS),
+         TUD_HID_DESCRIPTOR(ITF_NUM_HID_MOUSE, 0, HID_ITF_PROTOCOL_NONE, HIDDescReportSize(HID_INSTANCE_MOUSE),
+                            EPNUM_HID_MOUSE, CFG_TUD_HID_EP_BUFSIZE, m_pollIntervalMS),
+#if CFG_TUD_CDC
+         TUD_CDC_DESCRIPTOR(2, 0, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
+#endif
+      };
+
+      return splitConfig;
+   }
+
    static const uint8_t config[] =
    {
       // Config number, interface count, string index, total length, attribute, power in mA
-      TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+      TUD_CONFIG_DESCRIPTOR(1, 1 + CDC_ITF_COUNT, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
       // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-      TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, HIDDescReportSize(), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 5)
+      TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, HIDDescReportSize(HID_INSTANCE_GAMEPAD), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, m_pollIntervalMS),
+#if CFG_TUD_CDC
+      // Interface number, string index, notification EP & size, data EPs out & in, size
+      TUD_CDC_DESCRIPTOR(1, 0, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE),
+#endif
    };
 
    return config;
@@ -187,48 +517,197 @@ const uint16_t *USB::DescriptorString(uint8_t index, uint16_t langid) const
    return descStr;
 }
 
-// tud_hid_report_complete_cb() is used to send the next report after previous one is complete
-void USB::SendData(const InputData &input)
+uint16_t USB::GetFeature(uint8_t instance, uint8_t reportID, uint8_t *buffer, uint16_t reqlen)
+{
+   if (instance != HID_INSTANCE_GAMEPAD)
+      return 0;
+
+   if (reportID >= TELEMETRY_COUNTERS_ID && reportID < TELEMETRY_END_ID)
+      return m_telemetry.GetReport(reportID, buffer, reqlen);
+
+   if (reportID != TUNING_REPORT_ID || m_featureHandler.get == nullptr)
+      return 0;
+
+   return m_featureHandler.get(m_featureHandler.ctx, reportID, buffer, reqlen);
+}
+
+void USB::SetFeature(uint8_t instance, uint8_t reportID, const uint8_t *buffer, uint16_t len)
+{
+   if (instance != HID_INSTANCE_GAMEPAD)
+      return;
+
+   if (reportID >= TELEMETRY_COUNTERS_ID && reportID < TELEMETRY_END_ID)
+   {
+      m_telemetry.SetReport(reportID, buffer, len);
+      return;
+   }
+
+   if (reportID != TUNING_REPORT_ID || m_featureHandler.set == nullptr)
+      return;
+
+   m_featureHandler.set(m_featureHandler.ctx, reportID, buffer, len);
+}
+
+// Reports whose contents differ between cur and prev, a bit per report ID.
+// Player 1's report carries the buttons not on player 2 (only the mapped
+// ones as a keyboard) and the analogs, the mouse report the encoders.
+uint32_t USB::DirtyReports(const InputData &cur, const InputData &prev) const
+{
+   uint32_t changed = cur.buttons ^ prev.buttons;
+   uint32_t dirty   = 0;
+
+   if (KeyboardMode())
+   {
+      if (changed & m_keyboard.Mask())
+         dirty |= ReportBit(REPORT_ID_GAMEPAD);
+   }
+   else
+   {
+      // The calibrated value, which holds still through noise the raw reading doesn't
+      bool axisChanged = false;
+
+      for (uint32_t i = 0; i < m_numAnalogs; i++)
+         axisChanged = axisChanged || cur.axis[i] != prev.axis[i];
+
+      if ((changed & ~m_player2Mask) || axisChanged)
+         dirty |= ReportBit(REPORT_ID_GAMEPAD);
+
+      if (changed & m_player2Mask)
+         dirty |= ReportBit(REPORT_ID_GAMEPAD2);
+   }
+
+   for (uint32_t i = 0; i < m_numEncoders && i < 2; i++)
+      if (cur.angle[i] != prev.angle[i])
+         dirty |= ReportBit(REPORT_ID_MOUSE);
+
+   return dirty;
+}
+
+// Sends the reports in dirty, as given by DirtyReports() against LastSentData().
+// Split interfaces and two players have an endpoint each, so they all go out
+// now. With a single interface the first goes out now, and
+// tud_hid_report_complete_cb() sends the rest after it. Returns true if any
+// report was queued.
+bool USB::SendData(const InputData &input, uint32_t dirty)
 {
    // Remote wakeup
    if (tud_suspended())
    {
       // Wake up host if we are in suspend mode and REMOTE_WAKEUP feature is enabled by host
       tud_remote_wakeup();
+      return false;
    }
-   else
+
+   m_inputData = input;
+
+   if (NumHIDInterfaces() == 1)
+      return SendNextReport(0, dirty);
+
+   bool queued = false;
+
+   for (uint8_t reportID = REPORT_ID_GAMEPAD; reportID <= REPORT_ID_GAMEPAD2; reportID++)
+      if (dirty & ReportBit(reportID))
+         queued = SendHIDReport(reportID) || queued;
+
+   return queued;
+}
+
+// The next report of the single interface's chain after afterID, skipping
+// any that haven't changed
+bool USB::SendNextReport(uint8_t afterID, uint32_t dirty)
+{
+   for (uint8_t reportID = afterID + 1; reportID < REPORT_ID_COUNT; reportID++)
+      if (dirty & ReportBit(reportID))
+         return SendHIDReport(reportID);
+
+   return false;
+}
+
+void USB::ReportComplete(uint8_t reportID)
+{
+   // Completions are handled in the frame of the IN token, before that of the next SOF
+   uint32_t periodFrames = PollPeriodUS() / 1000;
+
+   if (m_sofLocked && reportID == REPORT_ID_GAMEPAD && (m_sofFrame - m_pollFrame) % periodFrames != 0)
    {
-      // Send the 1st of report chain, the rest will be sent by tud_hid_report_complete_cb()
-      m_inputData = input;
-      SendHIDReport(REPORT_ID_GAMEPAD);
+      m_pollFrame = m_sofFrame;
+      UpdatePollGrid();
    }
+
+   // Split interfaces and two players send each report on its own endpoint, there's no chain
+   if (NumHIDInterfaces() > 1)
+      return;
+
+   // Against what's gone out since the chain started, which may be more than it had then
+   SendNextReport(reportID, DirtyReports(m_inputData, m_lastSentData));
 }
 
-// Only called if there is new data in s_cur_data
-void USB::SendHIDReport(uint8_t reportID)
+// Only called for reports that have changed since the last one sent
+bool USB::SendHIDReport(uint8_t reportID)
 {
+   uint8_t instance = HID_INSTANCE_GAMEPAD;
+
+   if (reportID == REPORT_ID_GAMEPAD2)
+      instance = HID_INSTANCE_PLAYER2;
+   else if (m_splitInterfaces && reportID == REPORT_ID_MOUSE)
+      instance = HID_INSTANCE_MOUSE;
+
    // skip if hid is not ready yet
-   if (!tud_hid_ready())
-      return;
+   if (!tud_hid_n_ready(instance))
+   {
+      m_telemetry.ReadyMiss();
+      return false;
+   }
+
+   bool queued = false;
 
    switch (reportID)
    {
    case REPORT_ID_GAMEPAD:
    {
-      hid_gamepad_report_t report = {};
-      report.buttons = m_inputData.buttons;
+      if (KeyboardMode())
+      {
+         queued = SendKeyboardReport(instance);
+         break;
+      }
+
+      uint32_t buttons = m_inputData.buttons & ~m_player2Mask;
+
+      gamepad16_report_t report = {};
+      report.buttons = buttons;
 
       if (m_numAnalogs > 0)
-         report.x = m_inputData.USBValueFromAnalog(0);
+         report.x = m_inputData.axis[0];
       if (m_numAnalogs > 1)
-         report.y = m_inputData.USBValueFromAnalog(1);
+         report.y = m_inputData.axis[1];
       if (m_numAnalogs > 2)
-         report.rx = m_inputData.USBValueFromAnalog(2);
+         report.rx = m_inputData.axis[2];
 
-      tud_hid_report(REPORT_ID_GAMEPAD, &report, sizeof(report));
+      queued = tud_hid_n_report(instance, REPORT_ID_GAMEPAD, &report, sizeof(report));
 
-      if (m_numEncoders == 0) // Record last if no mouse data
-         m_lastSentData = m_inputData;
+      // Record player 1's half; player 2's report and the mouse report may still be busy
+      if (queued)
+      {
+         m_lastSentData.buttons = (m_lastSentData.buttons & m_player2Mask) | buttons;
+         memcpy(m_lastSentData.axis, m_inputData.axis, sizeof(m_inputData.axis));
+      }
+
+      break;
+   }
+   case REPORT_ID_GAMEPAD2: // Second joystick, no analogs
+   {
+      if (!TwoPlayers())
+         break;
+
+      uint32_t buttons = m_inputData.buttons & m_player2Mask;
+
+      gamepad16_report_t report = {};
+      report.buttons = PackBits(buttons, m_player2Mask);
+
+      queued = tud_hid_n_report(instance, REPORT_ID_GAMEPAD2, &report, sizeof(report));
+
+      if (queued)
+         m_lastSentData.buttons = (m_lastSentData.buttons & ~m_player2Mask) | buttons;
 
       break;
    }
@@ -237,26 +716,53 @@ void USB::SendHIDReport(uint8_t reportID)
       if (m_numEncoders == 0)
          break;
 
-      hid_mouse_report_t report = {};
+      mouse16_report_t report = {};
+      int32_t          sent[2] = {};
+
+      // Anything beyond the report's range is left unsent, and so goes out
+      // in the next report
+      for (uint32_t i = 0; i < m_numEncoders && i < 2; i++)
+         sent[i] = std::min(std::max(m_inputData.angleDelta[i], -MOUSE_RANGE), MOUSE_RANGE);
 
-      if (m_numEncoders > 0)
-         report.x = std::min(std::max(m_inputData.angleDelta[0], int32_t(-127)), int32_t(127));
-      if (m_numEncoders > 1)
-         report.y = std::min(std::max(m_inputData.angleDelta[1], int32_t(-127)), int32_t(127));
+      report.x = sent[0];
+      report.y = sent[1];
 
       if (report.x == 0 && report.y == 0)
          break; // Don't send if no deltas
 
-      tud_hid_report(REPORT_ID_MOUSE, &report, sizeof(report));
+      queued = tud_hid_n_report(instance, REPORT_ID_MOUSE, &report, sizeof(report));
 
-      m_lastSentData = m_inputData; // Record last
+      // Only the motion that went out counts as sent, so the next delta
+      // includes whatever didn't
+      for (uint32_t i = 0; i < m_numEncoders && i < 2; i++)
+         m_lastSentData.angle[i] = m_inputData.angle[i] - m_inputData.angleDelta[i] + (queued ? sent[i] : 0);
 
       break;
    }
    default:
       break;
    }
+
+   if (queued)
+      m_telemetry.Queued(instance, m_inputData.sampleUS);
+
+   return queued;
 }
+// In the gamepad report's place. The report is made by flipping the bits of
+// the buttons that changed since the last one made.
+bool USB::SendKeyboardReport(uint8_t instance)
+{
+   const KeyboardReport &report = m_keyboard.Update(m_inputData.buttons);
+
+   bool queued = tud_hid_n_report(instance, REPORT_ID_GAMEPAD, &report, sizeof(report));
+
+   // Record the mapped buttons; the rest never make the report dirty
+   if (queued)
+      m_lastSentData.buttons = (m_lastSentData.buttons & ~m_keyboard.Mask()) | (m_inputData.buttons & m_keyboard.Mask());
+
+   return queued;
+}
+
 //--------------------------------------------------------------------+
 // Device Descriptors
 //--------------------------------------------------------------------+
@@ -277,7 +783,7 @@ uint8_t const *tud_descriptor_device_cb(void)
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
-   return s_usbHandler->HIDDescReport();
+   return s_usbHandler->HIDDescReport(instance);
 }
 
 //--------------------------------------------------------------------+
@@ -335,6 +841,12 @@ void tud_resume_cb(void)
    s_usbHandler->SetMounted(true);
 }
 
+// Invoked from tud_task() for each start-of-frame, once enabled with tud_sof_cb_enable()
+void tud_sof_cb(uint32_t frame_count)
+{
+   s_usbHandler->OnStartOfFrame(frame_count);
+}
+
 //--------------------------------------------------------------------+
 // USB HID
 //--------------------------------------------------------------------+
@@ -344,10 +856,8 @@ void tud_resume_cb(void)
 // Note: For composite reports, report[0] is report ID
 void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint8_t len)
 {
-   uint8_t nextReportID = report[0] + 1;
-
-   if (nextReportID < REPORT_ID_COUNT)
-      s_usbHandler->SendHIDReport(nextReportID);
+   s_usbHandler->GetTelemetry().Completed(instance);
+   s_usbHandler->ReportComplete(report[0]);
 }
 
 // Invoked when received GET_REPORT control request
@@ -355,13 +865,26 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint8_t
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
-   // Not Implemented
-   return 0;
+   if (report_type != HID_REPORT_TYPE_FEATURE)
+      return 0;
+
+   return s_usbHandler->GetFeature(instance, report_id, buffer, reqlen);
 }
 
 // Invoked when received SET_REPORT control request or
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
-   // Not Implemented
+   if (report_type != HID_REPORT_TYPE_FEATURE)
+      return;
+
+   // Older TinyUSB leaves the report ID at the front
+   if (report_id != 0 && bufsize > 0 && buffer[0] == report_id &&
+       (bufsize == sizeof(TuningReport) + 1 || bufsize == sizeof(TelemetryCounters) + 1))
+   {
+      buffer++;
+      bufsize--;
+   }
+
+   s_usbHandler->SetFeature(instance, report_id, buffer, bufsize);
 }
@@ -27,17 +27,46 @@
 #include <stddef.h>
 
 #include "InputData.h"
+#include "Keyboard.h"
+#include "Telemetry.h"
 
 class USB
 {
 public:
    USB() = default;
-   USB(uint8_t pidDipValue, uint32_t numAnalogs, uint32_t numEncoders);
+   USB(uint8_t pidDipValue, uint32_t numAnalogs, uint32_t numEncoders, uint8_t pollIntervalMS,
+       bool splitInterfaces, uint32_t player2Mask = 0);
 
-   void SendData(const InputData &input);
+   // A bit for each report whose contents differ between cur and prev. Reads
+   // nothing that changes after Process() starts, so the sampling core can
+   // ask it as well.
+   uint32_t DirtyReports(const InputData &cur, const InputData &prev) const;
+
+   bool SendData(const InputData &input, uint32_t dirty);
    const InputData &LastSentData() const { return m_lastSentData; }
 
-   void SendHIDReport(uint8_t reportID);
+   bool SendHIDReport(uint8_t reportID);
+   void ReportComplete(uint8_t reportID);
+
+   // With encoders, the mouse report can have its own HID interface and
+   // endpoint so that it goes out in the same frame as the gamepad report.
+   // Otherwise both share one interface and the mouse report is chained
+   // after the gamepad one completes.
+   bool     SplitInterfaces() const { return m_splitInterfaces; }
+
+   // With a second joystick, the buttons in player2Mask go out in a gamepad
+   // report on a second interface, packed down from bit 0 in pin order, and
+   // the first player's report leaves them out. Each player's report is only
+   // sent when it changes, and neither waits for the other's. Boards with
+   // encoders have no room for it, so stay one player.
+   bool     TwoPlayers() const       { return m_player2Mask != 0; }
+   uint32_t NumHIDInterfaces() const { return m_splitInterfaces || TwoPlayers() ? 2 : 1; }
+
+   // Sends the buttons as an NKRO keyboard instead of the gamepad, through
+   // map. Only changes to mapped buttons send a report. Both players are on
+   // the one keyboard. Changes the descriptors, so call before Process().
+   void EnableKeyboard(const KeyMap &map) { m_keyboard = Keyboard(map); m_player2Mask = 0; }
+   bool KeyboardMode() const              { return m_keyboard.Enabled(); }
 
    void SetMounted(bool tf) { m_mounted = tf; }
    bool IsMounted() const   { return m_mounted; }
@@ -47,20 +76,84 @@ public:
 
    void Process();
 
+   // Start-of-frame tracking. The SOF callback only runs from tud_task(), so
+   // it is late by however long the main loop took to get there; the earliest
+   // callback over a window of frames gives the real SOF time.
+   void     EnableSOF();
+   void     OnStartOfFrame(uint32_t frameNumber);
+   bool     SOFLocked() const  { return m_sofLocked; }
+   uint32_t SOFPhaseUS() const { return m_sofPhaseUS; } // SOF time modulo 1ms, device clock
+
+   // The host's polls of the gamepad endpoint on the device clock: the SOF
+   // time of a frame it polls in, modulo PollPeriodUS(). The frames are learnt
+   // from the reports that complete, and until one has they're taken to be
+   // those numbered a multiple of the period. A single word, so an interrupt
+   // can read it.
+   uint32_t PollGridUS() const   { return m_pollGridUS; }
+   uint32_t PollPeriodUS() const;
+
+   struct SOFCallbackStats
+   {
+      uint32_t callbacks    = 0;
+      uint32_t maxDelayUS   = 0; // Callback time after the estimated SOF
+      uint64_t totalDelayUS = 0;
+   };
+
+   const SOFCallbackStats &GetSOFCallbackStats() const { return m_sofCallbackStats; }
+
+   // Feature reports on the gamepad interface are handed to these, from tud_task()
+   struct FeatureHandler
+   {
+      uint16_t (*get)(void *ctx, uint8_t reportID, uint8_t *buffer, uint16_t reqlen) = nullptr;
+      void     (*set)(void *ctx, uint8_t reportID, const uint8_t *buffer, uint16_t len) = nullptr;
+      void      *ctx = nullptr;
+   };
+
+   void     SetFeatureHandler(const FeatureHandler &handler) { m_featureHandler = handler; }
+   uint16_t GetFeature(uint8_t instance, uint8_t reportID, uint8_t *buffer, uint16_t reqlen);
+   void     SetFeature(uint8_t instance, uint8_t reportID, const uint8_t *buffer, uint16_t len);
+
+   uint8_t PollIntervalMS() const { return m_pollIntervalMS; }
+
+   // Recorded by the main loop as well as here, and read out as feature reports
+   Telemetry &GetTelemetry() { return m_telemetry; }
+
    const uint8_t  *DeviceDescriptor() const;
-   const uint8_t  *HIDDescReport() const;
-   size_t          HIDDescReportSize() const;
+   const uint8_t  *HIDDescReport(uint8_t instance) const;
+   size_t          HIDDescReportSize(uint8_t instance) const;
    const uint8_t  *DescriptorConfig() const;
    const uint16_t *DescriptorString(uint8_t index, uint16_t langid) const;
 
 private:
+   bool           SendNextReport(uint8_t afterID, uint32_t dirty);
+   void           UpdatePollGrid();
+   bool           SendKeyboardReport(uint8_t instance);
+   const uint8_t *PickHIDDescReport(uint8_t instance, size_t *size) const;
+
    uint8_t   m_pidVariant  = 0;
    uint32_t  m_numAnalogs  = 0;
    uint32_t  m_numEncoders = 0;
+   uint8_t   m_pollIntervalMS = 5;
+   bool      m_splitInterfaces = false;
+   uint32_t  m_player2Mask = 0;
    bool      m_mounted     = false;
    bool      m_suspended   = false;
    InputData m_inputData {};
    InputData m_lastSentData {};
+
+   uint64_t          m_sofFrame       = 0;
+   int64_t           m_sofOffsetUS    = 0; // SOF time of frame 0, device clock
+   int64_t           m_sofWindowMin   = 0;
+   uint32_t          m_sofWindowCount = 0;
+   volatile uint32_t m_sofPhaseUS     = 0;
+   volatile bool     m_sofLocked      = false;
+   uint64_t          m_pollFrame      = 0; // A frame the host polled the gamepad endpoint in
+   volatile uint32_t m_pollGridUS     = 0;
+   SOFCallbackStats  m_sofCallbackStats;
+
+   FeatureHandler m_featureHandler;
+   Telemetry      m_telemetry;
+   Keyboard       m_keyboard;
 };
 
 void RegisterUSBHandler(USB *usb);
\ No newline at end of file
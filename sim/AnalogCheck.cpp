@@ -0,0 +1,308 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks the ADC filtering three ways.
+//
+// Noise: traces are run through AnalogFilter as configured in ArcadeCtrl and
+// compared with taking a single conversion per poll, as the blocking reads
+// did. The synthetic traces add white noise, a little switching regulator
+// ripple and the odd spike to a known signal; recorded ones, one 12-bit
+// conversion per line at --rate, are taken to be of an idle stick, so their
+// mean is the truth. A sweep shows what the filter's delay costs on a moving
+// stick, and a full scale step how long it takes to follow. Flips counts how often the top 8 bits, which is what
+// the report carries, changed between polls.
+//
+// Kernel: the cost of AnalogFilter::Add() per conversion on this host.
+//
+// Sampler: AnalogSampler is run against the simulated ADC and DMA with a
+// different level on each input, to check every conversion is put down to
+// the right input, including after Update() stalls long enough for the ring
+// to wrap.
+//
+//   AnalogCheck [--trace FILE] [--rate HZ] [--seed N] [--bench-samples N]
+
+#include "AnalogFilter.h"
+#include "AnalogSampler.h"
+#include "AnalogTrace.h"
+#include "Sim.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// As ArcadeCtrl
+constexpr uint32_t INPUT_HZ        = 32000;
+constexpr uint32_t OVERSAMPLE_BITS = 4;
+constexpr uint32_t IIR_SHIFT       = 1;
+
+constexpr uint32_t POLL_US = 1000;
+
+struct Result
+{
+   double   rawRMS      = 0.0; // Codes
+   double   filteredRMS = 0.0;
+   uint32_t rawFlips    = 0;
+   uint32_t filtFlips   = 0;
+   double   riseMS      = -1.0; // 10-90% of the step, if the trace has one
+};
+
+// Polls at 1ms take either the latest conversion or the filter's value. The
+// filter's delay is part of its error, so slopes count against it.
+static Result Run(const Trace &trace, bool step)
+{
+   Result       r;
+   AnalogFilter filter(OVERSAMPLE_BITS, IIR_SHIFT);
+   uint32_t     perPoll = trace.rateHz * POLL_US / 1000000;
+   uint32_t     polls   = 0;
+   int32_t      lastRaw = -1;
+   int32_t      lastFilt = -1;
+   double       sumRaw  = 0.0;
+   double       sumFilt = 0.0;
+   double       t10     = -1.0;
+   double       t90     = -1.0;
+   double       lo      = trace.truth.front();
+   double       hi      = trace.truth.back();
+
+   for (size_t i = 0; i < trace.samples.size(); i++)
+   {
+      filter.Add(trace.samples[i]);
+
+      if ((i + 1) % perPoll != 0)
+         continue;
+
+      // Skip the first few polls while the filter fills
+      if (++polls <= 4)
+         continue;
+
+      double truth = trace.truth[i];
+      double raw   = trace.samples[i];
+      double filt  = filter.Value() / 16.0;
+
+      sumRaw  += (raw - truth) * (raw - truth);
+      sumFilt += (filt - truth) * (filt - truth);
+
+      int32_t rawTop  = trace.samples[i] >> 4;
+      int32_t filtTop = filter.Value() >> 8;
+
+      r.rawFlips  += lastRaw >= 0 && rawTop != lastRaw;
+      r.filtFlips += lastFilt >= 0 && filtTop != lastFilt;
+      lastRaw      = rawTop;
+      lastFilt     = filtTop;
+
+      if (step)
+      {
+         double ms = double(i + 1) * 1000.0 / trace.rateHz;
+
+         if (t10 < 0.0 && filt >= lo + 0.1 * (hi - lo))
+            t10 = ms;
+         if (t90 < 0.0 && filt >= lo + 0.9 * (hi - lo))
+            t90 = ms;
+      }
+   }
+
+   r.rawRMS      = std::sqrt(sumRaw / (polls - 4));
+   r.filteredRMS = std::sqrt(sumFilt / (polls - 4));
+
+   if (t10 >= 0.0 && t90 >= 0.0)
+      r.riseMS = t90 - t10;
+
+   return r;
+}
+
+static double BenchNS(uint32_t count)
+{
+   std::vector<uint16_t> samples(4096);
+   std::mt19937          rng(1);
+
+   for (uint16_t &s : samples)
+      s = rng() & 0xFFF;
+
+   AnalogFilter      filter(OVERSAMPLE_BITS, IIR_SHIFT);
+   volatile uint32_t sink = 0;
+
+   auto start = std::chrono::steady_clock::now();
+
+   for (uint32_t i = 0; i < count; i++)
+      sink += filter.Add(samples[i & 4095]);
+
+   auto end = std::chrono::steady_clock::now();
+
+   return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+// Each input at its own level, so a sample put down to the wrong input shows
+static bool CheckSampler()
+{
+   Sim           &sim       = Sim::Get();
+   const uint16_t levels[3] = { 500, 2000, 3700 };
+
+   std::mt19937 rng(7);
+
+   sim.SetADCSource([&](uint32_t channel, uint64_t)
+   {
+      return uint16_t(levels[channel] + rng() % 9 - 4);
+   });
+
+   AnalogSampler sampler(3, INPUT_HZ * 3, OVERSAMPLE_BITS, IIR_SHIFT);
+
+   auto check = [&](const char *when)
+   {
+      for (uint32_t i = 0; i < 3; i++)
+      {
+         int32_t value = sampler.Value(i) >> 4;
+
+         if (std::abs(value - levels[i]) > 2)
+         {
+            fprintf(stderr, "%s: input %u reads %d, expected %u\n", when, i, value, levels[i]);
+            return false;
+         }
+      }
+
+      return true;
+   };
+
+   for (uint32_t ms = 0; ms < 20; ms++)
+   {
+      sim.Charge(1000 * 1000);
+      sampler.Update();
+   }
+
+   if (!check("running"))
+      return false;
+
+   // Long enough for the ring to lap
+   sim.Charge(50 * 1000 * 1000);
+   sampler.Update();
+
+   for (uint32_t ms = 0; ms < 20; ms++)
+   {
+      sim.Charge(1000 * 1000);
+      sampler.Update();
+   }
+
+   if (!check("after a stall"))
+      return false;
+
+   const AnalogSampler::Stats &stats = sampler.GetStats();
+
+   printf("sampler: %u conversions, %u filtered values, %u overrun, every input read back at its own level\n",
+          stats.samples, stats.outputs, stats.overruns);
+
+   return stats.overruns == 1;
+}
+
+int main(int argc, char **argv)
+{
+   const char *path         = nullptr;
+   uint32_t    rateHz       = INPUT_HZ;
+   uint32_t    seed         = 1;
+   uint32_t    benchSamples = 50 * 1000 * 1000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+      if (!strcmp(argv[i], "--trace"))
+         path = next();
+      else if (!strcmp(argv[i], "--rate"))
+         rateHz = uint32_t(atoi(next()));
+      else if (!strcmp(argv[i], "--seed"))
+         seed = uint32_t(atoi(next()));
+      else if (!strcmp(argv[i], "--bench-samples"))
+         benchSamples = uint32_t(atoi(next()));
+      else
+      {
+         fprintf(stderr, "usage: %s [--trace FILE] [--rate HZ] [--seed N] [--bench-samples N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (rateHz < 1000000 / POLL_US)
+   {
+      fprintf(stderr, "rate must be at least one conversion per poll\n");
+      return 1;
+   }
+
+   std::mt19937 rng(seed);
+   bool         pass = true;
+
+   constexpr double PI = 3.14159265358979;
+
+   std::vector<Trace> traces;
+   traces.push_back(Synthetic(INPUT_HZ, "idle", 2.0, 2.0, rng, [](double) { return 2048.0; }));
+   traces.push_back(Synthetic(INPUT_HZ, "noisy idle", 2.0, 5.0, rng, [](double) { return 1900.0; }));
+   traces.push_back(Synthetic(INPUT_HZ, "sweep", 2.0, 2.0, rng, [=](double t) { return 2048.0 + 1800.0 * std::sin(2.0 * PI * 0.5 * t); }));
+
+   if (path != nullptr)
+   {
+      Trace recorded;
+
+      if (!Recorded(path, rateHz, &recorded))
+         return 1;
+
+      traces.push_back(recorded);
+   }
+
+   printf("%u kHz per input, averaging %u then IIR over %u; polled every %u us\n",
+          INPUT_HZ / 1000, 1u << OVERSAMPLE_BITS, 1u << IIR_SHIFT, POLL_US);
+
+   for (const Trace &trace : traces)
+   {
+      Result r = Run(trace, false);
+      bool   idle = trace.name != "sweep";
+
+      printf("%-12s rms error: single %6.2f, filtered %6.2f codes; 8-bit flips: single %5u, filtered %5u\n",
+             trace.name.c_str(), r.rawRMS, r.filteredRMS, r.rawFlips, r.filtFlips);
+
+      // Averaging 16 alone should take noise down 4x. On a sweep the error is
+      // mostly the filter's delay instead, which is held to 0.1% of full scale.
+      if (idle && (r.filteredRMS * 4.0 > r.rawRMS || r.filtFlips > r.rawFlips))
+         pass = false;
+      if (!idle && r.filteredRMS > 4096 * 0.001)
+         pass = false;
+   }
+
+   // Full scale step half way through
+   Trace  step   = Synthetic(INPUT_HZ, "step", 0.2, 2.0, rng, [](double t) { return t < 0.1 ? 300.0 : 3800.0; });
+   Result stepR  = Run(step, true);
+
+   printf("step response: 10-90%% in %.1f ms\n", stepR.riseMS);
+
+   if (stepR.riseMS < 0.0 || stepR.riseMS > 5.0)
+      pass = false;
+
+   printf("AnalogFilter::Add() on this host: %.2f ns per conversion\n", BenchNS(benchSamples));
+
+   pass = CheckSampler() && pass;
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
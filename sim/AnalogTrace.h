@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+// ADC traces shared by the analog sim tools: synthetic ones with a known
+// signal under noise, or recorded ones of an idle stick.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Trace
+{
+   std::string           name;
+   uint32_t              rateHz;
+   std::vector<uint16_t> samples;
+   std::vector<double>   truth; // In 12-bit codes, per sample
+};
+
+static inline uint16_t ToCode(double v)
+{
+   return uint16_t(std::min(4095.0, std::max(0.0, std::round(v))));
+}
+
+// signal(t) in codes against seconds, plus noise of sigma codes, 3 codes of
+// 100kHz-ish ripple aliased down to 1.7kHz, and a 60 code spike every 2000
+// conversions or so
+static inline Trace Synthetic(uint32_t rateHz, const char *name, double seconds, double sigma, std::mt19937 &rng,
+                              std::function<double(double)> signal)
+{
+   Trace                            trace{ name, rateHz, {}, {} };
+   std::normal_distribution<double> noise(0.0, sigma);
+   std::bernoulli_distribution      spike(1.0 / 2000.0);
+   constexpr double                 PI = 3.14159265358979;
+
+   for (uint32_t i = 0; i < uint32_t(seconds * rateHz); i++)
+   {
+      double t = double(i) / rateHz;
+      double v = signal(t);
+
+      trace.truth.push_back(v);
+
+      v += noise(rng) + 3.0 * std::sin(2.0 * PI * 1700.0 * t);
+
+      if (spike(rng))
+         v += 60.0;
+
+      trace.samples.push_back(ToCode(v));
+   }
+
+   return trace;
+}
+
+static inline bool Recorded(const char *path, uint32_t rateHz, Trace *trace)
+{
+   FILE *f = fopen(path, "r");
+
+   if (f == nullptr)
+   {
+      fprintf(stderr, "can't open %s\n", path);
+      return false;
+   }
+
+   char   line[64];
+   double sum = 0.0;
+
+   while (fgets(line, sizeof(line), f))
+   {
+      unsigned value;
+
+      if (line[0] == '#' || sscanf(line, "%u", &value) != 1)
+         continue;
+
+      trace->samples.push_back(uint16_t(value & 0xFFF));
+      sum += value & 0xFFF;
+   }
+
+   fclose(f);
+
+   if (trace->samples.empty())
+   {
+      fprintf(stderr, "%s: no samples\n", path);
+      return false;
+   }
+
+   trace->name   = path;
+   trace->rateHz = rateHz;
+   trace->truth.assign(trace->samples.size(), sum / double(trace->samples.size()));
+
+   return true;
+}
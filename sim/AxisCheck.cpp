@@ -0,0 +1,296 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks that noise on a stick held still doesn't send reports. Runs the real
+// ArcadeCtrl::Run() loop on a board with three analogs against the simulated
+// ADC, and decodes the axes of every gamepad report the host receives.
+//
+// Each input rests under noise for a while, X sweeps end to end and back,
+// then everything rests again. Y rests off the middle of the ADC's range but
+// is calibrated around where it rests; Rx rests off centre uncalibrated. Once
+// the filter has settled, each rest must send no reports at all, while the
+// sweep must reach both end stops and come back to exactly zero.
+//
+// A recorded idle trace, one 12-bit conversion per line at --rate, can stand
+// in for X's noise at rest with --trace.
+//
+// With --slow-poll the host tunes the poll interval before the first rest: an
+// interval the ADC ring can't last must be refused, and the slowest it can
+// must still pass everything above.
+//
+//   AxisCheck [--dip N] [--trace FILE] [--rate HZ] [--seed N] [--blocking-adc] [--slow-poll]
+
+#include "ArcadeCtrl.h"
+#include "AnalogTrace.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t REPORT_ID_GAMEPAD = 1;
+
+constexpr uint8_t HID_INSTANCE_GAMEPAD = 0;
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+// As ArcadeCtrl
+constexpr uint32_t INPUT_HZ = 32000;
+
+// The ADC ring lasts 10.3ms at 3 x 32kHz
+constexpr uint32_t SLOW_POLL_MS     = 9;
+constexpr uint32_t TOO_SLOW_POLL_MS = 10;
+constexpr uint64_t TUNE_NS          = 50 * MS;
+
+// Rest, sweep, rest
+constexpr uint64_t SWEEP_START_NS = 1500 * MS;
+constexpr uint64_t SWEEP_END_NS   = 3500 * MS;
+constexpr uint64_t END_NS         = 5000 * MS;
+
+// Allowed for the filter to settle after power up or the sweep
+constexpr uint64_t SETTLE_NS = 200 * MS;
+
+constexpr double Y_REST  = 1900.0; // Codes
+constexpr double RX_REST = 3000.0;
+
+struct Window
+{
+   const char *name;
+   uint64_t    startNS;
+   uint64_t    endNS;
+   uint32_t    reports = 0;
+};
+
+int main(int argc, char **argv)
+{
+   uint32_t    dip      = 2;
+   const char *path     = nullptr;
+   uint32_t    rateHz   = INPUT_HZ;
+   uint32_t    seed     = 1;
+   bool        blocking = false;
+   bool        slowPoll = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+      if (!strcmp(argv[i], "--dip"))
+         dip = uint32_t(atoi(next())) & 3;
+      else if (!strcmp(argv[i], "--trace"))
+         path = next();
+      else if (!strcmp(argv[i], "--rate"))
+         rateHz = uint32_t(atoi(next()));
+      else if (!strcmp(argv[i], "--seed"))
+         seed = uint32_t(atoi(next()));
+      else if (!strcmp(argv[i], "--blocking-adc"))
+         blocking = true;
+      else if (!strcmp(argv[i], "--slow-poll"))
+         slowPoll = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--trace FILE] [--rate HZ] [--seed N] [--blocking-adc] [--slow-poll]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (rateHz == 0)
+   {
+      fprintf(stderr, "rate must be non-zero\n");
+      return 1;
+   }
+
+   constexpr double PI = 3.14159265358979;
+
+   std::mt19937 rng(seed);
+   double       seconds = double(END_NS) / 1e9;
+
+   // X goes a little past both ends of the ADC, as a stick at its stops can
+   Trace x = Synthetic(INPUT_HZ, "x", seconds, 5.0, rng, [=](double t)
+   {
+      if (t < SWEEP_START_NS / 1e9 || t >= SWEEP_END_NS / 1e9)
+         return 2048.0;
+      return 2048.0 + 2200.0 * std::sin(2.0 * PI * (t - SWEEP_START_NS / 1e9) / (double(SWEEP_END_NS - SWEEP_START_NS) / 1e9));
+   });
+   Trace y  = Synthetic(INPUT_HZ, "y", seconds, 5.0, rng, [](double) { return Y_REST; });
+   Trace rx = Synthetic(INPUT_HZ, "rx", seconds, 2.0, rng, [](double) { return RX_REST; });
+   Trace recorded;
+
+   if (path != nullptr && !Recorded(path, rateHz, &recorded))
+      return 1;
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   sim.SetADCSource([&](uint32_t channel, uint64_t timeNS) -> uint16_t
+   {
+      bool resting = timeNS < SWEEP_START_NS || timeNS >= SWEEP_END_NS;
+
+      // The recording is replayed around its own mean
+      if (channel == 0 && resting && path != nullptr)
+      {
+         size_t i = size_t(timeNS * recorded.rateHz / 1000000000ull) % recorded.samples.size();
+         return ToCode(recorded.samples[i] - recorded.truth[i] + 2048.0);
+      }
+
+      const Trace &trace = channel == 0 ? x : channel == 1 ? y : rx;
+      size_t       i     = std::min(size_t(timeNS * INPUT_HZ / 1000000000ull), trace.samples.size() - 1);
+
+      return trace.samples[i];
+   });
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.numAnalogs  = 3;
+   cfg.numEncoders = 0;
+   cfg.adcDMA      = !blocking;
+
+   // Y's stick is calibrated to rest where it does
+   cfg.axisCal[1].centre = uint16_t(Y_REST * 16);
+
+   Window windows[] =
+   {
+      { "rest",       SETTLE_NS,                SWEEP_START_NS },
+      { "sweep",      SWEEP_START_NS,           SWEEP_END_NS },
+      { "rest again", SWEEP_END_NS + SETTLE_NS, END_NS },
+   };
+
+   int16_t  last[3]   = {};
+   int16_t  lowest    = 0;
+   int16_t  highest   = 0;
+   uint32_t badReport = 0;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t nowNS)
+   {
+      if (p.data.empty() || p.data[0] != REPORT_ID_GAMEPAD)
+         return;
+
+      if (p.data.size() != 11)
+      {
+         badReport++;
+         return;
+      }
+
+      for (uint32_t i = 0; i < 3; i++)
+         last[i] = int16_t(p.data[1 + 2 * i] | (p.data[2 + 2 * i] << 8));
+
+      lowest  = std::min(lowest, last[0]);
+      highest = std::max(highest, last[0]);
+
+      for (Window &w : windows)
+         if (nowNS >= w.startNS && nowNS < w.endNS)
+            w.reports++;
+   };
+
+   // Statuses of the too slow set, then the slow one; the blocking ADC has no
+   // ring, so takes either
+   uint8_t tuned[2] = { 0xFF, 0xFF };
+
+   auto tune = [&](uint64_t atNS, uint32_t pollMS, uint8_t *status)
+   {
+      sim.At(atNS, [&host, pollMS]()
+      {
+         TuningReport req = {};
+         req.version = TUNING_VERSION;
+         req.command = TUNING_APPLY;
+         req.fields  = TUNE_POLL_MS;
+         req.pollMS  = uint8_t(pollMS);
+
+         std::vector<uint8_t> data(1 + sizeof(req));
+         data[0] = TUNING_REPORT_ID;
+         memcpy(data.data() + 1, &req, sizeof(req));
+
+         host.SetReport(HID_INSTANCE_GAMEPAD, HID_REPORT_TYPE_FEATURE, data);
+      });
+
+      // Once the loop has taken it
+      sim.At(atNS + 5 * MS, [&host, status]()
+      {
+         host.GetReport(HID_INSTANCE_GAMEPAD, TUNING_REPORT_ID, HID_REPORT_TYPE_FEATURE, sizeof(TuningReport) + 1,
+                        [status](const std::vector<uint8_t> &got)
+         {
+            TuningReport report;
+
+            if (got.size() == sizeof(report) + 1)
+            {
+               memcpy(&report, got.data() + 1, sizeof(report));
+               *status = report.status;
+            }
+         });
+      });
+   };
+
+   if (slowPoll)
+   {
+      tune(TUNE_NS, TOO_SLOW_POLL_MS, &tuned[0]);
+      tune(TUNE_NS + 10 * MS, SLOW_POLL_MS, &tuned[1]);
+   }
+
+   sim.StopAt(END_NS);
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   printf("dip %u: 3 analogs, %s ADC, %s\n", dip, blocking ? "blocking" : "free-running",
+          path != nullptr ? path : "synthetic noise");
+
+   for (const Window &w : windows)
+      printf("%-10s %6.2f - %.2f s: %5u gamepad reports\n", w.name, w.startNS / 1e9, w.endNS / 1e9, w.reports);
+
+   printf("x swept %d to %d, axes left at %d %d %d\n", lowest, highest, last[0], last[1], last[2]);
+
+   if (slowPoll)
+      printf("%ums poll: status %u, %ums poll: status %u\n", TOO_SLOW_POLL_MS, tuned[0], SLOW_POLL_MS, tuned[1]);
+
+   bool pass = badReport == 0 && windows[1].reports > 0 && lowest == -AnalogAxis::RANGE &&
+               highest == AnalogAxis::RANGE && last[0] == 0 && last[1] == 0;
+
+   if (slowPoll && (tuned[0] != (blocking ? TUNING_OK : TUNING_OUT_OF_RANGE) || tuned[1] != TUNING_OK))
+      pass = false;
+
+   // A single conversion per poll has spikes well past any sensible hysteresis,
+   // so only the filtered path is held to silence at rest
+   if (blocking)
+      printf("the blocking ADC isn't filtered, so isn't held to the rest windows\n");
+   else if (windows[0].reports != 0 || windows[2].reports != 0)
+      pass = false;
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks ConfigStore's log-structured format against the simulated flash.
+//
+// Round trip: random records are saved and read back after each reboot, i.e.
+// by a new store scanning the flash from scratch, including after a record's
+// CRC is broken, and with the wrong version.
+//
+// Wear: many saves, then every sector must have been erased equally often.
+//
+// Torn writes: power is cut at a random byte of each save's erase or program.
+// After rebooting, the store must hold either the record from before or the
+// one being written, never nothing or garbage, and must go on saving.
+//
+// Boot: a board config saved with ArcadeCtrl::SaveBoardConfig() must be what
+// a controller constructed afterwards runs with.
+//
+//   ConfigCheck [--saves N] [--cuts N] [--seed N]
+
+#include "ArcadeCtrl.h"
+#include "ConfigStore.h"
+#include "Sim.h"
+#include "hardware/flash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+constexpr uint16_t VERSION = 7;
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+// Well clear of the end of flash, where ArcadeCtrl keeps its store
+constexpr uint32_t TEST_OFFSET = 1024 * 1024;
+
+struct Record
+{
+   uint32_t serial;
+   uint8_t  bytes[300];
+
+   bool operator==(const Record &rhs) const { return memcmp(this, &rhs, sizeof(*this)) == 0; }
+};
+
+static Record MakeRecord(uint32_t serial, std::mt19937 &rng)
+{
+   Record r;
+   r.serial = serial;
+
+   for (uint8_t &b : r.bytes)
+      b = uint8_t(rng());
+
+   return r;
+}
+
+// As after a reboot
+static bool LoadFresh(Record *r)
+{
+   ConfigStore store(TEST_OFFSET, ConfigStore::SECTORS);
+   return store.Load(VERSION, r, sizeof(*r));
+}
+
+static bool CheckRoundTrip(std::mt19937 &rng)
+{
+   Sim::Get().ResetFlash();
+
+   bool   pass = true;
+   Record loaded;
+
+   if (LoadFresh(&loaded))
+   {
+      printf("round trip: loaded a record from erased flash\n");
+      pass = false;
+   }
+
+   Record prev {};
+   Record last {};
+
+   for (uint32_t i = 0; i < 100; i++)
+   {
+      ConfigStore store(TEST_OFFSET, ConfigStore::SECTORS);
+
+      prev = last;
+      last = MakeRecord(i, rng);
+
+      if (!store.Save(VERSION, &last, sizeof(last)) || !LoadFresh(&loaded) || !(loaded == last))
+      {
+         printf("round trip: save %u didn't read back\n", i);
+         pass = false;
+      }
+   }
+
+   // Another version, or another size, is somebody else's layout
+   ConfigStore store(TEST_OFFSET, ConfigStore::SECTORS);
+   uint8_t     small[16];
+
+   if (store.Load(VERSION + 1, &loaded, sizeof(loaded)) || store.Load(VERSION, small, sizeof(small)))
+   {
+      printf("round trip: loaded a record of the wrong version or size\n");
+      pass = false;
+   }
+
+   // Break a bit in the newest record's data. Which slot that is doesn't
+   // matter; the one holding last's serial is it.
+   uint8_t *image = Sim::Get().FlashImage() + TEST_OFFSET;
+
+   for (uint32_t slot = 0; slot < ConfigStore::SECTORS * FLASH_SECTOR_SIZE / ConfigStore::SLOT_SIZE; slot++)
+   {
+      uint8_t *data = image + slot * ConfigStore::SLOT_SIZE + 16;
+
+      if (memcmp(data, &last, sizeof(last)) == 0)
+         data[100] ^= 0x10;
+   }
+
+   if (!LoadFresh(&loaded) || !(loaded == prev))
+   {
+      printf("round trip: a corrupt newest record didn't fall back to the one before\n");
+      pass = false;
+   }
+
+   printf("round trip: 100 saves read back after each reboot, corrupt and foreign records ignored: %s\n",
+          pass ? "ok" : "FAILED");
+   return pass;
+}
+
+static bool CheckWear(uint32_t saves, std::mt19937 &rng)
+{
+   Sim::Get().ResetFlash();
+
+   ConfigStore store(TEST_OFFSET, ConfigStore::SECTORS);
+
+   for (uint32_t i = 0; i < saves; i++)
+   {
+      Record r = MakeRecord(i, rng);
+      store.Save(VERSION, &r, sizeof(r));
+   }
+
+   uint32_t least = ~0u;
+   uint32_t most  = 0;
+
+   for (uint32_t s = 0; s < ConfigStore::SECTORS; s++)
+   {
+      uint32_t erases = Sim::Get().FlashEraseCount(TEST_OFFSET + s * FLASH_SECTOR_SIZE);
+      least = std::min(least, erases);
+      most  = std::max(most, erases);
+   }
+
+   // Each sector holds 8 records, and the first lap finds them erased
+   bool pass = most - least <= 1 && store.GetStats().erases <= saves / 8;
+
+   printf("wear: %u saves over %u sectors erased each sector %u to %u times (%.3f erases a save): %s\n",
+          saves, ConfigStore::SECTORS, least, most, double(store.GetStats().erases) / saves, pass ? "ok" : "FAILED");
+   return pass;
+}
+
+static bool CheckTornWrites(uint32_t cuts, std::mt19937 &rng)
+{
+   Sim::Get().ResetFlash();
+
+   bool     pass      = true;
+   bool     haveLast  = false;
+   Record   last {};
+   uint32_t torn      = 0;
+   uint32_t completed = 0;
+   uint32_t newKept   = 0;
+   uint32_t skipped   = 0;
+
+   // An erase and a program is the most a save can do
+   std::uniform_int_distribution<uint64_t> cutAt(0, FLASH_SECTOR_SIZE + ConfigStore::SLOT_SIZE);
+
+   for (uint32_t i = 0; i < cuts; i++)
+   {
+      ConfigStore store(TEST_OFFSET, ConfigStore::SECTORS);
+      Record      next = MakeRecord(i, rng);
+      bool        done = false;
+
+      Sim::Get().CutPowerAfter(cutAt(rng));
+
+      try
+      {
+         done = store.Save(VERSION, &next, sizeof(next));
+         Sim::Get().CancelPowerCut();
+         completed++;
+      }
+      catch (const Sim::PowerCut &)
+      {
+         torn++;
+      }
+
+      skipped += store.GetStats().skipped;
+
+      Record loaded;
+      bool   have = LoadFresh(&loaded);
+
+      // The new record can survive a cut in the padding after its data
+      if (have && loaded == next)
+      {
+         if (!done)
+            newKept++;
+
+         last     = next;
+         haveLast = true;
+      }
+      else if (done || have != haveLast || (have && !(loaded == last)))
+      {
+         printf("torn writes: save %u (%s) left %s\n", i, done ? "completed" : "cut",
+                have ? "a record that's neither the old nor the new one" : "no record");
+         pass = false;
+         break;
+      }
+   }
+
+   printf("torn writes: %u saves cut short, %u completed (%u slots skipped over); %u cut saves kept, "
+          "the rest left the record before: %s\n", torn, completed, skipped, newKept, pass ? "ok" : "FAILED");
+   return pass;
+}
+
+static bool CheckBoot()
+{
+   Sim &sim = Sim::Get();
+   sim.ResetFlash();
+
+   constexpr uint32_t DIP = 3;
+
+   ArcadeCtrl::BoardConfig cfg = ArcadeCtrl::s_boardConfigs[DIP];
+   cfg.numAnalogs        = 2;
+   cfg.numEncoders       = 1;
+   cfg.encoderGain       = 2.5f;
+   cfg.releaseUS         = 8000;
+   cfg.smooth            = true;
+   cfg.accel             = &ArcadeCtrl::s_trackballAccel;
+   cfg.axisCal[1].centre = 0x7000;
+
+   // Saved for another DIP setting as well, which must be left alone
+   ArcadeCtrl::BoardConfig other = ArcadeCtrl::s_boardConfigs[0];
+   other.encoderGain = 4.0f;
+
+   bool pass = ArcadeCtrl::SaveBoardConfig(0, other) && ArcadeCtrl::SaveBoardConfig(DIP, cfg);
+
+   sim.SetGPIOLevels(DIP << DIP_SHIFT, false);
+
+   ArcadeCtrl                     controller;
+   const ArcadeCtrl::BoardConfig &booted = controller.GetBoardConfig();
+
+   pass = pass && controller.ConfigFromFlash() && booted.numAnalogs == 2 && booted.numEncoders == 1 &&
+          booted.encoderGain == 2.5f && booted.releaseUS == 8000 && booted.smooth &&
+          booted.accel == &ArcadeCtrl::s_trackballAccel && booted.axisCal[1].centre == 0x7000 &&
+          booted.splitHID == cfg.splitHID && booted.adcDMA == cfg.adcDMA;
+
+   printf("boot: saved board config used in place of the table: %s\n", pass ? "ok" : "FAILED");
+   return pass;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t saves = 10000;
+   uint32_t cuts  = 5000;
+   uint32_t seed  = 1;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? strtoul(argv[++i], nullptr, 0) : 0; };
+
+      if (!strcmp(argv[i], "--saves"))
+         saves = next();
+      else if (!strcmp(argv[i], "--cuts"))
+         cuts = next();
+      else if (!strcmp(argv[i], "--seed"))
+         seed = next();
+      else
+      {
+         fprintf(stderr, "usage: %s [--saves N] [--cuts N] [--seed N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+
+   bool pass = CheckRoundTrip(rng);
+   pass = CheckWear(saves, rng) && pass;
+   pass = CheckTornWrites(cuts, rng) && pass;
+   pass = CheckBoot() && pass;
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
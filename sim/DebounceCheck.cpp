@@ -0,0 +1,375 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks Debouncer against a straightforward per-button model of the same
+// rules. Every pattern of down/up samples up to --length long is run on every
+// combination of release and confirm windows, under several sample timings,
+// followed by a randomised run with presses forced in as the edge interrupt
+// would. Then times Update() against the model and the old 5-sample OR ring.
+//
+//   DebounceCheck [--length N] [--seed N] [--bench-samples N]
+
+#include "Debouncer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint32_t TICK_US = 250;
+
+// One button, one counter, in absolute ticks
+struct RefButton
+{
+   uint32_t releaseTicks = 0;
+   uint32_t confirmTicks = 0;
+   bool     confirm      = false;
+
+   bool     state        = false;
+   bool     prevDown     = false;
+   uint64_t lastDownTick = 0;
+   uint64_t confirmTick  = 0;
+
+   bool Update(bool down, uint64_t tick)
+   {
+      if (state)
+      {
+         if (down)
+            lastDownTick = tick;
+         else if (tick - lastDownTick >= releaseTicks)
+            state = false;
+      }
+      else if (down)
+      {
+         if (!confirm)
+         {
+            state        = true;
+            lastDownTick = tick;
+         }
+         else if (!prevDown)
+            confirmTick = tick;
+         else if (tick - confirmTick >= confirmTicks)
+         {
+            state        = true;
+            lastDownTick = tick;
+         }
+      }
+
+      prevDown = down;
+      return state;
+   }
+
+   void ForcePress(uint64_t tick)
+   {
+      state        = true;
+      lastDownTick = tick;
+   }
+};
+
+struct Windows
+{
+   uint32_t releaseUS;
+   uint32_t confirmUS; // 0 for an eager press
+};
+
+// Includes windows that aren't a whole number of ticks and ones past the cap
+static const uint32_t s_releaseUS[] = { 0, 250, 1000, 1100, 3000, 5000, 15750, 20000 };
+static const uint32_t s_confirmUS[] = { 0, 250, 500, 2000, 2100 };
+
+static uint32_t Ticks(uint32_t us)
+{
+   return std::min((us + TICK_US - 1) / TICK_US, Debouncer::MAX_TICKS);
+}
+
+class Harness
+{
+public:
+   // Lane i of the debouncer runs with windows[i % windows.size()]
+   explicit Harness(const std::vector<Windows> &windows, uint32_t laneOffset) :
+      m_debouncer(TICK_US)
+   {
+      for (uint32_t lane = 0; lane < 32; lane++)
+      {
+         const Windows &w = windows[(lane + laneOffset) % windows.size()];
+
+         m_debouncer.SetReleaseWindow(1u << lane, w.releaseUS);
+         if (w.confirmUS)
+            m_debouncer.SetPressConfirm(1u << lane, w.confirmUS);
+
+         m_ref[lane].releaseTicks = Ticks(w.releaseUS);
+         m_ref[lane].confirmTicks = Ticks(w.confirmUS);
+         m_ref[lane].confirm      = w.confirmUS != 0;
+      }
+   }
+
+   // Returns false, describing the first difference, on a mismatch
+   bool Step(uint32_t down, uint32_t stepUS)
+   {
+      m_nowUS += m_started ? stepUS : 0;
+      m_started = true;
+
+      uint32_t got  = m_debouncer.Update(down, uint32_t(m_nowUS));
+      uint64_t tick = (m_nowUS - m_startUS) / TICK_US;
+      uint32_t want = 0;
+
+      for (uint32_t lane = 0; lane < 32; lane++)
+         want |= uint32_t(m_ref[lane].Update((down >> lane) & 1, tick)) << lane;
+
+      m_samples++;
+
+      if (got == want)
+         return true;
+
+      uint32_t lane = __builtin_ctz(got ^ want);
+      fprintf(stderr, "mismatch at sample %u, t=%llu us: lane %u (release %u ticks, confirm %s %u ticks) "
+              "debouncer %u, model %u\n", m_samples, (unsigned long long)m_nowUS, lane,
+              m_ref[lane].releaseTicks, m_ref[lane].confirm ? "on" : "off", m_ref[lane].confirmTicks,
+              (got >> lane) & 1, (want >> lane) & 1);
+      return false;
+   }
+
+   void ForcePress(uint32_t mask)
+   {
+      m_debouncer.ForcePress(mask);
+
+      uint64_t tick = (m_nowUS - m_startUS) / TICK_US;
+
+      for (uint32_t lane = 0; lane < 32; lane++)
+         if ((mask >> lane) & 1)
+            m_ref[lane].ForcePress(tick);
+   }
+
+   // Start the clock somewhere awkward, so it wraps during long runs
+   void SetStart(uint64_t us) { m_nowUS = m_startUS = us; }
+
+private:
+   Debouncer m_debouncer;
+   RefButton m_ref[32];
+   uint64_t  m_startUS = 0;
+   uint64_t  m_nowUS   = 0;
+   bool      m_started = false;
+   uint32_t  m_samples = 0;
+};
+
+// Every down/up pattern of the given length, 32 at a time, each followed by
+// enough up samples for the longest release window to expire
+static bool Exhaustive(uint32_t length, const std::vector<Windows> &windows,
+                       const std::vector<uint32_t> &stepsUS, uint64_t *samples)
+{
+   uint32_t patterns = 1u << length;
+   uint32_t tail     = 0;
+
+   for (uint32_t elapsedUS = 0; elapsedUS <= (Debouncer::MAX_TICKS + 1) * TICK_US; tail++)
+      elapsedUS += stepsUS[tail % stepsUS.size()];
+
+   for (uint32_t base = 0; base < patterns; base += 32)
+   {
+      // Shift the window assignment each batch so every pattern meets every window
+      for (uint32_t offset = 0; offset < windows.size(); offset += 32)
+      {
+         Harness h(windows, offset + base / 32);
+         h.SetStart(0xFFFFFFFFull - 3 * TICK_US);
+
+         for (uint32_t s = 0; s < length + tail; s++)
+         {
+            uint32_t down = 0;
+
+            if (s < length)
+               for (uint32_t lane = 0; lane < 32; lane++)
+                  down |= (((base + lane) % patterns >> s) & 1) << lane;
+
+            if (!h.Step(down, stepsUS[s % stepsUS.size()]))
+               return false;
+
+            (*samples)++;
+         }
+      }
+   }
+
+   return true;
+}
+
+// Bouncy presses and releases on random lanes with random sample spacing,
+// and presses forced in between samples
+static bool Randomised(std::mt19937 &rng, const std::vector<Windows> &windows, uint32_t count, uint64_t *samples)
+{
+   std::uniform_int_distribution<uint32_t> step(0, 3000);
+   std::uniform_int_distribution<uint32_t> lanePick(0, 31);
+   std::bernoulli_distribution             flip(0.1);
+   std::bernoulli_distribution             force(0.02);
+
+   Harness  h(windows, 0);
+   uint32_t down = 0;
+
+   h.SetStart(rng());
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      for (uint32_t lane = 0; lane < 32; lane++)
+         if (flip(rng))
+            down ^= 1u << lane;
+
+      if (force(rng))
+         h.ForcePress(1u << lanePick(rng));
+
+      if (!h.Step(down, step(rng)))
+         return false;
+
+      (*samples)++;
+   }
+
+   return true;
+}
+
+template <typename Fn>
+static double TimeNS(uint32_t count, Fn fn)
+{
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   auto end = std::chrono::steady_clock::now();
+
+   return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+static void Bench(uint32_t count, uint32_t seed)
+{
+   std::mt19937          rng(seed);
+   std::vector<uint32_t> downs(4096);
+
+   for (uint32_t &d : downs)
+      d = rng() & rng() & rng();
+
+   std::vector<Windows> windows = { { 5000, 0 } };
+   volatile uint32_t    sink    = 0;
+
+   double sliced = TimeNS(count, [&]()
+   {
+      Debouncer d(TICK_US);
+      d.SetReleaseWindow(~0u, 5000);
+
+      uint32_t acc = 0;
+      for (uint32_t i = 0; i < count; i++)
+         acc ^= d.Update(downs[i & 4095], i * 1000);
+      sink = acc;
+   });
+
+   double model = TimeNS(count, [&]()
+   {
+      RefButton ref[32];
+      for (RefButton &r : ref)
+         r.releaseTicks = Ticks(5000);
+
+      uint32_t acc = 0;
+      for (uint32_t i = 0; i < count; i++)
+      {
+         uint32_t state = 0;
+         for (uint32_t lane = 0; lane < 32; lane++)
+            state |= uint32_t(ref[lane].Update((downs[i & 4095] >> lane) & 1, uint64_t(i) * 4)) << lane;
+         acc ^= state;
+      }
+      sink = acc;
+   });
+
+   double ring = TimeNS(count, [&]()
+   {
+      uint32_t samples[5] = {};
+      uint32_t pos        = 0;
+
+      uint32_t acc = 0;
+      for (uint32_t i = 0; i < count; i++)
+      {
+         samples[pos++] = downs[i & 4095];
+         if (pos >= 5)
+            pos = 0;
+
+         uint32_t state = 0;
+         for (uint32_t s = 0; s < 5; s++)
+            state |= samples[s];
+         acc ^= state;
+      }
+      sink = acc;
+   });
+
+   printf("per sample, 32 buttons: bit-sliced %.1f ns, per-button model %.1f ns, 5-sample OR ring %.1f ns\n",
+          sliced, model, ring);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t length       = 12;
+   uint32_t seed         = 1;
+   uint32_t benchSamples = 10 * 1000 * 1000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? strtol(argv[++i], nullptr, 0) : 0; };
+
+      if (!strcmp(argv[i], "--length"))
+         length = std::min(uint32_t(next()), 20u);
+      else if (!strcmp(argv[i], "--seed"))
+         seed = next();
+      else if (!strcmp(argv[i], "--bench-samples"))
+         benchSamples = next();
+      else
+      {
+         fprintf(stderr, "usage: %s [--length N] [--seed N] [--bench-samples N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::vector<Windows> windows;
+
+   for (uint32_t r : s_releaseUS)
+      for (uint32_t c : s_confirmUS)
+         windows.push_back(Windows { r, c });
+
+   // Even polling, polling faster than the tick, uneven polling
+   const std::vector<std::vector<uint32_t>> timings =
+   {
+      { 1000 },
+      { 100 },
+      { 333, 1250, 0, 700, 2900 },
+   };
+
+   std::mt19937 rng(seed);
+   uint64_t     samples = 0;
+   bool         pass    = true;
+
+   for (const std::vector<uint32_t> &stepsUS : timings)
+      pass = pass && Exhaustive(length, windows, stepsUS, &samples);
+
+   pass = pass && Randomised(rng, windows, 2 * 1000 * 1000, &samples);
+
+   printf("%llu samples of %zu window combinations checked against the per-button model: %s\n",
+          (unsigned long long)samples, windows.size(), pass ? "PASS" : "FAIL");
+
+   if (benchSamples)
+      Bench(benchSamples, seed);
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks the fixed-point encoder accumulation against exact arithmetic and
+// compares the cost of the interrupt handler's work per step with the float
+// accumulation it replaced. The M0+ has no FPU, so the float side is timed
+// with a software add like the one it calls rather than the host's.
+//
+// Both simulated encoders are driven with random bursts of steps in either
+// direction, with different gains, and read at random points. Every read must
+// equal floor(steps * gain) for that encoder's own gain, so the deltas sent
+// never lose a fraction of a count and one encoder's gain can't leak into the
+// other's.
+//
+//   EncoderCheck [--steps N] [--seed N] [--gain0 G] [--gain1 G] [--bench-steps N]
+
+#include "Encoder.h"
+#include "Sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+// Returns the expected reading, computed independently of Encoder
+static int32_t Expected(int64_t steps, int32_t gainFixed)
+{
+   int64_t scaled = steps * gainFixed;
+   int64_t whole  = scaled / (1 << Encoder::GAIN_FRAC_BITS);
+
+   // Round towards minus infinity
+   if (scaled % (1 << Encoder::GAIN_FRAC_BITS) < 0)
+      whole--;
+
+   return int32_t(whole);
+}
+
+static bool Check(uint32_t numSteps, uint32_t seed, float gain0, float gain1)
+{
+   std::mt19937 rng(seed);
+   Sim         &sim = Sim::Get();
+
+   Encoder encoders[2] = { Encoder(0, 16, 17, gain0), Encoder(1, 18, 19, gain1) };
+   int32_t gains[2]    = { Encoder::ToFixed(gain0), Encoder::ToFixed(gain1) };
+   int64_t steps[2]    = {};
+   int64_t sent[2]     = {};
+   int32_t last[2]     = {};
+
+   std::uniform_int_distribution<uint32_t> burst(0, 40);
+   std::bernoulli_distribution             dir;
+   std::bernoulli_distribution             pick;
+
+   for (uint32_t done = 0; done < numSteps; )
+   {
+      uint32_t n  = burst(rng);
+      uint32_t e  = pick(rng);
+      bool     cw = dir(rng);
+
+      for (uint32_t i = 0; i < n; i++)
+         sim.EncoderStep(e, cw);
+
+      // Encoder.pio raises irq 0 for clockwise, which the handler counts down
+      steps[e] += cw ? -int64_t(n) : int64_t(n);
+      done     += n;
+
+      for (uint32_t j = 0; j < 2; j++)
+      {
+         int32_t angle = encoders[j].Read();
+         int32_t want  = Expected(steps[j], gains[j]);
+
+         sent[j] += angle - last[j];
+         last[j]  = angle;
+
+         if (angle != want)
+         {
+            fprintf(stderr, "encoder %u after %lld steps: read %d, expected %d\n",
+                    j, (long long)steps[j], angle, want);
+            return false;
+         }
+      }
+   }
+
+   printf("%u steps: encoder 0 gain %.3f sent %lld of %lld steps, encoder 1 gain %.3f sent %lld of %lld steps\n",
+          numSteps, gain0, (long long)sent[0], (long long)steps[0], gain1, (long long)sent[1], (long long)steps[1]);
+
+   return true;
+}
+
+// Single precision add the way the M0+ has to do it, in integer code: unpack,
+// align, add or subtract the mantissas, normalise and round to nearest even.
+// Zeros and normal numbers only, which is all the encoder accumulation sees.
+static uint32_t SoftFloatAdd(uint32_t a, uint32_t b)
+{
+   if ((a & 0x7fffffff) < (b & 0x7fffffff))
+      std::swap(a, b);
+
+   int32_t  expA = (a >> 23) & 0xff;
+   int32_t  expB = (b >> 23) & 0xff;
+   uint32_t sign = a & 0x80000000;
+
+   if (expB == 0)
+      return a;
+
+   // Three extra bits for rounding
+   uint32_t manA  = ((a & 0x7fffff) | 0x800000) << 3;
+   uint32_t manB  = ((b & 0x7fffff) | 0x800000) << 3;
+   int32_t  shift = expA - expB;
+
+   if (shift > 26)
+      return a;
+
+   uint32_t sticky = (manB & ((1u << shift) - 1)) != 0;
+   manB = (manB >> shift) | sticky;
+
+   uint32_t man = ((a ^ b) & 0x80000000) ? manA - manB : manA + manB;
+
+   if (man == 0)
+      return 0;
+
+   while (man >= (0x1000000u << 3))
+   {
+      man = (man >> 1) | (man & 1);
+      expA++;
+   }
+
+   while (man < (0x800000u << 3))
+   {
+      man <<= 1;
+      expA--;
+   }
+
+   uint32_t round = man & 7;
+   man >>= 3;
+
+   if (round > 4 || (round == 4 && (man & 1)))
+   {
+      if (++man == 0x1000000)
+      {
+         man >>= 1;
+         expA++;
+      }
+   }
+
+   return sign | (uint32_t(expA) << 23) | (man & 0x7fffff);
+}
+
+static uint32_t FloatBits(float f)
+{
+   uint32_t u;
+   memcpy(&u, &f, sizeof(u));
+   return u;
+}
+
+static float BitsFloat(uint32_t u)
+{
+   float f;
+   memcpy(&f, &u, sizeof(f));
+   return f;
+}
+
+// The per-step work of the two handlers, on a stand-in for the PIO irq register
+static volatile uint32_t s_irq;
+static volatile uint32_t s_rotation;
+static uint32_t          s_gain    = FloatBits(10.0f);
+static uint32_t          s_negGain = FloatBits(-10.0f);
+static volatile int32_t  s_steps;
+
+static void FloatStep()
+{
+   if (s_irq & 1)
+      s_rotation = SoftFloatAdd(s_rotation, s_negGain);
+   if (s_irq & 2)
+      s_rotation = SoftFloatAdd(s_rotation, s_gain);
+}
+
+// The bench is only meaningful if the soft-float add matches the hardware one
+static bool CheckSoftFloat(uint32_t seed)
+{
+   std::mt19937                          rng(seed);
+   std::uniform_real_distribution<float> value(-1e6f, 1e6f);
+   std::uniform_int_distribution<int>    scale(-20, 20);
+
+   for (uint32_t i = 0; i < 1000 * 1000; i++)
+   {
+      float a = std::ldexp(value(rng), scale(rng));
+      float b = std::ldexp(value(rng), scale(rng));
+
+      if (SoftFloatAdd(FloatBits(a), FloatBits(b)) != FloatBits(a + b))
+      {
+         fprintf(stderr, "soft-float %g + %g = %g, expected %g\n", a, b,
+                 BitsFloat(SoftFloatAdd(FloatBits(a), FloatBits(b))), a + b);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static void IntegerStep()
+{
+   if (s_irq & 1)
+      s_steps = s_steps - 1;
+   if (s_irq & 2)
+      s_steps = s_steps + 1;
+}
+
+template <typename Fn>
+static double TimeNS(uint32_t count, Fn fn)
+{
+   auto start = std::chrono::steady_clock::now();
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      s_irq = 1 + (i & 1);
+      fn();
+   }
+
+   auto end = std::chrono::steady_clock::now();
+
+   return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t numSteps   = 1000 * 1000;
+   uint32_t seed       = 1;
+   float    gain0      = 0.3f;
+   float    gain1      = -2.75f;
+   uint32_t benchSteps = 50 * 1000 * 1000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+      if (!strcmp(argv[i], "--steps"))
+         numSteps = strtoul(next(), nullptr, 0);
+      else if (!strcmp(argv[i], "--seed"))
+         seed = strtoul(next(), nullptr, 0);
+      else if (!strcmp(argv[i], "--gain0"))
+         gain0 = strtof(next(), nullptr);
+      else if (!strcmp(argv[i], "--gain1"))
+         gain1 = strtof(next(), nullptr);
+      else if (!strcmp(argv[i], "--bench-steps"))
+         benchSteps = strtoul(next(), nullptr, 0);
+      else
+      {
+         fprintf(stderr, "usage: %s [--steps N] [--seed N] [--gain0 G] [--gain1 G] [--bench-steps N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   bool pass = Check(numSteps, seed, gain0, gain1);
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+
+   if (benchSteps && CheckSoftFloat(seed))
+   {
+      double floatNS   = TimeNS(benchSteps, FloatStep);
+      double integerNS = TimeNS(benchSteps, IntegerStep);
+
+      printf("handler work per step, without an FPU: soft-float %.2f ns, integer %.2f ns\n", floatNS, integerNS);
+   }
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Sends fast flicks of both encoders through the real ArcadeCtrl::Run() loop
+// and send path, and checks the host receives every count: once each flick
+// has settled, the mouse X and Y summed over all reports so far must equal
+// floor(steps * gain) for each encoder.
+//
+// Encoder 0 spins up to --peak counts a second and decays, which at the
+// trackball board's gain is far more than 127 a report. Encoder 1 gets
+// --burst steps at once, more than even a 16-bit report holds, so the
+// remainder has to carry over into the following reports.
+//
+//   FlickCheck [--dip N] [--peak N] [--burst N] [--seed N] [--single-hid]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t REPORT_ID_MOUSE = 2;
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+// Report ID, buttons, then 16-bit X and Y
+constexpr size_t MOUSE_REPORT_SIZE = 6;
+
+static int64_t FloorScaled(int64_t steps, float gain)
+{
+   int64_t scaled = steps * Encoder::ToFixed(gain);
+   int64_t whole  = scaled / (1 << Encoder::GAIN_FRAC_BITS);
+
+   if (scaled % (1 << Encoder::GAIN_FRAC_BITS) < 0)
+      whole--;
+
+   return whole;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip       = 0;
+   uint32_t peak      = 20000;
+   uint32_t burst     = 5000;
+   uint32_t seed      = 1;
+   bool     singleHID = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? strtol(argv[++i], nullptr, 0) : 0; };
+
+      if (!strcmp(argv[i], "--dip"))
+         dip = next() & 3;
+      else if (!strcmp(argv[i], "--peak"))
+         peak = next();
+      else if (!strcmp(argv[i], "--burst"))
+         burst = next();
+      else if (!strcmp(argv[i], "--seed"))
+         seed = next();
+      else if (!strcmp(argv[i], "--single-hid"))
+         singleHID = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--peak N] [--burst N] [--seed N] [--single-hid]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+   Sim         &sim  = Sim::Get();
+   SimHost     &host = SimHost::Get();
+
+   host.sofPhaseNS = std::uniform_int_distribution<uint64_t>(0, MS - 1)(rng);
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.splitHID = !singleHID;
+
+   // Counts must come out at exactly the gain, so no acceleration curve
+   cfg.accel = nullptr;
+
+   if (cfg.numEncoders == 0)
+   {
+      fprintf(stderr, "dip %u has no encoders\n", dip);
+      return 1;
+   }
+
+   int64_t  steps[2]    = {};
+   int64_t  received[2] = {};
+   uint32_t settled     = 0;
+   uint32_t mismatches  = 0;
+
+   // Once the motion has stopped and the last report is through
+   auto checkpoint = [&]()
+   {
+      for (uint32_t i = 0; i < cfg.numEncoders && i < 2; i++)
+      {
+         int64_t want = FloorScaled(steps[i], cfg.encoderGain);
+
+         if (received[i] != want)
+         {
+            fprintf(stderr, "checkpoint %u, encoder %u: %lld steps at gain %.3f, host received %lld of %lld\n",
+                    settled, i, (long long)steps[i], cfg.encoderGain, (long long)received[i], (long long)want);
+            mismatches++;
+         }
+      }
+
+      settled++;
+   };
+
+   // Flicks in alternating directions, each decaying over 300 ms, with the
+   // edge times jittered so they don't line up with the polls
+   std::uniform_real_distribution<double> jitter(0.0, 1.0);
+
+   constexpr uint64_t FLICK_NS = 2000 * MS;
+
+   uint64_t t = 200 * MS;
+
+   for (uint32_t flick = 0; flick < 4; flick++, t += FLICK_NS)
+   {
+      bool   cw    = flick & 1;
+      double total = peak * 0.3;
+
+      for (uint32_t n = 0; n < uint32_t(total * 0.99); n++)
+      {
+         // Inverse of n = total * (1 - exp(-s / 0.3))
+         double   s  = -0.3 * std::log(1.0 - (n + jitter(rng)) / total);
+         uint64_t at = t + uint64_t(s * 1e9);
+
+         sim.At(at, [&, cw]() { Sim::Get().EncoderStep(0, cw); steps[0] += cw ? -1 : 1; });
+      }
+
+      sim.At(t + FLICK_NS - 10 * MS, checkpoint);
+   }
+
+   if (cfg.numEncoders > 1)
+   {
+      sim.At(t, [&]()
+      {
+         for (uint32_t n = 0; n < burst; n++)
+            Sim::Get().EncoderStep(1, false);
+
+         steps[1] += burst;
+      });
+   }
+
+   // Plenty of time for the carried remainder to drain
+   sim.At(t + 490 * MS, checkpoint);
+   sim.StopAt(t + 500 * MS);
+
+   uint32_t reports     = 0;
+   uint32_t over8Bit    = 0; // Reports an 8-bit axis couldn't have carried
+   int32_t  largest     = 0;
+   bool     badSize     = false;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      if (p.data.empty() || p.data[0] != REPORT_ID_MOUSE)
+         return;
+
+      if (p.data.size() != MOUSE_REPORT_SIZE)
+      {
+         badSize = true;
+         return;
+      }
+
+      int16_t axis[2] = { int16_t(p.data[2] | (p.data[3] << 8)), int16_t(p.data[4] | (p.data[5] << 8)) };
+
+      for (uint32_t i = 0; i < 2; i++)
+      {
+         received[i] += axis[i];
+         largest      = std::max(largest, std::abs(int32_t(axis[i])));
+      }
+
+      reports++;
+
+      if (std::abs(axis[0]) > 127 || std::abs(axis[1]) > 127)
+         over8Bit++;
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   if (badSize)
+   {
+      fprintf(stderr, "mouse report isn't %zu bytes\n", MOUSE_REPORT_SIZE);
+      printf("FAIL\n");
+      return 1;
+   }
+
+   printf("dip %u, %s: %u mouse reports, %u beyond 8 bits, largest %d\n", dip,
+          controller.GetUSB().SplitInterfaces() ? "split HID interfaces" : "single HID interface",
+          reports, over8Bit, largest);
+
+   for (uint32_t i = 0; i < cfg.numEncoders && i < 2; i++)
+      printf("encoder %u: %lld steps net at gain %.3f, host received %lld\n",
+             i, (long long)steps[i], cfg.encoderGain, (long long)received[i]);
+
+   bool pass = mismatches == 0 && settled == 5;
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
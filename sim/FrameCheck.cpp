@@ -0,0 +1,171 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Checks that a button press and encoder step made together reach the host
+// in the same USB frame. Runs the real ArcadeCtrl::Run() loop on a board with
+// an encoder and exits non-zero if any pair was split across frames, unless
+// --single-hid is given, where the chained mouse report is expected to lag.
+//
+//   FrameCheck [--dip N] [--pairs N] [--seed N] [--single-hid]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t REPORT_ID_GAMEPAD = 1;
+constexpr uint8_t REPORT_ID_MOUSE   = 2;
+
+constexpr uint32_t DIP_SHIFT  = 21;
+constexpr uint32_t BUTTON_BIT = 0;
+
+struct Pair
+{
+   uint64_t timeNS;
+   int64_t  gamepadFrame = -1;
+   int64_t  mouseFrame   = -1;
+};
+
+int main(int argc, char **argv)
+{
+   uint32_t dip       = 1;
+   uint32_t numPairs  = 500;
+   uint32_t seed      = 1;
+   bool     singleHID = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? strtol(argv[++i], nullptr, 0) : 0; };
+
+      if (!strcmp(argv[i], "--dip"))
+         dip = next() & 3;
+      else if (!strcmp(argv[i], "--pairs"))
+         numPairs = next();
+      else if (!strcmp(argv[i], "--seed"))
+         seed = next();
+      else if (!strcmp(argv[i], "--single-hid"))
+         singleHID = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--pairs N] [--seed N] [--single-hid]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+   Sim         &sim  = Sim::Get();
+   SimHost     &host = SimHost::Get();
+
+   host.sofPhaseNS = std::uniform_int_distribution<uint64_t>(0, MS - 1)(rng);
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.splitHID = !singleHID;
+
+   if (cfg.numEncoders == 0)
+   {
+      fprintf(stderr, "dip %u has no encoders\n", dip);
+      return 1;
+   }
+
+   // Press and step together at a random point in the frame, release well
+   // before the next pair so each pair's reports are unambiguous
+   std::vector<Pair> pairs;
+   std::uniform_int_distribution<uint64_t> jitter(0, MS - 1);
+
+   uint64_t t = 200 * MS;
+
+   for (uint32_t i = 0; i < numPairs; i++, t += 60 * MS)
+   {
+      uint64_t at = t + jitter(rng);
+
+      sim.At(at, []() { Sim::Get().PressButtons(1u << BUTTON_BIT); Sim::Get().EncoderStep(0, true); });
+      sim.At(at + 25 * MS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+      pairs.push_back(Pair { at });
+   }
+
+   sim.StopAt(t + 100 * MS);
+
+   size_t nextGamepad = 0;
+   size_t nextMouse   = 0;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t nowNS)
+   {
+      int64_t frame = host.FrameNumber();
+
+      if (p.data.size() >= 11 && p.data[0] == REPORT_ID_GAMEPAD && (p.data[7] >> BUTTON_BIT) & 1)
+      {
+         if (nextGamepad < pairs.size() && pairs[nextGamepad].timeNS <= nowNS)
+            pairs[nextGamepad++].gamepadFrame = frame;
+      }
+      else if (p.data.size() >= 4 && p.data[0] == REPORT_ID_MOUSE && (p.data[2] | p.data[3]) != 0)
+      {
+         if (nextMouse < pairs.size() && pairs[nextMouse].timeNS <= nowNS)
+            pairs[nextMouse++].mouseFrame = frame;
+      }
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   uint32_t sameFrame = 0;
+   uint32_t missing   = 0;
+   int64_t  maxLag    = 0;
+
+   for (const Pair &p : pairs)
+   {
+      if (p.gamepadFrame < 0 || p.mouseFrame < 0)
+         missing++;
+      else if (p.gamepadFrame == p.mouseFrame)
+         sameFrame++;
+      else
+         maxLag = std::max(maxLag, p.mouseFrame - p.gamepadFrame);
+   }
+
+   printf("dip %u, %s: %u of %zu press+step pairs reached the host in the same frame, "
+          "%u missing, mouse up to %lld frames behind\n", dip,
+          controller.GetUSB().SplitInterfaces() ? "split HID interfaces" : "single HID interface",
+          sameFrame, pairs.size(), missing, (long long)maxLag);
+
+   bool pass = missing == 0 && (singleHID || sameFrame == pairs.size());
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Runs the real ArcadeCtrl::Run() loop through a stretch with nothing
+// happening, then one of play, with presses on every button and the
+// encoders turning. Reads the telemetry feature report after each, as
+// ArcadeTelemetry would on a board, and reports how much of the time each
+// core spent asleep in WFE, how often it woke, and how late the polls started
+// against their deadlines. Sleeping, the cores must be asleep for most of the
+// idle stretch, and in both the polls must start within MAX_LATE_US of due and
+// every press reach the host. --spin turns the sleep off, for the loop as it
+// was, to compare against.
+//
+//   IdleCheck [--dip N] [--seconds S] [--dual-core] [--sof-lead US] [--irq-press] [--spin]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t  HID_INSTANCE_GAMEPAD = 0;
+constexpr uint8_t  REPORT_ID_GAMEPAD    = 1;
+constexpr uint32_t DIP_SHIFT            = 21;
+
+// Idle, at least this much of the time asleep
+constexpr double MIN_IDLE_ASLEEP = 0.9;
+
+// No poll may start later than this after it was due
+constexpr uint32_t MAX_LATE_US = 10;
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+template <typename T>
+static void Get(uint8_t reportID, T *report)
+{
+   SimHost::Get().GetReport(HID_INSTANCE_GAMEPAD, reportID, HID_REPORT_TYPE_FEATURE, sizeof(*report) + 1,
+                            [report](const std::vector<uint8_t> &data)
+   {
+      memset(report, 0, sizeof(*report));
+
+      if (data.size() == sizeof(*report) + 1)
+         memcpy(report, data.data() + 1, sizeof(*report));
+   });
+}
+
+static void Clear()
+{
+   TelemetryCounters req = {};
+   req.version = TELEMETRY_VERSION;
+   req.command = TELEMETRY_CLEAR;
+
+   std::vector<uint8_t> data(1 + sizeof(req));
+   data[0] = TELEMETRY_COUNTERS_ID;
+   memcpy(data.data() + 1, &req, sizeof(req));
+
+   SimHost::Get().SetReport(HID_INSTANCE_GAMEPAD, HID_REPORT_TYPE_FEATURE, data);
+}
+
+static double Asleep(const TelemetryCounters &c, uint32_t core)
+{
+   return c.sinceClearMS ? double(c.sleptMS[core]) / c.sinceClearMS : 0.0;
+}
+
+static void Print(const char *name, const TelemetryCounters &c, bool dualCore)
+{
+   double seconds = c.sinceClearMS / 1000.0;
+
+   printf("%s: %.1f s, %u polls, latest %u us after due; core0 asleep %.1f%%, %.0f wakes/s",
+          name, seconds, c.polls, c.maxLateUS, 100.0 * Asleep(c, 0), c.sleeps[0] / seconds);
+
+   if (dualCore)
+      printf("; core1 asleep %.1f%%, %.0f wakes/s", 100.0 * Asleep(c, 1), c.sleeps[1] / seconds);
+
+   printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip      = 2;
+   uint32_t seconds  = 10;
+   bool     dualCore = false;
+   uint32_t sofLead  = 0;
+   bool     irqPress = false;
+   bool     spin     = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+         seconds = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--dual-core"))
+         dualCore = true;
+      else if (!strcmp(argv[i], "--sof-lead") && i + 1 < argc)
+         sofLead = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--irq-press"))
+         irqPress = true;
+      else if (!strcmp(argv[i], "--spin"))
+         spin = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--seconds S] [--dual-core] [--sof-lead US] [--irq-press] [--spin]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+
+   cfg.dualCore     = dualCore;
+   cfg.sofLeadUS    = sofLead;
+   cfg.irqPressPath = irqPress;
+   cfg.sleep        = !spin;
+
+   // Idle from the clear, once enumerated, then play
+   uint64_t idleAt = 500 * MS;
+   uint64_t playAt = idleAt + seconds * 1000 * MS;
+   uint64_t endAt  = playAt + seconds * 1000 * MS;
+
+   TelemetryCounters idle = {}, play = {};
+
+   sim.At(idleAt, []() { Clear(); });
+   sim.At(playAt, [&]() { Get(TELEMETRY_COUNTERS_ID, &idle); Clear(); });
+   sim.At(endAt, [&]() { Get(TELEMETRY_COUNTERS_ID, &play); });
+   sim.StopAt(endAt + 10 * MS);
+
+   // Presses on one button or another, held 10-40ms, with 20-60ms between
+   // the release and the next press so each is seen on its own
+   static const uint32_t buttonBits[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 20 };
+
+   std::mt19937 rng(1);
+   uint32_t     presses[32] = {};
+
+   for (uint64_t t = playAt + 5 * MS; t < endAt - 100 * MS;
+        t += std::uniform_int_distribution<uint64_t>(20 * MS, 60 * MS)(rng))
+   {
+      uint32_t bit  = buttonBits[rng() % (sizeof(buttonBits) / sizeof(buttonBits[0]))];
+
+      // Only the first player's, which are all on the one report
+      if (cfg.player2Mask & (1u << bit))
+         continue;
+
+      uint64_t hold = std::uniform_int_distribution<uint64_t>(10 * MS, 40 * MS)(rng);
+
+      sim.At(t, [bit]() { Sim::Get().PressButtons(1u << bit); });
+      sim.At(t + hold, [bit]() { Sim::Get().ReleaseButtons(1u << bit); });
+      presses[bit]++;
+      t += hold;
+   }
+
+   // And the encoders turning steadily
+   for (uint32_t e = 0; e < cfg.numEncoders; e++)
+      for (uint64_t t = playAt; t < endAt; t += (e + 2) * MS / 3)
+         sim.At(t, [e]() { Sim::Get().EncoderStep(e, true); });
+
+   // Presses as the host saw them
+   uint32_t seen[32]    = {};
+   uint32_t lastButtons = 0;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      uint32_t buttons = 0;
+
+      if (p.data.size() < 11 || p.data[0] != REPORT_ID_GAMEPAD)
+         return;
+
+      memcpy(&buttons, &p.data[7], sizeof(buttons));
+
+      for (uint32_t pressed = buttons & ~lastButtons; pressed != 0; pressed &= pressed - 1)
+         seen[__builtin_ctz(pressed)]++;
+
+      lastButtons = buttons;
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   Print("idle", idle, dualCore);
+   Print("play", play, dualCore);
+
+   Check(idle.version == TELEMETRY_VERSION && play.version == TELEMETRY_VERSION, "telemetry read");
+
+   for (uint32_t bit = 0; bit < 32; bit++)
+      if (seen[bit] != presses[bit])
+      {
+         fprintf(stderr, "FAILED: GPIO %u pressed %u times, host saw %u\n", bit, presses[bit], seen[bit]);
+         s_failures++;
+      }
+
+   Check(idle.overruns == 0 && play.overruns == 0, "no poll overruns");
+   Check(idle.maxLateUS <= MAX_LATE_US && play.maxLateUS <= MAX_LATE_US, "polls start on time");
+
+   if (spin)
+      Check(idle.sleeps[0] == 0 && idle.sleeps[1] == 0, "spinning never sleeps");
+   else
+   {
+      Check(Asleep(idle, 0) >= MIN_IDLE_ASLEEP, "core0 asleep when idle");
+      Check(!dualCore || Asleep(idle, 1) >= MIN_IDLE_ASLEEP, "core1 asleep when idle");
+   }
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Keyboard mode. First the report builder on its own: key maps with clashes
+// and usages out of range, then random button sequences, each report checked
+// against one built from scratch. Then the real ArcadeCtrl::Run() loop with
+// the MAME key map: every input pressed at once, released, then each alone,
+// checking the keys the host sees and that there's a report per change and
+// no more.
+//
+//   KeyboardCheck [--dip N] [--seed N]
+
+#include "ArcadeCtrl.h"
+#include "Keyboard.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t  REPORT_ID_KEYBOARD = 1; // In the gamepad's place
+constexpr uint32_t DIP_SHIFT          = 21;
+
+// Every button input, with 16-19 when they're a second joystick's
+constexpr uint32_t INPUT_MASK    = ((1 << 16) - 1) | (1 << 20);
+constexpr uint32_t JOYSTICK2_MASK = 0xF << 16;
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+// The usages a report has down
+static std::set<uint8_t> Keys(const uint8_t *report)
+{
+   std::set<uint8_t> keys;
+
+   for (uint32_t bit = 0; bit < 8; bit++)
+      if (report[0] & (1u << bit))
+         keys.insert(0xE0 + bit);
+
+   for (uint32_t i = 0; i < KEY_BITMAP_BYTES * 8; i++)
+      if (report[1 + i / 8] & (1u << (i % 8)))
+         keys.insert(uint8_t(i));
+
+   return keys;
+}
+
+// The usages of the buttons down in mask, through map, taking the first
+// GPIO for a usage as its owner
+static std::set<uint8_t> Expected(const KeyMap &map, uint32_t buttons)
+{
+   std::set<uint8_t> owned, keys;
+
+   for (uint32_t i = 0; i < 32; i++)
+   {
+      uint8_t usage = map.usage[i];
+
+      if (usage == 0 || (usage >= KEY_BITMAP_BYTES * 8 && usage < 0xE0) || usage > 0xE7 || owned.count(usage))
+         continue;
+
+      owned.insert(usage);
+
+      if (buttons & (1u << i))
+         keys.insert(usage);
+   }
+
+   return keys;
+}
+
+static void CheckBuilder(std::mt19937 &rng)
+{
+   // Clashes, modifiers and usages past the bitmap
+   KeyMap map = {};
+
+   for (uint32_t i = 0; i < 32; i++)
+   {
+      uint32_t r = rng() % (KEY_BITMAP_BYTES * 8 + 8);
+
+      map.usage[i] = uint8_t(r < KEY_BITMAP_BYTES * 8 ? r : 0xE0 + r - KEY_BITMAP_BYTES * 8);
+   }
+
+   map.usage[3] = map.usage[1];
+   map.usage[5] = 0xE2;
+   map.usage[6] = 0xE2;
+   map.usage[7] = 0;
+   map.usage[8] = KEY_BITMAP_BYTES * 8;
+
+   Keyboard keyboard(map);
+
+   // Each GPIO alone gives its key, unless a lower one has it already
+   uint32_t mask = 0;
+
+   for (uint32_t i = 0; i < 32; i++)
+      if (Expected(map, 1u << i).size() == 1)
+         mask |= 1u << i;
+
+   Check(keyboard.Mask() == mask, "GPIOs with a key");
+   Check(!(mask & (1u << 3)) && !(mask & (1u << 6)), "a clashing GPIO has no key");
+   Check(!(mask & (1u << 7)) && !(mask & (1u << 8)), "no key for zero or past the bitmap");
+
+   uint32_t buttons = 0;
+   uint32_t wrong   = 0;
+
+   for (uint32_t n = 0; n < 200000; n++)
+   {
+      // Mostly one or two buttons at a time, as play is, sometimes a lot
+      if (n % 50 == 0)
+         buttons = rng();
+      else
+         buttons ^= (1u << (rng() % 32)) | (rng() % 4 == 0 ? 1u << (rng() % 32) : 0);
+
+      const KeyboardReport &report = keyboard.Update(buttons);
+
+      wrong += Keys(&report.modifiers) != Expected(map, buttons);
+   }
+
+   Check(wrong == 0, "incremental reports match ones built from scratch");
+   printf("builder: %u GPIOs mapped of 32, 200000 updates, %u wrong\n", __builtin_popcount(keyboard.Mask()), wrong);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip  = 2;
+   uint32_t seed = 1;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+         seed = strtol(argv[++i], nullptr, 0);
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--seed N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+
+   CheckBuilder(rng);
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.keymap = &ArcadeCtrl::s_mameKeys;
+
+   if (cfg.numEncoders > 0)
+   {
+      fprintf(stderr, "dip %u has encoders; the key map needs 16-19\n", dip);
+      return 1;
+   }
+
+   const KeyMap &map    = ArcadeCtrl::s_mameKeys;
+   uint32_t      inputs = INPUT_MASK | (cfg.player2Mask & JOYSTICK2_MASK);
+
+   std::vector<uint32_t> pins;
+
+   for (uint32_t i = 0; i < 32; i++)
+      if (inputs & (1u << i))
+         pins.push_back(i);
+
+   // Everything at once, then each alone
+   struct Change
+   {
+      uint64_t timeNS;
+      uint32_t down;
+   };
+
+   std::vector<Change> changes;
+   uint64_t            t = 200 * MS + 300 * 1000;
+
+   changes.push_back(Change { t, inputs });
+   changes.push_back(Change { t += 30 * MS, 0 });
+
+   for (uint32_t pin : pins)
+   {
+      changes.push_back(Change { t += 20 * MS + 130 * 1000, 1u << pin });
+      changes.push_back(Change { t += 20 * MS + 130 * 1000, 0 });
+   }
+
+   uint32_t down = 0;
+
+   for (const Change &c : changes)
+   {
+      uint32_t press   = c.down & ~down;
+      uint32_t release = down & ~c.down;
+
+      sim.At(c.timeNS, [press, release]()
+      {
+         if (press)
+            Sim::Get().PressButtons(press);
+         if (release)
+            Sim::Get().ReleaseButtons(release);
+      });
+
+      down = c.down;
+   }
+
+   sim.StopAt(t + 50 * MS);
+
+   // The host's view: each report and when it was queued
+   struct Seen
+   {
+      std::set<uint8_t> keys;
+      uint64_t          queuedNS;
+   };
+
+   std::vector<Seen> seen;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      Check(p.instance == 0, "keyboard on the first interface");
+      Check(p.data.size() == 1 + sizeof(KeyboardReport) && p.data[0] == REPORT_ID_KEYBOARD, "keyboard report");
+
+      if (p.data.size() == 1 + sizeof(KeyboardReport))
+         seen.push_back(Seen { Keys(&p.data[1]), p.queuedNS });
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   const USB &usb = controller.GetUSB();
+
+   Check(usb.KeyboardMode() && !usb.TwoPlayers() && host.Endpoints().size() == 1, "one keyboard interface");
+
+   // The descriptor declares a keyboard application collection
+   const std::vector<uint8_t> &desc = host.ReportDescriptors().at(0);
+   static const uint8_t keyboardUsage[] = { 0x05, HID_USAGE_PAGE_DESKTOP, 0x09, HID_USAGE_DESKTOP_KEYBOARD };
+
+   Check(desc.size() >= sizeof(keyboardUsage) && memcmp(desc.data(), keyboardUsage, sizeof(keyboardUsage)) == 0,
+         "report descriptor is a keyboard");
+
+   // A report per change, with the keys down and nothing else
+   Check(seen.size() == changes.size(), "a report per change and no more");
+
+   uint32_t matched = 0;
+   uint64_t maxNS   = 0;
+
+   for (size_t i = 0; i < seen.size() && i < changes.size(); i++)
+   {
+      matched += seen[i].keys == Expected(map, changes[i].down);
+      maxNS    = std::max(maxNS, seen[i].queuedNS - changes[i].timeNS);
+   }
+
+   Check(matched == changes.size(), "each report has the keys down");
+   Check(!seen.empty() && seen[0].keys.size() == pins.size(), "every input down at once in one report");
+
+   printf("dip %u: %zu inputs all down in one report of %zu keys; %zu changes, %zu reports, %u matched, "
+          "slowest %.1f us to queue (a release, after its window)\n", dip, pins.size(), seen.empty() ? 0 : seen[0].keys.size(), changes.size(),
+          seen.size(), matched, maxNS / 1000.0);
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
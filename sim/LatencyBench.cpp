@@ -0,0 +1,444 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Runs the real ArcadeCtrl::Run() loop against the simulator with a scripted
+// sequence of button presses (with contact bounce) and encoder steps, and
+// reports the distribution of simulated time from each edge to the report
+// that carries it being queued with tud_hid_report(), and to the host
+// actually receiving it. --spin keeps the loop running between polls rather
+// than waiting in WFE, to compare against.
+//
+//   LatencyBench [--dip N] [--seconds S] [--seed N] [--bounce-us US]
+//                [--task-ns NS] [--irq-press] [--dual-core] [--sof-lead US]
+//                [--single-hid] [--pio-sampler] [--pio-count] [--smooth]
+//                [--accel] [--analogs N] [--blocking-adc] [--spin] [--hist]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+constexpr uint64_t US = 1000;
+
+constexpr uint8_t REPORT_ID_GAMEPAD  = 1;
+constexpr uint8_t REPORT_ID_MOUSE    = 2;
+constexpr uint8_t REPORT_ID_GAMEPAD2 = 3; // Two player boards
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+struct Options
+{
+   uint32_t dip       = 2;
+   uint32_t seconds   = 60;
+   uint32_t seed      = 1;
+   uint32_t bounceUS  = 300;
+   int32_t  taskNS    = -1;
+   bool     irqPress  = false;
+   bool     dualCore  = false;
+   uint32_t sofLead   = 0;
+   bool     singleHID = false;
+   bool     pioSample = false;
+   bool     pioCount  = false;
+   bool     smooth    = false;
+   bool     accel     = false;
+   int32_t  analogs   = -1;
+   bool     blockADC  = false;
+   bool     spin      = false;
+   bool     hist      = false;
+};
+
+class Distribution
+{
+public:
+   explicit Distribution(const char *name) : m_name(name) {}
+
+   void Add(uint64_t ns) { m_us.push_back(ns / 1000.0); }
+
+   void Print(bool hist)
+   {
+      if (m_us.empty())
+      {
+         printf("%-28s n=0\n", m_name);
+         return;
+      }
+
+      std::sort(m_us.begin(), m_us.end());
+
+      double sum = 0.0;
+      for (double v : m_us)
+         sum += v;
+
+      printf("%-28s n=%-6zu min %8.1f  mean %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f us\n",
+             m_name, m_us.size(), m_us.front(), sum / m_us.size(), Percentile(0.5),
+             Percentile(0.9), Percentile(0.99), m_us.back());
+
+      if (hist)
+         PrintHistogram();
+   }
+
+private:
+   double Percentile(double p) const
+   {
+      return m_us[std::min(m_us.size() - 1, size_t(p * m_us.size()))];
+   }
+
+   void PrintHistogram() const
+   {
+      constexpr uint32_t BUCKETS = 20;
+
+      double lo    = m_us.front();
+      double width = std::max((m_us.back() - lo) / BUCKETS, 1.0);
+
+      uint32_t counts[BUCKETS] = {};
+      for (double v : m_us)
+         counts[std::min(BUCKETS - 1, uint32_t((v - lo) / width))]++;
+
+      uint32_t peak = *std::max_element(counts, counts + BUCKETS);
+
+      for (uint32_t b = 0; b < BUCKETS; b++)
+         printf("   %8.1f us |%-50s %u\n", lo + b * width,
+                std::string(counts[b] * 50 / peak, '#').c_str(), counts[b]);
+   }
+
+   const char         *m_name;
+   std::vector<double> m_us;
+};
+
+struct Edge
+{
+   uint64_t timeNS;
+   uint32_t bit;
+   bool     press;
+   bool     queued;
+   bool     delivered;
+};
+
+static Options ParseArgs(int argc, char **argv)
+{
+   Options opts;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? strtol(argv[++i], nullptr, 0) : 0; };
+
+      if (!strcmp(argv[i], "--dip"))
+         opts.dip = next() & 3;
+      else if (!strcmp(argv[i], "--seconds"))
+         opts.seconds = next();
+      else if (!strcmp(argv[i], "--seed"))
+         opts.seed = next();
+      else if (!strcmp(argv[i], "--bounce-us"))
+         opts.bounceUS = next();
+      else if (!strcmp(argv[i], "--task-ns"))
+         opts.taskNS = next();
+      else if (!strcmp(argv[i], "--irq-press"))
+         opts.irqPress = true;
+      else if (!strcmp(argv[i], "--dual-core"))
+         opts.dualCore = true;
+      else if (!strcmp(argv[i], "--sof-lead"))
+         opts.sofLead = next();
+      else if (!strcmp(argv[i], "--single-hid"))
+         opts.singleHID = true;
+      else if (!strcmp(argv[i], "--pio-sampler"))
+         opts.pioSample = true;
+      else if (!strcmp(argv[i], "--pio-count"))
+         opts.pioCount = true;
+      else if (!strcmp(argv[i], "--smooth"))
+         opts.smooth = true;
+      else if (!strcmp(argv[i], "--accel"))
+         opts.accel = true;
+      else if (!strcmp(argv[i], "--analogs"))
+         opts.analogs = std::min<int32_t>(next(), 3);
+      else if (!strcmp(argv[i], "--blocking-adc"))
+         opts.blockADC = true;
+      else if (!strcmp(argv[i], "--spin"))
+         opts.spin = true;
+      else if (!strcmp(argv[i], "--hist"))
+         opts.hist = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--seconds S] [--seed N] [--bounce-us US] "
+                         "[--task-ns NS] [--irq-press] [--dual-core] [--sof-lead US] [--single-hid] [--pio-sampler] [--pio-count] [--smooth] [--accel] [--analogs N] [--blocking-adc] [--spin] [--hist]\n", argv[0]);
+         exit(1);
+      }
+   }
+
+   return opts;
+}
+
+// Presses and releases one button at a time, each edge followed by a burst
+// of contact bounce, and returns the first (true) edge of each transition.
+static std::vector<Edge> ScriptButtons(std::mt19937 &rng, const Options &opts, uint64_t start, uint64_t end)
+{
+   static const uint32_t buttonBits[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 20 };
+
+   std::vector<Edge> edges;
+   Sim &sim = Sim::Get();
+
+   auto scriptBounce = [&](uint64_t t, uint32_t mask, bool press)
+   {
+      if (opts.bounceUS == 0)
+         return;
+
+      std::uniform_int_distribution<uint64_t> when(1, opts.bounceUS * US);
+
+      for (uint32_t i = 0; i < 4; i++)
+      {
+         uint64_t a = t + when(rng);
+         uint64_t b = std::max(a, t + when(rng)) + US;
+         sim.At(a, [=]() { press ? Sim::Get().ReleaseButtons(mask) : Sim::Get().PressButtons(mask); });
+         sim.At(b, [=]() { press ? Sim::Get().PressButtons(mask) : Sim::Get().ReleaseButtons(mask); });
+      }
+   };
+
+   std::uniform_int_distribution<uint32_t> pick(0, std::size(buttonBits) - 1);
+   std::uniform_int_distribution<uint64_t> hold(20 * MS, 60 * MS);
+   std::uniform_int_distribution<uint64_t> gap(15 * MS, 40 * MS);
+
+   for (uint64_t t = start; t < end; )
+   {
+      uint32_t bit  = buttonBits[pick(rng)];
+      uint32_t mask = 1u << bit;
+
+      sim.At(t, [=]() { Sim::Get().PressButtons(mask); });
+      scriptBounce(t, mask, true);
+      edges.push_back(Edge { t, bit, true, false, false });
+
+      t += hold(rng);
+
+      sim.At(t, [=]() { Sim::Get().ReleaseButtons(mask); });
+      scriptBounce(t, mask, false);
+      edges.push_back(Edge { t, bit, false, false, false });
+
+      t += gap(rng);
+   }
+
+   return edges;
+}
+
+// Single encoder steps, well apart so each one produces its own report
+static std::vector<uint64_t> ScriptEncoder(std::mt19937 &rng, uint64_t start, uint64_t end)
+{
+   std::vector<uint64_t> steps;
+   std::uniform_int_distribution<uint64_t> gap(20 * MS, 50 * MS);
+   std::bernoulli_distribution             dir;
+
+   for (uint64_t t = start + gap(rng); t < end; t += gap(rng))
+   {
+      bool cw = dir(rng);
+      Sim::Get().At(t, [=]() { Sim::Get().EncoderStep(0, cw); });
+      steps.push_back(t);
+   }
+
+   return steps;
+}
+
+int main(int argc, char **argv)
+{
+   Options      opts = ParseArgs(argc, argv);
+   std::mt19937 rng(opts.seed);
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   if (opts.taskNS >= 0)
+      sim.costs.tudTaskNS = opts.taskNS;
+
+   // Host SOF phase is unrelated to the device's millisecond clock
+   host.sofPhaseNS = std::uniform_int_distribution<uint64_t>(0, MS - 1)(rng);
+
+   // Select the board config; DIP switches pull their pins low when on
+   sim.SetGPIOLevels(opts.dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[opts.dip];
+
+   cfg.irqPressPath = opts.irqPress;
+   cfg.dualCore     = opts.dualCore;
+   cfg.sofLeadUS    = opts.sofLead;
+   cfg.splitHID     = !opts.singleHID;
+   cfg.pioSampler   = opts.pioSample;
+   cfg.pioCount     = opts.pioCount;
+   cfg.smooth       = opts.smooth;
+   cfg.accel        = opts.accel ? &ArcadeCtrl::s_trackballAccel : nullptr;
+   cfg.adcDMA       = !opts.blockADC;
+   cfg.sleep        = !opts.spin;
+
+   if (opts.analogs >= 0)
+      cfg.numAnalogs = opts.analogs;
+
+   uint64_t start = 200 * MS;
+   uint64_t end   = start + uint64_t(opts.seconds) * 1000 * MS;
+
+   std::vector<Edge>     edges = ScriptButtons(rng, opts, start, end);
+   std::vector<uint64_t> steps;
+
+   if (cfg.numEncoders > 0)
+      steps = ScriptEncoder(rng, start, end);
+
+   sim.StopAt(end + 100 * MS);
+
+   Distribution pressQueued("press   edge -> queued");
+   Distribution pressDelivered("press   edge -> host");
+   Distribution releaseQueued("release edge -> queued");
+   Distribution releaseDelivered("release edge -> host");
+   Distribution stepQueued("encoder step -> queued");
+   Distribution stepDelivered("encoder step -> host");
+
+   size_t   nextEdge[2] = {};
+   size_t   nextStep[2] = {};
+   uint32_t reports     = 0;
+
+   // Edges are scripted in order and one button at a time, so only the
+   // oldest unmatched edge can be satisfied by a report.
+   auto match = [&](const SimHost::Packet &p, uint64_t nowNS, int stage)
+   {
+      if (p.data.size() < 1)
+         return;
+
+      if ((p.data[0] == REPORT_ID_GAMEPAD || p.data[0] == REPORT_ID_GAMEPAD2) && p.data.size() >= 11)
+      {
+         uint32_t buttons = p.data[7] | (p.data[8] << 8) | (p.data[9] << 16) | (p.data[10] << 24);
+         uint32_t covered = ~cfg.player2Mask;
+
+         // Player 2's report has their pins packed from bit 0, in pin order
+         if (p.data[0] == REPORT_ID_GAMEPAD2)
+         {
+            uint32_t packed = buttons;
+
+            buttons = 0;
+            covered = cfg.player2Mask;
+
+            for (uint32_t bit = 0, in = 0; bit < 32; bit++)
+               if (covered & (1u << bit))
+                  buttons |= ((packed >> in++) & 1) << bit;
+         }
+
+         while (nextEdge[stage] < edges.size() && edges[nextEdge[stage]].timeNS <= nowNS)
+         {
+            const Edge &e = edges[nextEdge[stage]];
+
+            if (!((covered >> e.bit) & 1) || ((buttons >> e.bit) & 1) != e.press)
+               break;
+
+            uint64_t latency = nowNS - e.timeNS;
+
+            if (stage == 0)
+               (e.press ? pressQueued : releaseQueued).Add(latency);
+            else
+               (e.press ? pressDelivered : releaseDelivered).Add(latency);
+
+            nextEdge[stage]++;
+         }
+      }
+      else if (p.data[0] == REPORT_ID_MOUSE && p.data.size() >= 4 && (p.data[2] | p.data[3]) != 0)
+      {
+         while (nextStep[stage] < steps.size() && steps[nextStep[stage]] <= nowNS)
+         {
+            (stage == 0 ? stepQueued : stepDelivered).Add(nowNS - steps[nextStep[stage]]);
+            nextStep[stage]++;
+         }
+      }
+   };
+
+   host.onQueued    = [&](const SimHost::Packet &p) { reports++; match(p, p.queuedNS, 0); };
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t nowNS) { match(p, nowNS, 1); };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   printf("dip %u: %u analog, %u encoder(s); host polls every %u ms; %u s simulated, %u reports queued\n",
+          opts.dip, cfg.numAnalogs, cfg.numEncoders,
+          host.Endpoints().empty() ? 0 : host.Endpoints()[0].interval, opts.seconds, reports);
+
+   pressQueued.Print(opts.hist);
+   pressDelivered.Print(opts.hist);
+   releaseQueued.Print(opts.hist);
+   releaseDelivered.Print(opts.hist);
+
+   if (!steps.empty())
+   {
+      stepQueued.Print(opts.hist);
+      stepDelivered.Print(opts.hist);
+   }
+
+   if (opts.irqPress)
+   {
+      const ArcadeCtrl::IRQPressStats &irq = controller.GetIRQPressStats();
+      uint32_t n = std::max(irq.presses, 1u);
+
+      printf("irq press path: %u presses sent ahead of the poll, edge -> queued mean %.1f max %u us, "
+             "saved mean %.1f max %u us\n", irq.presses, double(irq.totalEdgeToQueueUS) / n,
+             irq.maxEdgeToQueueUS, double(irq.totalSavedUS) / n, irq.maxSavedUS);
+   }
+
+   if (opts.dualCore)
+   {
+      const ArcadeCtrl::PipelineStats &pipe = controller.GetPipelineStats();
+
+      printf("dual core: %u snapshots published, %u overruns, %u consumed, %u superseded, "
+             "age mean %.1f max %u us\n", pipe.published, pipe.overruns, pipe.consumed, pipe.superseded,
+             double(pipe.totalAgeUS) / std::max(pipe.consumed, 1u), pipe.maxAgeUS);
+   }
+
+   if (opts.pioSample)
+   {
+      const ButtonSampler::Stats &smp = controller.GetSampler().GetStats();
+
+      printf("pio sampler: %u samples, %u passed to the debouncer, %u overruns\n",
+             smp.samples, smp.passed, smp.overruns);
+   }
+
+   if (opts.sofLead)
+   {
+      const ArcadeCtrl::SOFStats  &sof = controller.GetSOFStats();
+      const USB::SOFCallbackStats &cb  = controller.GetUSB().GetSOFCallbackStats();
+      uint32_t n    = std::max(sof.samples, 1u);
+      double   mean = double(sof.totalPhaseUS) / n;
+      double   var  = std::max(0.0, double(sof.totalPhaseSqUS) / n - mean * mean);
+
+      printf("sof sync: %u samples, lead to SOF mean %.1f min %u max %u us, jitter %.1f us rms; "
+             "sof callback delay mean %.1f max %u us\n", sof.samples, mean, sof.minPhaseUS,
+             sof.maxPhaseUS, sqrt(var), double(cb.totalDelayUS) / std::max(cb.callbacks, 1u),
+             cb.maxDelayUS);
+   }
+
+   return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Runs the two simulated encoders through the same motion profiles, reading
+// them once per poll the way ReadInputs does: encoder 0 as plain counts and
+// encoder 1 with smoothing on. Each poll's delta is compared with the true
+// motion over the poll, both after gain, and the RMS of the difference shows
+// how much stair-stepping is left. The lag column is the furthest the
+// reported position fell behind the true one, also after gain. With acceleration
+// on, the truth no longer applies and the effective gain is shown instead.
+//
+// Every profile ends at rest for longer than the smoothing's longest glide,
+// after which both encoders must have reported exactly floor(steps * gain):
+// smoothing may delay a count but never lose or invent one. Smoothing must
+// also leave no more error than plain counts, give or take 5% for when the
+// gain is too low for it to make any difference, and lag them by no more
+// than a count (or a unit, if that's more).
+//
+// The synthetic profiles are generated here. A recorded one can be given as
+// a text file of "<time us> <+1|-1>" lines, one per edge; the true motion is
+// then taken as even between edges, which is the best it can be known.
+//
+//   MotionCheck [--gain G] [--poll-us US] [--profile FILE] [--accel]
+
+#include "ArcadeCtrl.h"
+#include "Encoder.h"
+#include "Sim.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Edge
+{
+   uint64_t timeUS;
+   int32_t  dir;
+};
+
+struct Profile
+{
+   std::string                   name;
+   std::vector<Edge>             edges;
+   std::function<double(double)> position; // True position in counts, against us from the start
+   uint64_t                      lengthUS;
+};
+
+static constexpr uint64_t REST_US = 2 * Encoder::SMOOTH_MAX_GAP_US;
+
+// Edges wherever the floor of the position changes, checked every us
+static Profile Synthetic(const char *name, double seconds, std::function<double(double)> position)
+{
+   Profile p{ name, {}, position, uint64_t(seconds * 1e6) };
+   int64_t count = 0;
+
+   for (uint64_t t = 1; t <= p.lengthUS; t++)
+   {
+      int64_t now = int64_t(std::floor(position(double(t))));
+
+      for (; count < now; count++)
+         p.edges.push_back({ t, 1 });
+      for (; count > now; count--)
+         p.edges.push_back({ t, -1 });
+   }
+
+   return p;
+}
+
+static bool Recorded(const char *path, Profile *p)
+{
+   FILE *f = fopen(path, "r");
+
+   if (f == nullptr)
+   {
+      fprintf(stderr, "can't open %s\n", path);
+      return false;
+   }
+
+   char line[128];
+
+   while (fgets(line, sizeof(line), f))
+   {
+      unsigned long long timeUS;
+      int                dir;
+
+      if (line[0] == '#' || sscanf(line, "%llu %d", &timeUS, &dir) != 2)
+         continue;
+
+      if (!p->edges.empty() && timeUS < p->edges.back().timeUS)
+      {
+         fprintf(stderr, "%s: edges out of order at %llu us\n", path, timeUS);
+         fclose(f);
+         return false;
+      }
+
+      p->edges.push_back({ timeUS, dir < 0 ? -1 : 1 });
+   }
+
+   fclose(f);
+
+   if (p->edges.empty())
+   {
+      fprintf(stderr, "%s: no edges\n", path);
+      return false;
+   }
+
+   // Time from the first edge, with the count moving evenly from one edge to the next
+   uint64_t first = p->edges.front().timeUS;
+
+   for (Edge &e : p->edges)
+      e.timeUS -= first;
+
+   std::vector<Edge> edges = p->edges;
+
+   p->name     = path;
+   p->lengthUS = edges.back().timeUS;
+   p->position = [edges](double t)
+   {
+      double count = 0.0;
+
+      for (size_t i = 0; i < edges.size(); i++)
+      {
+         if (t < double(edges[i].timeUS))
+         {
+            if (i > 0)
+            {
+               double span = double(edges[i].timeUS - edges[i - 1].timeUS);
+               count += edges[i].dir * (t - double(edges[i - 1].timeUS)) / span;
+            }
+            break;
+         }
+
+         count += edges[i].dir;
+      }
+
+      return count;
+   };
+
+   return true;
+}
+
+struct Result
+{
+   double  sumSqError = 0.0;
+   double  maxLag     = 0.0;
+   double  moved      = 0.0; // Reported, after gain
+   int64_t polls      = 0;
+};
+
+static int64_t FloorScaled(int64_t steps, int32_t gain)
+{
+   int64_t scaled = steps * gain;
+   int64_t whole  = scaled / (1 << Encoder::GAIN_FRAC_BITS);
+
+   if (scaled % (1 << Encoder::GAIN_FRAC_BITS) < 0)
+      whole--;
+
+   return whole;
+}
+
+// Plays one profile into both encoders, then rests. steps carries the total
+// over all profiles so far, which is what the readings are checked against.
+static bool Run(const Profile &p, Encoder *encoders, float gain, uint32_t pollUS, bool accel, int64_t *steps)
+{
+   Sim     &sim = Sim::Get();
+   Result   results[2];
+   int32_t  last[2];
+   uint64_t startNS = sim.NowNS();
+   double   base    = double(*steps);
+   size_t   next    = 0;
+
+   for (uint32_t i = 0; i < 2; i++)
+      last[i] = encoders[i].Read();
+
+   double lastTrue  = 0.0;
+   double trueMoved = 0.0;
+
+   for (uint64_t pollAt = pollUS; pollAt <= p.lengthUS + REST_US; pollAt += pollUS)
+   {
+      // Edges up to the poll, each at its own time so the handlers stamp it
+      for (; next < p.edges.size() && p.edges[next].timeUS <= pollAt; next++)
+      {
+         uint64_t at = startNS + p.edges[next].timeUS * 1000;
+
+         if (at > sim.NowNS())
+            sim.Charge(at - sim.NowNS());
+
+         // Encoder.pio's clockwise is the handler's count down
+         bool cw = p.edges[next].dir < 0;
+
+         sim.EncoderStep(0, cw);
+         sim.EncoderStep(1, cw);
+         *steps += p.edges[next].dir;
+      }
+
+      uint64_t at = startNS + pollAt * 1000;
+
+      if (at > sim.NowNS())
+         sim.Charge(at - sim.NowNS());
+
+      double truePos = p.position(double(std::min(pollAt, p.lengthUS)));
+
+      for (uint32_t i = 0; i < 2; i++)
+      {
+         int32_t angle = encoders[i].Read();
+         double  error = double(angle - last[i]) - (truePos - lastTrue) * gain;
+         double  lag   = std::fabs((base + truePos) * gain - double(angle));
+
+         results[i].sumSqError += error * error;
+         results[i].maxLag      = std::max(results[i].maxLag, lag);
+         results[i].moved      += std::fabs(double(angle - last[i]));
+         results[i].polls++;
+         last[i] = angle;
+      }
+
+      trueMoved += std::fabs(truePos - lastTrue);
+      lastTrue   = truePos;
+   }
+
+   double rms[2];
+
+   printf("%-12s %8zu edges  %6.0f ms", p.name.c_str(), p.edges.size(), p.lengthUS / 1000.0);
+
+   for (uint32_t i = 0; i < 2; i++)
+   {
+      rms[i] = std::sqrt(results[i].sumSqError / double(results[i].polls));
+
+      if (accel)
+         printf("  | gain %7.3f", results[i].moved / trueMoved);
+      else
+         printf("  | rms %7.3f  lag %6.2f", rms[i], results[i].maxLag);
+   }
+
+   printf("\n");
+
+   if (accel)
+      return true;
+
+   if (rms[1] > rms[0] * 1.05 || results[1].maxLag > results[0].maxLag + std::max(std::fabs(gain), 1.0f))
+   {
+      fprintf(stderr, "%s: smoothing isn't helping\n", p.name.c_str());
+      return false;
+   }
+
+   int64_t want = FloorScaled(*steps, Encoder::ToFixed(gain));
+
+   for (uint32_t i = 0; i < 2; i++)
+   {
+      if (last[i] != int32_t(want))
+      {
+         fprintf(stderr, "%s: encoder %u reads %d at rest, expected %lld from %lld steps\n",
+                 p.name.c_str(), i, last[i], (long long)want, (long long)*steps);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   float       gain    = 10.0f;
+   uint32_t    pollUS  = 1000;
+   const char *path    = nullptr;
+   bool        accel   = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+      if (!strcmp(argv[i], "--gain"))
+         gain = float(atof(next()));
+      else if (!strcmp(argv[i], "--poll-us"))
+         pollUS = uint32_t(atoi(next()));
+      else if (!strcmp(argv[i], "--profile"))
+         path = next();
+      else if (!strcmp(argv[i], "--accel"))
+         accel = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--gain G] [--poll-us US] [--profile FILE] [--accel]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (pollUS == 0)
+   {
+      fprintf(stderr, "poll period must be non-zero\n");
+      return 1;
+   }
+
+   std::vector<Profile> profiles;
+
+   constexpr double PI = 3.14159265358979;
+
+   // Speeds in counts per second; t is in us
+   profiles.push_back(Synthetic("creep", 2.0, [](double t) { return 25.0 * t / 1e6; }));
+   profiles.push_back(Synthetic("slow", 2.0, [](double t) { return -150.0 * t / 1e6; }));
+   profiles.push_back(Synthetic("ramp", 2.0, [](double t)
+   {
+      // Up to 3000/s over a second and back down
+      double s = t / 1e6;
+      return s < 1.0 ? 1500.0 * s * s : 3000.0 - 1500.0 * (2.0 - s) * (2.0 - s);
+   }));
+   profiles.push_back(Synthetic("wobble", 2.0, [=](double t) { return 20.0 * std::sin(2.0 * PI * 1.5 * t / 1e6); }));
+   profiles.push_back(Synthetic("flick", 2.0, [](double t)
+   {
+      // A spin of 8000/s decaying over 300 ms
+      return -8000.0 * 0.3 * (1.0 - std::exp(-t / 0.3e6));
+   }));
+   profiles.push_back(Synthetic("bursts", 2.0, [](double t)
+   {
+      // 400/s for 150 ms in every 400
+      double period = std::floor(t / 400e3);
+      double within = std::min(t - period * 400e3, 150e3);
+      return 400.0 * (period * 150e3 + within) / 1e6;
+   }));
+
+   if (path != nullptr)
+   {
+      Profile recorded;
+
+      if (!Recorded(path, &recorded))
+         return 1;
+
+      profiles.push_back(recorded);
+   }
+
+   Encoder encoders[2] = { Encoder(0, 16, 17, gain), Encoder(1, 18, 19, gain) };
+
+   encoders[1].SetSmoothing(true);
+
+   if (accel)
+   {
+      encoders[0].SetAccel(&ArcadeCtrl::s_trackballAccel);
+      encoders[1].SetAccel(&ArcadeCtrl::s_trackballAccel);
+   }
+
+   printf("gain %.3f, polled every %u us; %s, plain | smoothed\n",
+          gain, pollUS, accel ? "effective gain with acceleration" : "per poll delta error and max lag");
+
+   int64_t steps = 0;
+
+   for (const Profile &p : profiles)
+   {
+      if (!Run(p, encoders, gain, pollUS, accel, &steps))
+      {
+         printf("FAIL\n");
+         return 1;
+      }
+   }
+
+   printf("PASS\n");
+
+   return 0;
+}
@@ -0,0 +1,692 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host implementations of the pico-sdk calls the firmware makes. Each one
+// charges its rough on-device cost to the simulated clock.
+
+#include "Sim.h"
+
+#include "bsp/board.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
+
+#include <algorithm>
+#include <memory>
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+
+absolute_time_t get_absolute_time()
+{
+   // The timer is shared by both cores, so readings never go backwards even
+   // when the core reading it is running slightly behind the other in Sim
+   static uint64_t s_lastUS;
+
+   Sim::Get().Charge(Sim::Get().costs.timeReadNS);
+   s_lastUS = std::max(s_lastUS, Sim::Get().NowUS());
+   return s_lastUS;
+}
+
+uint32_t time_us_32()
+{
+   return uint32_t(get_absolute_time());
+}
+
+uint64_t time_us_64()
+{
+   return get_absolute_time();
+}
+
+void sleep_us(uint64_t us)
+{
+   Sim::Get().Charge(us * 1000);
+}
+
+void sleep_ms(uint32_t ms)
+{
+   sleep_us(uint64_t(ms) * 1000);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp)
+{
+   Sim &sim = Sim::Get();
+
+   sim.WaitForEvent(to_us_since_boot(timeout_timestamp) * 1000);
+   sim.Charge(sim.costs.wakeNS);
+
+   return time_us_64() >= to_us_since_boot(timeout_timestamp);
+}
+
+// Four alarms, as the RP2040 timer has. Each new target replaces the last, so
+// an event left over from an earlier one is ignored when it runs.
+struct SimAlarm
+{
+   hardware_alarm_callback_t callback = nullptr;
+   uint64_t                  armed    = 0; // Generation of the live target, 0 for none
+};
+
+static SimAlarm s_alarms[4];
+static uint64_t s_alarmGeneration;
+
+void hardware_alarm_claim(uint alarm_num)
+{
+   (void)alarm_num;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback)
+{
+   s_alarms[alarm_num].callback = callback;
+   s_alarms[alarm_num].armed    = 0;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t)
+{
+   SimAlarm &alarm = s_alarms[alarm_num];
+
+   if (t <= time_us_64())
+   {
+      alarm.armed = 0;
+      return true;
+   }
+
+   uint64_t generation = ++s_alarmGeneration;
+
+   alarm.armed = generation;
+
+   Sim::Get().At(t * 1000, [alarm_num, generation]()
+   {
+      SimAlarm &alarm = s_alarms[alarm_num];
+
+      if (alarm.armed != generation || alarm.callback == nullptr)
+         return;
+
+      alarm.armed = 0;
+      Sim::Get().Interrupt();
+      alarm.callback(alarm_num);
+   });
+
+   return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num)
+{
+   s_alarms[alarm_num].armed = 0;
+}
+
+//--------------------------------------------------------------------+
+// Multicore
+//--------------------------------------------------------------------+
+
+void multicore_launch_core1(void (*entry)())
+{
+   Sim::Get().LaunchCore1(entry);
+}
+
+uint get_core_num()
+{
+   return Sim::Get().CoreNum();
+}
+
+void multicore_lockout_victim_init()
+{
+}
+
+void multicore_lockout_start_blocking()
+{
+}
+
+void multicore_lockout_end_blocking()
+{
+}
+
+//--------------------------------------------------------------------+
+// Board & GPIO
+//--------------------------------------------------------------------+
+
+void board_init()
+{
+}
+
+void gpio_init(uint gpio)
+{
+}
+
+void gpio_init_mask(uint32_t mask)
+{
+}
+
+void gpio_set_dir_in_masked(uint32_t mask)
+{
+}
+
+void gpio_set_dir_out_masked(uint32_t mask)
+{
+}
+
+void gpio_pull_up(uint gpio)
+{
+}
+
+uint32_t gpio_get_all()
+{
+   Sim::Get().Charge(Sim::Get().costs.gpioReadNS);
+   return Sim::Get().GPIOLevels();
+}
+
+bool gpio_get(uint gpio)
+{
+   return (gpio_get_all() >> gpio) & 1;
+}
+
+void gpio_set_mask(uint32_t mask)
+{
+   Sim::Get().SetOutputLevels(mask, true);
+}
+
+void gpio_clr_mask(uint32_t mask)
+{
+   Sim::Get().SetOutputLevels(mask, false);
+}
+
+void gpio_put(uint gpio, bool value)
+{
+   Sim::Get().SetOutputLevels(1u << gpio, value);
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+   Sim::Get().SetGPIOIRQEnabled(gpio, events, enabled);
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback)
+{
+   Sim::Get().SetGPIOIRQCallback(callback);
+   gpio_set_irq_enabled(gpio, events, enabled);
+   irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+//--------------------------------------------------------------------+
+// IRQ
+//--------------------------------------------------------------------+
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+   Sim::Get().SetIRQHandler(num, handler);
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+   Sim::Get().SetIRQEnabled(num, enabled);
+}
+
+bool irq_is_enabled(uint num)
+{
+   return Sim::Get().IRQEnabled(num);
+}
+
+// Sim runs interrupts only from within Charge(), so nothing can land inside a
+// critical section that doesn't call back into the SDK.
+uint32_t save_and_disable_interrupts()
+{
+   return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+}
+
+void __sev()
+{
+   Sim::Get().SendEvent();
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+
+uint8_t *sim_xip_base()
+{
+   return Sim::Get().FlashImage();
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+   assert(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0);
+
+   Sim::Get().Charge(uint64_t(Sim::Get().costs.flashEraseNS) * (count / FLASH_SECTOR_SIZE));
+   Sim::Get().FlashErase(flash_offs, uint32_t(count));
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+   assert(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0);
+
+   Sim::Get().Charge(uint64_t(Sim::Get().costs.flashPageNS) * (count / FLASH_PAGE_SIZE));
+   Sim::Get().FlashProgram(flash_offs, data, uint32_t(count));
+}
+
+//--------------------------------------------------------------------+
+// ADC
+//--------------------------------------------------------------------+
+
+adc_hw_t sim_adc_hw = { ADC_CS_READY_BITS, 0, 0, 0, 0 };
+
+static uint     s_adcInput;
+static uint     s_adcRoundRobin;
+static float    s_adcClkdiv;
+static bool     s_adcRunning;
+static uint32_t s_adcChannel; // DMA channel + 1 draining the FIFO
+
+static void StartADCToRing();
+
+void adc_init()
+{
+}
+
+void adc_gpio_init(uint gpio)
+{
+}
+
+void adc_select_input(uint input)
+{
+   assert(input < 5);
+   s_adcInput = input;
+}
+
+uint16_t adc_read()
+{
+   assert(!s_adcRunning);
+   Sim::Get().Charge(Sim::Get().costs.adcReadNS);
+   return Sim::Get().Convert(s_adcInput, Sim::Get().NowNS());
+}
+
+void adc_set_clkdiv(float clkdiv)
+{
+   s_adcClkdiv = clkdiv;
+}
+
+void adc_set_round_robin(uint input_mask)
+{
+   assert(input_mask < (1u << 5));
+   s_adcRoundRobin = input_mask;
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift)
+{
+   // Only plain 12-bit samples, one DMA request each, are modelled
+   assert(en && dreq_en && dreq_thresh == 1 && !err_in_fifo && !byte_shift);
+}
+
+void adc_fifo_drain()
+{
+}
+
+void adc_run(bool run)
+{
+   if (run && !s_adcRunning && s_adcChannel)
+      StartADCToRing();
+
+   if (!run && s_adcRunning)
+   {
+      Sim::Get().SyncADC(Sim::Get().NowNS());
+      Sim::Get().StopADC();
+   }
+
+   s_adcRunning = run;
+}
+
+//--------------------------------------------------------------------+
+// PIO
+//--------------------------------------------------------------------+
+
+pio_hw_t sim_pio_hw[2];
+
+static uint32_t      s_pioUsedInstr[2];
+static uint32_t      s_pioClaimedSMs[2];
+static pio_sm_config s_pioSMConfigs[2][4];
+static uint          s_pioSMInitialPC[2][4];
+static uint32_t      s_pioEnabledSMs[2];
+static uint32_t      s_pioRXChannel[2][4]; // DMA channel + 1 reading each RX FIFO
+
+static void StartPIOToRing(uint32_t pioIndex, uint32_t sm);
+
+static uint PIOIndex(PIO pio)
+{
+   return pio == pio0 ? 0 : 1;
+}
+
+// As the SDK: full speed, wrapping the whole of instruction memory, both
+// shifts to the right with 32 bit thresholds
+pio_sm_config pio_get_default_sm_config()
+{
+   pio_sm_config c {};
+   c.clkdiv    = 1u << 16;
+   c.execctrl  = (31u << 12) | (0u << 7);
+   c.shiftctrl = (1u << 18) | (1u << 19);
+   return c;
+}
+
+void sm_config_set_wrap(pio_sm_config *c, uint wrapTarget, uint wrap)
+{
+   c->execctrl = (wrap << 12) | (wrapTarget << 7);
+}
+
+void sm_config_set_in_pins(pio_sm_config *c, uint inBase)
+{
+   c->pinctrl = (c->pinctrl & ~(0x1fu << 15)) | (inBase << 15);
+}
+
+void sm_config_set_in_shift(pio_sm_config *c, bool shiftRight, bool autopush, uint pushThreshold)
+{
+   c->shiftctrl = (c->shiftctrl & ~0x1f50000u) |
+                  (uint32_t(shiftRight) << 18) | (uint32_t(autopush) << 16) |
+                  ((pushThreshold & 0x1fu) << 20);
+}
+
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)
+{
+   c->shiftctrl = (c->shiftctrl & ~(3u << 30)) | (uint32_t(join) << 30);
+}
+
+void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t divInt, uint8_t divFrac)
+{
+   c->clkdiv = (uint32_t(divInt) << 16) | (uint32_t(divFrac) << 8);
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+   uint32_t &used   = s_pioUsedInstr[PIOIndex(pio)];
+   uint32_t  mask   = (program->length >= 32 ? ~0u : (1u << program->length) - 1);
+   uint      offset = 0;
+
+   if (program->origin >= 0)
+      offset = program->origin;
+   else
+      while (offset + program->length <= 32 && (used & (mask << offset)))
+         offset++;
+
+   // Real pio_add_program() panics when the program doesn't fit
+   assert(offset + program->length <= 32 && !(used & (mask << offset)));
+
+   used |= mask << offset;
+   return offset;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+   uint32_t &claimed = s_pioClaimedSMs[PIOIndex(pio)];
+
+   for (int sm = 0; sm < 4; sm++)
+   {
+      if (!(claimed & (1u << sm)))
+      {
+         claimed |= 1u << sm;
+         return sm;
+      }
+   }
+
+   assert(!required);
+   return -1;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initialPC, const pio_sm_config *config)
+{
+   s_pioSMConfigs[PIOIndex(pio)][sm]   = *config;
+   s_pioSMInitialPC[PIOIndex(pio)][sm] = initialPC;
+}
+
+const pio_sm_config &sim_pio_sm_config(PIO pio, uint sm, uint *initialPC)
+{
+   if (initialPC)
+      *initialPC = s_pioSMInitialPC[PIOIndex(pio)][sm];
+
+   return s_pioSMConfigs[PIOIndex(pio)][sm];
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+   uint32_t &mask = s_pioEnabledSMs[PIOIndex(pio)];
+   bool      was  = mask & (1u << sm);
+
+   mask = enabled ? mask | (1u << sm) : mask & ~(1u << sm);
+
+   if (enabled && !was && s_pioRXChannel[PIOIndex(pio)][sm])
+      StartPIOToRing(PIOIndex(pio), sm);
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm)
+{
+   return 0;
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+   Sim::Get().Charge(Sim::Get().costs.gpioReadNS);
+   return uint32_t(Sim::Get().EncoderCount(PIOIndex(pio)));
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm)
+{
+   return pio_sm_get(pio, sm);
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool isTX)
+{
+   return (PIOIndex(pio) == 0 ? DREQ_PIO0_TX0 : DREQ_PIO1_TX0) + (isTX ? 0 : 4) + sm;
+}
+
+//--------------------------------------------------------------------+
+// Clocks
+//--------------------------------------------------------------------+
+
+uint32_t clock_get_hz(enum clock_index clkIndex)
+{
+   return clkIndex == clk_usb || clkIndex == clk_adc ? 48000000 : 125000000;
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+
+dma_hw_t sim_dma_hw;
+
+static uint32_t           s_dmaClaimed;
+static dma_channel_config s_dmaConfigs[NUM_DMA_CHANNELS];
+static uint32_t          *s_dmaRings[NUM_DMA_CHANNELS];
+
+// The state machine is assumed to run a single in instruction, so there's one
+// sample per state machine clock; at 125MHz that's 8ns per unit of the divider
+static void StartPIOToRing(uint32_t pioIndex, uint32_t sm)
+{
+   uint32_t          channel  = s_pioRXChannel[pioIndex][sm] - 1;
+   uint32_t          ctrl     = s_dmaConfigs[channel].ctrl;
+   uint32_t          ringBits = (ctrl >> 6) & 0xf;
+   uint32_t         *ring     = s_dmaRings[channel];
+   dma_channel_hw_t &hw       = sim_dma_hw.ch[channel];
+   uint32_t          clkdiv   = s_pioSMConfigs[pioIndex][sm].clkdiv;
+   uint64_t          periodNS = uint64_t(clkdiv >> 16) * 8 + ((clkdiv >> 8) & 0xff) * 8 / 256;
+
+   // Only a ring on the write address is modelled
+   assert(((ctrl >> 10) & 1) && ringBits >= 2 && ((ctrl >> 2) & 3) == DMA_SIZE_32);
+   assert(periodNS > 0 && (uintptr_t(ring) & ((1u << ringBits) - 1)) == 0);
+
+   uint32_t words = (1u << ringBits) / sizeof(uint32_t);
+   auto     pos   = std::make_shared<uint32_t>(0);
+
+   Sim::Get().StartSampler(periodNS, [=, &hw](uint32_t levels)
+   {
+      ring[*pos] = levels;
+      *pos = (*pos + 1) & (words - 1);
+      hw.write_addr.value = uint32_t(uintptr_t(&ring[*pos]));
+   });
+}
+
+// A conversion takes 96 ADC clocks at 48MHz, or the divider plus one if longer
+static void StartADCToRing()
+{
+   uint32_t          channel  = s_adcChannel - 1;
+   uint32_t          ctrl     = s_dmaConfigs[channel].ctrl;
+   uint32_t          ringBits = (ctrl >> 6) & 0xf;
+   uint16_t         *ring     = reinterpret_cast<uint16_t *>(s_dmaRings[channel]);
+   dma_channel_hw_t &hw       = sim_dma_hw.ch[channel];
+   double            cycles   = std::max(96.0, 1.0 + double(s_adcClkdiv));
+   uint64_t          periodNS = uint64_t(cycles * 1000.0 / 48.0 + 0.5);
+
+   assert(((ctrl >> 10) & 1) && ringBits >= 1 && ((ctrl >> 2) & 3) == DMA_SIZE_16);
+   assert((uintptr_t(ring) & ((1u << ringBits) - 1)) == 0);
+
+   // Carries on from wherever the channel had got to
+   uint32_t samples = (1u << ringBits) / sizeof(uint16_t);
+   auto     pos     = std::make_shared<uint32_t>((hw.write_addr.value - uint32_t(uintptr_t(ring))) / sizeof(uint16_t) & (samples - 1));
+
+   Sim::Get().StartADC(periodNS, [=, &hw](uint64_t timeNS)
+   {
+      ring[*pos] = Sim::Get().Convert(s_adcInput, timeNS);
+      *pos = (*pos + 1) & (samples - 1);
+      hw.write_addr.value = uint32_t(uintptr_t(&ring[*pos]));
+
+      // Round robin moves on to the next input in the mask after each conversion
+      if (s_adcRoundRobin != 0)
+      {
+         do
+            s_adcInput = (s_adcInput + 1) % 5;
+         while (!((s_adcRoundRobin >> s_adcInput) & 1));
+      }
+   });
+}
+
+sim_dma_write_addr_reg::operator uint32_t() const
+{
+   Sim::Get().Charge(Sim::Get().costs.gpioReadNS);
+   Sim::Get().SyncSampler(Sim::Get().NowNS());
+   Sim::Get().SyncADC(Sim::Get().NowNS());
+   return value;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+   for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+   {
+      if (!(s_dmaClaimed & (1u << ch)))
+      {
+         s_dmaClaimed |= 1u << ch;
+         return ch;
+      }
+   }
+
+   assert(!required);
+   return -1;
+}
+
+// Laid out as the CTRL register: size 3:2, incr read 4, incr write 5,
+// ring size 9:6, ring sel 10, chain to 14:11, dreq 20:15
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+   dma_channel_config c {};
+   c.ctrl = (1u << 4) | (DMA_SIZE_32 << 2) | (channel << 11) | (uint32_t(DREQ_FORCE) << 15);
+   return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+   c->ctrl = (c->ctrl & ~(3u << 2)) | (uint32_t(size) << 2);
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+   c->ctrl = (c->ctrl & ~(1u << 4)) | (uint32_t(incr) << 4);
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+   c->ctrl = (c->ctrl & ~(1u << 5)) | (uint32_t(incr) << 5);
+}
+
+void channel_config_set_ring(dma_channel_config *c, bool write, uint sizeBits)
+{
+   c->ctrl = (c->ctrl & ~(0x1fu << 6)) | ((sizeBits & 0xf) << 6) | (uint32_t(write) << 10);
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+   c->ctrl = (c->ctrl & ~(0x3fu << 15)) | ((dreq & 0x3f) << 15);
+}
+
+void channel_config_set_chain_to(dma_channel_config *c, uint chainTo)
+{
+   c->ctrl = (c->ctrl & ~(0xfu << 11)) | ((chainTo & 0xf) << 11);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *writeAddr,
+                           const volatile void *readAddr, uint transferCount, bool trigger)
+{
+   uint32_t dreq = (config->ctrl >> 15) & 0x3f;
+
+   dma_channel_hw_t &hw = sim_dma_hw.ch[channel];
+   hw.read_addr        = uint32_t(uintptr_t(readAddr));
+   hw.write_addr.value = uint32_t(uintptr_t(writeAddr));
+   hw.transfer_count   = transferCount;
+
+   s_dmaConfigs[channel] = *config;
+   s_dmaRings[channel]   = static_cast<uint32_t *>(const_cast<void *>(writeAddr));
+
+   if (!trigger)
+      return;
+
+   if (dreq == DREQ_ADC)
+   {
+      s_adcChannel = channel + 1;
+
+      if (s_adcRunning)
+         StartADCToRing();
+
+      return;
+   }
+
+   // Otherwise only PIO RX FIFO to a word ring in memory is modelled
+   assert((dreq >= DREQ_PIO0_RX0 && dreq < DREQ_PIO1_TX0) || (dreq >= DREQ_PIO1_RX0 && dreq < DREQ_PIO1_RX0 + 4));
+
+   uint32_t pioIndex = dreq >= DREQ_PIO1_TX0;
+   uint32_t sm       = dreq & 3;
+
+   s_pioRXChannel[pioIndex][sm] = channel + 1;
+
+   if (s_pioEnabledSMs[pioIndex] & (1u << sm))
+      StartPIOToRing(pioIndex, sm);
+}
@@ -0,0 +1,383 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "PioEmu.h"
+
+#include <algorithm>
+
+static uint32_t Rotate(uint32_t v, uint32_t right)
+{
+   right &= 31;
+   return right ? (v >> right) | (v << (32 - right)) : v;
+}
+
+static uint32_t Mask(uint32_t bits)
+{
+   return bits >= 32 ? ~0u : (1u << bits) - 1;
+}
+
+PioEmu::PioEmu(const uint16_t *instructions, uint32_t length, uint32_t offset,
+               const pio_sm_config &config, uint32_t initialPC)
+{
+   assert(offset + length <= 32);
+
+   for (uint32_t i = 0; i < length; i++)
+   {
+      uint16_t instr = instructions[i];
+
+      // Jump targets are relative to the program, as pio_add_program() relocates them
+      if ((instr >> 13) == 0)
+         instr = uint16_t((instr & ~0x1fu) | ((instr + offset) & 0x1f));
+
+      m_program[offset + i] = instr;
+   }
+
+   uint32_t fifoJoin = config.shiftctrl >> 30;
+   uint32_t pushThr  = (config.shiftctrl >> 20) & 0x1f;
+   uint32_t pullThr  = (config.shiftctrl >> 25) & 0x1f;
+
+   m_wrapTarget    = (config.execctrl >> 7) & 0x1f;
+   m_wrap          = (config.execctrl >> 12) & 0x1f;
+   m_inBase        = (config.pinctrl >> 15) & 0x1f;
+   m_inShiftRight  = (config.shiftctrl >> 18) & 1;
+   m_outShiftRight = (config.shiftctrl >> 19) & 1;
+   m_autopush      = (config.shiftctrl >> 16) & 1;
+   m_pushThreshold = pushThr ? pushThr : 32;
+   m_pullThreshold = pullThr ? pullThr : 32;
+   m_rxDepth       = fifoJoin == PIO_FIFO_JOIN_RX ? 8 : fifoJoin == PIO_FIFO_JOIN_TX ? 0 : 4;
+   m_txDepth       = fifoJoin == PIO_FIFO_JOIN_TX ? 8 : fifoJoin == PIO_FIFO_JOIN_RX ? 0 : 4;
+   m_pc            = initialPC;
+}
+
+uint32_t PioEmu::Get()
+{
+   assert(!m_rx.empty());
+
+   uint32_t v = m_rx.front();
+   m_rx.pop_front();
+   return v;
+}
+
+void PioEmu::Put(uint32_t value)
+{
+   if (m_tx.size() < m_txDepth)
+      m_tx.push_back(value);
+}
+
+void PioEmu::Step(uint32_t pins)
+{
+   m_cycles++;
+
+   if (m_delay > 0)
+   {
+      m_delay--;
+      return;
+   }
+
+   bool     exec  = m_haveExec;
+   uint16_t instr = exec ? m_exec : m_program[m_pc];
+
+   m_haveExec = false;
+
+   if (!Execute(instr, pins, exec))
+   {
+      // Stalled; an EXEC'd instruction is retried as well
+      if (exec)
+      {
+         m_haveExec = true;
+         m_exec     = instr;
+      }
+   }
+}
+
+void PioEmu::Advance()
+{
+   m_pc = m_pc == m_wrap ? m_wrapTarget : (m_pc + 1) & 31;
+}
+
+void PioEmu::ShiftIn(uint32_t data, uint32_t bits)
+{
+   data &= Mask(bits);
+
+   if (bits == 32)
+      m_isr = data;
+   else if (m_inShiftRight)
+      m_isr = (m_isr >> bits) | (data << (32 - bits));
+   else
+      m_isr = (m_isr << bits) | data;
+
+   m_isrCount = std::min(m_isrCount + bits, 32u);
+}
+
+uint32_t PioEmu::ShiftOut(uint32_t bits)
+{
+   uint32_t data;
+
+   if (bits == 32)
+   {
+      data  = m_osr;
+      m_osr = 0;
+   }
+   else if (m_outShiftRight)
+   {
+      data  = m_osr & Mask(bits);
+      m_osr >>= bits;
+   }
+   else
+   {
+      data  = m_osr >> (32 - bits);
+      m_osr <<= bits;
+   }
+
+   m_osrCount = std::min(m_osrCount + bits, 32u);
+   return data;
+}
+
+bool PioEmu::Push(bool block)
+{
+   if (m_rx.size() >= m_rxDepth)
+   {
+      if (block)
+         return false;
+   }
+   else
+      m_rx.push_back(m_isr);
+
+   m_isr      = 0;
+   m_isrCount = 0;
+   return true;
+}
+
+bool PioEmu::Execute(uint16_t instr, uint32_t pins, bool fromExec)
+{
+   uint32_t op    = instr >> 13;
+   uint32_t delay = (instr >> 8) & 0x1f;
+   uint32_t arg1  = (instr >> 5) & 7;
+   uint32_t arg2  = instr & 0x1f;
+   bool     jumped = false;
+
+   switch (op)
+   {
+   case 0: // JMP
+   {
+      bool take = false;
+
+      switch (arg1)
+      {
+      case 0: take = true; break;
+      case 1: take = m_x == 0; break;
+      case 2: take = m_x != 0; m_x--; break;
+      case 3: take = m_y == 0; break;
+      case 4: take = m_y != 0; m_y--; break;
+      case 5: take = m_x != m_y; break;
+      case 6: assert(!"jmp pin not modelled"); break;
+      case 7: take = m_osrCount < m_pullThreshold; break;
+      }
+
+      if (take)
+      {
+         m_pc   = arg2;
+         jumped = true;
+      }
+      break;
+   }
+
+   case 1: // WAIT
+   {
+      uint32_t polarity = (instr >> 7) & 1;
+      uint32_t source   = (instr >> 5) & 3;
+      uint32_t level    = 0;
+
+      if (source == 0)
+         level = (pins >> arg2) & 1;
+      else if (source == 1)
+         level = (Rotate(pins, m_inBase) >> arg2) & 1;
+      else
+         level = (m_irq >> (arg2 & 7)) & 1;
+
+      if (level != polarity)
+         return false;
+
+      if (source == 2 && polarity)
+         m_irq &= ~(1u << (arg2 & 7));
+      break;
+   }
+
+   case 2: // IN
+   {
+      uint32_t bits = arg2 ? arg2 : 32;
+      uint32_t data = 0;
+
+      switch (arg1)
+      {
+      case 0: data = Rotate(pins, m_inBase); break;
+      case 1: data = m_x; break;
+      case 2: data = m_y; break;
+      case 3: data = 0; break;
+      case 6: data = m_isr; break;
+      case 7: data = m_osr; break;
+      default: assert(!"bad in source");
+      }
+
+      // Autopush stalls rather than shifting into a full ISR
+      if (m_autopush && m_isrCount >= m_pushThreshold && m_rx.size() >= m_rxDepth)
+         return false;
+
+      ShiftIn(data, bits);
+
+      if (m_autopush && m_isrCount >= m_pushThreshold && m_rx.size() < m_rxDepth)
+         Push(false);
+      break;
+   }
+
+   case 3: // OUT
+   {
+      uint32_t bits = arg2 ? arg2 : 32;
+      uint32_t data = ShiftOut(bits);
+
+      switch (arg1)
+      {
+      case 1: m_x = data; break;
+      case 2: m_y = data; break;
+      case 3: break;
+      case 5: m_pc = data & 31; jumped = true; break;
+      case 6: m_isr = data; m_isrCount = bits; break;
+      case 7: m_haveExec = true; m_exec = uint16_t(data); break;
+      default: assert(!"out to pins not modelled");
+      }
+      break;
+   }
+
+   case 4: // PUSH / PULL
+   {
+      bool pull   = (instr >> 7) & 1;
+      bool ifFull = (instr >> 6) & 1;
+      bool block  = (instr >> 5) & 1;
+
+      if (!pull)
+      {
+         if (ifFull && m_isrCount < m_pushThreshold)
+            break;
+         if (!Push(block))
+            return false;
+      }
+      else
+      {
+         if (ifFull && m_osrCount < m_pullThreshold)
+            break;
+
+         if (m_tx.empty())
+         {
+            if (block)
+               return false;
+            m_osr = m_x;
+         }
+         else
+         {
+            m_osr = m_tx.front();
+            m_tx.pop_front();
+         }
+
+         m_osrCount = 0;
+      }
+      break;
+   }
+
+   case 5: // MOV
+   {
+      uint32_t dest = arg1;
+      uint32_t mop  = (instr >> 3) & 3;
+      uint32_t src  = instr & 7;
+      uint32_t data = 0;
+
+      switch (src)
+      {
+      case 0: data = Rotate(pins, m_inBase); break;
+      case 1: data = m_x; break;
+      case 2: data = m_y; break;
+      case 3: data = 0; break;
+      case 5: data = 0; break; // STATUS isn't configured by anything here
+      case 6: data = m_isr; break;
+      case 7: data = m_osr; break;
+      default: assert(!"bad mov source");
+      }
+
+      if (mop == 1)
+         data = ~data;
+      else if (mop == 2)
+      {
+         uint32_t r = 0;
+         for (uint32_t b = 0; b < 32; b++)
+            r |= ((data >> b) & 1) << (31 - b);
+         data = r;
+      }
+
+      switch (dest)
+      {
+      case 1: m_x = data; break;
+      case 2: m_y = data; break;
+      case 4: m_haveExec = true; m_exec = uint16_t(data); break;
+      case 5: m_pc = data & 31; jumped = true; break;
+      case 6: m_isr = data; m_isrCount = 0; break;
+      case 7: m_osr = data; m_osrCount = 0; break;
+      default: assert(!"mov to pins not modelled");
+      }
+      break;
+   }
+
+   case 6: // IRQ
+   {
+      bool     clear = (instr >> 6) & 1;
+      uint32_t flag  = arg2 & 7;
+
+      // Waiting for the flag to clear, and relative flags, aren't modelled
+      assert(!((instr >> 5) & 1) && !(arg2 & 0x10));
+
+      if (clear)
+         m_irq &= ~(1u << flag);
+      else
+         m_irq |= 1u << flag;
+      break;
+   }
+
+   case 7: // SET
+      switch (arg1)
+      {
+      case 1: m_x = arg2; break;
+      case 2: m_y = arg2; break;
+      default: assert(!"set pins not modelled");
+      }
+      break;
+   }
+
+   // Delay on an OUT or MOV to EXEC is ignored; the executee's own applies.
+   // Executees only move the PC if they jump.
+   m_delay = m_haveExec ? 0 : delay;
+
+   if (!jumped && !fromExec)
+      Advance();
+
+   return true;
+}
@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include "hardware/pio.h"
+
+#include <cstdint>
+#include <deque>
+
+// Cycle by cycle emulation of a single PIO state machine, for checking the
+// firmware's programs against synthetic pin activity far faster than Sim's
+// event model could drive them. Instructions and config are taken as the
+// firmware hands them to the SDK, so the program's own init function is
+// exercised too.
+//
+// Covers what the programs here use: JMP, WAIT on a GPIO or pin, IN, OUT,
+// PUSH, PULL, MOV (including to PC and EXEC), IRQ set and clear, and SET,
+// with delays, wrapping, autopush and joined FIFOs. Side-set and the input
+// synchronisers are not modelled.
+class PioEmu
+{
+public:
+   PioEmu(const uint16_t *instructions, uint32_t length, uint32_t offset,
+          const pio_sm_config &config, uint32_t initialPC);
+
+   // Runs one state machine clock with the GPIOs at the given levels
+   void Step(uint32_t pins);
+
+   uint32_t RXLevel() const { return uint32_t(m_rx.size()); }
+   uint32_t Get();
+
+   void Put(uint32_t value);
+
+   // IRQ flags raised by the program; write-one-to-clear, as on the device
+   uint32_t IRQFlags() const          { return m_irq; }
+   void     ClearIRQ(uint32_t mask)   { m_irq &= ~mask; }
+
+   uint32_t X() const      { return m_x; }
+   uint32_t Y() const      { return m_y; }
+   uint32_t PC() const     { return m_pc; }
+   uint64_t Cycles() const { return m_cycles; }
+
+private:
+   // Returns false if the instruction stalled and must be retried
+   bool Execute(uint16_t instr, uint32_t pins, bool fromExec);
+   void ShiftIn(uint32_t data, uint32_t bits);
+   uint32_t ShiftOut(uint32_t bits);
+   bool Push(bool block);
+   void Advance();
+
+   uint16_t m_program[32] = {};
+
+   uint32_t m_wrapTarget    = 0;
+   uint32_t m_wrap          = 31;
+   uint32_t m_inBase        = 0;
+   bool     m_inShiftRight  = true;
+   bool     m_outShiftRight = true;
+   bool     m_autopush      = false;
+   uint32_t m_pushThreshold = 32;
+   uint32_t m_pullThreshold = 32;
+   uint32_t m_rxDepth       = 4;
+   uint32_t m_txDepth       = 4;
+
+   uint32_t m_pc       = 0;
+   uint32_t m_x        = 0;
+   uint32_t m_y        = 0;
+   uint32_t m_isr      = 0;
+   uint32_t m_isrCount = 0;
+   uint32_t m_osr      = 0;
+   uint32_t m_osrCount = 32; // Empty
+   uint32_t m_irq      = 0;
+   uint32_t m_delay    = 0;
+   uint64_t m_cycles   = 0;
+
+   bool     m_haveExec = false;
+   uint16_t m_exec     = 0;
+
+   std::deque<uint32_t> m_rx;
+   std::deque<uint32_t> m_tx;
+};
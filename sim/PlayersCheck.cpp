@@ -0,0 +1,284 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Enumerates a two player board from the simulated host and checks it comes
+// up as two gamepad interfaces, each with its own interrupt IN endpoint and a
+// report descriptor of its own. Then runs the real ArcadeCtrl::Run() loop
+// through presses by one player, the other, and both at once, and checks each
+// player's report carries only their buttons (player 2's packed from bit 0),
+// that neither sends a report for the other's changes, and that presses made
+// together reach the host in the same frame.
+//
+//   PlayersCheck [--dip N] [--rounds N]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t REPORT_ID_GAMEPAD  = 1;
+constexpr uint8_t REPORT_ID_GAMEPAD2 = 3;
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+// A button of player 1's, and player 2's joystick up (GPIO 16) and a button
+constexpr uint32_t P1_PRESS = 1u << 0;
+constexpr uint32_t P2_PRESS = (1u << 16) | (1u << 10);
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+// Report IDs declared by a report descriptor, from its short items
+static std::set<uint8_t> ReportIDs(const std::vector<uint8_t> &desc)
+{
+   std::set<uint8_t> ids;
+
+   for (size_t i = 0; i < desc.size();)
+   {
+      uint8_t prefix = desc[i];
+      size_t  size   = (prefix & 3) == 3 ? 4 : prefix & 3;
+
+      if ((prefix & 0xFC) == 0x84 && size == 1 && i + 1 < desc.size())
+         ids.insert(desc[i + 1]);
+
+      i += 1 + size;
+   }
+
+   return ids;
+}
+
+static uint32_t PackBits(uint32_t value, uint32_t mask)
+{
+   uint32_t packed = 0;
+   uint32_t out    = 0;
+
+   for (uint32_t bit = 0; bit < 32; bit++)
+      if (mask & (1u << bit))
+         packed |= ((value >> bit) & 1) << out++;
+
+   return packed;
+}
+
+struct Sent
+{
+   uint32_t buttons;
+   uint32_t frame;
+};
+
+int main(int argc, char **argv)
+{
+   uint32_t dip    = 3;
+   uint32_t rounds = 100;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--rounds") && i + 1 < argc)
+         rounds = strtol(argv[++i], nullptr, 0);
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--rounds N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   const ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+
+   if (cfg.player2Mask == 0 || (cfg.player2Mask & P2_PRESS) != P2_PRESS || (cfg.player2Mask & P1_PRESS) != 0)
+   {
+      fprintf(stderr, "dip %u isn't a two player board with the pins this expects\n", dip);
+      return 1;
+   }
+
+   // Reports as the host took them, per interface
+   std::vector<Sent> sent[2];
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      uint32_t buttons = 0;
+
+      Check(p.instance < 2, "reports on the two gamepad interfaces only");
+      Check(p.data.size() == 11, "gamepad report size");
+      Check(p.data[0] == (p.instance == 0 ? REPORT_ID_GAMEPAD : REPORT_ID_GAMEPAD2), "report ID for the interface");
+
+      if (p.instance >= 2 || p.data.size() != 11)
+         return;
+
+      memcpy(&buttons, &p.data[7], sizeof(buttons));
+      sent[p.instance].push_back(Sent { buttons, host.FrameNumber() });
+   };
+
+   // Each round: both press, both release, player 2 alone, then player 1
+   // alone. 20.3ms apart, so they drift through the polls and clear the
+   // release window.
+   struct Step
+   {
+      uint32_t press;
+      uint32_t release;
+   };
+
+   const Step steps[] =
+   {
+      { P1_PRESS | P2_PRESS, 0 }, { 0, P1_PRESS | P2_PRESS },
+      { P2_PRESS, 0 },            { 0, P2_PRESS },
+      { P1_PRESS, 0 },            { 0, P1_PRESS }
+   };
+
+   uint32_t expected[2] = {};
+   uint32_t together    = 0;
+   uint64_t t           = 200 * MS;
+
+   for (uint32_t r = 0; r < rounds; r++)
+   {
+      for (const Step &step : steps)
+      {
+         sim.At(t, [step]()
+         {
+            if (step.press)
+               Sim::Get().PressButtons(step.press);
+            if (step.release)
+               Sim::Get().ReleaseButtons(step.release);
+         });
+
+         uint32_t changed = step.press | step.release;
+
+         expected[0] += (changed & P1_PRESS) != 0;
+         expected[1] += (changed & P2_PRESS) != 0;
+         together    += (changed & P1_PRESS) && (changed & P2_PRESS);
+
+         t += 20 * MS + 300 * 1000;
+      }
+   }
+
+   sim.StopAt(t + 50 * MS);
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   // What the host enumerated
+   const USB &usb = controller.GetUSB();
+
+   Check(usb.TwoPlayers() && usb.NumHIDInterfaces() == 2, "two player mode");
+
+   const std::vector<uint8_t> &config = host.ConfigDescriptor();
+   uint32_t                    hidInterfaces = 0;
+
+   for (size_t pos = 0; pos + 1 < config.size() && config[pos] != 0; pos += config[pos])
+      if (config[pos + 1] == TUSB_DESC_INTERFACE && config[pos + 5] == TUSB_CLASS_HID)
+         hidInterfaces++;
+
+   Check(config.size() > 4 && config[4] == 2 + 2 * CFG_TUD_CDC, "config descriptor interface count");
+   Check(hidInterfaces == 2, "two HID interfaces");
+
+   const std::vector<SimHost::Endpoint> &eps = host.Endpoints();
+
+   Check(eps.size() == 2 && eps[0].instance == 0 && eps[1].instance == 1 && eps[0].address != eps[1].address,
+         "an interrupt IN endpoint per interface");
+
+   auto &descs = host.ReportDescriptors();
+
+   Check(descs.size() == 2, "a report descriptor per interface");
+
+   if (descs.size() == 2)
+   {
+      std::set<uint8_t> ids1 = ReportIDs(descs.at(0));
+      std::set<uint8_t> ids2 = ReportIDs(descs.at(1));
+
+      Check(ids1.count(REPORT_ID_GAMEPAD) && !ids1.count(REPORT_ID_GAMEPAD2), "player 1's descriptor");
+      Check(ids2.size() == 1 && ids2.count(REPORT_ID_GAMEPAD2), "player 2's descriptor is the gamepad alone");
+   }
+
+   const tusb_desc_device_t *device = (const tusb_desc_device_t *)usb.DeviceDescriptor();
+
+   Check(((device->idProduct >> 2) & 3) == 2, "product ID counts both interfaces");
+
+   // One report per change, for the player that changed, with only their buttons
+   Check(sent[0].size() == expected[0], "player 1 reports only for player 1's changes");
+   Check(sent[1].size() == expected[1], "player 2 reports only for player 2's changes");
+
+   bool onlyOwn[2] = { true, true };
+   bool toggles[2] = { true, true };
+
+   for (uint32_t p = 0; p < 2; p++)
+   {
+      uint32_t pressed = p == 0 ? P1_PRESS : PackBits(P2_PRESS, cfg.player2Mask);
+
+      for (size_t i = 0; i < sent[p].size(); i++)
+      {
+         uint32_t b = sent[p][i].buttons;
+
+         onlyOwn[p] = onlyOwn[p] && (b & ~pressed) == 0;
+         toggles[p] = toggles[p] && b == (i % 2 == 0 ? pressed : 0);
+      }
+   }
+
+   Check(onlyOwn[0] && onlyOwn[1], "each report has only its player's buttons");
+   Check(toggles[0] && toggles[1], "each report follows its player's presses");
+
+   // Changes made together: the first two of each player's four per round
+   uint32_t sameFrame = 0;
+
+   for (uint32_t r = 0; r < rounds && sent[0].size() == expected[0] && sent[1].size() == expected[1]; r++)
+      for (uint32_t k = 0; k < 2; k++)
+         sameFrame += sent[0][r * 4 + k].frame == sent[1][r * 4 + k].frame;
+
+   Check(sameFrame == together, "changes made together reach the host in the same frame");
+
+   printf("dip %u: %zu HID interfaces, endpoints 0x%02x and 0x%02x; player 1 %zu reports, player 2 %zu; "
+          "%u of %u simultaneous changes in the same frame\n", dip, descs.size(), eps.empty() ? 0 : eps[0].address,
+          eps.size() < 2 ? 0 : eps[1].address, sent[0].size(), sent[1].size(), sameFrame, together);
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
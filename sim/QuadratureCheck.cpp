@@ -0,0 +1,300 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Runs the encoder PIO programs instruction by instruction against synthetic
+// quadrature streams at rates up to several MHz, and checks the counting
+// program never loses a step. Each program is set up by its own init
+// function through the sim's SDK stand-ins and emulated with PioEmu at the
+// 125MHz system clock.
+//
+// The counting program is read as Encoder::Read() does, once per simulated
+// millisecond: drain the stale FIFO entries, then take the next push. Every
+// read must match the true count from within the last pass of the program,
+// and the final read must match exactly.
+//
+// For comparison the interrupt program is run over the same streams with an
+// interrupt handler that takes --irq-cycles to respond, and the steps it
+// drops because an irq flag was raised again before being cleared are counted.
+//
+//   QuadratureCheck [--seed N] [--ms N] [--irq-cycles N] [--rates HZ,HZ,...]
+
+#include "EncoderPio.h"
+#include "PioEmu.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint32_t SYS_CLOCK_HZ  = 125 * 1000 * 1000;
+constexpr uint32_t CYCLES_PER_MS = SYS_CLOCK_HZ / 1000;
+constexpr uint32_t PIN_A         = 16;
+
+// A transition is sampled, counted and pushed within two passes of the
+// program, so a read is never older than this
+constexpr uint32_t HISTORY = 32;
+
+// Quadrature states in pin order (bit 0 = A) going clockwise, which the
+// programs count down
+static const uint32_t s_clockwise[4] = { 0, 1, 3, 2 };
+
+// A random walk at a mean transition rate, with the interval between
+// transitions varying by up to a quarter either way
+class Stream
+{
+public:
+   Stream(uint32_t seed, double rateHz, uint64_t startCycle = 0) :
+      m_rng(seed),
+      m_meanCycles(SYS_CLOCK_HZ / rateHz),
+      m_jitter(0.75, 1.25)
+   {
+      m_next = startCycle + Interval();
+   }
+
+   // Levels for this cycle, and the net count so far (clockwise down)
+   uint32_t Pins() const  { return ~(3u << PIN_A) | (s_clockwise[m_phase] << PIN_A); }
+   int32_t  Count() const { return m_count; }
+   uint32_t Transitions() const { return m_transitions; }
+
+   void Tick(uint64_t cycle)
+   {
+      if (cycle < m_next)
+         return;
+
+      // Change direction now and then, as a spinner being rocked would
+      if (m_reverse(m_rng))
+         m_clockwise = !m_clockwise;
+
+      m_phase  = (m_phase + (m_clockwise ? 1 : 3)) & 3;
+      m_count += m_clockwise ? -1 : 1;
+      m_next   = cycle + Interval();
+      m_transitions++;
+   }
+
+private:
+   uint64_t Interval()
+   {
+      return std::max<uint64_t>(1, uint64_t(m_meanCycles * m_jitter(m_rng) + 0.5));
+   }
+
+   std::mt19937                           m_rng;
+   double                                 m_meanCycles;
+   std::uniform_real_distribution<double> m_jitter;
+   std::bernoulli_distribution            m_reverse { 0.01 };
+
+   uint64_t m_next        = 0;
+   uint32_t m_phase       = 0;
+   bool     m_clockwise   = true;
+   int32_t  m_count       = 0;
+   uint32_t m_transitions = 0;
+};
+
+static PioEmu LoadProgram(PIO pio, const pio_program *program, const uint16_t *instructions,
+                          void (*init)(PIO, uint, uint, uint))
+{
+   uint offset = pio_add_program(pio, program);
+   uint sm     = pio_claim_unused_sm(pio, true);
+
+   init(pio, sm, offset, PIN_A);
+
+   uint                 pc;
+   const pio_sm_config &cfg = sim_pio_sm_config(pio, sm, &pc);
+
+   return PioEmu(instructions, program->length, offset, cfg, pc);
+}
+
+static void CountInit(PIO pio, uint sm, uint offset, uint pinA)
+{
+   EncoderCountProgramInit(pio, sm, offset, pinA);
+}
+
+static void IRQInit(PIO pio, uint sm, uint offset, uint pinA)
+{
+   EncoderProgramInit(pio, sm, offset, pinA);
+}
+
+static bool CheckCounting(const PioEmu &loaded, uint32_t seed, double rateHz, uint32_t ms)
+{
+   PioEmu   emu = loaded;
+   Stream   stream(seed, rateHz, HISTORY);
+   int32_t  history[HISTORY];
+   uint64_t cycle  = 0;
+   uint32_t reads  = 0;
+   uint32_t misses = 0;
+
+   auto tick = [&]()
+   {
+      stream.Tick(cycle);
+      history[cycle % HISTORY] = stream.Count();
+      emu.Step(stream.Pins());
+      cycle++;
+   };
+
+   // As Encoder::Read(), with the stream carrying on while it waits
+   auto read = [&]()
+   {
+      for (uint32_t stale = emu.RXLevel(); stale > 0; stale--)
+         emu.Get();
+
+      while (emu.RXLevel() == 0)
+         tick();
+
+      return int32_t(emu.Get());
+   };
+
+   // Let it start before anything moves, then zero against the first read
+   for (uint32_t i = 0; i < HISTORY; i++)
+      tick();
+
+   int32_t zero = read() - stream.Count();
+   assert(stream.Transitions() == 0);
+
+   for (uint32_t m = 0; m < ms; m++)
+   {
+      while (cycle < uint64_t(m + 1) * CYCLES_PER_MS)
+         tick();
+
+      int32_t got   = read() - zero;
+      bool    found = false;
+
+      for (uint32_t i = 0; i < HISTORY && !found; i++)
+         found = history[i] == got;
+
+      reads++;
+      misses += !found;
+   }
+
+   // Stop moving and let the last transition through
+   for (uint32_t i = 0; i < HISTORY; i++)
+      emu.Step(stream.Pins());
+
+   for (uint32_t stale = emu.RXLevel(); stale > 0; stale--)
+      emu.Get();
+
+   while (emu.RXLevel() == 0)
+      emu.Step(stream.Pins());
+
+   int32_t final = int32_t(emu.Get()) - zero;
+   bool    pass  = misses == 0 && final == stream.Count();
+
+   printf("  counting   %9.0f Hz: %8u transitions, %5u reads, %u off, final %d of %d  %s\n",
+          rateHz, stream.Transitions(), reads, misses, final, stream.Count(), pass ? "ok" : "FAIL");
+
+   return pass;
+}
+
+static void CompareIRQ(const PioEmu &loaded, uint32_t seed, double rateHz, uint32_t ms, uint32_t irqCycles)
+{
+   PioEmu   emu = loaded;
+   Stream   stream(seed, rateHz);
+   int32_t  count      = 0;
+   uint32_t interrupts = 0;
+   uint64_t serviceAt  = 0;
+   bool     pending    = false;
+
+   for (uint64_t cycle = 0; cycle < uint64_t(ms) * CYCLES_PER_MS; cycle++)
+   {
+      stream.Tick(cycle);
+      emu.Step(stream.Pins());
+
+      if (!pending && emu.IRQFlags() & 3)
+      {
+         pending   = true;
+         serviceAt = cycle + irqCycles;
+      }
+
+      // As Encoder::IRQHandler0()
+      if (pending && cycle >= serviceAt)
+      {
+         uint32_t flags = emu.IRQFlags();
+
+         if (flags & 1)
+            count--;
+         if (flags & 2)
+            count++;
+
+         emu.ClearIRQ(3);
+         pending = false;
+         interrupts++;
+      }
+   }
+
+   uint32_t lost = uint32_t(std::abs(stream.Count() - count));
+
+   printf("  interrupts %9.0f Hz: %8u transitions, %8.0f interrupts/s, counted %d of %d (%u lost)\n",
+          rateHz, stream.Transitions(), interrupts * 1000.0 / ms, count, stream.Count(), lost);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t            seed      = 1;
+   uint32_t            ms        = 50;
+   uint32_t            irqCycles = 125;
+   std::vector<double> rates     = { 1e3, 1e4, 1e5, 1e6, 2e6, 4e6, 8e6 };
+
+   for (int i = 1; i < argc; i++)
+   {
+      auto next = [&]() { return i + 1 < argc ? argv[++i] : "0"; };
+
+      if (!strcmp(argv[i], "--seed"))
+         seed = strtoul(next(), nullptr, 0);
+      else if (!strcmp(argv[i], "--ms"))
+         ms = strtoul(next(), nullptr, 0);
+      else if (!strcmp(argv[i], "--irq-cycles"))
+         irqCycles = strtoul(next(), nullptr, 0);
+      else if (!strcmp(argv[i], "--rates"))
+      {
+         rates.clear();
+         for (char *p = const_cast<char *>(next()); *p; )
+         {
+            rates.push_back(strtod(p, &p));
+            if (*p == ',')
+               p++;
+            else
+               break;
+         }
+      }
+      else
+      {
+         fprintf(stderr, "usage: %s [--seed N] [--ms N] [--irq-cycles N] [--rates HZ,HZ,...]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   PioEmu counting = LoadProgram(pio0, &QuadEncoderCount_program, QuadEncoderCount_program_instructions, CountInit);
+   PioEmu irq      = LoadProgram(pio1, &QuadEncoder_program, QuadEncoder_program_instructions, IRQInit);
+
+   bool pass = true;
+
+   for (double rate : rates)
+   {
+      pass = CheckCounting(counting, seed, rate, ms) && pass;
+      CompareIRQ(irq, seed, rate, ms, irqCycles);
+   }
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,417 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Button remapping. First ButtonRemap on its own against a per-GPIO model of
+// the table: every one of the 2^17 states of the button inputs through the
+// built-in hotkey remap, one with no entries, and random tables with clashes,
+// dropped GPIOs and entries out of range, then random states of all 32 bits.
+// Then times Apply() against the per-GPIO loop it replaces. Last, the real
+// ArcadeCtrl::Run() loop with the hotkey remap: the host must see start and
+// button 1 as themselves, coin and service while shift is held, and never
+// the shift button.
+//
+//   RemapCheck [--seed N] [--tables N] [--bench-states N]
+
+#include "ArcadeCtrl.h"
+#include "ButtonRemap.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t  REPORT_ID_GAMEPAD = 1;
+constexpr uint32_t DIP               = 2;
+constexpr uint32_t DIP_SHIFT         = 21;
+
+constexpr uint32_t INPUT_MASK = ((1 << 16) - 1) | (1 << 20);
+constexpr uint32_t NUM_INPUTS = 17;
+
+// The hotkey remap's buttons
+constexpr uint32_t SHIFT   = 1u << 10;
+constexpr uint32_t START   = 1u << 20;
+constexpr uint32_t BUTTON1 = 1u << 4;
+constexpr uint32_t COIN    = 1u << 24;
+constexpr uint32_t SERVICE = 1u << 25;
+
+// Built at compile time, so the lookups are too
+constexpr RemapTable s_swapTable =
+{
+   RemapTable::NO_BUTTON,
+   3,
+   {
+      { 0, 1 },
+      { 1, 0 },
+      { 2, RemapTable::NO_BUTTON }
+   },
+   0, {}
+};
+
+constexpr ButtonRemap s_swap(s_swapTable);
+
+static_assert(s_swap.Apply(0x1) == 0x2 && s_swap.Apply(0x2) == 0x1 && s_swap.Apply(0x4) == 0 &&
+              s_swap.Apply(0x8) == 0x8, "remap tables build at compile time");
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+static bool ValidEntry(const RemapTable::Entry &e)
+{
+   return e.gpio < 32 && (e.button < 32 || e.button == RemapTable::NO_BUTTON);
+}
+
+// GPIO by GPIO, straight from the table
+static uint32_t Model(const RemapTable &table, uint32_t gpios)
+{
+   bool     shifted = table.shift < 32 && ((gpios >> table.shift) & 1);
+   uint32_t buttons = 0;
+
+   for (uint32_t gpio = 0; gpio < 32; gpio++)
+   {
+      if (!((gpios >> gpio) & 1) || gpio == table.shift)
+         continue;
+
+      uint32_t button = gpio;
+
+      for (uint32_t i = 0; i < table.numEntries && i < RemapTable::MAX_ENTRIES; i++)
+         if (table.entries[i].gpio == gpio && ValidEntry(table.entries[i]))
+            button = table.entries[i].button;
+
+      for (uint32_t i = 0; shifted && i < table.numShifted && i < RemapTable::MAX_ENTRIES; i++)
+         if (table.shifted[i].gpio == gpio && ValidEntry(table.shifted[i]))
+            button = table.shifted[i].button;
+
+      if (button < 32)
+         buttons |= 1u << button;
+   }
+
+   return buttons;
+}
+
+// The nth state of the button inputs, spread over their GPIOs
+static uint32_t InputState(uint32_t n)
+{
+   uint32_t gpios = 0;
+   uint32_t bit   = 0;
+
+   for (uint32_t gpio = 0; gpio < 32; gpio++)
+      if (INPUT_MASK & (1u << gpio))
+         gpios |= ((n >> bit++) & 1) << gpio;
+
+   return gpios;
+}
+
+static void CheckTable(const RemapTable &table, const char *name, std::mt19937 &rng, uint32_t *states)
+{
+   ButtonRemap remap(table);
+   uint32_t    wrong   = 0;
+   uint32_t    outputs = 0;
+
+   for (uint32_t n = 0; n < 1u << NUM_INPUTS; n++)
+   {
+      uint32_t gpios = InputState(n);
+      uint32_t got   = remap.Apply(gpios);
+
+      wrong   += got != Model(table, gpios);
+      outputs |= got;
+   }
+
+   for (uint32_t i = 0; i < 100000; i++)
+   {
+      uint32_t gpios = rng();
+
+      wrong += remap.Apply(gpios) != Model(table, gpios);
+   }
+
+   *states += (1u << NUM_INPUTS) + 100000;
+
+   if (wrong != 0)
+   {
+      fprintf(stderr, "FAILED: %s: %u states remapped wrongly\n", name, wrong);
+      s_failures++;
+   }
+
+   if (remap.Outputs(INPUT_MASK) != outputs)
+   {
+      fprintf(stderr, "FAILED: %s: outputs 0x%08x, the inputs set 0x%08x\n", name, remap.Outputs(INPUT_MASK), outputs);
+      s_failures++;
+   }
+}
+
+static RemapTable RandomTable(std::mt19937 &rng)
+{
+   RemapTable table = {};
+
+   // Mostly real GPIOs and buttons, some dropped, some out of range
+   auto entry = [&rng]()
+   {
+      uint32_t r      = rng() % 40;
+      uint8_t  button = r < 32 ? uint8_t(r) : r < 36 ? RemapTable::NO_BUTTON : uint8_t(32 + r);
+
+      return RemapTable::Entry { uint8_t(rng() % 34), button };
+   };
+
+   table.shift      = rng() % 4 == 0 ? RemapTable::NO_BUTTON : uint8_t(rng() % 32);
+   table.numEntries = rng() % (RemapTable::MAX_ENTRIES + 1);
+   table.numShifted = rng() % (RemapTable::MAX_ENTRIES + 1);
+
+   for (RemapTable::Entry &e : table.entries)
+      e = entry();
+   for (RemapTable::Entry &e : table.shifted)
+      e = entry();
+
+   // Including the shift button, and the same GPIO twice
+   table.entries[0].gpio = table.shift;
+   table.shifted[1].gpio = table.shifted[0].gpio;
+
+   return table;
+}
+
+template <typename Fn>
+static double TimeNS(uint32_t count, Fn fn)
+{
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   auto end = std::chrono::steady_clock::now();
+
+   return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+// Needs a table with a shift button
+static void Bench(const RemapTable &table, uint32_t count, std::mt19937 &rng)
+{
+   std::vector<uint32_t> states(4096);
+
+   for (uint32_t &s : states)
+      s = InputState(rng());
+
+   ButtonRemap       remap(table);
+   volatile uint32_t sink = 0;
+
+   // The loop a remap would otherwise be: each layer resolved to a button per
+   // GPIO. The shift button sets nothing, so it doesn't get in the way.
+   uint8_t to[2][32];
+
+   for (uint32_t layer = 0; layer < 2; layer++)
+      for (uint32_t gpio = 0; gpio < 32; gpio++)
+      {
+         uint32_t buttons = Model(table, (1u << gpio) | (layer << table.shift));
+
+         to[layer][gpio] = buttons != 0 ? uint8_t(__builtin_ctz(buttons)) : RemapTable::NO_BUTTON;
+      }
+
+   double lut = TimeNS(count, [&]()
+   {
+      uint32_t acc = 0;
+      for (uint32_t i = 0; i < count; i++)
+         acc ^= remap.Apply(states[i & 4095] ^ i);
+      sink = acc;
+   });
+
+   double loop = TimeNS(count, [&]()
+   {
+      uint32_t acc = 0;
+      for (uint32_t i = 0; i < count; i++)
+      {
+         uint32_t gpios   = states[i & 4095] ^ i;
+         uint32_t layer   = (gpios >> table.shift) & 1;
+         uint32_t buttons = 0;
+
+         for (uint32_t left = gpios; left != 0; left &= left - 1)
+         {
+            uint8_t button = to[layer][__builtin_ctz(left)];
+
+            if (button < 32)
+               buttons |= 1u << button;
+         }
+         acc ^= buttons;
+      }
+      sink = acc;
+   });
+
+   printf("per state: nibble lookups %.1f ns, per-GPIO loop %.1f ns\n", lut, loop);
+}
+
+// The host's view of the hotkey remap through Run()
+static void CheckFirmware()
+{
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(DIP << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[DIP];
+   cfg.remap = &ArcadeCtrl::s_hotkeyRemap;
+
+   // Pressed, in order, then released in reverse, with what the host should
+   // have after each step
+   struct Step
+   {
+      uint32_t press;
+      uint32_t release;
+      uint32_t expect;
+   };
+
+   static const Step s_steps[] =
+   {
+      { START,   0,       START },
+      { 0,       START,   0 },
+      { BUTTON1, 0,       BUTTON1 },
+      { 0,       BUTTON1, 0 },
+      { SHIFT,   0,       0 },
+      { START,   0,       COIN },
+      { BUTTON1, 0,       COIN | SERVICE },
+      { 0,       START,   SERVICE },
+      { 0,       SHIFT,   BUTTON1 },
+      { 0,       BUTTON1, 0 },
+      { 1u << 0, 0,       1u << 0 },      // Unlisted, the same in both layers
+      { SHIFT,   0,       1u << 0 },
+      { 0,       SHIFT | (1u << 0), 0 }
+   };
+
+   constexpr uint32_t NUM_STEPS = sizeof(s_steps) / sizeof(s_steps[0]);
+
+   uint64_t t = 200 * MS;
+
+   for (const Step &s : s_steps)
+   {
+      t += 30 * MS;
+
+      uint32_t press = s.press, release = s.release;
+
+      sim.At(t, [press, release]()
+      {
+         if (press)
+            Sim::Get().PressButtons(press);
+         if (release)
+            Sim::Get().ReleaseButtons(release);
+      });
+   }
+
+   sim.StopAt(t + 50 * MS);
+
+   std::vector<uint32_t> seen;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      uint32_t buttons = 0;
+
+      if (p.data.size() < 11 || p.data[0] != REPORT_ID_GAMEPAD)
+         return;
+
+      memcpy(&buttons, &p.data[7], sizeof(buttons));
+      seen.push_back(buttons);
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   // A report per step that changes what the host has, in order
+   uint32_t next = 0;
+   uint32_t last = 0;
+
+   for (const Step &s : s_steps)
+   {
+      if (s.expect == last)
+         continue;
+
+      Check(next < seen.size() && seen[next] == s.expect, "host sees the remapped buttons, step by step");
+      next++;
+      last = s.expect;
+   }
+
+   Check(next == seen.size(), "no reports beyond the steps'");
+
+   for (uint32_t buttons : seen)
+      Check((buttons & SHIFT) == 0, "shift button never sent");
+
+   printf("hotkey remap through Run(): %u steps, %u reports, expected %u\n", NUM_STEPS, uint32_t(seen.size()), next);
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t seed        = 1;
+   uint32_t tables      = 20;
+   uint32_t benchStates = 10 * 1000 * 1000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+         seed = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--tables") && i + 1 < argc)
+         tables = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--bench-states") && i + 1 < argc)
+         benchStates = strtol(argv[++i], nullptr, 0);
+      else
+      {
+         fprintf(stderr, "usage: %s [--seed N] [--tables N] [--bench-states N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+   uint32_t     states = 0;
+   RemapTable   none   = { RemapTable::NO_BUTTON, 0, {}, 0, {} };
+
+   CheckTable(ArcadeCtrl::s_hotkeyRemap, "hotkey remap", rng, &states);
+   CheckTable(none, "no entries", rng, &states);
+   CheckTable(s_swapTable, "swap", rng, &states);
+
+   for (uint32_t i = 0; i < tables; i++)
+   {
+      char name[32];
+      snprintf(name, sizeof(name), "random table %u", i);
+      CheckTable(RandomTable(rng), name, rng, &states);
+   }
+
+   printf("%u tables, %u states checked\n", tables + 3, states);
+
+   Bench(ArcadeCtrl::s_hotkeyRemap, benchStates, rng);
+   CheckFirmware();
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Hammers SPSCRing with a real producer and consumer thread. The producer
+// pushes InputData snapshots whose every field is derived from a sequence
+// number; the consumer checks that sequence numbers arrive in order and that
+// no snapshot is ever seen half written. With --drop the producer behaves
+// like core1 and drops a snapshot when the ring is full instead of retrying.
+//
+//   RingStress [--items N] [--drop]
+
+#include "InputData.h"
+#include "SPSCRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+struct Snapshot
+{
+   InputData inputs;
+   uint32_t  seq;
+};
+
+static Snapshot MakeSnapshot(uint32_t seq)
+{
+   Snapshot s {};
+   s.seq            = seq;
+   s.inputs.buttons = seq * 2654435761u;
+   for (uint32_t i = 0; i < 3; i++)
+   {
+      s.inputs.analog[i] = uint16_t(seq + i);
+      s.inputs.axis[i]   = int16_t(seq - i);
+   }
+   for (uint32_t i = 0; i < 2; i++)
+   {
+      s.inputs.angle[i]      = int32_t(seq) * (i + 1);
+      s.inputs.angleDelta[i] = -int32_t(seq) * (i + 1);
+   }
+   return s;
+}
+
+static bool Matches(const Snapshot &s)
+{
+   Snapshot expected = MakeSnapshot(s.seq);
+   return memcmp(&expected.inputs, &s.inputs, sizeof(InputData)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t items = 5 * 1000 * 1000;
+   bool     drop  = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--items") && i + 1 < argc)
+         items = strtoul(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--drop"))
+         drop = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--items N] [--drop]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   static SPSCRing<Snapshot, 8> ring;
+
+   uint64_t fullCount  = 0;
+   uint64_t emptyCount = 0;
+   uint64_t received   = 0;
+   uint64_t torn       = 0;
+   uint64_t outOfOrder = 0;
+
+   std::atomic<bool> producerDone { false };
+
+   auto start = std::chrono::steady_clock::now();
+
+   std::thread producer([&]()
+   {
+      for (uint32_t seq = 1; seq <= items; seq++)
+      {
+         Snapshot s = MakeSnapshot(seq);
+
+         while (!ring.Push(s))
+         {
+            fullCount++;
+            if (drop)
+               break;
+            std::this_thread::yield();
+         }
+      }
+
+      producerDone.store(true, std::memory_order_release);
+   });
+
+   std::thread consumer([&]()
+   {
+      uint32_t lastSeq = 0;
+      Snapshot s;
+
+      while (true)
+      {
+         if (!ring.Pop(&s))
+         {
+            // Done once the producer has finished and everything is drained
+            if (producerDone.load(std::memory_order_acquire) && ring.Size() == 0)
+               break;
+            emptyCount++;
+            std::this_thread::yield();
+            continue;
+         }
+
+         received++;
+
+         if (!Matches(s))
+            torn++;
+         if (s.seq <= lastSeq || (!drop && s.seq != lastSeq + 1))
+            outOfOrder++;
+
+         lastSeq = s.seq;
+      }
+   });
+
+   producer.join();
+   consumer.join();
+
+   double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   printf("%u pushed, %llu received in %.2fs (%.1f M/s), ring full %llu times, empty %llu times\n",
+          items, (unsigned long long)received, secs, received / secs / 1e6,
+          (unsigned long long)fullCount, (unsigned long long)emptyCount);
+   printf("%llu torn snapshots, %llu out of order\n",
+          (unsigned long long)torn, (unsigned long long)outOfOrder);
+
+   bool lost = !drop && received != items;
+
+   return torn == 0 && outOfOrder == 0 && !lost ? 0 : 1;
+}
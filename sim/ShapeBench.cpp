@@ -0,0 +1,158 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// The per-poll change check for every board shape, 0-3 analogs by 0-2
+// encoders. Each shape's USB::DirtyReports() is checked against a model over
+// random changes, then timed, on mostly idle polls as a board sees them.
+//
+//   ShapeBench [--seed N] [--polls N]
+
+#include "InputData.h"
+#include "USB.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr uint8_t REPORT_ID_GAMEPAD  = 1;
+constexpr uint8_t REPORT_ID_MOUSE    = 2;
+constexpr uint8_t REPORT_ID_GAMEPAD2 = 3;
+
+constexpr uint32_t PLAYER2_MASK = 0x000FFC00;
+
+// The reports each change should make dirty, straight from what's in them
+static uint32_t Model(uint32_t numAnalogs, uint32_t numEncoders, uint32_t player2Mask, const InputData &cur,
+                      const InputData &prev)
+{
+   uint32_t changed = cur.buttons ^ prev.buttons;
+   uint32_t dirty   = 0;
+
+   for (uint32_t i = 0; i < numAnalogs; i++)
+      if (cur.axis[i] != prev.axis[i])
+         dirty |= 1u << REPORT_ID_GAMEPAD;
+
+   if (changed & ~player2Mask)
+      dirty |= 1u << REPORT_ID_GAMEPAD;
+
+   if (changed & player2Mask)
+      dirty |= 1u << REPORT_ID_GAMEPAD2;
+
+   for (uint32_t i = 0; i < numEncoders; i++)
+      if (cur.angle[i] != prev.angle[i])
+         dirty |= 1u << REPORT_ID_MOUSE;
+
+   return dirty;
+}
+
+template <typename Fn>
+static double TimeNS(uint32_t count, Fn fn)
+{
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   auto end = std::chrono::steady_clock::now();
+
+   return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t seed  = 1;
+   uint32_t polls = 20 * 1000 * 1000;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+         seed = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--polls") && i + 1 < argc)
+         polls = strtol(argv[++i], nullptr, 0);
+      else
+      {
+         fprintf(stderr, "usage: %s [--seed N] [--polls N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::mt19937 rng(seed);
+   uint32_t     wrong = 0;
+
+   // Each poll against the one before; one in eight changes something
+   std::vector<InputData> inputs(4096);
+
+   for (uint32_t i = 0; i < inputs.size(); i++)
+   {
+      InputData &in = inputs[i];
+
+      in = i > 0 ? inputs[i - 1] : InputData {};
+
+      if (rng() % 8 != 0)
+         continue;
+
+      switch (rng() % 4)
+      {
+      case 0:  in.buttons ^= 1u << (rng() % 21); break;
+      case 1:  in.axis[rng() % 3]++;             break;
+      default: in.angle[rng() % 2]++;            break;
+      }
+   }
+
+   printf("DirtyReports() per poll:\n");
+
+   for (uint32_t numAnalogs = 0; numAnalogs <= 3; numAnalogs++)
+   {
+      for (uint32_t numEncoders = 0; numEncoders <= 2; numEncoders++)
+      {
+         uint32_t player2Mask = numEncoders == 0 ? PLAYER2_MASK : 0;
+         USB      usb(0, numAnalogs, numEncoders, 5, true, player2Mask);
+
+         for (uint32_t i = 1; i < inputs.size(); i++)
+            wrong += usb.DirtyReports(inputs[i], inputs[i - 1]) !=
+                     Model(numAnalogs, numEncoders, player2Mask, inputs[i], inputs[i - 1]);
+
+         volatile uint32_t sink = 0;
+
+         double ns = TimeNS(polls, [&]()
+         {
+            uint32_t acc = 0;
+            for (uint32_t i = 0; i < polls; i++)
+            {
+               uint32_t n = i & 4095;
+               acc ^= usb.DirtyReports(inputs[n], inputs[(n - 1) & 4095]);
+            }
+            sink = acc;
+         });
+
+         printf("  %u analogs, %u encoders: %.2f ns\n", numAnalogs, numEncoders, ns);
+      }
+   }
+
+   if (wrong != 0)
+      fprintf(stderr, "FAILED: %u polls with the wrong reports dirty\n", wrong);
+
+   printf("%s\n", wrong == 0 ? "PASS" : "FAIL");
+   return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "Sim.h"
+
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#include <algorithm>
+
+Sim &Sim::Get()
+{
+   static Sim s_sim;
+   return s_sim;
+}
+
+void Sim::Charge(uint64_t ns)
+{
+   m_coreNowNS[m_core] += ns;
+
+   if (m_core1Running && !m_inEvent &&
+       m_coreNowNS[m_core] > m_coreNowNS[m_core ^ 1] + CORE_QUANTUM_NS)
+      SwitchCore();
+
+   RunDue();
+}
+
+uint64_t Sim::GlobalNS() const
+{
+   return m_core1Running ? std::min(m_coreNowNS[0], m_coreNowNS[1]) : m_coreNowNS[0];
+}
+
+void Sim::SwitchCore()
+{
+   uint32_t from = m_core;
+   m_core ^= 1;
+   swapcontext(&m_coreContext[from], &m_coreContext[m_core]);
+}
+
+void Sim::LaunchCore1(void (*entry)())
+{
+   assert(!m_core1Running && m_core == 0);
+
+   m_core1Stack.resize(1024 * 1024);
+
+   getcontext(&m_coreContext[1]);
+   m_coreContext[1].uc_stack.ss_sp   = m_core1Stack.data();
+   m_coreContext[1].uc_stack.ss_size = m_core1Stack.size();
+   m_coreContext[1].uc_link          = nullptr;
+   makecontext(&m_coreContext[1], &Core1Trampoline, 0);
+
+   m_core1Entry    = entry;
+   m_coreNowNS[1]  = m_coreNowNS[0];
+   m_core1Running  = true;
+}
+
+void Sim::Core1Trampoline()
+{
+   Sim &sim = Get();
+
+   sim.m_core1Entry();
+
+   // Core1 returned; core0 carries on alone
+   sim.m_core1Running = false;
+   sim.m_core = 0;
+   setcontext(&sim.m_coreContext[0]);
+}
+
+void Sim::At(uint64_t timeNS, std::function<void()> fn)
+{
+   m_events.push(Event { timeNS, m_eventSeq++, std::move(fn) });
+}
+
+void Sim::StopAt(uint64_t timeNS)
+{
+   At(timeNS, [this]() { m_stopping = true; Interrupt(); });
+}
+
+void Sim::WaitForEvent(uint64_t untilNS)
+{
+   uint32_t core = m_core;
+
+   while (!m_eventRegister[core] && !m_stopping && NowNS() < untilNS)
+   {
+      uint64_t nextNS = untilNS;
+
+      if (!m_events.empty())
+         nextNS = std::min(nextNS, m_events.top().timeNS);
+
+      // An SEV from the other core isn't an event, so look for one each quantum
+      if (m_core1Running)
+         nextNS = std::min(nextNS, NowNS() + CORE_QUANTUM_NS);
+
+      Charge(nextNS > NowNS() ? nextNS - NowNS() : WAIT_STEP_NS);
+   }
+
+   m_eventRegister[core] = false;
+}
+
+void Sim::RunDue()
+{
+   // Events can call back into stubs that charge time; don't nest
+   if (m_inEvent)
+      return;
+
+   m_inEvent = true;
+
+   while (!m_events.empty() && m_events.top().timeNS <= GlobalNS())
+   {
+      std::function<void()> fn = m_events.top().fn;
+      m_eventNS = m_events.top().timeNS;
+      m_events.pop();
+      fn();
+   }
+
+   m_inEvent = false;
+}
+
+void Sim::SetGPIOLevels(uint32_t mask, bool high)
+{
+   uint32_t prev = m_gpioLevels;
+
+   // Samples up to the change see the old levels
+   SyncSampler(m_inEvent ? m_eventNS : NowNS());
+
+   if (high)
+      m_gpioLevels |= mask;
+   else
+      m_gpioLevels &= ~mask;
+
+   uint32_t fell = prev & ~m_gpioLevels & m_gpioFallIRQ;
+   uint32_t rose = ~prev & m_gpioLevels & m_gpioRiseIRQ;
+
+   if (!(fell | rose) || !IRQEnabled(IO_IRQ_BANK0) || m_gpioIRQCallback == nullptr)
+      return;
+
+   Interrupt();
+
+   for (uint32_t gpio = 0; gpio < 32; gpio++)
+   {
+      uint32_t events = (((fell >> gpio) & 1) ? GPIO_IRQ_EDGE_FALL : 0) |
+                        (((rose >> gpio) & 1) ? GPIO_IRQ_EDGE_RISE : 0);
+      if (events)
+         m_gpioIRQCallback(gpio, events);
+   }
+}
+
+void Sim::SetGPIOIRQEnabled(uint32_t gpio, uint32_t events, bool enabled)
+{
+   uint32_t bit = 1u << gpio;
+
+   if (events & GPIO_IRQ_EDGE_FALL)
+      m_gpioFallIRQ = enabled ? m_gpioFallIRQ | bit : m_gpioFallIRQ & ~bit;
+   if (events & GPIO_IRQ_EDGE_RISE)
+      m_gpioRiseIRQ = enabled ? m_gpioRiseIRQ | bit : m_gpioRiseIRQ & ~bit;
+}
+
+void Sim::SetOutputLevels(uint32_t mask, bool high)
+{
+   if (high)
+      m_outputLevels |= mask;
+   else
+      m_outputLevels &= ~mask;
+}
+
+void Sim::EncoderStep(uint32_t pioIndex, bool clockwise)
+{
+   pio_hw_t &pio = sim_pio_hw[pioIndex];
+   uint32_t  flag = clockwise ? 1 : 2;
+
+   pio.irq.value |= flag;
+   m_encoderCount[pioIndex] += clockwise ? -1 : 1;
+
+   // The encoder program runs on the first claimed state machine; its irq
+   // flags route to PIOx_IRQ_0 through INTE0 bits 8-11.
+   if (pio.inte0 & (flag << 8))
+      RaiseIRQ(pioIndex == 0 ? PIO0_IRQ_0 : PIO1_IRQ_0);
+}
+
+void Sim::StartSampler(uint64_t periodNS, std::function<void(uint32_t)> push)
+{
+   m_samplerPeriodNS = periodNS;
+   m_samplerNextNS   = NowNS() + periodNS;
+   m_samplerPush     = std::move(push);
+}
+
+void Sim::SyncSampler(uint64_t timeNS)
+{
+   if (!m_samplerPush)
+      return;
+
+   for (; m_samplerNextNS <= timeNS; m_samplerNextNS += m_samplerPeriodNS)
+      m_samplerPush(m_gpioLevels);
+}
+
+void Sim::SetADC(uint32_t channel, uint16_t value)
+{
+   // Conversions up to the change see the old value
+   SyncADC(m_inEvent ? m_eventNS : NowNS());
+   m_adc[channel] = value;
+}
+
+uint16_t Sim::Convert(uint32_t channel, uint64_t timeNS) const
+{
+   return (m_adcSource ? m_adcSource(channel, timeNS) : m_adc[channel]) & 0xFFF;
+}
+
+void Sim::StartADC(uint64_t periodNS, std::function<void(uint64_t)> push)
+{
+   m_adcPeriodNS = periodNS;
+   m_adcNextNS   = NowNS() + periodNS;
+   m_adcPush     = std::move(push);
+}
+
+void Sim::SyncADC(uint64_t timeNS)
+{
+   if (!m_adcPush)
+      return;
+
+   for (; m_adcNextNS <= timeNS; m_adcNextNS += m_adcPeriodNS)
+      m_adcPush(m_adcNextNS);
+}
+
+void Sim::SetIRQEnabled(uint32_t num, bool enabled)
+{
+   if (enabled)
+      m_irqEnabled |= 1u << num;
+   else
+      m_irqEnabled &= ~(1u << num);
+}
+
+void Sim::RaiseIRQ(uint32_t num)
+{
+   if (!IRQEnabled(num) || m_irqHandlers[num] == nullptr)
+      return;
+
+   Interrupt();
+   m_irqHandlers[num]();
+}
+
+void Sim::FlashErase(uint32_t offset, uint32_t count)
+{
+   assert(offset % FLASH_SECTOR == 0 && count % FLASH_SECTOR == 0 && offset + count <= FLASH_BYTES);
+
+   for (uint32_t sector = offset; sector < offset + count; sector += FLASH_SECTOR)
+      m_flashErases[sector / FLASH_SECTOR]++;
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      if (m_flashCutArmed && m_flashBytesToCut-- == 0)
+      {
+         m_flashCutArmed = false;
+         throw PowerCut();
+      }
+
+      m_flash[offset + i] = 0xFF;
+   }
+}
+
+void Sim::FlashProgram(uint32_t offset, const uint8_t *data, uint32_t count)
+{
+   assert(offset + count <= FLASH_BYTES);
+
+   for (uint32_t i = 0; i < count; i++)
+   {
+      if (m_flashCutArmed && m_flashBytesToCut-- == 0)
+      {
+         m_flashCutArmed = false;
+         throw PowerCut();
+      }
+
+      m_flash[offset + i] &= data[i];
+   }
+}
+
+void Sim::ResetFlash()
+{
+   std::fill(m_flash.begin(), m_flash.end(), 0xFF);
+   std::fill(m_flashErases.begin(), m_flashErases.end(), 0);
+   m_flashCutArmed = false;
+}
@@ -0,0 +1,227 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include <ucontext.h>
+
+// Discrete-event model of the RP2040 and its surroundings for host builds of
+// the firmware. There is one simulated clock. Stubbed SDK calls charge their
+// approximate cost to it, and scripted events (button edges, encoder steps,
+// USB frames) run as soon as the clock passes their timestamp, the same way
+// an interrupt would land between two instructions on the device.
+//
+// Once the firmware launches core1, each core gets its own clock and its own
+// host stack (a ucontext). Whichever core has fallen behind by more than a
+// small quantum is switched to, so both make progress in simulated time
+// together and events run once both cores have passed them.
+class Sim
+{
+public:
+   // Thrown out of tud_task() once the script is done, to unwind Run()
+   struct Stop {};
+
+   // Thrown out of a flash erase or program that CutPowerAfter() stopped part way
+   struct PowerCut {};
+
+   // Approximate cost of each stubbed call, in nanoseconds of simulated time
+   struct Costs
+   {
+      uint32_t tudTaskNS    = 1000;
+      uint32_t timeReadNS   = 100;
+      uint32_t gpioReadNS   = 50;
+      uint32_t adcReadNS    = 2000;     // 96 ADC clocks at 48MHz
+      uint32_t hidReportNS  = 2000;
+      uint32_t cdcWriteNS   = 1000;     // Copy into the CDC FIFO, per call
+      uint32_t flashEraseNS = 45000000; // Per sector
+      uint32_t flashPageNS  = 700000;   // Per 256 byte page programmed
+      uint32_t wakeNS       = 2000;     // Out of best_effort_wfe_or_timeout(): its alarm, the IRQ and the cancel
+   };
+
+   static constexpr uint32_t FLASH_BYTES  = 2 * 1024 * 1024;
+   static constexpr uint32_t FLASH_SECTOR = 4096;
+
+   static Sim &Get();
+
+   // Time on the core currently executing
+   uint64_t NowNS() const { return m_coreNowNS[m_core]; }
+   uint64_t NowUS() const { return NowNS() / 1000; }
+
+   // Moves the current core's clock forward, running any events that become due
+   void Charge(uint64_t ns);
+
+   // Starts running entry as core1 alongside the caller
+   void     LaunchCore1(void (*entry)());
+   uint32_t CoreNum() const { return m_core; }
+
+   // Runs fn when the clock reaches timeNS
+   void At(uint64_t timeNS, std::function<void()> fn);
+
+   // Makes tud_task() throw Stop once the clock reaches timeNS
+   void StopAt(uint64_t timeNS);
+   bool ShouldStop() const { return m_stopping; }
+
+   // WFE. Each core has an event register, which SEV sets on both. Taking an
+   // interrupt sets it too, on core0 only, as that's where the firmware's
+   // handlers all run. WaitForEvent() moves the current core's clock on,
+   // running events as it goes, until its register is set or the clock
+   // reaches untilNS, then clears the register.
+   void Interrupt() { m_eventRegister[0] = true; }
+   void SendEvent() { m_eventRegister[0] = m_eventRegister[1] = true; }
+   void WaitForEvent(uint64_t untilNS);
+
+   // GPIO. Inputs are pulled up, so a pressed button reads as 0.
+   uint32_t GPIOLevels() const { return m_gpioLevels; }
+   void     SetGPIOLevels(uint32_t mask, bool high);
+   void     PressButtons(uint32_t mask)   { SetGPIOLevels(mask, false); }
+   void     ReleaseButtons(uint32_t mask) { SetGPIOLevels(mask, true); }
+   uint32_t OutputLevels() const          { return m_outputLevels; }
+   void     SetOutputLevels(uint32_t mask, bool high);
+
+   // GPIO edge interrupts
+   void SetGPIOIRQEnabled(uint32_t gpio, uint32_t events, bool enabled);
+   void SetGPIOIRQCallback(void (*callback)(uint32_t gpio, uint32_t events)) { m_gpioIRQCallback = callback; }
+
+   // One quadrature step on the encoder attached to PIO pioIndex. Clockwise
+   // raises PIO irq 0, anticlockwise irq 1, as Encoder.pio does. The step is
+   // also counted, clockwise down, as the counting program keeps it in X.
+   void    EncoderStep(uint32_t pioIndex, bool clockwise);
+   int32_t EncoderCount(uint32_t pioIndex) const { return m_encoderCount[pioIndex]; }
+
+   // PIO button sampler. Once started, push is given the GPIO levels every
+   // periodNS, as the state machine and its DMA would deliver them.
+   // SyncSampler() runs it up to timeNS; reads of the DMA write address and
+   // GPIO changes call it, so samples are only made when something looks.
+   void StartSampler(uint64_t periodNS, std::function<void(uint32_t)> push);
+   void SyncSampler(uint64_t timeNS);
+
+   // ADC. Inputs hold the value set here unless a source is given, which is
+   // asked for every conversion's value instead, e.g. to replay a trace.
+   void     SetADC(uint32_t channel, uint16_t value);
+   uint16_t ADC(uint32_t channel) const { return m_adc[channel]; }
+   void     SetADCSource(std::function<uint16_t(uint32_t channel, uint64_t timeNS)> source) { m_adcSource = std::move(source); }
+   uint16_t Convert(uint32_t channel, uint64_t timeNS) const;
+
+   // Free-running ADC, which like the button sampler delivers a conversion to
+   // push every periodNS and is only run up to date when something looks
+   void StartADC(uint64_t periodNS, std::function<void(uint64_t timeNS)> push);
+   void StopADC() { m_adcPush = nullptr; }
+   void SyncADC(uint64_t timeNS);
+
+   // Flash, starting erased. The image is what reads through XIP see. As
+   // with NOR flash, an erase sets a sector to 0xFF and programming can only
+   // clear bits.
+   uint8_t *FlashImage() { return m_flash.data(); }
+   void     FlashErase(uint32_t offset, uint32_t count);
+   void     FlashProgram(uint32_t offset, const uint8_t *data, uint32_t count);
+   uint32_t FlashEraseCount(uint32_t offset) const { return m_flashErases[offset / FLASH_SECTOR]; }
+   void     ResetFlash();
+
+   // Power fails once this many more bytes have been erased or programmed.
+   // The operation in progress is left part done, up to that byte, and throws
+   // PowerCut. The cut is used up once it happens.
+   void CutPowerAfter(uint64_t bytes) { m_flashBytesToCut = bytes; m_flashCutArmed = true; }
+   void CancelPowerCut()             { m_flashCutArmed = false; }
+
+   // Interrupt controller
+   void SetIRQHandler(uint32_t num, void (*handler)()) { m_irqHandlers[num] = handler; }
+   void SetIRQEnabled(uint32_t num, bool enabled);
+   bool IRQEnabled(uint32_t num) const { return (m_irqEnabled >> num) & 1; }
+   void RaiseIRQ(uint32_t num);
+
+   Costs costs;
+
+private:
+   struct Event
+   {
+      uint64_t              timeNS;
+      uint64_t              seq;
+      std::function<void()> fn;
+
+      bool operator>(const Event &rhs) const
+      {
+         return timeNS != rhs.timeNS ? timeNS > rhs.timeNS : seq > rhs.seq;
+      }
+   };
+
+   void     RunDue();
+   void     SwitchCore();
+   uint64_t GlobalNS() const;
+
+   static void Core1Trampoline();
+
+   // Cores may run this far ahead of each other before switching
+   static constexpr uint64_t CORE_QUANTUM_NS = 1000;
+
+   // How far a waiting core steps when the next event is already due but
+   // waits on the other core to pass it
+   static constexpr uint64_t WAIT_STEP_NS = 100;
+
+   uint64_t m_coreNowNS[2]  = {};
+   uint32_t m_core          = 0;
+   bool     m_core1Running  = false;
+   void   (*m_core1Entry)() = nullptr;
+
+   ucontext_t           m_coreContext[2];
+   std::vector<uint8_t> m_core1Stack;
+
+   uint64_t m_eventSeq   = 0;
+   uint64_t m_eventNS    = 0;
+   bool     m_inEvent    = false;
+   bool     m_stopping   = false;
+   bool     m_eventRegister[2] = {};
+
+   std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+
+   uint32_t m_gpioLevels   = ~0u;
+   uint32_t m_outputLevels = 0;
+   uint32_t m_gpioFallIRQ  = 0;
+   uint32_t m_gpioRiseIRQ  = 0;
+   void   (*m_gpioIRQCallback)(uint32_t gpio, uint32_t events) = nullptr;
+   uint16_t m_adc[5]       = {};
+   std::function<uint16_t(uint32_t, uint64_t)> m_adcSource;
+   int32_t  m_encoderCount[2] = {};
+
+   uint64_t                      m_samplerPeriodNS = 0;
+   uint64_t                      m_samplerNextNS   = 0;
+   std::function<void(uint32_t)> m_samplerPush;
+
+   uint64_t                      m_adcPeriodNS = 0;
+   uint64_t                      m_adcNextNS   = 0;
+   std::function<void(uint64_t)> m_adcPush;
+
+   std::vector<uint8_t>  m_flash        = std::vector<uint8_t>(FLASH_BYTES, 0xFF);
+   std::vector<uint32_t> m_flashErases  = std::vector<uint32_t>(FLASH_BYTES / FLASH_SECTOR);
+   uint64_t              m_flashBytesToCut = 0;
+   bool                  m_flashCutArmed   = false;
+
+   void   (*m_irqHandlers[32])() = {};
+   uint32_t m_irqEnabled         = 0;
+};
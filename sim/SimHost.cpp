@@ -0,0 +1,426 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "SimHost.h"
+#include "Sim.h"
+
+#include "tusb.h"
+
+#include <algorithm>
+
+constexpr uint64_t MS_NS = 1000 * 1000;
+
+SimHost &SimHost::Get()
+{
+   static SimHost s_host;
+   return s_host;
+}
+
+uint64_t SimHost::FrameStartNS(uint32_t frame) const
+{
+   return m_frame0NS + uint64_t(frame) * frameNS;
+}
+
+void SimHost::Enumerate()
+{
+   // Device descriptor first, as a real host would, although we've no use for it
+   tud_descriptor_device_cb();
+
+   const uint8_t *cfg = tud_descriptor_configuration_cb(0);
+   uint16_t totalLen  = cfg[2] | (cfg[3] << 8);
+
+   m_config.assign(cfg, cfg + totalLen);
+   m_endpoints.clear();
+   m_reportDescs.clear();
+
+   int      hidInstance = -1;
+   uint8_t  itfClass    = 0;
+   uint16_t pos         = 0;
+
+   m_cdcIn = 0;
+
+   while (pos + 1 < totalLen && cfg[pos] != 0)
+   {
+      const uint8_t *desc = cfg + pos;
+
+      switch (desc[1])
+      {
+      case TUSB_DESC_INTERFACE:
+         itfClass    = desc[5];
+         hidInstance = itfClass == TUSB_CLASS_HID ? hidInstance + 1 : hidInstance;
+         break;
+
+      case HID_DESC_TYPE_HID:
+      {
+         uint16_t reportLen = desc[7] | (desc[8] << 8);
+         const uint8_t *report = tud_hid_descriptor_report_cb(hidInstance);
+         m_reportDescs[hidInstance].assign(report, report + reportLen);
+         break;
+      }
+
+      case TUSB_DESC_ENDPOINT:
+         if (itfClass == TUSB_CLASS_CDC_DATA && (desc[2] & 0x80) && (desc[3] & 3) == TUSB_XFER_BULK)
+            m_cdcIn = desc[2];
+
+         if (itfClass == TUSB_CLASS_HID && (desc[2] & 0x80) && (desc[3] & 3) == TUSB_XFER_INTERRUPT)
+         {
+            Endpoint ep;
+            ep.address   = desc[2];
+            ep.instance  = hidInstance;
+            ep.bInterval = desc[6];
+            ep.interval  = desc[6] ? desc[6] : 1;
+
+            if (roundIntervalPow2)
+               while (ep.interval & (ep.interval - 1))
+                  ep.interval &= ep.interval - 1;
+
+            m_endpoints.push_back(ep);
+         }
+         break;
+
+      default:
+         break;
+      }
+
+      pos += desc[0];
+   }
+
+   for (uint8_t i = 0; i < 4; i++)
+      tud_descriptor_string_cb(i, 0x0409);
+
+   m_mounted = true;
+   tud_mount_cb();
+
+   // Frames start on the next millisecond boundary plus the host's phase
+   uint64_t now = Sim::Get().NowNS();
+   m_frame0NS = (now / MS_NS + 1) * MS_NS + sofPhaseNS;
+   m_frame    = 0;
+
+   Sim::Get().At(m_frame0NS, [this]() { StartOfFrame(); });
+}
+
+void SimHost::StartOfFrame()
+{
+   uint64_t start = FrameStartNS(m_frame);
+
+   // Only taken as an interrupt once the firmware asks for the callback
+   if (m_sofCallback)
+   {
+      m_sofFrames.push_back(m_frame & 0x7FF);
+      Sim::Get().Interrupt();
+   }
+
+   for (size_t i = 0; i < m_endpoints.size(); i++)
+      if (m_frame % m_endpoints[i].interval == 0)
+         Sim::Get().At(start + inTokenOffsetNS, [this, i]() { InToken(i); });
+
+   // Bulk goes in whatever the frame has left after the interrupt transfers
+   if (m_cdcIn != 0)
+      Sim::Get().At(start + 2 * inTokenOffsetNS, [this]() { CDCInTokens(); });
+
+   m_frame++;
+   Sim::Get().At(FrameStartNS(m_frame), [this]() { StartOfFrame(); });
+}
+
+void SimHost::InToken(size_t epIndex)
+{
+   Endpoint &ep = m_endpoints[epIndex];
+
+   if (!ep.queued || !hidPolling)
+      return; // NAK
+
+   ep.queued = false;
+   m_completed.push_back(ep.packet);
+   Sim::Get().Interrupt();
+
+   if (onDelivered)
+      onDelivered(ep.packet, Sim::Get().NowNS());
+}
+
+void SimHost::CDCInTokens()
+{
+   if (!cdcReading || !CDCConnected() || m_cdcFlushed == 0)
+      return;
+
+   size_t len = std::min<size_t>(m_cdcFlushed, cdcBytesPerFrame);
+
+   if (onCDCData)
+      onCDCData(m_cdcFifo.data(), len, Sim::Get().NowNS());
+
+   m_cdcFifo.erase(m_cdcFifo.begin(), m_cdcFifo.begin() + len);
+   m_cdcFlushed -= len;
+
+   Sim::Get().Interrupt();
+}
+
+uint32_t SimHost::CDCWriteAvailable() const
+{
+   return CFG_TUD_CDC_TX_BUFSIZE - uint32_t(m_cdcFifo.size());
+}
+
+uint32_t SimHost::CDCWrite(const void *data, uint32_t len)
+{
+   Sim::Get().Charge(Sim::Get().costs.cdcWriteNS);
+
+   const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+   len = std::min(len, CDCWriteAvailable());
+   m_cdcFifo.insert(m_cdcFifo.end(), bytes, bytes + len);
+   return len;
+}
+
+SimHost::Endpoint *SimHost::EndpointForInstance(uint8_t instance)
+{
+   for (Endpoint &ep : m_endpoints)
+      if (ep.instance == instance)
+         return &ep;
+
+   return nullptr;
+}
+
+void SimHost::Task()
+{
+   Sim &sim = Sim::Get();
+
+   sim.Charge(sim.costs.tudTaskNS);
+
+   if (sim.ShouldStop())
+      throw Sim::Stop();
+
+   if (!m_mounted)
+   {
+      if (sim.NowNS() >= enumerateAtNS)
+         Enumerate();
+      return;
+   }
+
+   // Like transfer completions, SOF events are deferred from the ISR to here
+   std::vector<uint32_t> sofFrames;
+   sofFrames.swap(m_sofFrames);
+
+   for (uint32_t frame : sofFrames)
+      tud_sof_cb(frame);
+
+   // Transfer complete events are handled here, not in the ISR
+   std::vector<Packet> completed;
+   completed.swap(m_completed);
+
+   for (const Packet &p : completed)
+   {
+      EndpointForInstance(p.instance)->busy = false;
+      tud_hid_report_complete_cb(p.instance, p.data.data(), uint8_t(p.data.size()));
+   }
+
+   std::vector<ControlRequest> control;
+   control.swap(m_control);
+
+   for (ControlRequest &req : control)
+      Control(req);
+}
+
+void SimHost::GetReport(uint8_t instance, uint8_t reportID, uint8_t type, uint16_t length, ReportDone done)
+{
+   ControlRequest req;
+   req.instance = instance;
+   req.reportID = reportID;
+   req.type     = type;
+   req.length   = length;
+   req.done     = done;
+   m_control.push_back(req);
+
+   Sim::Get().Interrupt();
+}
+
+void SimHost::SetReport(uint8_t instance, uint8_t type, const std::vector<uint8_t> &data, ReportDone done)
+{
+   ControlRequest req;
+   req.set      = true;
+   req.instance = instance;
+   req.reportID = data.empty() ? 0 : data[0];
+   req.type     = type;
+   req.data     = data;
+   req.done     = done;
+   m_control.push_back(req);
+
+   Sim::Get().Interrupt();
+}
+
+void SimHost::Control(ControlRequest &req)
+{
+   Sim &sim = Sim::Get();
+
+   // The setup and data stages, as seen by the device
+   sim.Charge(sim.costs.hidReportNS);
+
+   // Like current TinyUSB, the report ID is put in or taken out here, so the
+   // callbacks only ever see the report itself
+   uint16_t idLen = req.reportID != 0 ? 1 : 0;
+
+   // TinyUSB takes both through a buffer of CFG_TUD_HID_EP_BUFSIZE, stalling
+   // longer sets and cutting gets short
+   if (req.set)
+   {
+      if (req.data.size() > CFG_TUD_HID_EP_BUFSIZE)
+      {
+         if (req.done)
+            req.done({});
+         return;
+      }
+
+      tud_hid_set_report_cb(req.instance, req.reportID, hid_report_type_t(req.type),
+                            req.data.data() + idLen, uint16_t(req.data.size() - idLen));
+
+      if (req.done)
+         req.done(req.data);
+      return;
+   }
+
+   req.length = std::min<uint16_t>(req.length, CFG_TUD_HID_EP_BUFSIZE);
+
+   std::vector<uint8_t> reply(req.length);
+   uint16_t len = 0;
+
+   if (req.length > idLen)
+      len = tud_hid_get_report_cb(req.instance, req.reportID, hid_report_type_t(req.type),
+                                  reply.data() + idLen, uint16_t(req.length - idLen));
+
+   if (len == 0)
+      reply.clear();
+   else
+   {
+      if (idLen)
+         reply[0] = req.reportID;
+      reply.resize(idLen + len);
+   }
+
+   if (req.done)
+      req.done(reply);
+}
+
+bool SimHost::Ready(uint8_t instance) const
+{
+   for (const Endpoint &ep : m_endpoints)
+      if (ep.instance == instance)
+         return m_mounted && !ep.busy;
+
+   return false;
+}
+
+bool SimHost::Queue(uint8_t instance, uint8_t reportID, const void *data, uint16_t len)
+{
+   Endpoint *ep = EndpointForInstance(instance);
+
+   if (ep == nullptr || !Ready(instance))
+      return false;
+
+   Sim::Get().Charge(Sim::Get().costs.hidReportNS);
+
+   Packet &p = ep->packet;
+   p.instance = instance;
+   p.endpoint = ep->address;
+   p.queuedNS = Sim::Get().NowNS();
+   p.data.clear();
+
+   if (reportID != 0)
+      p.data.push_back(reportID);
+
+   const uint8_t *bytes = static_cast<const uint8_t *>(data);
+   p.data.insert(p.data.end(), bytes, bytes + len);
+
+   ep->busy   = true;
+   ep->queued = true;
+
+   if (onQueued)
+      onQueued(p);
+
+   return true;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB device API
+//--------------------------------------------------------------------+
+
+bool tusb_init()
+{
+   // The bus reset that starts enumeration
+   Sim::Get().At(SimHost::Get().enumerateAtNS, []() { Sim::Get().Interrupt(); });
+   return true;
+}
+
+void tud_task()
+{
+   SimHost::Get().Task();
+}
+
+bool tud_mounted()
+{
+   return SimHost::Get().IsMounted();
+}
+
+bool tud_suspended()
+{
+   return false;
+}
+
+bool tud_remote_wakeup()
+{
+   return false;
+}
+
+void tud_sof_cb_enable(bool en)
+{
+   SimHost::Get().EnableSOFCallback(en);
+}
+
+bool tud_hid_n_ready(uint8_t instance)
+{
+   return SimHost::Get().Ready(instance);
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, const void *report, uint16_t len)
+{
+   return SimHost::Get().Queue(instance, report_id, report, len);
+}
+
+bool tud_cdc_connected()
+{
+   return SimHost::Get().CDCConnected();
+}
+
+uint32_t tud_cdc_write_available()
+{
+   return SimHost::Get().CDCWriteAvailable();
+}
+
+uint32_t tud_cdc_write(const void *buffer, uint32_t bufsize)
+{
+   return SimHost::Get().CDCWrite(buffer, bufsize);
+}
+
+uint32_t tud_cdc_write_flush()
+{
+   SimHost::Get().CDCFlush();
+   return 0;
+}
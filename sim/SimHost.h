@@ -0,0 +1,151 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+// A full-speed USB host as seen from the device. It enumerates the firmware
+// through the TinyUSB descriptor callbacks, then issues start-of-frame every
+// 1ms and polls each interrupt IN endpoint every bInterval frames (rounded
+// down to a power of two, as the Linux host controller drivers do). Transfer
+// completion is reported back from tud_task(), like TinyUSB defers it.
+class SimHost
+{
+public:
+   struct Packet
+   {
+      uint8_t              instance = 0;
+      uint8_t              endpoint = 0;
+      std::vector<uint8_t> data;
+      uint64_t             queuedNS = 0;
+   };
+
+   struct Endpoint
+   {
+      uint8_t  address   = 0;
+      uint8_t  instance  = 0;
+      uint8_t  bInterval = 0;
+      uint32_t interval  = 1;   // frames between polls actually used
+      bool     busy      = false;
+      bool     queued    = false;
+      Packet   packet;
+   };
+
+   static SimHost &Get();
+
+   // Host behaviour, set before the firmware starts
+   uint64_t enumerateAtNS    = 50 * 1000 * 1000;
+   uint64_t sofPhaseNS       = 0;        // SOF time within the device's 1ms
+   uint64_t frameNS          = 1000 * 1000; // The host's 1ms by the device clock
+   uint64_t inTokenOffsetNS  = 100 * 1000;
+   bool     roundIntervalPow2 = true;
+
+   // Clearing hidPolling stops the IN tokens to the HID endpoints, so a
+   // queued report holds its endpoint busy until it's set again
+   bool     hidPolling        = true;
+
+   // GET_REPORT and SET_REPORT on endpoint 0, passed to the firmware from the
+   // next tud_task() once mounted. Data carries the report ID first, as hidraw
+   // has it. A get the firmware stalls, or a set longer than its buffer,
+   // completes with no data.
+   using ReportDone = std::function<void(const std::vector<uint8_t> &data)>;
+
+   void GetReport(uint8_t instance, uint8_t reportID, uint8_t type, uint16_t length, ReportDone done);
+   void SetReport(uint8_t instance, uint8_t type, const std::vector<uint8_t> &data, ReportDone done = nullptr);
+
+   // CDC, if the firmware has it. Like a terminal program, the host asserts
+   // DTR once mounted and reads the bulk IN endpoint every frame, up to
+   // cdcBytesPerFrame of what the firmware has flushed. Clearing cdcReading
+   // stops it reading, so the firmware's FIFO fills.
+   bool     cdcConnected     = true;
+   bool     cdcReading       = true;
+   uint32_t cdcBytesPerFrame = 19 * 64;
+
+   std::function<void(const uint8_t *data, size_t len, uint64_t nowNS)> onCDCData;
+
+   bool HasCDC() const { return m_cdcIn != 0; }
+
+   std::function<void(const Packet &)>                   onQueued;
+   std::function<void(const Packet &, uint64_t nowNS)>    onDelivered;
+
+   bool     IsMounted() const   { return m_mounted; }
+   uint32_t FrameNumber() const { return m_frame; }
+   uint64_t FrameStartNS(uint32_t frame) const;
+
+   const std::vector<uint8_t>              &ConfigDescriptor() const { return m_config; }
+   const std::map<uint8_t, std::vector<uint8_t>> &ReportDescriptors() const { return m_reportDescs; }
+   const std::vector<Endpoint>             &Endpoints() const { return m_endpoints; }
+
+   // Called by the TinyUSB stubs
+   void Task();
+   bool Ready(uint8_t instance) const;
+   bool Queue(uint8_t instance, uint8_t reportID, const void *data, uint16_t len);
+   void EnableSOFCallback(bool en) { m_sofCallback = en; }
+
+   bool     CDCConnected() const { return m_mounted && m_cdcIn != 0 && cdcConnected; }
+   uint32_t CDCWriteAvailable() const;
+   uint32_t CDCWrite(const void *data, uint32_t len);
+   void     CDCFlush() { m_cdcFlushed = m_cdcFifo.size(); }
+
+private:
+   struct ControlRequest
+   {
+      bool                 set      = false;
+      uint8_t              instance = 0;
+      uint8_t              reportID = 0;
+      uint8_t              type     = 0;
+      uint16_t             length   = 0;
+      std::vector<uint8_t> data;
+      ReportDone           done;
+   };
+
+   void      Enumerate();
+   void      Control(ControlRequest &req);
+   void      StartOfFrame();
+   void      InToken(size_t epIndex);
+   void      CDCInTokens();
+   Endpoint *EndpointForInstance(uint8_t instance);
+
+   bool     m_mounted = false;
+   uint32_t m_frame   = 0;
+   uint64_t m_frame0NS = 0;
+   bool     m_sofCallback = false;
+
+   std::vector<uint32_t>                   m_sofFrames; // SOFs not yet seen by tud_task()
+
+   std::vector<uint8_t>                    m_config;
+   std::map<uint8_t, std::vector<uint8_t>> m_reportDescs;
+   std::vector<Endpoint>                   m_endpoints;
+   std::vector<Packet>                     m_completed;
+   std::vector<ControlRequest>             m_control;
+
+   uint8_t              m_cdcIn      = 0;
+   std::vector<uint8_t> m_cdcFifo;
+   size_t               m_cdcFlushed = 0; // Bytes at the front of the FIFO the host may take
+};
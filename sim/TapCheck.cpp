@@ -0,0 +1,212 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Sub-millisecond taps through the real ArcadeCtrl::Run() loop, with the PIO
+// sampler and a short release window, while the host every so often stops
+// polling so the gamepad endpoint stays busy. Each round one button is
+// tapped twice, another once, and two more together, all inside the stall;
+// then a tap lands at a random time with the host polling as usual. The host
+// must see every tap as a press, and get no more reports than there were
+// changes.
+//
+//   TapCheck [--dip N] [--rounds N] [--stall-ms N] [--release-us N] [--seed N] [--dual-core]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+constexpr uint64_t US = 1000;
+constexpr uint64_t MS = 1000 * US;
+
+constexpr uint8_t  REPORT_ID_GAMEPAD = 1;
+constexpr uint32_t DIP_SHIFT         = 21;
+
+// Button GPIOs: tapped twice, once, and two together in the stall; then alone
+constexpr uint32_t TWICE    = 1u << 0;
+constexpr uint32_t ONCE     = 1u << 1;
+constexpr uint32_t TOGETHER = (1u << 2) | (1u << 3);
+constexpr uint32_t ALONE    = 1u << 4;
+
+int main(int argc, char **argv)
+{
+   uint32_t dip       = 2;
+   uint32_t rounds    = 500;
+   uint32_t stallMS   = 12;
+   uint32_t releaseUS = 250;
+   uint32_t seed      = 1;
+   bool     dualCore  = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--rounds") && i + 1 < argc)
+         rounds = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--stall-ms") && i + 1 < argc)
+         stallMS = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--release-us") && i + 1 < argc)
+         releaseUS = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+         seed = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--dual-core"))
+         dualCore = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--rounds N] [--stall-ms N] [--release-us N] [--seed N] [--dual-core]\n",
+                 argv[0]);
+         return 1;
+      }
+   }
+
+   // Taps of one button closer than its release window are one press to the
+   // debouncer, so would never be separate
+   if (stallMS * 1000 / 5 < releaseUS + 1200)
+   {
+      fprintf(stderr, "a %u ms stall is too short to space taps clear of a %u us release window\n", stallMS, releaseUS);
+      return 1;
+   }
+
+   std::mt19937 rng(seed);
+   Sim         &sim  = Sim::Get();
+   SimHost     &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.pioSampler = true;
+   cfg.releaseUS  = releaseUS;
+   cfg.dualCore   = dualCore;
+
+   std::uniform_int_distribution<uint64_t> jitter(0, 400 * US);
+   std::uniform_int_distribution<uint64_t> tapLength(200 * US, 800 * US);
+
+   uint32_t taps[32]    = {};
+   uint32_t changes     = 0; // Of the pressed state, counting simultaneous edges once
+   uint64_t t           = 200 * MS;
+   uint64_t stallNS     = stallMS * MS;
+   uint64_t roundNS     = stallNS + 40 * MS;
+
+   auto tap = [&](uint32_t mask, uint64_t at)
+   {
+      uint64_t length = tapLength(rng);
+
+      sim.At(at, [mask]() { Sim::Get().PressButtons(mask); });
+      sim.At(at + length, [mask]() { Sim::Get().ReleaseButtons(mask); });
+
+      for (uint32_t bit = 0; bit < 32; bit++)
+         taps[bit] += (mask >> bit) & 1;
+
+      changes += 2;
+   };
+
+   for (uint32_t r = 0; r < rounds; r++, t += roundNS)
+   {
+      sim.At(t, []() { SimHost::Get().hidPolling = false; });
+      sim.At(t + stallNS, []() { SimHost::Get().hidPolling = true; });
+
+      // Spread through the stall, each clear of the last one's release window
+      uint64_t step = stallNS / 5;
+
+      tap(TWICE, t + step / 2 + jitter(rng));
+      tap(ONCE, t + step * 3 / 2 + jitter(rng));
+      tap(TWICE, t + step * 5 / 2 + jitter(rng));
+      tap(TOGETHER, t + step * 7 / 2 + jitter(rng));
+
+      // Anywhere in the rest of the round, polling as usual
+      std::uniform_int_distribution<uint64_t> after(t + stallNS + 2 * MS, t + roundNS - 5 * MS);
+
+      tap(ALONE, after(rng));
+   }
+
+   sim.StopAt(t + 50 * MS);
+
+   // Presses as the host saw them
+   uint32_t seen[32]    = {};
+   uint32_t reports     = 0;
+   uint32_t lastButtons = 0;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      uint32_t buttons = 0;
+
+      if (p.data.size() < 11 || p.data[0] != REPORT_ID_GAMEPAD)
+         return;
+
+      memcpy(&buttons, &p.data[7], sizeof(buttons));
+
+      for (uint32_t pressed = buttons & ~lastButtons; pressed != 0; pressed &= pressed - 1)
+         seen[__builtin_ctz(pressed)]++;
+
+      lastButtons = buttons;
+      reports++;
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   uint32_t made = 0;
+   uint32_t lost = 0;
+   bool     pass = true;
+
+   for (uint32_t bit = 0; bit < 32; bit++)
+   {
+      made += taps[bit];
+
+      if (seen[bit] != taps[bit])
+      {
+         fprintf(stderr, "FAILED: GPIO %u tapped %u times, host saw %u presses\n", bit, taps[bit], seen[bit]);
+         lost += taps[bit] > seen[bit] ? taps[bit] - seen[bit] : 0;
+         pass = false;
+      }
+   }
+
+   if (reports > changes)
+   {
+      fprintf(stderr, "FAILED: %u reports for %u changes\n", reports, changes);
+      pass = false;
+   }
+
+   const EdgeQueue::Stats &edges = controller.GetEdges().GetStats();
+
+   printf("dip %u%s, %u us release window, %u ms stalls: %u taps, %u lost; %u reports for %u changes; "
+          "edge queue %u recorded, %u coalesced, %u forced, %u dropped\n", dip, dualCore ? ", dual core" : "",
+          releaseUS, stallMS, made, lost, reports, changes, edges.recorded, edges.coalesced, edges.forced,
+          edges.dropped);
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Reads the telemetry feature reports from the simulated host after running
+// the real ArcadeCtrl::Run() loop through presses, encoder motion and a
+// stalled stretch, and checks them against what the simulation saw: step
+// interrupts, reports queued and delivered, the histograms' totals, the
+// slowest report against the host's own measure, and that the stall shows
+// up as overruns. Then clears them and checks they start over.
+//
+// Built with ARCADE_CTRL_TELEMETRY=0, it checks the reports say so instead.
+//
+//   TelemetryCheck [--dip N] [--hist]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t  HID_INSTANCE_GAMEPAD = 0;
+constexpr uint32_t DIP_SHIFT            = 21;
+constexpr uint32_t BUTTON_BIT           = 0;
+
+constexpr uint64_t STALL_AT_NS = 2500 * MS;
+constexpr uint32_t STALL_NS    = 3 * MS;
+constexpr uint64_t READ_AT_NS  = 3000 * MS;
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+template <typename T>
+static void Get(uint8_t reportID, T *report)
+{
+   SimHost::Get().GetReport(HID_INSTANCE_GAMEPAD, reportID, HID_REPORT_TYPE_FEATURE, sizeof(*report) + 1,
+                            [report, reportID](const std::vector<uint8_t> &data)
+   {
+      Check(data.size() == sizeof(*report) + 1 && data[0] == reportID, "get returns the whole report");
+
+      memset(report, 0, sizeof(*report));
+
+      if (data.size() == sizeof(*report) + 1)
+         memcpy(report, data.data() + 1, sizeof(*report));
+   });
+}
+
+static uint64_t Total(const TelemetryHistogram &h)
+{
+   uint64_t total = 0;
+
+   for (uint32_t count : h.buckets)
+      total += count;
+
+   return total;
+}
+
+static void Print(const char *name, const TelemetryHistogram &h)
+{
+   printf("%s: max %u us\n", name, h.maxUS);
+
+   for (uint32_t b = 0; b < TELEMETRY_BUCKETS; b++)
+   {
+      if (h.buckets[b] == 0)
+         continue;
+
+      if (b == TELEMETRY_BUCKETS - 1)
+         printf("  >= %4u us %8u\n", 1u << (b - 1), h.buckets[b]);
+      else
+         printf("  <  %4u us %8u\n", 1u << b, h.buckets[b]);
+   }
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip  = 0;
+   bool     hist = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--hist"))
+         hist = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--hist]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   const ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+
+   // What the simulation saw, up to the read
+   uint32_t steps[2]      = {};
+   uint32_t queued        = 0;
+   uint32_t delivered     = 0;
+   uint64_t maxQueueToHostNS = 0;
+
+   host.onQueued = [&](const SimHost::Packet &) { queued++; };
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t nowNS)
+   {
+      delivered++;
+      maxQueueToHostNS = std::max(maxQueueToHostNS, nowNS - p.queuedNS);
+   };
+
+   // A press every 37ms, so they drift through the polls and frames
+   for (uint64_t t = 200 * MS; t < 2000 * MS; t += 37 * MS)
+   {
+      sim.At(t, []() { Sim::Get().PressButtons(1u << BUTTON_BIT); });
+      sim.At(t + 15 * MS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+   }
+
+   // Both encoders turning, at different rates
+   for (uint32_t e = 0; e < cfg.numEncoders && e < 2; e++)
+      for (uint64_t t = 300 * MS; t < 1300 * MS; t += (e + 2) * MS / 2 + 7000)
+         sim.At(t, [&, e]() { Sim::Get().EncoderStep(e, e == 0); steps[e]++; });
+
+   // A few loop iterations each held up by 3ms, as a slow flash write or
+   // debug print would
+   uint32_t stallTaskNS = 0;
+
+   sim.At(STALL_AT_NS, [&]() { stallTaskNS = sim.costs.tudTaskNS; sim.costs.tudTaskNS = STALL_NS; });
+   sim.At(STALL_AT_NS + 10 * MS, [&]() { sim.costs.tudTaskNS = stallTaskNS; });
+
+   TelemetryCounters  counters = {};
+   TelemetryHistogram loop = {}, sampleToQueue = {}, queueToComplete = {};
+   uint32_t           queuedAtRead = 0, deliveredAtRead = 0;
+
+   sim.At(READ_AT_NS, [&]()
+   {
+      queuedAtRead    = queued;
+      deliveredAtRead = delivered;
+
+      Get(TELEMETRY_COUNTERS_ID, &counters);
+      Get(TELEMETRY_LOOP_ID, &loop);
+      Get(TELEMETRY_SAMPLE_TO_QUEUE_ID, &sampleToQueue);
+      Get(TELEMETRY_QUEUE_TO_COMPLETE_ID, &queueToComplete);
+   });
+
+   // Then start over, and see that only what came after counts
+   TelemetryCounters cleared = {};
+
+   sim.At(READ_AT_NS + 10 * MS, [&]()
+   {
+      TelemetryCounters req = {};
+      req.version = TELEMETRY_VERSION;
+      req.command = TELEMETRY_CLEAR;
+
+      std::vector<uint8_t> data(1 + sizeof(req));
+      data[0] = TELEMETRY_COUNTERS_ID;
+      memcpy(data.data() + 1, &req, sizeof(req));
+
+      host.SetReport(HID_INSTANCE_GAMEPAD, HID_REPORT_TYPE_FEATURE, data);
+   });
+
+   sim.At(READ_AT_NS + 110 * MS, [&]() { Get(TELEMETRY_COUNTERS_ID, &cleared); });
+   sim.StopAt(READ_AT_NS + 150 * MS);
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   Check(counters.version == TELEMETRY_VERSION, "version");
+
+   if (!ARCADE_CTRL_TELEMETRY)
+   {
+      Check(!counters.compiledIn && counters.loops == 0 && Total(loop) == 0, "compiled out and empty");
+
+      printf("telemetry compiled out, reports empty\n");
+      printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+      return s_failures == 0 ? 0 : 1;
+   }
+
+   Check(counters.compiledIn, "compiled in");
+
+   for (uint32_t e = 0; e < 2; e++)
+      Check(counters.encoderIRQs[e] == steps[e], "an interrupt counted per step");
+
+   Check(counters.queued == queuedAtRead, "reports queued match the host's");
+   Check(counters.completed == deliveredAtRead, "reports completed match the host's");
+   Check(Total(sampleToQueue) == counters.queued, "sample to queue has every report");
+   Check(Total(queueToComplete) == counters.completed, "queue to complete has every completion");
+   Check(Total(loop) + 1 == counters.loops, "loop histogram has every iteration but the first");
+
+   // One core, sleeping between its polls
+   Check(counters.sleeps[0] > 0 && counters.sleptMS[0] < counters.sinceClearMS && counters.sleeps[1] == 0,
+         "core0 alone sleeps");
+
+   // Completions are seen from the next tud_task(), so after the host took
+   // the report by up to a loop iteration
+   uint32_t hostMaxUS = uint32_t(maxQueueToHostNS / 1000);
+
+   Check(queueToComplete.maxUS >= hostMaxUS && queueToComplete.maxUS <= hostMaxUS + loop.maxUS + 1,
+         "slowest completion matches the host's");
+
+   // One poll a millisecond, less the ones the stall swallowed
+   uint32_t polls = uint32_t(READ_AT_NS / MS) - uint32_t(host.enumerateAtNS / MS);
+
+   Check(counters.polls <= READ_AT_NS / MS && counters.polls + 10 >= polls, "a poll per millisecond");
+   Check(counters.overruns > 0 && counters.maxLateUS >= STALL_NS / 1000 - 1000, "the stall is overruns");
+   Check(loop.maxUS >= STALL_NS / 1000, "the stall is in the loop histogram");
+   Check(cfg.numEncoders == 0 || counters.readyMisses > 0, "busy endpoint while the encoders turn");
+
+   Check(cleared.sinceClearMS >= 99 && cleared.sinceClearMS <= 101 && cleared.polls <= 101 && cleared.polls >= 95 &&
+         cleared.overruns == 0 && cleared.encoderIRQs[0] == 0, "clear starts over");
+
+   printf("dip %u over %.1f s: %u loops, %u polls, %u overruns (latest %u us), %u queued, %u completed, "
+          "%u endpoint busy, encoder interrupts %u %u\n", dip, counters.sinceClearMS / 1000.0, counters.loops,
+          counters.polls, counters.overruns, counters.maxLateUS, counters.queued, counters.completed,
+          counters.readyMisses, counters.encoderIRQs[0], counters.encoderIRQs[1]);
+
+   printf("slowest: loop %u us, sample to queue %u us, queue to complete %u us (host saw %u us)\n",
+          loop.maxUS, sampleToQueue.maxUS, queueToComplete.maxUS, hostMaxUS);
+
+   if (hist)
+   {
+      Print("loop", loop);
+      Print("sample to queue", sampleToQueue);
+      Print("queue to complete", queueToComplete);
+   }
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Reads the CDC trace the simulated host receives while the real
+// ArcadeCtrl::Run() loop sees bouncing presses and encoder motion, and checks
+// it against the HID reports: every record in sequence and in sync, each
+// queued gamepad report's time and buttons in a record, the encoder counts
+// adding up to the mouse motion, and the bounce the debouncer hid showing in
+// the raw edges. Then stops the host reading for a second, and checks the
+// records that didn't fit are counted as dropped, are exactly the gaps in
+// seq, and that the HID reports went out no later for it.
+//
+//   TraceCheck [--dip N]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "TraceRecord.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t  REPORT_ID_GAMEPAD = 1;
+constexpr uint8_t  REPORT_ID_MOUSE   = 2;
+constexpr uint32_t DIP_SHIFT         = 21;
+constexpr uint32_t BUTTON_BIT        = 0;
+
+// Each press bounces twice before settling, each release once
+constexpr uint64_t BOUNCE_NS = 1500 * 1000;
+
+constexpr uint64_t PRESSES_END_NS  = 3400 * MS;
+constexpr uint64_t STALL_AT_NS     = 2000 * MS;
+constexpr uint64_t STALL_END_NS    = 3000 * MS;
+constexpr uint64_t STOP_AT_NS      = 3600 * MS;
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip = 0;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   const ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+
+   // The stream as the host read it, cut into records
+   std::vector<uint8_t>     stream;
+   std::vector<TraceRecord> records;
+   uint32_t                 resyncs = 0;
+
+   host.onCDCData = [&](const uint8_t *data, size_t len, uint64_t)
+   {
+      stream.insert(stream.end(), data, data + len);
+
+      size_t at = 0;
+
+      while (stream.size() - at >= sizeof(TraceRecord))
+      {
+         TraceRecord record;
+         memcpy(&record, stream.data() + at, sizeof(record));
+
+         if (record.sync != TRACE_SYNC)
+         {
+            resyncs++;
+            at++;
+            continue;
+         }
+
+         records.push_back(record);
+         at += sizeof(record);
+      }
+
+      stream.erase(stream.begin(), stream.begin() + at);
+   };
+
+   // Gamepad reports by when they were queued, and the mouse motion
+   std::multimap<uint32_t, uint32_t> gamepadQueuedUS; // Time -> buttons
+   int64_t                           mouseX = 0, mouseXBeforeStall = 0;
+
+   host.onQueued = [&](const SimHost::Packet &p)
+   {
+      uint32_t queuedUS = uint32_t(p.queuedNS / 1000);
+
+      if (p.data.size() >= 11 && p.data[0] == REPORT_ID_GAMEPAD)
+      {
+         uint32_t buttons;
+         memcpy(&buttons, &p.data[7], sizeof(buttons));
+         gamepadQueuedUS.emplace(queuedUS, buttons);
+      }
+      else if (p.data.size() >= 4 && p.data[0] == REPORT_ID_MOUSE)
+      {
+         int16_t x;
+         memcpy(&x, &p.data[2], sizeof(x));
+         mouseX += x;
+
+         if (p.queuedNS < STALL_AT_NS)
+            mouseXBeforeStall += x;
+      }
+   };
+
+   // Press edge to the gamepad report that carried it, outside and during the stall
+   uint64_t pressNS = 0;
+   uint64_t maxPressNS[2] = {};
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      if (pressNS == 0 || p.data.size() < 11 || p.data[0] != REPORT_ID_GAMEPAD || !((p.data[7] >> BUTTON_BIT) & 1))
+         return;
+
+      bool stalled = pressNS >= STALL_AT_NS && pressNS < STALL_END_NS;
+
+      maxPressNS[stalled] = std::max(maxPressNS[stalled], p.queuedNS - pressNS);
+      pressNS = 0;
+   };
+
+   // A bouncing press every 37.13ms, so they drift through the polls
+   uint32_t presses = 0;
+
+   for (uint64_t t = 200 * MS; t < PRESSES_END_NS; t += 37 * MS + 130 * 1000)
+   {
+      sim.At(t, [&, t]() { Sim::Get().PressButtons(1u << BUTTON_BIT); pressNS = t; presses++; });
+      sim.At(t + BOUNCE_NS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+      sim.At(t + 2 * BOUNCE_NS, []() { Sim::Get().PressButtons(1u << BUTTON_BIT); });
+      sim.At(t + 3 * BOUNCE_NS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+      sim.At(t + 4 * BOUNCE_NS, []() { Sim::Get().PressButtons(1u << BUTTON_BIT); });
+      sim.At(t + 15 * MS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+      sim.At(t + 15 * MS + BOUNCE_NS, []() { Sim::Get().PressButtons(1u << BUTTON_BIT); });
+      sim.At(t + 15 * MS + 2 * BOUNCE_NS, []() { Sim::Get().ReleaseButtons(1u << BUTTON_BIT); });
+   }
+
+   // The first encoder turning, before the stall and through it
+   for (uint32_t e = 0; e < cfg.numEncoders && e < 1; e++)
+   {
+      for (uint64_t t = 300 * MS; t < 1300 * MS; t += MS / 2 + 7000)
+         sim.At(t, [e]() { Sim::Get().EncoderStep(e, true); });
+
+      for (uint64_t t = STALL_AT_NS + 100 * MS; t < STALL_END_NS - 100 * MS; t += 3 * MS)
+         sim.At(t, [e]() { Sim::Get().EncoderStep(e, false); });
+   }
+
+   // Like a terminal program left in the background
+   size_t recordsBeforeStall = 0;
+
+   sim.At(STALL_AT_NS, [&]() { host.cdcReading = false; recordsBeforeStall = records.size(); });
+   sim.At(STALL_END_NS, [&]() { host.cdcReading = true; });
+   sim.StopAt(STOP_AT_NS);
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   Check(host.HasCDC(), "CDC interface enumerated");
+   Check(!records.empty(), "records received");
+
+   if (records.empty())
+   {
+      printf("FAIL\n");
+      return 1;
+   }
+
+   Check(resyncs == 0, "every record starts with the sync word");
+
+   // Before the stall, nothing lost and everything accounted for
+   uint32_t matched    = 0;
+   uint32_t bounces    = 0;
+   int64_t  countsX    = 0;
+   uint32_t lastSentUS = 0;
+
+   for (size_t i = 0; i < recordsBeforeStall; i++)
+   {
+      const TraceRecord &r = records[i];
+
+      if (i > 0)
+         Check(uint16_t(r.seq - records[i - 1].seq) == 1 && r.dropped == records[0].dropped,
+               "records contiguous before the stall");
+
+      countsX += r.counts[0];
+
+      // A raw edge that didn't change the reported buttons is bounce
+      if ((r.rawEdges >> BUTTON_BIT) & 1 && !((r.changed >> BUTTON_BIT) & 1))
+         bounces++;
+
+      if (r.sentUS == 0)
+         continue;
+
+      Check(r.sentUS >= r.sampleUS && r.sentUS - r.sampleUS < 1000, "sent after sampled, in the same poll");
+      lastSentUS = r.sentUS;
+
+      // time_us_32() is read just after the report is queued
+      auto it = gamepadQueuedUS.upper_bound(r.sentUS);
+
+      if (it != gamepadQueuedUS.begin())
+      {
+         --it;
+
+         if (r.sentUS - it->first <= 20)
+         {
+            Check(it->second == r.buttons, "buttons match the gamepad report");
+            matched++;
+         }
+      }
+   }
+
+   // Every gamepad report before the stall has its record
+   uint32_t gamepadBeforeStall = 0;
+
+   for (const auto &g : gamepadQueuedUS)
+      if (g.first <= lastSentUS)
+         gamepadBeforeStall++;
+
+   Check(matched == gamepadBeforeStall, "a record for every gamepad report");
+   Check(countsX == mouseXBeforeStall, "encoder counts add up to the mouse motion");
+   Check(bounces >= presses / 2, "bounce shows in the raw edges");
+
+   // Through the stall, drops are exactly the gaps and are counted
+   uint32_t gaps = 0;
+
+   for (size_t i = recordsBeforeStall; i < records.size(); i++)
+   {
+      uint16_t step = records[i].seq - records[i - 1].seq;
+
+      gaps += step - 1u;
+   }
+
+   uint16_t dropped = records.back().dropped - records[recordsBeforeStall - 1].dropped;
+
+   Check(dropped > 0, "records dropped while the host wasn't reading");
+   Check(gaps == dropped, "seq skips by the number dropped");
+   Check(host.CDCWriteAvailable() == CFG_TUD_CDC_TX_BUFSIZE || records.back().sampleUS > STOP_AT_NS / 1000 - 50000,
+         "stream caught up after the stall");
+
+   // The trace must never hold up a report
+   Check(maxPressNS[1] <= maxPressNS[0] + 50 * 1000, "presses queued as soon during the stall");
+
+   printf("dip %u: %zu records (%u bytes), %u gamepad reports matched, %u bounces seen, encoder %lld counts\n",
+          dip, records.size(), uint32_t(records.size() * sizeof(TraceRecord)), matched, bounces,
+          (long long)countsX);
+   printf("stall: %u records dropped, seq gaps %u; press to queued max %.1f us, %.1f us while stalled\n",
+          dropped, gaps, maxPressNS[0] / 1000.0, maxPressNS[1] / 1000.0);
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
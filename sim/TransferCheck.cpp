@@ -0,0 +1,210 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Counts the reports the real ArcadeCtrl::Run() loop queues for the host,
+// first over a minute of nothing happening, then through scripted presses and
+// encoder bursts. Idle, nothing should go out at all. Busy, each report should
+// only go out for a change to what it carries: a gamepad report per button
+// change, mouse reports only while an encoder is turning, and nothing in the
+// quiet gaps between.
+//
+//   TransferCheck [--dip N] [--seconds N] [--presses N] [--single-hid] [--dual-core]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t REPORT_ID_GAMEPAD  = 1;
+constexpr uint8_t REPORT_ID_MOUSE    = 2;
+constexpr uint8_t REPORT_ID_GAMEPAD2 = 3;
+
+constexpr uint32_t DIP_SHIFT = 21;
+constexpr uint32_t BUTTON    = 1u << 0;
+
+// Reports still going out this long after a change are late, not idle ones
+constexpr uint64_t SETTLE_NS = 10 * MS;
+
+int main(int argc, char **argv)
+{
+   uint32_t dip       = 0;
+   uint32_t seconds   = 60;
+   uint32_t presses   = 50;
+   bool     singleHID = false;
+   bool     dualCore  = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+         seconds = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--presses") && i + 1 < argc)
+         presses = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--single-hid"))
+         singleHID = true;
+      else if (!strcmp(argv[i], "--dual-core"))
+         dualCore = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--seconds N] [--presses N] [--single-hid] [--dual-core]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[dip];
+   cfg.splitHID = !singleHID;
+   cfg.dualCore = dualCore;
+
+   // Enumerated and settled by then
+   const uint64_t idleStart = 500 * MS;
+   const uint64_t idleEnd   = idleStart + seconds * 1000 * MS;
+
+   // Windows in which a report may go out: from a change until it has settled
+   std::vector<std::pair<uint64_t, uint64_t>> busy;
+
+   uint64_t t = idleEnd;
+
+   for (uint32_t n = 0; n < presses; n++, t += 40 * MS)
+   {
+      sim.At(t, []() { Sim::Get().PressButtons(BUTTON); });
+      sim.At(t + 20 * MS, []() { Sim::Get().ReleaseButtons(BUTTON); });
+
+      busy.push_back({ t, t + SETTLE_NS });
+      busy.push_back({ t + 20 * MS, t + 20 * MS + SETTLE_NS + cfg.releaseUS * 1000ull });
+   }
+
+   // Bursts of 100 steps 0.5ms apart, on each encoder in turn
+   constexpr uint32_t BURST_STEPS = 100;
+   constexpr uint64_t STEP_NS     = MS / 2;
+
+   uint32_t bursts = 0;
+
+   for (uint32_t n = 0; n < 20 && cfg.numEncoders > 0; n++, t += 100 * MS)
+   {
+      uint32_t encoder = n % cfg.numEncoders;
+
+      for (uint32_t s = 0; s < BURST_STEPS; s++)
+         sim.At(t + s * STEP_NS, [encoder, n]() { Sim::Get().EncoderStep(encoder, n & 2); });
+
+      busy.push_back({ t, t + BURST_STEPS * STEP_NS + SETTLE_NS });
+      bursts++;
+   }
+
+   sim.StopAt(t + 50 * MS);
+
+   uint32_t idle          = 0;
+   uint32_t outside       = 0; // After the idle minute, outside the busy windows
+   uint32_t reports[4]    = {};
+   uint64_t firstOutside  = 0;
+
+   host.onQueued = [&](const SimHost::Packet &p)
+   {
+      if (p.queuedNS < idleStart || p.data.empty())
+         return;
+
+      if (p.data[0] < 4)
+         reports[p.data[0]]++;
+
+      if (p.queuedNS < idleEnd)
+      {
+         idle++;
+         return;
+      }
+
+      bool inWindow = std::any_of(busy.begin(), busy.end(), [&](const std::pair<uint64_t, uint64_t> &w)
+      {
+         return p.queuedNS >= w.first && p.queuedNS < w.second;
+      });
+
+      if (!inWindow && outside++ == 0)
+         firstOutside = p.queuedNS;
+   };
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   const USB &usb = controller.GetUSB();
+
+   // The encoder steps on the mouse, or on nothing without encoders; the
+   // button on player 1
+   uint32_t gamepad  = reports[REPORT_ID_GAMEPAD] + reports[REPORT_ID_GAMEPAD2];
+   uint32_t mouse    = reports[REPORT_ID_MOUSE];
+   uint32_t maxMouse = bursts * uint32_t((BURST_STEPS * STEP_NS + SETTLE_NS) / MS);
+   bool     pass     = true;
+
+   if (idle != 0)
+   {
+      fprintf(stderr, "FAILED: %u reports over %u idle seconds\n", idle, seconds);
+      pass = false;
+   }
+
+   if (outside != 0)
+   {
+      fprintf(stderr, "FAILED: %u reports outside the changes, the first at %.3f ms\n", outside,
+              double(firstOutside) / MS);
+      pass = false;
+   }
+
+   if (gamepad != 2 * presses)
+   {
+      fprintf(stderr, "FAILED: %u gamepad reports for %u button changes\n", gamepad, 2 * presses);
+      pass = false;
+   }
+
+   if ((bursts > 0 && mouse == 0) || mouse > maxMouse)
+   {
+      fprintf(stderr, "FAILED: %u mouse reports for %u bursts, at most %u expected\n", mouse, bursts, maxMouse);
+      pass = false;
+   }
+
+   printf("dip %u, %s%s: %u reports over %u idle seconds; %u button changes sent in %u gamepad reports, "
+          "%u encoder bursts in %u mouse reports, %u outside the changes\n", dip,
+          usb.NumHIDInterfaces() > 1 ? "2 HID interfaces" : "1 HID interface", dualCore ? ", dual core" : "",
+          idle, seconds, 2 * presses, gamepad, bursts, mouse, outside);
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Drives the tuning feature report through the real ArcadeCtrl::Run() loop
+// with GET_REPORT and SET_REPORT from the simulated host, as the ArcadeTune
+// tool does over hidraw, and checks:
+//
+// Get: the build's values come back, with the fields this board can tune.
+// Apply: a new gain scales the counts the host receives from then on, a new
+// sampling interval changes how often mouse reports arrive, and a get reads
+// both back.
+// Rejects: bad versions, sizes, out of range values and fields the board
+// doesn't have are refused with the right status, changing nothing.
+// Save: the values are in flash for the next boot.
+//
+// With --pio-sampler the board samples its buttons with PIO + DMA, whose
+// ring only lasts so long between polls, and intervals past it are refused.
+//
+//   TuneCheck [--dip N] [--pio-sampler]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+#include "tusb.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+constexpr uint64_t MS = 1000 * 1000;
+
+constexpr uint8_t HID_INSTANCE_GAMEPAD = 0;
+constexpr uint8_t REPORT_ID_MOUSE      = 2;
+
+constexpr uint32_t DIP_SHIFT = 21;
+
+constexpr uint32_t TUNED_POLL_MS    = 16;
+constexpr uint32_t SAMPLER_POLL_MS  = 8;  // The slowest the PIO sampler's ring lasts
+constexpr uint32_t HOST_INTERVAL_MS = 4;
+constexpr float    TUNED_GAIN       = 2.5f;
+constexpr uint32_t TUNED_RELEASE_US = 3000;
+constexpr uint32_t SAVED_RELEASE_US = 4000;
+
+static uint32_t s_failures = 0;
+
+static void Check(bool ok, const char *what)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAILED: %s\n", what);
+      s_failures++;
+   }
+}
+
+static void Get(TuningReport *report)
+{
+   SimHost::Get().GetReport(HID_INSTANCE_GAMEPAD, TUNING_REPORT_ID, HID_REPORT_TYPE_FEATURE, sizeof(*report) + 1,
+                            [report](const std::vector<uint8_t> &data)
+   {
+      Check(data.size() == sizeof(*report) + 1 && data[0] == TUNING_REPORT_ID, "get returns the tuning report");
+
+      if (data.size() == sizeof(*report) + 1)
+         memcpy(report, data.data() + 1, sizeof(*report));
+      else
+         memset(report, 0, sizeof(*report));
+   });
+}
+
+static void Set(const TuningReport &report, size_t len = sizeof(TuningReport))
+{
+   std::vector<uint8_t> data(1 + len);
+   data[0] = TUNING_REPORT_ID;
+   memcpy(data.data() + 1, &report, std::min(len, sizeof(report)));
+
+   SimHost::Get().SetReport(HID_INSTANCE_GAMEPAD, HID_REPORT_TYPE_FEATURE, data);
+}
+
+static TuningReport Request(uint8_t command, uint16_t fields)
+{
+   TuningReport req = {};
+   req.version = TUNING_VERSION;
+   req.command = command;
+   req.fields  = fields;
+   return req;
+}
+
+int main(int argc, char **argv)
+{
+   uint32_t dip        = 0;
+   bool     pioSampler = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--dip") && i + 1 < argc)
+         dip = strtol(argv[++i], nullptr, 0) & 3;
+      else if (!strcmp(argv[i], "--pio-sampler"))
+         pioSampler = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--dip N] [--pio-sampler]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   Sim     &sim  = Sim::Get();
+   SimHost &host = SimHost::Get();
+
+   sim.SetGPIOLevels(dip << DIP_SHIFT, false);
+
+   // Counts must come out at exactly the gain, so no acceleration curve
+   ArcadeCtrl::s_boardConfigs[dip].accel      = nullptr;
+   ArcadeCtrl::s_boardConfigs[dip].pioSampler = pioSampler;
+
+   const ArcadeCtrl::BoardConfig built = ArcadeCtrl::s_boardConfigs[dip];
+   const uint32_t tunedPollMS = pioSampler ? SAMPLER_POLL_MS : TUNED_POLL_MS;
+
+   if (built.numEncoders == 0 || built.sofLeadUS != 0)
+   {
+      fprintf(stderr, "dip %u needs an encoder and not to be synced to SOF\n", dip);
+      return 1;
+   }
+
+   // Mouse counts and reports received, per phase
+   int64_t  steps       = 0;
+   int64_t  received    = 0;
+   uint32_t reports     = 0;
+   bool     counting    = false;
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      if (p.data.size() < 6 || p.data[0] != REPORT_ID_MOUSE)
+         return;
+
+      received += int16_t(p.data[2] | (p.data[3] << 8));
+
+      if (counting)
+         reports++;
+   };
+
+   // Encoder 0 turns steadily at 2kHz for a second from start, with reports
+   // counted over the middle 800ms
+   auto spin = [&](uint64_t start)
+   {
+      for (uint64_t t = start; t < start + 1000 * MS; t += MS / 2)
+         sim.At(t, [&]() { Sim::Get().EncoderStep(0, false); steps++; });
+
+      sim.At(start + 100 * MS, [&]() { counting = true; reports = 0; });
+      sim.At(start + 900 * MS, [&]() { counting = false; });
+   };
+
+   TuningReport got = {};
+   uint32_t     reportsBefore = 0;
+   int64_t      gainCheck[2]  = {};
+
+   // Defaults, taken as soon as the host has enumerated
+   Get(&got);
+
+   sim.At(150 * MS, [&]()
+   {
+      uint16_t tunable = TUNE_POLL_MS | TUNE_RELEASE_US | TUNE_CONFIRM_US | TUNE_GAIN;
+
+      Check(got.version == TUNING_VERSION && got.status == TUNING_OK, "get version and status");
+      Check(got.fields == tunable, "get lists what the board can tune");
+      Check(got.pollMS == built.pollMS && got.releaseUS == built.releaseUS &&
+            got.encoderGain == Encoder::ToFixed(built.encoderGain), "get returns the built values");
+      Check(got.hidIntervalMS != 0, "get reports the host interval");
+   });
+
+   spin(200 * MS);
+
+   sim.At(1300 * MS, [&]()
+   {
+      gainCheck[0]  = received - (steps * Encoder::ToFixed(built.encoderGain) >> Encoder::GAIN_FRAC_BITS);
+      reportsBefore = reports;
+      steps         = 0;
+      received      = 0;
+
+      TuningReport req = Request(TUNING_APPLY, TUNE_POLL_MS | TUNE_GAIN | TUNE_RELEASE_US);
+      req.pollMS      = tunedPollMS;
+      req.encoderGain = Encoder::ToFixed(TUNED_GAIN);
+      req.releaseUS   = TUNED_RELEASE_US;
+      Set(req);
+   });
+
+   sim.At(1350 * MS, [&]() { Get(&got); });
+   sim.At(1360 * MS, [&]()
+   {
+      Check(got.status == TUNING_OK, "apply status");
+      Check(got.pollMS == tunedPollMS && got.releaseUS == TUNED_RELEASE_US &&
+            got.encoderGain == Encoder::ToFixed(TUNED_GAIN) && got.confirmUS == built.confirmUS,
+            "get returns the applied values and leaves the rest");
+   });
+
+   spin(1400 * MS);
+
+   sim.At(2500 * MS, [&]()
+   {
+      gainCheck[1] = received - (steps * Encoder::ToFixed(TUNED_GAIN) >> Encoder::GAIN_FRAC_BITS);
+   });
+
+   // Each of these must be refused
+   struct Reject
+   {
+      TuningReport req;
+      size_t       len;
+      uint8_t      status;
+      const char  *what;
+   };
+
+   std::vector<Reject> rejects;
+
+   auto reject = [&](uint8_t status, const char *what, uint16_t fields, void (*edit)(TuningReport *), size_t len = sizeof(TuningReport))
+   {
+      TuningReport req = Request(TUNING_SAVE, fields);
+      edit(&req);
+      rejects.push_back({ req, len, status, what });
+   };
+
+   reject(TUNING_BAD_REQUEST,  "wrong version",      TUNE_POLL_MS,    [](TuningReport *r) { r->version = TUNING_VERSION + 1; r->pollMS = 2; });
+   reject(TUNING_BAD_REQUEST,  "unknown command",    TUNE_POLL_MS,    [](TuningReport *r) { r->command = 9; r->pollMS = 2; });
+   reject(TUNING_BAD_REQUEST,  "short report",       TUNE_POLL_MS,    [](TuningReport *r) { r->pollMS = 2; }, sizeof(TuningReport) - 4);
+   reject(TUNING_OUT_OF_RANGE, "zero poll interval", TUNE_POLL_MS,    [](TuningReport *r) { r->pollMS = 0; });
+   reject(TUNING_OUT_OF_RANGE, "zero gain",          TUNE_GAIN,       [](TuningReport *r) { r->encoderGain = 0; });
+   reject(TUNING_OUT_OF_RANGE, "long release",       TUNE_RELEASE_US, [](TuningReport *r) { r->releaseUS = 10000000; });
+   reject(TUNING_NOT_TUNABLE,  "SOF lead, unsynced", TUNE_SOF_LEAD,   [](TuningReport *r) { r->sofLeadUS = 500; });
+
+   if (built.numAnalogs == 0)
+      reject(TUNING_NOT_TUNABLE, "filter, no analogs", TUNE_FILTER, [](TuningReport *r) { r->filterShift = 3; });
+
+   // Past the 9.9ms the sampler's ring lasts, with a millisecond for a late poll
+   if (built.pioSampler)
+      reject(TUNING_OUT_OF_RANGE, "poll past the sampler ring", TUNE_POLL_MS, [](TuningReport *r) { r->pollMS = 10; });
+
+   std::vector<TuningReport> afterReject(rejects.size());
+
+   for (size_t i = 0; i < rejects.size(); i++)
+   {
+      uint64_t t = (2600 + i * 20) * MS;
+
+      sim.At(t, [&, i]() { Set(rejects[i].req, rejects[i].len); Get(&afterReject[i]); });
+   }
+
+   // Save just one field; what was applied before goes with it
+   uint64_t saveAt = (2600 + rejects.size() * 20 + 100) * MS;
+
+   sim.At(saveAt, [&]()
+   {
+      TuningReport req = Request(TUNING_SAVE, TUNE_RELEASE_US);
+      req.releaseUS = SAVED_RELEASE_US;
+      Set(req);
+      Get(&got);
+   });
+
+   TuningReport saved = {};
+
+   sim.At(saveAt + 50 * MS, [&]() { Get(&saved); });
+   sim.StopAt(saveAt + 100 * MS);
+
+   ArcadeCtrl controller;
+
+   try
+   {
+      controller.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   Check(gainCheck[0] == 0, "built gain applied to counts");
+   Check(gainCheck[1] == 0, "tuned gain applied to counts");
+
+   // The host takes a report every 4ms, so the build's 1ms sampling fills each
+   // of those, and slower sampling only one in tunedPollMS / 4
+   Check(reportsBefore > 150 && reports > 0 &&
+         reports * tunedPollMS < reportsBefore * HOST_INTERVAL_MS * 5 / 4, "sampling interval changes the report rate");
+
+   for (size_t i = 0; i < rejects.size(); i++)
+   {
+      const TuningReport &r = afterReject[i];
+
+      if (r.status != rejects[i].status || r.pollMS != tunedPollMS || r.releaseUS != TUNED_RELEASE_US ||
+          r.encoderGain != Encoder::ToFixed(TUNED_GAIN))
+      {
+         fprintf(stderr, "%s: status %u, wanted %u\n", rejects[i].what, r.status, rejects[i].status);
+         Check(false, "rejected and nothing changed");
+      }
+   }
+
+   // A get straight after the save is before the loop has applied it
+   Check(got.status == TUNING_PENDING, "save pending until done");
+   Check(saved.status == TUNING_OK && saved.releaseUS == SAVED_RELEASE_US, "save status");
+
+   ArcadeCtrl::BoardConfig boot = built;
+
+   Check(ArcadeCtrl::LoadBoardConfig(dip, &boot) && boot.pollMS == tunedPollMS &&
+         boot.releaseUS == SAVED_RELEASE_US && boot.encoderGain == TUNED_GAIN && boot.confirmUS == built.confirmUS,
+         "saved values in flash for the next boot");
+
+   printf("dip %u: %u mouse reports in 800ms at %ums sampling, %u at %ums; %zu bad sets refused\n",
+          dip, reportsBefore, built.pollMS, reports, tunedPollMS, rejects.size());
+
+   printf("%s\n", s_failures == 0 ? "PASS" : "FAIL");
+   return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Autofire through the real ArcadeCtrl::Run() loop over a long run. One turbo
+// button is held throughout, another is held on and off at random, and a
+// plain button is tapped alongside. From the reports the host gets, and the
+// frames it gets them in, every on and off state of a held turbo button must
+// last exactly the configured number of polls, both turbo buttons must be in
+// the same phase, and the plain button's presses must all arrive. The host's
+// frames can run fast or slow of the device clock.
+//
+//   TurboCheck [--polls N] [--seconds N] [--drift-ppm N] [--dual-core]
+
+#include "ArcadeCtrl.h"
+#include "Sim.h"
+#include "SimHost.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+constexpr uint64_t US = 1000;
+constexpr uint64_t MS = 1000 * US;
+
+constexpr uint8_t  REPORT_ID_GAMEPAD = 1;
+constexpr uint32_t DIP               = 2;
+constexpr uint32_t DIP_SHIFT         = 21;
+
+// Button GPIOs
+constexpr uint32_t HELD  = 1u << 0; // Turbo, down all run
+constexpr uint32_t TAPS  = 1u << 1; // Turbo, down and up
+constexpr uint32_t PLAIN = 1u << 2;
+
+int main(int argc, char **argv)
+{
+   uint32_t polls    = 2;
+   uint32_t seconds  = 60;
+   int32_t  driftPPM = 0;
+   bool     dualCore = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--polls") && i + 1 < argc)
+         polls = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+         seconds = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--drift-ppm") && i + 1 < argc)
+         driftPPM = strtol(argv[++i], nullptr, 0);
+      else if (!strcmp(argv[i], "--dual-core"))
+         dualCore = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--polls N] [--seconds N] [--drift-ppm N] [--dual-core]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (polls == 0)
+   {
+      fprintf(stderr, "--polls must be at least 1\n");
+      return 1;
+   }
+
+   std::mt19937 rng(1);
+   Sim         &sim  = Sim::Get();
+   SimHost     &host = SimHost::Get();
+
+   sim.SetGPIOLevels(DIP << DIP_SHIFT, false);
+
+   ArcadeCtrl::BoardConfig &cfg = ArcadeCtrl::s_boardConfigs[DIP];
+   cfg.turboMask  = HELD | TAPS;
+   cfg.turboPolls = polls;
+   cfg.dualCore   = dualCore;
+
+   host.frameNS = uint64_t(int64_t(MS) + driftPPM);
+
+   uint64_t startNS = 300 * MS;
+   uint64_t endNS   = startNS + uint64_t(seconds) * 1000 * MS;
+
+   sim.At(startNS, []() { Sim::Get().PressButtons(HELD); });
+
+   // Down and up for long enough to cover a few turbo cycles
+   std::uniform_int_distribution<uint64_t> tapsLength(40 * MS, 300 * MS);
+   std::uniform_int_distribution<uint64_t> plainLength(20 * MS, 120 * MS);
+
+   for (uint64_t t = startNS; t + 700 * MS < endNS;)
+   {
+      uint64_t down = tapsLength(rng);
+
+      sim.At(t, []() { Sim::Get().PressButtons(TAPS); });
+      sim.At(t + down, []() { Sim::Get().ReleaseButtons(TAPS); });
+      t += down + tapsLength(rng);
+   }
+
+   uint32_t plainTaps = 0;
+
+   for (uint64_t t = startNS + 7 * MS; t + 300 * MS < endNS; plainTaps++)
+   {
+      uint64_t down = plainLength(rng);
+
+      sim.At(t, []() { Sim::Get().PressButtons(PLAIN); });
+      sim.At(t + down, []() { Sim::Get().ReleaseButtons(PLAIN); });
+      t += down + plainLength(rng);
+   }
+
+   sim.StopAt(endNS);
+
+   ArcadeCtrl *controller = nullptr;
+
+   // Each state change of the held button, by the host's frame number
+   uint32_t lastButtons  = 0;
+   uint32_t lastChange   = 0;
+   uint32_t heldChanges  = 0;
+   uint32_t runs         = 0;
+   uint32_t wrongRuns    = 0;
+   uint32_t outOfPhase   = 0;
+   uint32_t plainPresses = 0;
+   int32_t  worstFrames  = 0; // Furthest from the right length, signed
+
+   host.onDelivered = [&](const SimHost::Packet &p, uint64_t)
+   {
+      uint32_t buttons = 0;
+      uint32_t frame   = SimHost::Get().FrameNumber();
+
+      if (p.data.size() < 11 || p.data[0] != REPORT_ID_GAMEPAD)
+         return;
+
+      memcpy(&buttons, &p.data[7], sizeof(buttons));
+
+      uint32_t changed = buttons ^ lastButtons;
+
+      // Held through the report before as well, so neither end is a press or a release
+      if ((buttons & lastButtons & TAPS) && (buttons & HELD) != ((buttons & TAPS) >> 1))
+         outOfPhase++;
+
+      if ((buttons & ~lastButtons) & PLAIN)
+         plainPresses++;
+
+      if (changed & HELD)
+      {
+         // The first is the press, down until turbo starts; from there on each is a flip
+         if (heldChanges >= 2)
+         {
+            uint32_t pollFrames = controller->GetUSB().PollPeriodUS() / 1000;
+            int32_t  error      = int32_t(frame - lastChange) - int32_t(polls * pollFrames);
+
+            runs++;
+
+            if (error != 0)
+            {
+               wrongRuns++;
+
+               if (abs(error) > abs(worstFrames))
+                  worstFrames = error;
+            }
+         }
+
+         heldChanges++;
+         lastChange = frame;
+      }
+
+      lastButtons = buttons;
+   };
+
+   ArcadeCtrl ctrl;
+
+   controller = &ctrl;
+
+   try
+   {
+      ctrl.Run();
+   }
+   catch (const Sim::Stop &)
+   {
+   }
+
+   Autofire::Stats stats = ctrl.GetAutofire().GetStats();
+   bool            pass  = true;
+
+   // A few seconds of runs at the least, whatever the cadence
+   if (runs < seconds * 100 / (polls * 8))
+   {
+      fprintf(stderr, "FAILED: only %u turbo runs in %u s\n", runs, seconds);
+      pass = false;
+   }
+
+   if (wrongRuns != 0)
+   {
+      fprintf(stderr, "FAILED: %u of %u runs not %u polls long, worst off by %d frames\n", wrongRuns, runs, polls,
+              worstFrames);
+      pass = false;
+   }
+
+   if (outOfPhase != 0)
+   {
+      fprintf(stderr, "FAILED: turbo buttons out of phase in %u reports\n", outOfPhase);
+      pass = false;
+   }
+
+   if (plainPresses != plainTaps)
+   {
+      fprintf(stderr, "FAILED: plain button tapped %u times, host saw %u presses\n", plainTaps, plainPresses);
+      pass = false;
+   }
+
+   printf("%u polls per state, %u s%s, host clock %+d ppm: %u runs, %u wrong; %u out of phase; "
+          "%u of %u plain presses; %u flips, %u missed\n", polls, seconds, dualCore ? ", dual core" : "", driftPPM,
+          runs, wrongRuns, outOfPhase, plainPresses, plainTaps, stats.flips, stats.missed);
+
+   printf("%s\n", pass ? "PASS" : "FAIL");
+   return pass ? 0 : 1;
+}
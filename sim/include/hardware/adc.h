@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for hardware/adc.h. Conversions return whatever Sim
+// has been scripted to present on the selected input. Free-running mode is
+// only modelled with DMA draining the FIFO, see dma.h.
+
+#pragma once
+
+#include "pico/types.h"
+
+void     adc_init();
+void     adc_gpio_init(uint gpio);
+void     adc_select_input(uint input);
+uint16_t adc_read();
+void     adc_set_clkdiv(float clkdiv);
+void     adc_set_round_robin(uint input_mask);
+void     adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void     adc_fifo_drain();
+void     adc_run(bool run);
+
+#define ADC_CS_READY_BITS 0x00000100
+
+// Free-running conversions are over as soon as they stop, so READY always reads set
+typedef struct
+{
+   uint32_t cs;
+   uint32_t result;
+   uint32_t fcs;
+   uint32_t fifo;
+   uint32_t div;
+} adc_hw_t;
+
+extern adc_hw_t sim_adc_hw;
+
+#define adc_hw (&sim_adc_hw)
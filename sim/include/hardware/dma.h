@@ -0,0 +1,97 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for hardware/dma.h. The only transfers modelled
+// are from a PIO RX FIFO or the ADC FIFO into a write ring, paced by the
+// state machine's clock divider or the ADC's. Reading a channel's write address brings the transfer up to
+// the simulated time first. Transfer counts are not modelled; the channel
+// simply never runs out.
+
+#pragma once
+
+#include "pico/types.h"
+
+#define NUM_DMA_CHANNELS 12
+
+// Reading it catches the simulated transfer up to the current time
+struct sim_dma_write_addr_reg
+{
+   operator uint32_t() const;
+
+   uint32_t value = 0;
+};
+
+typedef struct
+{
+   uint32_t               read_addr;
+   sim_dma_write_addr_reg write_addr;
+   uint32_t               transfer_count;
+   uint32_t               ctrl_trig;
+   uint32_t               al1_transfer_count_trig;
+} dma_channel_hw_t;
+
+typedef struct
+{
+   dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+} dma_hw_t;
+
+extern dma_hw_t sim_dma_hw;
+
+#define dma_hw (&sim_dma_hw)
+
+enum dma_channel_transfer_size
+{
+   DMA_SIZE_8  = 0,
+   DMA_SIZE_16 = 1,
+   DMA_SIZE_32 = 2
+};
+
+enum dreq_num_rp2040
+{
+   DREQ_PIO0_TX0 = 0,
+   DREQ_PIO0_RX0 = 4,
+   DREQ_PIO1_TX0 = 8,
+   DREQ_PIO1_RX0 = 12,
+   DREQ_ADC      = 36,
+   DREQ_FORCE    = 63,
+};
+
+typedef struct
+{
+   uint32_t ctrl;
+} dma_channel_config;
+
+int  dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_ring(dma_channel_config *c, bool write, uint sizeBits);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config *c, uint chainTo);
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *writeAddr,
+                           const volatile void *readAddr, uint transferCount, bool trigger);
@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for hardware/gpio.h. Pin levels come from Sim, which
+// models the pulled-up inputs being shorted to ground by the buttons.
+
+#pragma once
+
+#include "pico/types.h"
+#include "hardware/irq.h"
+
+void gpio_init(uint gpio);
+void gpio_init_mask(uint32_t mask);
+void gpio_set_dir_in_masked(uint32_t mask);
+void gpio_set_dir_out_masked(uint32_t mask);
+void gpio_pull_up(uint gpio);
+
+uint32_t gpio_get_all();
+bool     gpio_get(uint gpio);
+
+enum gpio_irq_level
+{
+   GPIO_IRQ_LEVEL_LOW  = 0x1u,
+   GPIO_IRQ_LEVEL_HIGH = 0x2u,
+   GPIO_IRQ_EDGE_FALL  = 0x4u,
+   GPIO_IRQ_EDGE_RISE  = 0x8u,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t events);
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback);
+
+void gpio_set_mask(uint32_t mask);
+void gpio_clr_mask(uint32_t mask);
+void gpio_put(uint gpio, bool value);
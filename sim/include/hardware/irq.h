@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for hardware/irq.h. Handlers are called by Sim when
+// the simulated peripheral raises the interrupt and it is enabled.
+
+#pragma once
+
+#include "pico/types.h"
+
+typedef void (*irq_handler_t)();
+
+enum irq_num_rp2040
+{
+   TIMER_IRQ_0  = 0,
+   TIMER_IRQ_1  = 1,
+   TIMER_IRQ_2  = 2,
+   TIMER_IRQ_3  = 3,
+   PWM_IRQ_WRAP = 4,
+   USBCTRL_IRQ  = 5,
+   XIP_IRQ      = 6,
+   PIO0_IRQ_0   = 7,
+   PIO0_IRQ_1   = 8,
+   PIO1_IRQ_0   = 9,
+   PIO1_IRQ_1   = 10,
+   DMA_IRQ_0    = 11,
+   DMA_IRQ_1    = 12,
+   IO_IRQ_BANK0 = 13,
+   IO_IRQ_QSPI  = 14,
+   SIO_IRQ_PROC0 = 15,
+   SIO_IRQ_PROC1 = 16,
+   CLOCKS_IRQ   = 17,
+   SPI0_IRQ     = 18,
+   SPI1_IRQ     = 19,
+   UART0_IRQ    = 20,
+   UART1_IRQ    = 21,
+   ADC_IRQ_FIFO = 22,
+   I2C0_IRQ     = 23,
+   I2C1_IRQ     = 24,
+   RTC_IRQ      = 25,
+   NUM_IRQS     = 32
+};
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for hardware/pio.h. Only the parts of the PIO block
+// the firmware touches are modelled: program loading, state machine claiming,
+// the IRQ flag register the encoder handlers read and clear, and the RX FIFOs
+// as a DMA source (see hardware/dma.h) or as read by the counting encoder.
+
+#pragma once
+
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+// Write-one-to-clear register, as the PIO IRQ flags are on the real hardware
+struct sim_w1c_reg
+{
+   operator uint32_t() const { return value; }
+   sim_w1c_reg &operator=(uint32_t clearBits) { value &= ~clearBits; return *this; }
+
+   uint32_t value = 0;
+};
+
+typedef struct
+{
+   sim_w1c_reg irq;
+   uint32_t    inte0;
+   uint32_t    inte1;
+   uint32_t    rxf[4];
+} pio_hw_t;
+
+extern pio_hw_t sim_pio_hw[2];
+
+#define pio0_hw (&sim_pio_hw[0])
+#define pio1_hw (&sim_pio_hw[1])
+
+typedef pio_hw_t *PIO;
+
+#define pio0 pio0_hw
+#define pio1 pio1_hw
+
+#define PIO_IRQ0_INTE_SM0_BITS 0x00000100u
+#define PIO_IRQ0_INTE_SM1_BITS 0x00000200u
+#define PIO_IRQ0_INTE_SM2_BITS 0x00000400u
+#define PIO_IRQ0_INTE_SM3_BITS 0x00000800u
+
+typedef struct pio_program
+{
+   const uint16_t *instructions;
+   uint8_t         length;
+   int8_t          origin;
+} pio_program_t;
+
+enum pio_fifo_join
+{
+   PIO_FIFO_JOIN_NONE = 0,
+   PIO_FIFO_JOIN_TX   = 1,
+   PIO_FIFO_JOIN_RX   = 2,
+};
+
+typedef struct
+{
+   uint32_t clkdiv;
+   uint32_t execctrl;
+   uint32_t shiftctrl;
+   uint32_t pinctrl;
+} pio_sm_config;
+
+pio_sm_config pio_get_default_sm_config();
+
+void sm_config_set_wrap(pio_sm_config *c, uint wrapTarget, uint wrap);
+void sm_config_set_in_pins(pio_sm_config *c, uint inBase);
+void sm_config_set_in_shift(pio_sm_config *c, bool shiftRight, bool autopush, uint pushThreshold);
+void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join);
+void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t divInt, uint8_t divFrac);
+
+void pio_gpio_init(PIO pio, uint pin);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int  pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_init(PIO pio, uint sm, uint initialPC, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+uint pio_get_dreq(PIO pio, uint sm, bool isTX);
+
+// Sim only: the config and start address a state machine was last
+// initialised with, so a program's own init function can be checked
+const pio_sm_config &sim_pio_sm_config(PIO pio, uint sm, uint *initialPC);
+
+// The only RX FIFO the CPU reads is the counting encoder program's, so these
+// return that encoder's step count, fresh on every read
+uint     pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
@@ -0,0 +1,59 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for pico/time.h. Time is the simulated clock owned
+// by Sim, so reading it charges a little simulated CPU time.
+
+#pragma once
+
+#include "pico/types.h"
+
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time();
+
+uint32_t time_us_32();
+uint64_t time_us_64();
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+// Waits in WFE until an event or the timeout, true if it was the timeout
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+   return t;
+}
+
+static inline absolute_time_t from_us_since_boot(uint64_t us)
+{
+   return us;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t)
+{
+   return uint32_t(t / 1000);
+}
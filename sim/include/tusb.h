@@ -0,0 +1,479 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Host simulation stand-in for the subset of TinyUSB the firmware uses. The
+// descriptor macros and report structs match TinyUSB's so the firmware builds
+// the same bytes it would on the device. Transfers go to the simulated host in
+// SimHost, which polls the interrupt endpoints on a 1ms frame clock.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "pico/types.h"
+
+#define OPT_MCU_RP2040        1900
+#define OPT_OS_NONE           1
+#define OPT_MODE_DEVICE       0x0001
+#define OPT_MODE_HOST         0x0002
+#define OPT_MODE_FULL_SPEED   0x0000
+#define OPT_MODE_HIGH_SPEED   0x0400
+
+#include "tusb_config.h"
+
+//--------------------------------------------------------------------+
+// Common descriptor definitions
+//--------------------------------------------------------------------+
+
+#define TU_BIT(n)              (1UL << (n))
+#define TU_U16_HIGH(u16)       ((uint8_t)(((u16) >> 8) & 0x00ff))
+#define TU_U16_LOW(u16)        ((uint8_t)((u16) & 0x00ff))
+#define U16_TO_U8S_LE(u16)     TU_U16_LOW(u16), TU_U16_HIGH(u16)
+#define TU_U32_BYTE3(u32)      ((uint8_t)((((uint32_t)u32) >> 24) & 0x000000ff))
+#define TU_U32_BYTE2(u32)      ((uint8_t)((((uint32_t)u32) >> 16) & 0x000000ff))
+#define TU_U32_BYTE1(u32)      ((uint8_t)((((uint32_t)u32) >>  8) & 0x000000ff))
+#define TU_U32_BYTE0(u32)      ((uint8_t)(((uint32_t)u32)         & 0x000000ff))
+#define U32_TO_U8S_LE(u32)     TU_U32_BYTE0(u32), TU_U32_BYTE1(u32), TU_U32_BYTE2(u32), TU_U32_BYTE3(u32)
+
+enum
+{
+   TUSB_DESC_DEVICE        = 0x01,
+   TUSB_DESC_CONFIGURATION = 0x02,
+   TUSB_DESC_STRING        = 0x03,
+   TUSB_DESC_INTERFACE     = 0x04,
+   TUSB_DESC_ENDPOINT      = 0x05,
+   TUSB_DESC_INTERFACE_ASSOCIATION = 0x0B,
+   TUSB_DESC_CS_INTERFACE  = 0x24,
+};
+
+enum
+{
+   TUSB_XFER_CONTROL     = 0,
+   TUSB_XFER_ISOCHRONOUS = 1,
+   TUSB_XFER_BULK        = 2,
+   TUSB_XFER_INTERRUPT   = 3,
+};
+
+enum
+{
+   TUSB_CLASS_CDC      = 2,
+   TUSB_CLASS_HID      = 3,
+   TUSB_CLASS_CDC_DATA = 10,
+   TUSB_CLASS_MISC     = 0xEF,
+};
+
+enum
+{
+   MISC_SUBCLASS_COMMON = 2,
+   MISC_PROTOCOL_IAD    = 1,
+};
+
+enum
+{
+   TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP = TU_BIT(5),
+   TUSB_DESC_CONFIG_ATT_SELF_POWERED  = TU_BIT(6),
+};
+
+typedef struct __attribute__((packed))
+{
+   uint8_t  bLength;
+   uint8_t  bDescriptorType;
+   uint16_t bcdUSB;
+   uint8_t  bDeviceClass;
+   uint8_t  bDeviceSubClass;
+   uint8_t  bDeviceProtocol;
+   uint8_t  bMaxPacketSize0;
+   uint16_t idVendor;
+   uint16_t idProduct;
+   uint16_t bcdDevice;
+   uint8_t  iManufacturer;
+   uint8_t  iProduct;
+   uint8_t  iSerialNumber;
+   uint8_t  bNumConfigurations;
+} tusb_desc_device_t;
+
+#define TUD_CONFIG_DESC_LEN (9)
+
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len, _attribute, _power_ma) \
+  9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount, config_num, _stridx, TU_BIT(7) | _attribute, (_power_ma)/2
+
+//--------------------------------------------------------------------+
+// HID
+//--------------------------------------------------------------------+
+
+enum
+{
+   HID_SUBCLASS_NONE = 0,
+   HID_SUBCLASS_BOOT = 1
+};
+
+enum
+{
+   HID_ITF_PROTOCOL_NONE     = 0,
+   HID_ITF_PROTOCOL_KEYBOARD = 1,
+   HID_ITF_PROTOCOL_MOUSE    = 2
+};
+
+enum
+{
+   HID_DESC_TYPE_HID      = 0x21,
+   HID_DESC_TYPE_REPORT   = 0x22,
+   HID_DESC_TYPE_PHYSICAL = 0x23
+};
+
+typedef enum
+{
+   HID_REPORT_TYPE_INVALID = 0,
+   HID_REPORT_TYPE_INPUT,
+   HID_REPORT_TYPE_OUTPUT,
+   HID_REPORT_TYPE_FEATURE
+} hid_report_type_t;
+
+#define TUD_HID_DESC_LEN (9 + 9 + 7)
+
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize, _ep_interval) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_HID, (uint8_t)((_boot_protocol) ? (uint8_t)HID_SUBCLASS_BOOT : 0), _boot_protocol, _stridx,\
+  /* HID descriptor */\
+  9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(_report_desc_len),\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
+typedef struct __attribute__((packed))
+{
+   int8_t   x;
+   int8_t   y;
+   int8_t   z;
+   int8_t   rz;
+   int8_t   rx;
+   int8_t   ry;
+   uint8_t  hat;
+   uint32_t buttons;
+} hid_gamepad_report_t;
+
+typedef struct __attribute__((packed))
+{
+   uint8_t buttons;
+   int8_t  x;
+   int8_t  y;
+   int8_t  wheel;
+   int8_t  pan;
+} hid_mouse_report_t;
+
+// Report descriptor items
+#define HID_REPORT_DATA_0(data)
+#define HID_REPORT_DATA_1(data) , data
+#define HID_REPORT_DATA_2(data) , U16_TO_U8S_LE(data)
+#define HID_REPORT_DATA_3(data) , U32_TO_U8S_LE(data)
+
+#define HID_REPORT_ITEM(data, tag, type, size) \
+  (((tag) << 4) | ((type) << 2) | (size)) HID_REPORT_DATA_##size(data)
+
+#define RI_TYPE_MAIN   0
+#define RI_TYPE_GLOBAL 1
+#define RI_TYPE_LOCAL  2
+
+#define HID_DATA             (0<<0)
+#define HID_CONSTANT         (1<<0)
+#define HID_ARRAY            (0<<1)
+#define HID_VARIABLE         (1<<1)
+#define HID_ABSOLUTE         (0<<2)
+#define HID_RELATIVE         (1<<2)
+#define HID_WRAP_NO          (0<<3)
+#define HID_LINEAR           (0<<4)
+#define HID_PREFERRED_STATE  (0<<5)
+#define HID_NO_NULL_POSITION (0<<6)
+#define HID_NON_VOLATILE     (0<<7)
+#define HID_BITFIELD         (0<<8)
+
+#define HID_INPUT(x)           HID_REPORT_ITEM(x, 8, RI_TYPE_MAIN, 1)
+#define HID_OUTPUT(x)          HID_REPORT_ITEM(x, 9, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION(x)      HID_REPORT_ITEM(x, 10, RI_TYPE_MAIN, 1)
+#define HID_FEATURE(x)         HID_REPORT_ITEM(x, 11, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION_END     HID_REPORT_ITEM(x, 12, RI_TYPE_MAIN, 0)
+
+#define HID_USAGE_PAGE(x)         HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE_PAGE_N(x, n)    HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, n)
+#define HID_LOGICAL_MIN(x)        HID_REPORT_ITEM(x, 1, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MIN_N(x, n)   HID_REPORT_ITEM(x, 1, RI_TYPE_GLOBAL, n)
+#define HID_LOGICAL_MAX(x)        HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX_N(x, n)   HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, n)
+#define HID_PHYSICAL_MIN(x)       HID_REPORT_ITEM(x, 3, RI_TYPE_GLOBAL, 1)
+#define HID_PHYSICAL_MIN_N(x, n)  HID_REPORT_ITEM(x, 3, RI_TYPE_GLOBAL, n)
+#define HID_PHYSICAL_MAX(x)       HID_REPORT_ITEM(x, 4, RI_TYPE_GLOBAL, 1)
+#define HID_PHYSICAL_MAX_N(x, n)  HID_REPORT_ITEM(x, 4, RI_TYPE_GLOBAL, n)
+#define HID_REPORT_SIZE(x)        HID_REPORT_ITEM(x, 7, RI_TYPE_GLOBAL, 1)
+#define HID_REPORT_ID(x)          HID_REPORT_ITEM(x, 8, RI_TYPE_GLOBAL, 1),
+#define HID_REPORT_COUNT(x)       HID_REPORT_ITEM(x, 9, RI_TYPE_GLOBAL, 1)
+#define HID_REPORT_COUNT_N(x, n)  HID_REPORT_ITEM(x, 9, RI_TYPE_GLOBAL, n)
+
+#define HID_USAGE(x)              HID_REPORT_ITEM(x, 0, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_N(x, n)         HID_REPORT_ITEM(x, 0, RI_TYPE_LOCAL, n)
+#define HID_USAGE_MIN(x)          HID_REPORT_ITEM(x, 1, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MIN_N(x, n)     HID_REPORT_ITEM(x, 1, RI_TYPE_LOCAL, n)
+#define HID_USAGE_MAX(x)          HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MAX_N(x, n)     HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, n)
+
+enum
+{
+   HID_COLLECTION_PHYSICAL    = 0,
+   HID_COLLECTION_APPLICATION = 1,
+   HID_COLLECTION_LOGICAL     = 2
+};
+
+enum
+{
+   HID_USAGE_PAGE_DESKTOP  = 0x01,
+   HID_USAGE_PAGE_KEYBOARD = 0x07,
+   HID_USAGE_PAGE_LED      = 0x08,
+   HID_USAGE_PAGE_BUTTON   = 0x09,
+   HID_USAGE_PAGE_CONSUMER = 0x0c,
+   HID_USAGE_PAGE_VENDOR   = 0xFF00
+};
+
+// Keyboard usages, only those the firmware's key maps use
+#define HID_KEY_A             0x04
+#define HID_KEY_D             0x07
+#define HID_KEY_F             0x09
+#define HID_KEY_G             0x0A
+#define HID_KEY_I             0x0C
+#define HID_KEY_K             0x0E
+#define HID_KEY_Q             0x14
+#define HID_KEY_R             0x15
+#define HID_KEY_S             0x16
+#define HID_KEY_W             0x1A
+#define HID_KEY_X             0x1B
+#define HID_KEY_Z             0x1D
+#define HID_KEY_1             0x1E
+#define HID_KEY_5             0x22
+#define HID_KEY_9             0x26
+#define HID_KEY_SPACE         0x2C
+#define HID_KEY_ARROW_RIGHT   0x4F
+#define HID_KEY_ARROW_LEFT    0x50
+#define HID_KEY_ARROW_DOWN    0x51
+#define HID_KEY_ARROW_UP      0x52
+#define HID_KEY_CONTROL_LEFT  0xE0
+#define HID_KEY_SHIFT_LEFT    0xE1
+#define HID_KEY_ALT_LEFT      0xE2
+
+enum
+{
+   HID_USAGE_DESKTOP_POINTER    = 0x01,
+   HID_USAGE_DESKTOP_MOUSE      = 0x02,
+   HID_USAGE_DESKTOP_JOYSTICK   = 0x04,
+   HID_USAGE_DESKTOP_GAMEPAD    = 0x05,
+   HID_USAGE_DESKTOP_KEYBOARD   = 0x06,
+   HID_USAGE_DESKTOP_X          = 0x30,
+   HID_USAGE_DESKTOP_Y          = 0x31,
+   HID_USAGE_DESKTOP_Z          = 0x32,
+   HID_USAGE_DESKTOP_RX         = 0x33,
+   HID_USAGE_DESKTOP_RY         = 0x34,
+   HID_USAGE_DESKTOP_RZ         = 0x35,
+   HID_USAGE_DESKTOP_WHEEL      = 0x38,
+   HID_USAGE_DESKTOP_HAT_SWITCH = 0x39
+};
+
+enum
+{
+   HID_USAGE_CONSUMER_AC_PAN = 0x0238
+};
+
+#define TUD_HID_REPORT_DESC_GAMEPAD(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP     )                 ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_GAMEPAD  )                 ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION )                 ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    /* 8 bit X, Y, Z, Rz, Rx, Ry (min -127, max 127 ) */ \
+    HID_USAGE_PAGE     ( HID_USAGE_PAGE_DESKTOP                 ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_X                    ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_Y                    ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_Z                    ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_RZ                   ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_RX                   ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_RY                   ) ,\
+    HID_LOGICAL_MIN    ( 0x81                                   ) ,\
+    HID_LOGICAL_MAX    ( 0x7f                                   ) ,\
+    HID_REPORT_COUNT   ( 6                                      ) ,\
+    HID_REPORT_SIZE    ( 8                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    /* 8 bit DPad/Hat Button Map  */ \
+    HID_USAGE_PAGE     ( HID_USAGE_PAGE_DESKTOP                 ) ,\
+    HID_USAGE          ( HID_USAGE_DESKTOP_HAT_SWITCH           ) ,\
+    HID_LOGICAL_MIN    ( 1                                      ) ,\
+    HID_LOGICAL_MAX    ( 8                                      ) ,\
+    HID_PHYSICAL_MIN   ( 0                                      ) ,\
+    HID_PHYSICAL_MAX_N ( 315, 2                                 ) ,\
+    HID_REPORT_COUNT   ( 1                                      ) ,\
+    HID_REPORT_SIZE    ( 8                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+    /* 32 bit Button Map */ \
+    HID_USAGE_PAGE     ( HID_USAGE_PAGE_BUTTON                  ) ,\
+    HID_USAGE_MIN      ( 1                                      ) ,\
+    HID_USAGE_MAX      ( 32                                     ) ,\
+    HID_LOGICAL_MIN    ( 0                                      ) ,\
+    HID_LOGICAL_MAX    ( 1                                      ) ,\
+    HID_REPORT_COUNT   ( 32                                     ) ,\
+    HID_REPORT_SIZE    ( 1                                      ) ,\
+    HID_INPUT          ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+  HID_COLLECTION_END \
+
+#define TUD_HID_REPORT_DESC_MOUSE(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP      )                   ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_MOUSE     )                   ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION  )                   ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    HID_USAGE      ( HID_USAGE_DESKTOP_POINTER )                   ,\
+    HID_COLLECTION ( HID_COLLECTION_PHYSICAL   )                   ,\
+      HID_USAGE_PAGE  ( HID_USAGE_PAGE_BUTTON  )                   ,\
+        HID_USAGE_MIN   ( 1                                      ) ,\
+        HID_USAGE_MAX   ( 5                                      ) ,\
+        HID_LOGICAL_MIN ( 0                                      ) ,\
+        HID_LOGICAL_MAX ( 1                                      ) ,\
+        /* Left, Right, Middle, Backward, Forward buttons */ \
+        HID_REPORT_COUNT( 5                                      ) ,\
+        HID_REPORT_SIZE ( 1                                      ) ,\
+        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+        /* 3 bit padding */ \
+        HID_REPORT_COUNT( 1                                      ) ,\
+        HID_REPORT_SIZE ( 3                                      ) ,\
+        HID_INPUT       ( HID_CONSTANT                           ) ,\
+      HID_USAGE_PAGE  ( HID_USAGE_PAGE_DESKTOP )                   ,\
+        /* X, Y position [-127, 127] */ \
+        HID_USAGE       ( HID_USAGE_DESKTOP_X                    ) ,\
+        HID_USAGE       ( HID_USAGE_DESKTOP_Y                    ) ,\
+        HID_LOGICAL_MIN ( 0x81                                   ) ,\
+        HID_LOGICAL_MAX ( 0x7f                                   ) ,\
+        HID_REPORT_COUNT( 2                                      ) ,\
+        HID_REPORT_SIZE ( 8                                      ) ,\
+        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ) ,\
+        /* Verital wheel scroll [-127, 127] */ \
+        HID_USAGE       ( HID_USAGE_DESKTOP_WHEEL                )  ,\
+        HID_LOGICAL_MIN ( 0x81                                   )  ,\
+        HID_LOGICAL_MAX ( 0x7f                                   )  ,\
+        HID_REPORT_COUNT( 1                                      )  ,\
+        HID_REPORT_SIZE ( 8                                      )  ,\
+        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE )  ,\
+      HID_USAGE_PAGE_N ( HID_USAGE_PAGE_CONSUMER, 2    ), \
+       /* Horizontal wheel scroll [-127, 127] */ \
+        HID_USAGE_N     ( HID_USAGE_CONSUMER_AC_PAN, 2           ), \
+        HID_LOGICAL_MIN ( 0x81                                   ), \
+        HID_LOGICAL_MAX ( 0x7f                                   ), \
+        HID_REPORT_COUNT( 1                                      ), \
+        HID_REPORT_SIZE ( 8                                      ), \
+        HID_INPUT       ( HID_DATA | HID_VARIABLE | HID_RELATIVE ), \
+    HID_COLLECTION_END                                            , \
+  HID_COLLECTION_END \
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+
+enum
+{
+   CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL = 2,
+   CDC_COMM_PROTOCOL_NONE                   = 0,
+   CDC_FUNC_DESC_HEADER                     = 0x00,
+   CDC_FUNC_DESC_CALL_MANAGEMENT            = 0x01,
+   CDC_FUNC_DESC_ABSTRACT_CONTROL_MANAGEMENT = 0x02,
+   CDC_FUNC_DESC_UNION                      = 0x06,
+};
+
+#define TUD_CDC_DESC_LEN (8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7)
+
+#define TUD_CDC_DESCRIPTOR(_itfnum, _stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize) \
+  /* Interface Associate */\
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_CDC, CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL, CDC_COMM_PROTOCOL_NONE, 0,\
+  /* CDC Control Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_CDC, CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL, CDC_COMM_PROTOCOL_NONE, _stridx,\
+  /* CDC Header */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_HEADER, U16_TO_U8S_LE(0x0120),\
+  /* CDC Call */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_CALL_MANAGEMENT, 0, (uint8_t)((_itfnum) + 1),\
+  /* CDC ACM: support line request */\
+  4, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_ABSTRACT_CONTROL_MANAGEMENT, 2,\
+  /* CDC Union */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_UNION, _itfnum, (uint8_t)((_itfnum) + 1),\
+  /* Endpoint Notification */\
+  7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_notif_size), 16,\
+  /* CDC Data Interface */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum) + 1), 0, 2, TUSB_CLASS_CDC_DATA, 0, 0, 0,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+//--------------------------------------------------------------------+
+// Device API (implemented by the simulator)
+//--------------------------------------------------------------------+
+
+bool tusb_init();
+void tud_task();
+
+bool tud_mounted();
+bool tud_suspended();
+bool tud_remote_wakeup();
+void tud_sof_cb_enable(bool en);
+
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, const void *report, uint16_t len);
+
+static inline bool tud_hid_ready()
+{
+   return tud_hid_n_ready(0);
+}
+
+static inline bool tud_hid_report(uint8_t report_id, const void *report, uint16_t len)
+{
+   return tud_hid_n_report(0, report_id, report, len);
+}
+
+bool     tud_cdc_connected();
+uint32_t tud_cdc_write_available();
+uint32_t tud_cdc_write(const void *buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_flush();
+
+//--------------------------------------------------------------------+
+// Application callbacks (implemented by the firmware)
+//--------------------------------------------------------------------+
+
+uint8_t const  *tud_descriptor_device_cb();
+uint8_t const  *tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+uint8_t const  *tud_hid_descriptor_report_cb(uint8_t instance);
+
+void tud_mount_cb();
+void tud_umount_cb();
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb();
+void tud_sof_cb(uint32_t frame_count);
+
+void     tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint8_t len);
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen);
+void     tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t const *buffer, uint16_t bufsize);
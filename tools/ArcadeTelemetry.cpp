@@ -0,0 +1,216 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Reads the firmware's telemetry feature reports (see TelemetryReport.h) over
+// hidraw and prints the counters and histograms. Linux only.
+//
+//   ArcadeTelemetry [--device /dev/hidrawN] [--clear]
+//
+// --clear starts the counts over once they've been printed. Without
+// --device, the first controller found that answers is used.
+
+#include "HidRaw.h"
+#include "TelemetryReport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+constexpr uint32_t BAR_WIDTH = 50;
+
+// Upper bound of a bucket, so percentiles err on the slow side
+static uint32_t BucketTopUS(uint32_t bucket)
+{
+   return bucket == 0 ? 0 : (1u << bucket) - 1;
+}
+
+static void PrintHistogram(const char *name, const TelemetryHistogram &h)
+{
+   uint64_t total = 0;
+
+   for (uint32_t count : h.buckets)
+      total += count;
+
+   printf("\n%s: %llu events, max %u us\n", name, (unsigned long long)total, h.maxUS);
+
+   if (total == 0)
+      return;
+
+   uint32_t largest = 0;
+
+   for (uint32_t count : h.buckets)
+      largest = std::max(largest, count);
+
+   uint64_t seen   = 0;
+   uint32_t p50    = 0;
+   uint32_t p99    = 0;
+   bool     gotP50 = false;
+   bool     gotP99 = false;
+
+   for (uint32_t b = 0; b < TELEMETRY_BUCKETS; b++)
+   {
+      uint32_t count = h.buckets[b];
+      seen += count;
+
+      if (!gotP50 && seen * 2 >= total)
+      {
+         p50    = BucketTopUS(b);
+         gotP50 = true;
+      }
+
+      if (!gotP99 && seen * 100 >= total * 99)
+      {
+         p99    = BucketTopUS(b);
+         gotP99 = true;
+      }
+
+      if (count == 0)
+         continue;
+
+      char range[24];
+
+      if (b == 0)
+         snprintf(range, sizeof(range), "0");
+      else if (b == TELEMETRY_BUCKETS - 1)
+         snprintf(range, sizeof(range), "%u+", 1u << (b - 1));
+      else if (b == 1)
+         snprintf(range, sizeof(range), "1");
+      else
+         snprintf(range, sizeof(range), "%u-%u", 1u << (b - 1), BucketTopUS(b));
+
+      uint32_t bar = uint32_t(uint64_t(count) * BAR_WIDTH / largest);
+
+      printf("  %10s us %10u %5.1f%% %s\n", range, count, 100.0 * count / total, std::string(bar ? bar : 1, '#').c_str());
+   }
+
+   // The last bucket has no top, so its max stands in
+   if (p99 == BucketTopUS(TELEMETRY_BUCKETS - 1))
+      p99 = h.maxUS;
+   if (p50 == BucketTopUS(TELEMETRY_BUCKETS - 1))
+      p50 = h.maxUS;
+
+   printf("  p50 <= %u us, p99 <= %u us\n", p50, p99);
+}
+
+int main(int argc, char **argv)
+{
+   std::string device;
+   bool        clear = false;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (!strcmp(argv[i], "--device") && i + 1 < argc)
+         device = argv[++i];
+      else if (!strcmp(argv[i], "--clear"))
+         clear = true;
+      else
+      {
+         fprintf(stderr, "usage: %s [--device /dev/hidrawN] [--clear]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   TelemetryCounters counters;
+   int               fd = HidRaw::Find(&device, TELEMETRY_COUNTERS_ID, &counters, sizeof(counters));
+
+   if (fd < 0)
+   {
+      fprintf(stderr, "no controller found%s%s (check permissions on /dev/hidraw*)\n",
+              device.empty() ? "" : " at ", device.c_str());
+      return 1;
+   }
+
+   if (counters.version != TELEMETRY_VERSION)
+   {
+      fprintf(stderr, "%s: telemetry version %u, expected %u\n", device.c_str(), counters.version, TELEMETRY_VERSION);
+      close(fd);
+      return 1;
+   }
+
+   if (!counters.compiledIn)
+   {
+      printf("%s: built without telemetry (ARCADE_CTRL_TELEMETRY=0)\n", device.c_str());
+      close(fd);
+      return 0;
+   }
+
+   static const struct
+   {
+      uint8_t     id;
+      const char *name;
+   }
+   s_histograms[] =
+   {
+      { TELEMETRY_LOOP_ID,              "main loop iteration" },
+      { TELEMETRY_SAMPLE_TO_QUEUE_ID,   "inputs read -> report queued" },
+      { TELEMETRY_QUEUE_TO_COMPLETE_ID, "report queued -> host took it" },
+   };
+
+   TelemetryHistogram histograms[3];
+
+   for (uint32_t i = 0; i < 3; i++)
+   {
+      if (!HidRaw::GetFeature(fd, s_histograms[i].id, &histograms[i], sizeof(histograms[i])))
+      {
+         fprintf(stderr, "%s: reading report 0x%02x failed\n", device.c_str(), s_histograms[i].id);
+         close(fd);
+         return 1;
+      }
+   }
+
+   if (clear)
+   {
+      TelemetryCounters req = {};
+      req.version = TELEMETRY_VERSION;
+      req.command = TELEMETRY_CLEAR;
+
+      if (!HidRaw::SetFeature(fd, TELEMETRY_COUNTERS_ID, &req, sizeof(req)))
+         fprintf(stderr, "%s: clear failed\n", device.c_str());
+   }
+
+   close(fd);
+
+   double seconds = counters.sinceClearMS / 1000.0;
+
+   printf("%s, over %.1f s\n", device.c_str(), seconds);
+   printf("  loops              %10u  (%.0f/s)\n", counters.loops, seconds > 0 ? counters.loops / seconds : 0.0);
+   printf("  polls              %10u  (%.0f/s)\n", counters.polls, seconds > 0 ? counters.polls / seconds : 0.0);
+   printf("  poll overruns      %10u  latest start %u us after due\n", counters.overruns, counters.maxLateUS);
+   printf("  reports queued     %10u\n", counters.queued);
+   printf("  reports completed  %10u\n", counters.completed);
+   printf("  endpoint busy      %10u\n", counters.readyMisses);
+   printf("  encoder interrupts %10u %10u\n", counters.encoderIRQs[0], counters.encoderIRQs[1]);
+
+   // Core1 only runs, and so only waits, in dual core mode
+   for (uint32_t core = 0; core < 2; core++)
+      printf("  core%u asleep       %9.1f%%  in %u waits\n", core,
+             seconds > 0 ? counters.sleptMS[core] / (10.0 * seconds) : 0.0, counters.sleeps[core]);
+
+   for (uint32_t i = 0; i < 3; i++)
+      PrintHistogram(s_histograms[i].name, histograms[i]);
+
+   return 0;
+}
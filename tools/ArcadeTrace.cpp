@@ -0,0 +1,189 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Decodes the firmware's CDC input trace (see TraceRecord.h) into CSV, one
+// line per record. Reads the ACM tty in raw mode until interrupted, or a
+// capture of it from a file or stdin. Linux only.
+//
+//   ArcadeTrace [/dev/ttyACMn | file | -] > trace.csv
+//
+// Times are unwrapped to 64 bits from the first record. lost is the number
+// of records skipped before this one, whether the firmware dropped them or
+// they were made while no terminal had the port open. A stream opened part
+// way through a record is resynced on the next sync word.
+
+#include "TraceRecord.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+// Makes the tty pass bytes through untouched, and asserts DTR so the
+// firmware sees a terminal and starts writing
+static bool SetRaw(int fd)
+{
+   termios tio;
+
+   if (tcgetattr(fd, &tio) < 0)
+      return false;
+
+   cfmakeraw(&tio);
+   tio.c_cflag |= CLOCAL | CREAD | HUPCL;
+   tio.c_cc[VMIN]  = 1;
+   tio.c_cc[VTIME] = 0;
+
+   if (tcsetattr(fd, TCSANOW, &tio) < 0)
+      return false;
+
+   tcflush(fd, TCIFLUSH);
+   return true;
+}
+
+class Decoder
+{
+public:
+   void Write(const TraceRecord &r)
+   {
+      uint32_t lost = 0;
+
+      if (m_first)
+      {
+         m_sampleUS = r.sampleUS;
+         m_first    = false;
+         printf("seq,lost,sample_us,sent_us,buttons,changed,raw,raw_edges,count0,count1,"
+                "analog0,analog1,analog2,dropped\n");
+      }
+      else
+      {
+         lost        = uint16_t(r.seq - m_lastSeq - 1);
+         m_sampleUS += uint32_t(r.sampleUS - m_lastSampleUS);
+      }
+
+      m_lastSeq      = r.seq;
+      m_lastSampleUS = r.sampleUS;
+
+      printf("%u,%u,%llu,", r.seq, lost, (unsigned long long)m_sampleUS);
+
+      // Queued after the sample by less than a wrap, so relative to it
+      if (r.sentUS != 0)
+         printf("%llu", (unsigned long long)(m_sampleUS + int32_t(r.sentUS - r.sampleUS)));
+
+      printf(",0x%08x,0x%08x,0x%08x,0x%08x,%d,%d,%u,%u,%u,%u\n", r.buttons, r.changed, r.raw, r.rawEdges,
+             r.counts[0], r.counts[1], r.analog[0], r.analog[1], r.analog[2], r.dropped);
+   }
+
+   // Takes whole records off the front of buf, skipping to the next sync
+   // word when one doesn't start with it
+   uint32_t Decode(std::vector<uint8_t> *buf)
+   {
+      size_t   at      = 0;
+      uint32_t skipped = 0;
+
+      while (buf->size() - at >= sizeof(TraceRecord))
+      {
+         TraceRecord r;
+         memcpy(&r, buf->data() + at, sizeof(r));
+
+         if (r.sync != TRACE_SYNC)
+         {
+            at++;
+            skipped++;
+            continue;
+         }
+
+         Write(r);
+         at += sizeof(r);
+      }
+
+      buf->erase(buf->begin(), buf->begin() + at);
+      return skipped;
+   }
+
+private:
+   bool     m_first        = true;
+   uint16_t m_lastSeq      = 0;
+   uint32_t m_lastSampleUS = 0;
+   uint64_t m_sampleUS     = 0;
+};
+
+int main(int argc, char **argv)
+{
+   const char *path = argc > 1 ? argv[1] : "-";
+
+   if (argc > 2 || !strcmp(path, "-h") || !strcmp(path, "--help"))
+   {
+      fprintf(stderr, "usage: %s [/dev/ttyACMn | file | -]\n", argv[0]);
+      return 1;
+   }
+
+   int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : STDIN_FILENO;
+
+   if (fd < 0)
+   {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return 1;
+   }
+
+   bool tty = isatty(fd);
+
+   if (tty && !SetRaw(fd))
+   {
+      fprintf(stderr, "%s: can't set raw mode: %s\n", path, strerror(errno));
+      return 1;
+   }
+
+   // Each record as it comes when watching live
+   if (tty)
+      setvbuf(stdout, nullptr, _IOLBF, 0);
+
+   Decoder              decoder;
+   std::vector<uint8_t> buf;
+   uint8_t              chunk[4096];
+   uint64_t             skipped = 0;
+
+   while (true)
+   {
+      ssize_t len = read(fd, chunk, sizeof(chunk));
+
+      if (len < 0 && errno == EINTR)
+         continue;
+
+      if (len <= 0)
+         break;
+
+      buf.insert(buf.end(), chunk, chunk + len);
+      skipped += decoder.Decode(&buf);
+   }
+
+   if (skipped != 0 || !buf.empty())
+      fprintf(stderr, "%llu bytes skipped resyncing, %zu left over at the end\n", (unsigned long long)skipped,
+              buf.size());
+
+   return 0;
+}
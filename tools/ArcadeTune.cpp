@@ -0,0 +1,219 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+// Reads and changes the firmware's latency settings at runtime, through the
+// tuning feature report on the gamepad interface (see Tuning.h). Linux only,
+// over hidraw, so it needs read/write access to the /dev/hidraw* node.
+//
+//   ArcadeTune [--device /dev/hidrawN] get
+//   ArcadeTune [--device /dev/hidrawN] set [--save] name=value ...
+//
+// Names are poll-ms, release-us, confirm-us, gain, filter and sof-lead-us.
+// Without --device, the first controller found that answers is used.
+
+#include "HidRaw.h"
+#include "Tuning.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+constexpr uint32_t SET_TIMEOUT_MS = 1000;
+
+static const char *StatusName(uint8_t status)
+{
+   static const char *s_names[] =
+   {
+      "ok", "pending", "bad request", "not tunable on this board", "out of range", "busy", "save failed"
+   };
+
+   return status < sizeof(s_names) / sizeof(s_names[0]) ? s_names[status] : "unknown";
+}
+
+static bool GetReport(int fd, TuningReport *report)
+{
+   return HidRaw::GetFeature(fd, TUNING_REPORT_ID, report, sizeof(*report)) && report->version == TUNING_VERSION;
+}
+
+static void Print(const TuningReport &r)
+{
+   auto tunable = [&](uint16_t field) { return (r.fields & field) ? "" : "  (fixed on this board)"; };
+
+   printf("host polls every   %u ms  (fixed at enumeration)\n", r.hidIntervalMS);
+   printf("poll-ms            %u%s\n", r.pollMS, tunable(TUNE_POLL_MS));
+   printf("sof-lead-us        %u%s\n", r.sofLeadUS, tunable(TUNE_SOF_LEAD));
+   printf("release-us         %u%s\n", r.releaseUS, tunable(TUNE_RELEASE_US));
+   printf("confirm-us         %u%s\n", r.confirmUS, tunable(TUNE_CONFIRM_US));
+   printf("gain               %.4f%s\n", r.encoderGain / 65536.0, tunable(TUNE_GAIN));
+   printf("filter             %u%s\n", r.filterShift, tunable(TUNE_FILTER));
+   printf("last set           %s\n", StatusName(r.status));
+}
+
+static bool Parse(const char *arg, TuningReport *req)
+{
+   const char *eq = strchr(arg, '=');
+
+   if (eq == nullptr)
+      return false;
+
+   std::string name(arg, eq - arg);
+   const char *value = eq + 1;
+   char       *end   = nullptr;
+   double      v     = strtod(value, &end);
+
+   if (end == value || *end != '\0' || (v < 0.0 && name != "gain"))
+      return false;
+
+   if (name == "poll-ms")
+   {
+      req->fields |= TUNE_POLL_MS;
+      req->pollMS  = v > 255.0 ? 0 : uint8_t(v);
+   }
+   else if (name == "release-us")
+   {
+      req->fields   |= TUNE_RELEASE_US;
+      req->releaseUS = uint32_t(v);
+   }
+   else if (name == "confirm-us")
+   {
+      req->fields   |= TUNE_CONFIRM_US;
+      req->confirmUS = uint32_t(v);
+   }
+   else if (name == "gain")
+   {
+      req->fields     |= TUNE_GAIN;
+      req->encoderGain = int32_t(v * 65536.0 + (v < 0.0 ? -0.5 : 0.5));
+   }
+   else if (name == "filter")
+   {
+      req->fields     |= TUNE_FILTER;
+      req->filterShift = v > 255.0 ? 255 : uint8_t(v);
+   }
+   else if (name == "sof-lead-us")
+   {
+      req->fields   |= TUNE_SOF_LEAD;
+      req->sofLeadUS = uint32_t(v);
+   }
+   else
+      return false;
+
+   return true;
+}
+
+static int Usage(const char *argv0)
+{
+   fprintf(stderr, "usage: %s [--device /dev/hidrawN] get\n"
+                   "       %s [--device /dev/hidrawN] set [--save] name=value ...\n"
+                   "names: poll-ms release-us confirm-us gain filter sof-lead-us\n", argv0, argv0);
+   return 1;
+}
+
+int main(int argc, char **argv)
+{
+   std::string device;
+   int         i = 1;
+
+   if (i + 1 < argc && !strcmp(argv[i], "--device"))
+   {
+      device = argv[i + 1];
+      i += 2;
+   }
+
+   if (i >= argc)
+      return Usage(argv[0]);
+
+   bool set = !strcmp(argv[i], "set");
+
+   if (!set && strcmp(argv[i], "get"))
+      return Usage(argv[0]);
+
+   TuningReport req = {};
+   req.version = TUNING_VERSION;
+   req.command = TUNING_APPLY;
+
+   for (i++; i < argc; i++)
+   {
+      if (set && !strcmp(argv[i], "--save"))
+         req.command = TUNING_SAVE;
+      else if (!set || !Parse(argv[i], &req))
+         return Usage(argv[0]);
+   }
+
+   // A save on its own keeps what's in use
+   if (set && req.fields == 0 && req.command != TUNING_SAVE)
+      return Usage(argv[0]);
+
+   TuningReport report;
+   int          fd = HidRaw::Find(&device, TUNING_REPORT_ID, &report, sizeof(report));
+
+   if (fd < 0)
+   {
+      fprintf(stderr, "no controller found%s%s (check permissions on /dev/hidraw*)\n",
+              device.empty() ? "" : " at ", device.c_str());
+      return 1;
+   }
+
+   if (report.version != TUNING_VERSION)
+   {
+      fprintf(stderr, "%s: tuning version %u, expected %u\n", device.c_str(), report.version, TUNING_VERSION);
+      close(fd);
+      return 1;
+   }
+
+   if (set)
+   {
+      if (!HidRaw::SetFeature(fd, TUNING_REPORT_ID, &req, sizeof(req)))
+      {
+         fprintf(stderr, "%s: set failed: %s\n", device.c_str(), strerror(errno));
+         close(fd);
+         return 1;
+      }
+
+      // Applied at the next poll, and a save waits on that, so give it a moment
+      for (uint32_t waited = 0; ; waited += 10)
+      {
+         usleep(10 * 1000);
+
+         if (!GetReport(fd, &report))
+         {
+            fprintf(stderr, "%s: get failed: %s\n", device.c_str(), strerror(errno));
+            close(fd);
+            return 1;
+         }
+
+         if (report.status != TUNING_PENDING || waited >= SET_TIMEOUT_MS)
+            break;
+      }
+   }
+
+   close(fd);
+
+   printf("%s\n", device.c_str());
+   Print(report);
+
+   return set && report.status != TUNING_OK ? 1 : 0;
+}
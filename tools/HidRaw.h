@@ -0,0 +1,116 @@
+/*
+ * The MIT License (MIT)
+
+ * Copyright (c) 2023 Gary Sweet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+// hidraw access shared by the host tools. Linux only.
+
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace HidRaw
+{
+
+constexpr uint16_t USB_VID = 0xBA5E;
+
+// Feature reports as the firmware sees them, without the report ID hidraw
+// puts in front
+inline bool GetFeature(int fd, uint8_t reportID, void *report, size_t len)
+{
+   uint8_t buf[64] = { reportID };
+
+   if (len + 1 > sizeof(buf))
+      return false;
+
+   int got = ioctl(fd, HIDIOCGFEATURE(len + 1), buf);
+
+   if (got != int(len + 1) || buf[0] != reportID)
+      return false;
+
+   memcpy(report, buf + 1, len);
+   return true;
+}
+
+inline bool SetFeature(int fd, uint8_t reportID, const void *report, size_t len)
+{
+   uint8_t buf[64] = { reportID };
+
+   if (len + 1 > sizeof(buf))
+      return false;
+
+   memcpy(buf + 1, report, len);
+   return ioctl(fd, HIDIOCSFEATURE(len + 1), buf) == int(len + 1);
+}
+
+// One of ours at path that answers the given feature report, which only the
+// gamepad interface does, read into report
+inline int Open(const char *path, uint8_t reportID, void *report, size_t len)
+{
+   int fd = open(path, O_RDWR);
+
+   if (fd < 0)
+      return -1;
+
+   hidraw_devinfo info = {};
+
+   if (ioctl(fd, HIDIOCGRAWINFO, &info) < 0 || uint16_t(info.vendor) != USB_VID ||
+       !GetFeature(fd, reportID, report, len))
+   {
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+// As Open(), at *path if set or else the first controller found, whose
+// path is then returned there
+inline int Find(std::string *path, uint8_t reportID, void *report, size_t len)
+{
+   if (!path->empty())
+      return Open(path->c_str(), reportID, report, len);
+
+   for (uint32_t i = 0; i < 64; i++)
+   {
+      std::string candidate = "/dev/hidraw" + std::to_string(i);
+      int         fd        = Open(candidate.c_str(), reportID, report, len);
+
+      if (fd >= 0)
+      {
+         *path = candidate;
+         return fd;
+      }
+   }
+
+   return -1;
+}
+
+}
@@ -94,15 +94,26 @@
 #define CFG_TUD_ENDPOINT0_SIZE    64
 #endif
 
+// Builds with ARCADE_CTRL_TRACE add a CDC ACM interface streaming the input trace
+#ifndef ARCADE_CTRL_TRACE
+#define ARCADE_CTRL_TRACE         0
+#endif
+
 //------------- CLASS -------------//
-#define CFG_TUD_HID               1
-#define CFG_TUD_CDC               0
+#define CFG_TUD_HID               2 // Gamepad, plus mouse when split
+#define CFG_TUD_CDC               ARCADE_CTRL_TRACE
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
-// HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    16
+// HID buffer size Should be sufficient to hold ID (if any) + Data. Feature
+// reports go through it too, so it's sized for the largest, TelemetryHistogram.
+#define CFG_TUD_HID_EP_BUFSIZE    64
+
+// The trace only goes out, so most of the room is for transmit
+#define CFG_TUD_CDC_RX_BUFSIZE    64
+#define CFG_TUD_CDC_TX_BUFSIZE    1024
+#define CFG_TUD_CDC_EP_BUFSIZE    64
 
 #ifdef __cplusplus
  }